@@ -27,6 +27,11 @@ extern "C" {
 #define AI_AUDIO_PCM_FRAME_SIZE  (320)
 
 #define AI_AUDIO_VOICE_FRAME_LEN_GET(tm_ms) ((tm_ms) / AI_AUDIO_PCM_FRAME_TM_MS * AI_AUDIO_PCM_FRAME_SIZE)
+
+// log the delay from capture to cloud upload of every uploaded chunk
+#ifndef AI_AUDIO_LATENCY_TRACE
+#define AI_AUDIO_LATENCY_TRACE 0
+#endif
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
@@ -60,6 +65,9 @@ typedef struct {
 
 typedef void (*AI_AUDIO_INOUT_INFORM_CB)(AI_AUDIO_INPUT_EVENT_E event, void *arg);
 
+// called in the audio capture context, must not block
+typedef void (*AI_AUDIO_INPUT_DATA_NOTIFY_CB)(uint32_t data_size);
+
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
@@ -85,6 +93,21 @@ uint32_t ai_audio_get_input_data_size(void);
 
 void ai_audio_discard_input_data(uint32_t discard_size);
 
+/**
+ * @brief Sets the callback called once when the buffered input data reaches the threshold.
+ *        It is armed again by every read, discard or reset of the input data.
+ * @param threshold Buffered data size in bytes that triggers the callback.
+ * @param cb Callback function, NULL to stop notifying.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_input_set_data_notify(uint32_t threshold, AI_AUDIO_INPUT_DATA_NOTIFY_CB cb);
+
+/**
+ * @brief Gets the capture time of the first byte returned by the last ai_audio_get_input_data.
+ * @return SYS_TIME_T - capture time in milliseconds.
+ */
+SYS_TIME_T ai_audio_get_input_data_capture_ms(void);
+
 #ifdef __cplusplus
 }
 #endif
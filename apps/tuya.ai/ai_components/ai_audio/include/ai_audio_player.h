@@ -23,6 +23,9 @@ extern "C" {
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
+// largest frame a decoder may need in contiguous memory, and decode to
+#define AI_AUDIO_DECODER_IN_FRAME_MAX  (1940)
+#define AI_AUDIO_DECODER_PCM_FRAME_MAX (576 * 2 * 2 * 2)
 
 /***********************************************************
 ***********************typedef define***********************
@@ -53,6 +56,33 @@ typedef enum {
     AI_AUDIO_ALERT_FREE_TALK,
 } AI_AUDIO_ALERT_TYPE_E;
 
+/**
+ * @brief Streaming decoder used by the player.
+ *
+ * The player hands at least in_frame_max contiguous bytes to decode() unless
+ * the stream is at its end, and keeps the decoder handle across streams.
+ */
+typedef struct {
+    const char *name;
+    uint32_t in_frame_max;  // max stream bytes of one frame, <= AI_AUDIO_DECODER_IN_FRAME_MAX
+    uint32_t pcm_frame_max; // max pcm bytes of one frame, <= AI_AUDIO_DECODER_PCM_FRAME_MAX
+
+    // create the handle if *handle is NULL, then reset it for a new stream
+    OPERATE_RET (*start)(void **handle);
+    // decode one frame, consumed 0 means no whole frame, pcm_len 0 means the consumed bytes are skipped
+    OPERATE_RET (*decode)(void *handle, uint8_t *in, uint32_t in_len, uint32_t *consumed, uint8_t *pcm,
+                          uint32_t *pcm_len);
+    void (*close)(void *handle);
+} AI_AUDIO_DECODER_T;
+
+typedef struct {
+    uint32_t frame_num;     // frames decoded
+    uint32_t underrun_num;  // times the speaker ran dry before the end of a stream
+    uint32_t jitter_len;    // stream bytes buffered before playing
+    uint32_t decode_max_ms; // decode time of one frame
+    uint32_t decode_avg_ms;
+} AI_AUDIO_PLAYER_STATS_T;
+
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
@@ -119,6 +149,24 @@ OPERATE_RET ai_audio_player_play_alert_syn(AI_AUDIO_ALERT_TYPE_E type);
  */
 uint8_t ai_audio_player_is_playing(void);
 
+/**
+ * @brief Sets the decoder used for the following streams.
+ *
+ * @param decoder   The decoder, must stay valid while it is in use.
+ *
+ * @return OPERATE_RET - Returns OPRT_OK if the decoder is set, OPRT_RESOURCE_NOT_READY if a stream is playing.
+ */
+OPERATE_RET ai_audio_player_set_decoder(const AI_AUDIO_DECODER_T *decoder);
+
+/**
+ * @brief Gets the playback statistics since the player was initialized.
+ *
+ * @param stats     Pointer to the statistics to fill.
+ *
+ * @return None
+ */
+void ai_audio_player_get_stats(AI_AUDIO_PLAYER_STATS_T *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,7 @@
 ************************macro define************************
 ***********************************************************/
 #define AI_AGENT_NLG_TEXT_MAX_LEN (4 * 1024)
+#define AI_AGENT_UPLOAD_WAIT_MS   1000
 
 #define TY_BIZCODE_AI_CHAT     0x00010001 // 聊天场景可支持打断
 #define TY_AI_CHAT_ID_DS_CNT   4
@@ -547,12 +548,13 @@ OPERATE_RET ai_audio_agent_upload_start(uint8_t enable_vad)
 OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
 {
     OPERATE_RET rt = OPRT_OK;
+    char *frame = NULL;
 
 #if defined(AI_AUDIO_DEBUG) && (AI_AUDIO_DEBUG == 1)
     ai_audio_debug_data((char *)data, len);
 #endif
 
-    // send data use tuya_ai_send_biz_pkt, pcm
+    // pcm frames are pushed to the biz send queue, the capture thread does not wait for the socket
     AI_BIZ_ATTR_INFO_T attr = {
         .flag = AI_HAS_ATTR,
         .type = AI_PT_AUDIO,
@@ -588,7 +590,12 @@ OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
 
     PR_DEBUG("tuya ai upload data[%d][%d]...", head.stream_flag, len);
 
-    TUYA_CALL_ERR_RETURN(tuya_ai_send_biz_pkt(TY_AI_CHAT_ID_DS_AUDIO, &attr, AI_PT_AUDIO, &head, (char *)data));
+    frame = tuya_ai_biz_frame_alloc(len);
+    TUYA_CHECK_NULL_RETURN(frame, OPRT_MALLOC_FAILED);
+    if (data && len) {
+        memcpy(frame, data, len);
+    }
+    TUYA_CALL_ERR_RETURN(tuya_ai_biz_frame_push(TY_AI_CHAT_ID_DS_AUDIO, AI_PT_AUDIO, &attr, &head, frame));
 
     return rt;
 }
@@ -609,6 +616,8 @@ OPERATE_RET ai_audio_agent_upload_stop(void)
 #endif
 
     TUYA_CALL_ERR_RETURN(ai_audio_agent_upload_data(NULL, 0));
+    // the payloads end event is sent directly, it must follow the last audio frame
+    TUYA_CALL_ERR_LOG(tuya_ai_biz_frame_wait(AI_AGENT_UPLOAD_WAIT_MS));
 
     AI_ATTRIBUTE_T attr[] = {{
         .type = 1002,
@@ -24,6 +24,8 @@
 #define AI_AUDIO_UPLOAD_MIN_TIME_MS  (100)
 #define AI_AUDIO_UPLOAD_BUFF_TIME_MS (100)
 #define AI_AUDIO_WAIT_ASR_TM_MS      (10 * 1000)
+// input data wakes up the task, the timeout is only a fallback
+#define AI_CLOUD_ASR_FETCH_TM_MS     (200)
 
 #define AI_CLOUD_ASR_EVENT(event)                                                                                      \
     do {                                                                                                               \
@@ -104,6 +106,29 @@ static void __ai_audio_wait_cloud_asr_tm_cb(TIMER_ID timer_id, void *arg)
     return;
 }
 
+static void __ai_audio_input_data_notify(uint32_t data_size)
+{
+    AI_CLOUD_ASR_MSG_T send_msg;
+
+    send_msg.event = sg_ai_cloud_asr.is_uploading ? AI_CLOUD_ASR_EVT_UPLOADING : AI_CLOUD_ASR_EVT_UPDATE_VAD;
+    send_msg.is_force_interrupt = false;
+    tal_queue_post(sg_ai_cloud_asr.queue, &send_msg, 0);
+}
+
+static void __ai_audio_cloud_asr_set_notify(bool is_uploading)
+{
+    uint32_t threshold = 0;
+
+    if (is_uploading) {
+        threshold = AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_MIN_TIME_MS);
+    } else {
+        // trim the vad data every AI_AUDIO_UPLOAD_MIN_TIME_MS
+        threshold = AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_VAD_TM_MS + AI_AUDIO_UPLOAD_MIN_TIME_MS);
+    }
+
+    ai_audio_input_set_data_notify(threshold, __ai_audio_input_data_notify);
+}
+
 static void __ai_audio_cloud_asr_task(void *arg)
 {
     static AI_CLOUD_ASR_STATE_E last_state;
@@ -114,7 +139,7 @@ static void __ai_audio_cloud_asr_task(void *arg)
     sg_ai_cloud_asr.state = AI_CLOUD_ASR_STATE_IDLE;
 
     for (;;) {
-        rt = tal_queue_fetch(sg_ai_cloud_asr.queue, &msg, 20);
+        rt = tal_queue_fetch(sg_ai_cloud_asr.queue, &msg, AI_CLOUD_ASR_FETCH_TM_MS);
         if (OPRT_OK != rt) {
             // wait event timeout
             if (true == sg_ai_cloud_asr.is_uploading) {
@@ -140,6 +165,7 @@ static void __ai_audio_cloud_asr_task(void *arg)
             }
 
             sg_ai_cloud_asr.state = AI_CLOUD_ASR_STATE_IDLE;
+            __ai_audio_cloud_asr_set_notify(false);
 
             send_msg.event = AI_CLOUD_ASR_EVT_UPDATE_VAD;
             send_msg.is_force_interrupt = false;
@@ -166,6 +192,7 @@ static void __ai_audio_cloud_asr_task(void *arg)
             rt = ai_audio_agent_upload_start(true);
             if (OPRT_OK == rt) {
                 sg_ai_cloud_asr.state = AI_CLOUD_ASR_STATE_UPLOAD;
+                __ai_audio_cloud_asr_set_notify(true);
                 send_msg.event = AI_CLOUD_ASR_EVT_UPLOADING;
                 send_msg.is_force_interrupt = false;
                 tal_queue_post(sg_ai_cloud_asr.queue, &send_msg, 0);
@@ -191,6 +218,10 @@ static void __ai_audio_cloud_asr_task(void *arg)
 
             upload_len = ai_audio_get_input_data(sg_ai_cloud_asr.upload_buffer, sg_ai_cloud_asr.upload_buffer_len);
             TUYA_CALL_ERR_LOG(ai_audio_agent_upload_data(sg_ai_cloud_asr.upload_buffer, upload_len));
+#if defined(AI_AUDIO_LATENCY_TRACE) && (AI_AUDIO_LATENCY_TRACE == 1)
+            PR_DEBUG("audio capture to upload: %d ms, len:%d",
+                     (int)(tal_system_get_millisecond() - ai_audio_get_input_data_capture_ms()), upload_len);
+#endif
         } break;
         case AI_CLOUD_ASR_EVT_STOP: {
             uint32_t upload_len = 0;
@@ -227,6 +258,7 @@ static void __ai_audio_cloud_asr_task(void *arg)
             tal_sw_timer_start(sg_ai_cloud_asr.asr_timer_id, AI_AUDIO_WAIT_ASR_TM_MS, TAL_TIMER_ONCE);
             sg_ai_cloud_asr.state = AI_CLOUD_ASR_STATE_WAIT_ASR;
             sg_ai_cloud_asr.is_uploading = false;
+            __ai_audio_cloud_asr_set_notify(false);
         } break;
 
             AI_CLOUD_ASR_STAT_CHANGE(last_state, sg_ai_cloud_asr.state);
@@ -256,6 +288,7 @@ OPERATE_RET ai_audio_cloud_asr_init(void)
                        __ERR);
 
     TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_ai_cloud_asr.mutex), __ERR);
+    __ai_audio_cloud_asr_set_notify(false);
     TUYA_CALL_ERR_GOTO(tkl_thread_create_in_psram(&sg_ai_cloud_asr.thrd_hdl, "audio_cloud_asr", 1024 * 4, THREAD_PRIO_1,
                                                   __ai_audio_cloud_asr_task, NULL),
                        __ERR);
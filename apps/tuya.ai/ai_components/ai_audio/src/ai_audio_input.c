@@ -32,6 +32,9 @@
 
 #define ASR_PROCE_UNIT_NUM    30
 #define ASR_WAKEUP_TIMEOUT_MS (30000)
+
+// the input state machine also steps without new frames while data is buffered or the asr timeout is to be informed
+#define AI_AUDIO_INPUT_STEP_MS (10)
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
@@ -43,6 +46,7 @@ typedef struct {
     MUTEX_HANDLE        rb_mutex;
     TUYA_RINGBUFF_T     feed_ringbuff;
     uint32_t            buff_len;
+    uint8_t            *unit_buff;
 }AI_AUDIO_INPUT_ASR_T;
 
 typedef struct {
@@ -55,6 +59,13 @@ typedef struct {
 
     TUYA_RINGBUFF_T                ringbuff_hdl;
     MUTEX_HANDLE                   rb_mutex;
+    SEM_HANDLE                     frame_sem;
+    SYS_TIME_T                     last_frame_ms;
+    SYS_TIME_T                     read_capture_ms;
+
+    uint32_t                       notify_threshold;
+    bool                           is_notify_armed;
+    AI_AUDIO_INPUT_DATA_NOTIFY_CB  notify_cb;
 
     AI_AUDIO_INPUT_ASR_T           asr;  
 
@@ -96,6 +107,8 @@ static void __ai_audio_asr_wakeup_timeout(TIMER_ID timer_id, void *arg)
     PR_NOTICE("asr wakeup timeout");
     sg_audio_input.asr.is_wakeup = false;
     sg_audio_input.asr.is_need_inform_wakeup_stop = true;
+    // the frame task may be blocked with no data
+    tal_semaphore_post(sg_audio_input.frame_sem);
 }
 
 static OPERATE_RET __ai_audio_asr_init(void)
@@ -116,6 +129,12 @@ static OPERATE_RET __ai_audio_asr_init(void)
                        __ASR_INIT_ERR);
     TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_audio_input.asr.rb_mutex), __ASR_INIT_ERR);
 
+    sg_audio_input.asr.unit_buff = tkl_system_psram_malloc(tkl_asr_get_process_uint_size());
+    if (NULL == sg_audio_input.asr.unit_buff) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __ASR_INIT_ERR;
+    }
+
     return OPRT_OK;
 
 __ASR_INIT_ERR:
@@ -155,6 +174,9 @@ static __attribute__((unused)) OPERATE_RET __ai_audio_asr_deinit(void)
     TUYA_CALL_ERR_LOG(tal_mutex_release(sg_audio_input.asr.rb_mutex));
     sg_audio_input.asr.rb_mutex = NULL;
 
+    tkl_system_psram_free(sg_audio_input.asr.unit_buff);
+    sg_audio_input.asr.unit_buff = NULL;
+
     return OPRT_OK;
 }
 
@@ -191,11 +213,8 @@ static TKL_ASR_WAKEUP_WORD_E __asr_recognize_wakeup_keyword(void)
         return TKL_ASR_WAKEUP_WORD_UNKNOWN;
     }
 
-    uint8_t *p_buf = tkl_system_psram_malloc(uint_size);
-    if (NULL == p_buf) {
-        PR_ERR("malloc fail");
-        return TKL_ASR_WAKEUP_WORD_UNKNOWN;
-    }
+    // only the input task recognizes, the unit buffer is reused for every unit
+    uint8_t *p_buf = sg_audio_input.asr.unit_buff;
 
     fc = feed_size / uint_size;
     for (i = 0; i < fc; i++) {
@@ -209,8 +228,6 @@ static TKL_ASR_WAKEUP_WORD_E __asr_recognize_wakeup_keyword(void)
         }
     }
 
-    tkl_system_psram_free(p_buf);
-
     return wakeup_word;
 }
 
@@ -264,6 +281,7 @@ static OPERATE_RET __ai_audio_input_rb_reset(void)
 {
     tal_mutex_lock(sg_audio_input.rb_mutex);
     tuya_ring_buff_reset(sg_audio_input.ringbuff_hdl);
+    sg_audio_input.is_notify_armed = true;
     tal_mutex_unlock(sg_audio_input.rb_mutex);
 
     return OPRT_OK;
@@ -382,10 +400,25 @@ static void __ai_audio_get_input_frame(TDL_AUDIO_FRAME_FORMAT_E type, TDL_AUDIO_
         __ai_audio_detect_valid_data_feed(sg_audio_input.method, (uint8_t *)data, len);
     }
 
+    AI_AUDIO_INPUT_DATA_NOTIFY_CB notify_cb = NULL;
+    uint32_t rb_used_sz = 0;
+
     tal_mutex_lock(sg_audio_input.rb_mutex);
     tuya_ring_buff_write(sg_audio_input.ringbuff_hdl, data, len);
+    sg_audio_input.last_frame_ms = tal_system_get_millisecond();
+    rb_used_sz = tuya_ring_buff_used_size_get(sg_audio_input.ringbuff_hdl);
+    if (sg_audio_input.notify_cb && sg_audio_input.is_notify_armed && rb_used_sz >= sg_audio_input.notify_threshold) {
+        sg_audio_input.is_notify_armed = false;
+        notify_cb = sg_audio_input.notify_cb;
+    }
     tal_mutex_unlock(sg_audio_input.rb_mutex);
 
+    // wake up the consumers instead of letting them poll
+    tal_semaphore_post(sg_audio_input.frame_sem);
+    if (notify_cb) {
+        notify_cb(rb_used_sz);
+    }
+
     return;
 }
 
@@ -394,13 +427,18 @@ static void __ai_audio_handle_frame_task(void *arg)
     uint32_t rb_used_sz = 0;
     AI_AUDIO_INPUT_EVENT_E event = AI_AUDIO_INPUT_EVT_NONE;
     AI_AUDIO_INPUT_STATE_E last_state = AI_AUDIO_INPUT_STATE_IDLE;
+    uint32_t timeout = SEM_WAIT_FOREVER;
 
     while (1) {
+        // posted by every captured frame and the asr timeout, the timed wait only while a step is pending
+        tal_semaphore_wait(sg_audio_input.frame_sem, timeout);
+
         rb_used_sz = tuya_ring_buff_used_size_get(sg_audio_input.ringbuff_hdl);
-        if (0 == rb_used_sz) {
-            tal_system_sleep(10);
+        if (0 == rb_used_sz && false == sg_audio_input.asr.is_need_inform_wakeup_stop) {
+            timeout = SEM_WAIT_FOREVER;
             continue;
         }
+        timeout = AI_AUDIO_INPUT_STEP_MS;
 
         last_state = sg_audio_input.state;
         if (true == sg_audio_input.is_enable_get_valid_data) {
@@ -427,8 +465,6 @@ static void __ai_audio_handle_frame_task(void *arg)
         if ((event != AI_AUDIO_INPUT_EVT_NONE) && sg_audio_input_inform_cb) {
             sg_audio_input_inform_cb(event, NULL);
         }
-
-        tal_system_sleep(10);
     }
 }
 
@@ -490,6 +526,7 @@ OPERATE_RET ai_audio_input_init(AI_AUDIO_INPUT_CFG_T *cfg, AI_AUDIO_INOUT_INFORM
     TUYA_CALL_ERR_RETURN(tuya_ring_buff_create(AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_INPUT_RB_TIME_MS) + 1,
                                                OVERFLOW_PSRAM_STOP_TYPE, &sg_audio_input.ringbuff_hdl));
     TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&sg_audio_input.rb_mutex));
+    TUYA_CALL_ERR_RETURN(tal_semaphore_create_init(&sg_audio_input.frame_sem, 0, 1));
 
     TUYA_CALL_ERR_RETURN(__ai_audio_input_set_method(cfg->get_valid_data_method));
 
@@ -605,7 +642,12 @@ uint32_t ai_audio_get_input_data(uint8_t *buff, uint32_t buff_len)
     }
 
     tal_mutex_lock(sg_audio_input.rb_mutex);
+    // the newest byte was captured with the last frame, the oldest one is used size earlier
+    sg_audio_input.read_capture_ms =
+        sg_audio_input.last_frame_ms - tuya_ring_buff_used_size_get(sg_audio_input.ringbuff_hdl) *
+                                           AI_AUDIO_PCM_FRAME_TM_MS / AI_AUDIO_PCM_FRAME_SIZE;
     read_len = tuya_ring_buff_read(sg_audio_input.ringbuff_hdl, buff, buff_len);
+    sg_audio_input.is_notify_armed = true;
     tal_mutex_unlock(sg_audio_input.rb_mutex);
 
     return read_len;
@@ -626,5 +668,26 @@ void ai_audio_discard_input_data(uint32_t discard_size)
 {
     tal_mutex_lock(sg_audio_input.rb_mutex);
     tuya_ring_buff_discard(sg_audio_input.ringbuff_hdl, discard_size);
+    sg_audio_input.is_notify_armed = true;
+    tal_mutex_unlock(sg_audio_input.rb_mutex);
+}
+
+OPERATE_RET ai_audio_input_set_data_notify(uint32_t threshold, AI_AUDIO_INPUT_DATA_NOTIFY_CB cb)
+{
+    if (NULL == sg_audio_input.rb_mutex) {
+        return OPRT_COM_ERROR;
+    }
+
+    tal_mutex_lock(sg_audio_input.rb_mutex);
+    sg_audio_input.notify_threshold = threshold;
+    sg_audio_input.notify_cb = cb;
+    sg_audio_input.is_notify_armed = true;
     tal_mutex_unlock(sg_audio_input.rb_mutex);
+
+    return OPRT_OK;
+}
+
+SYS_TIME_T ai_audio_get_input_data_capture_ms(void)
+{
+    return sg_audio_input.read_capture_ms;
 }
\ No newline at end of file
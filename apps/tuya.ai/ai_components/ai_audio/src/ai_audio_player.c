@@ -16,7 +16,6 @@
 #include "tkl_thread.h"
 
 #include "tal_api.h"
-#include "tuya_ringbuf.h"
 
 #include "tdl_audio_manage.h"
 
@@ -29,7 +28,7 @@
 ***********************************************************/
 #define MP3_STREAM_BUFF_MAX_LEN (1024 * 64 * 2)
 
-#define MAINBUF_SIZE 1940
+#define MAINBUF_SIZE AI_AUDIO_DECODER_IN_FRAME_MAX
 
 #define MAX_NGRAN 2   /* max granules */
 #define MAX_NCHAN 2   /* max channels */
@@ -38,6 +37,15 @@
 #define MP3_PCM_SIZE_MAX           (MAX_NSAMP * MAX_NCHAN * MAX_NGRAN * 2)
 #define PLAYING_NO_DATA_TIMEOUT_MS (5 * 1000)
 
+// pcm frames decoded ahead of the speaker
+#define AI_AUDIO_PLAYER_PCM_BUF_NUM 3
+
+// stream bytes buffered before playing, doubled on every under-run and halved
+// after AI_AUDIO_PLAYER_JITTER_DECAY_FRAMES frames played without one
+#define AI_AUDIO_PLAYER_JITTER_MIN          (1024 * 2)
+#define AI_AUDIO_PLAYER_JITTER_MAX          (1024 * 32)
+#define AI_AUDIO_PLAYER_JITTER_DECAY_FRAMES (500)
+
 #define AI_AUDIO_PLAYER_STAT_CHANGE(last_stat, new_stat)                                                               \
     do {                                                                                                               \
         if (last_stat != new_stat) {                                                                                   \
@@ -48,6 +56,12 @@
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t gen; // stream generation the frame was decoded in
+} APP_PLAYER_PCM_T;
+
 typedef struct {
     bool is_playing;
     bool is_writing;
@@ -56,138 +70,348 @@ typedef struct {
     TDL_AUDIO_HANDLE_T audio_hdl;
     MUTEX_HANDLE mutex;
     THREAD_HANDLE thrd_hdl;
+    SEM_HANDLE wake_sem; // stream data written or pcm frame played
 
     char *id;
-    TUYA_RINGBUFF_T rb_hdl;
     MUTEX_HANDLE spk_rb_mutex;
+    uint8_t *stream;      // stream ring, frames are decoded in place
+    uint32_t stream_rd;
+    uint32_t stream_used;
+    uint32_t stream_hold; // bytes of the last decoded frame, released on the next read
+    uint8_t *stream_wrap; // linear copy of a frame crossing the end of the ring
     uint8_t is_eof;
     TIMER_ID tm_id;
 
-    mp3dec_t *mp3_dec;
-    mp3dec_frame_info_t mp3_frame_info;
-    uint8_t *mp3_raw;
-    uint8_t *mp3_raw_head;
-    uint32_t mp3_raw_used_len;
-    uint8_t *mp3_pcm; // mp3 decode to pcm buffer
-
+    const AI_AUDIO_DECODER_T *decoder;
+    void *dec_hdl;
+
+    THREAD_HANDLE out_thrd_hdl;
+    MUTEX_HANDLE pcm_mutex;
+    SEM_HANDLE pcm_sem; // pcm frame decoded
+    APP_PLAYER_PCM_T pcm[AI_AUDIO_PLAYER_PCM_BUF_NUM];
+    uint8_t pcm_rd;
+    uint8_t pcm_num;
+    uint32_t pcm_gen;
+
+    bool is_buffering;
+    uint32_t jitter_len;
+    uint32_t smooth_frames;
+    uint32_t decode_ms_sum;
+    AI_AUDIO_PLAYER_STATS_T stats;
 } APP_PLAYER_T;
 
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
+static OPERATE_RET __ai_audio_mp3_start(void **handle);
+static OPERATE_RET __ai_audio_mp3_decode(void *handle, uint8_t *in, uint32_t in_len, uint32_t *consumed, uint8_t *pcm,
+                                         uint32_t *pcm_len);
+static void __ai_audio_mp3_close(void *handle);
 
 /***********************************************************
 ***********************variable define**********************
 ***********************************************************/
 static APP_PLAYER_T sg_player;
 
+static const AI_AUDIO_DECODER_T sg_mp3_decoder = {
+    .name = "mp3",
+    .in_frame_max = MAINBUF_SIZE,
+    .pcm_frame_max = MP3_PCM_SIZE_MAX,
+    .start = __ai_audio_mp3_start,
+    .decode = __ai_audio_mp3_decode,
+    .close = __ai_audio_mp3_close,
+};
+
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
-static OPERATE_RET __ai_audio_player_mp3_start(void)
+static OPERATE_RET __ai_audio_mp3_start(void **handle)
 {
-    OPERATE_RET rt = OPRT_OK;
+    mp3dec_t *mp3_dec = (mp3dec_t *)*handle;
 
-    if (NULL == sg_player.mp3_dec) {
-        sg_player.mp3_dec = (mp3dec_t *)tkl_system_psram_malloc(sizeof(mp3dec_t));
-        if (NULL == sg_player.mp3_dec) {
+    if (NULL == mp3_dec) {
+        mp3_dec = (mp3dec_t *)tkl_system_psram_malloc(sizeof(mp3dec_t));
+        if (NULL == mp3_dec) {
             PR_ERR("malloc mp3dec_t failed");
             return OPRT_MALLOC_FAILED;
         }
+        *handle = mp3_dec;
+    }
+
+    mp3dec_init(mp3_dec);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ai_audio_mp3_decode(void *handle, uint8_t *in, uint32_t in_len, uint32_t *consumed, uint8_t *pcm,
+                                         uint32_t *pcm_len)
+{
+    mp3dec_frame_info_t info;
+
+    int samples = mp3dec_decode_frame((mp3dec_t *)handle, in, in_len, (mp3d_sample_t *)pcm, &info);
+
+    *consumed = info.frame_bytes;
+    *pcm_len = samples * sizeof(mp3d_sample_t);
+
+    return OPRT_OK;
+}
+
+static void __ai_audio_mp3_close(void *handle)
+{
+    tkl_system_psram_free(handle);
+}
+
+static uint32_t __ai_audio_player_stream_write(APP_PLAYER_T *ctx, uint8_t *data, uint32_t len)
+{
+    uint32_t wr = 0, first = 0;
+
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    wr = (ctx->stream_rd + ctx->stream_used) % MP3_STREAM_BUFF_MAX_LEN;
+    len = GET_MIN_LEN(len, MP3_STREAM_BUFF_MAX_LEN - ctx->stream_used);
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+
+    // the reader never touches the free part of the ring, copy without the lock
+    first = GET_MIN_LEN(len, MP3_STREAM_BUFF_MAX_LEN - wr);
+    memcpy(ctx->stream + wr, data, first);
+    memcpy(ctx->stream, data + first, len - first);
+
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    ctx->stream_used += len;
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+
+    return len;
+}
+
+static void __ai_audio_player_stream_reset(APP_PLAYER_T *ctx)
+{
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    ctx->stream_rd = 0;
+    ctx->stream_used = 0;
+    ctx->stream_hold = 0;
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+}
+
+static APP_PLAYER_PCM_T *__ai_audio_player_pcm_get_free(APP_PLAYER_T *ctx)
+{
+    APP_PLAYER_PCM_T *pcm = NULL;
 
-        mp3dec_init(sg_player.mp3_dec);
+    tal_mutex_lock(ctx->pcm_mutex);
+    if (ctx->pcm_num < AI_AUDIO_PLAYER_PCM_BUF_NUM) {
+        pcm = &ctx->pcm[(ctx->pcm_rd + ctx->pcm_num) % AI_AUDIO_PLAYER_PCM_BUF_NUM];
     }
+    tal_mutex_unlock(ctx->pcm_mutex);
 
-    sg_player.mp3_raw_used_len = 0;
+    return pcm;
+}
 
-    return rt;
+static void __ai_audio_player_pcm_put(APP_PLAYER_T *ctx)
+{
+    tal_mutex_lock(ctx->pcm_mutex);
+    ctx->pcm_num++;
+    tal_mutex_unlock(ctx->pcm_mutex);
+
+    tal_semaphore_post(ctx->pcm_sem);
+}
+
+static void __ai_audio_player_underrun(APP_PLAYER_T *ctx)
+{
+    // still buffering, or the speaker has frames left to play
+    if (ctx->is_buffering || ctx->pcm_num > 0) {
+        return;
+    }
+
+    ctx->is_buffering = true;
+    ctx->smooth_frames = 0;
+    ctx->jitter_len = GET_MIN_LEN(ctx->jitter_len * 2, AI_AUDIO_PLAYER_JITTER_MAX);
+    ctx->stats.underrun_num++;
+
+    PR_DEBUG("ai audio player under-run, jitter buffer %d bytes", ctx->jitter_len);
+}
+
+static void __ai_audio_player_frame_done(APP_PLAYER_T *ctx, uint32_t decode_ms)
+{
+    ctx->stats.frame_num++;
+    ctx->decode_ms_sum += decode_ms;
+    if (decode_ms > ctx->stats.decode_max_ms) {
+        ctx->stats.decode_max_ms = decode_ms;
+    }
+
+    if (++ctx->smooth_frames >= AI_AUDIO_PLAYER_JITTER_DECAY_FRAMES) {
+        ctx->smooth_frames = 0;
+        ctx->jitter_len = ctx->jitter_len / 2;
+        if (ctx->jitter_len < AI_AUDIO_PLAYER_JITTER_MIN) {
+            ctx->jitter_len = AI_AUDIO_PLAYER_JITTER_MIN;
+        }
+    }
 }
 
-static OPERATE_RET __ai_audio_player_mp3_playing(void)
+static OPERATE_RET __ai_audio_player_decoder_start(void)
 {
     OPERATE_RET rt = OPRT_OK;
+
+    rt = sg_player.decoder->start(&sg_player.dec_hdl);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    // wait for the jitter buffer before the first frame
+    sg_player.is_buffering = true;
+
+    return rt;
+}
+
+static OPERATE_RET __ai_audio_player_playing(void)
+{
     APP_PLAYER_T *ctx = &sg_player;
+    APP_PLAYER_PCM_T *pcm = NULL;
+    uint8_t *in = NULL;
+    uint32_t used = 0, in_len = 0, tail_len = 0, consumed = 0;
+    SYS_TIME_T start_ms = 0;
 
-    if (NULL == ctx->mp3_dec) {
-        PR_ERR("mp3 decoder is NULL");
+    if (NULL == ctx->dec_hdl) {
+        PR_ERR("%s decoder is NULL", ctx->decoder->name);
         return OPRT_COM_ERROR;
     }
 
-    tal_mutex_lock(sg_player.spk_rb_mutex);
-    uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-    tal_mutex_unlock(sg_player.spk_rb_mutex);
-    if (0 == rb_used_len && 0 == ctx->mp3_raw_used_len) {
-        // PR_DEBUG("mp3 data is empty");
-        rt = OPRT_RECV_DA_NOT_ENOUGH;
-        goto __EXIT;
+    // release the last frame and see what is buffered in one lock
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    ctx->stream_rd = (ctx->stream_rd + ctx->stream_hold) % MP3_STREAM_BUFF_MAX_LEN;
+    ctx->stream_used -= ctx->stream_hold;
+    ctx->stream_hold = 0;
+    used = ctx->stream_used;
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+
+    if (ctx->is_buffering) {
+        if (used < ctx->jitter_len && !ctx->is_eof) {
+            return OPRT_RECV_DA_NOT_ENOUGH;
+        }
+        ctx->is_buffering = false;
     }
 
-    if (NULL != ctx->mp3_raw_head && ctx->mp3_raw_used_len > 0 && ctx->mp3_raw_head != ctx->mp3_raw) {
-        // PR_DEBUG("move data, offset=%d, used_len=%d", ctx->mp3_raw_head - ctx->mp3_raw, ctx->mp3_raw_used_len);
-        memmove(ctx->mp3_raw, ctx->mp3_raw_head, ctx->mp3_raw_used_len);
+    // a frame is only decoded once it is surely complete, a partial window
+    // would make the decoder resync and drop data
+    if (0 == used || (used < ctx->decoder->in_frame_max && !ctx->is_eof)) {
+        if (!ctx->is_eof) {
+            __ai_audio_player_underrun(ctx);
+        }
+        return OPRT_RECV_DA_NOT_ENOUGH;
     }
-    ctx->mp3_raw_head = ctx->mp3_raw;
 
-    // read new data
-    if (rb_used_len > 0 && ctx->mp3_raw_used_len < MAINBUF_SIZE) {
-        uint32_t read_len = ((MAINBUF_SIZE - ctx->mp3_raw_used_len) > rb_used_len)
-                                ? rb_used_len
-                                : (MAINBUF_SIZE - ctx->mp3_raw_used_len);
+    pcm = __ai_audio_player_pcm_get_free(ctx);
+    if (NULL == pcm) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
 
-        tal_mutex_lock(sg_player.spk_rb_mutex);
-        uint32_t rt_len = tuya_ring_buff_read(ctx->rb_hdl, ctx->mp3_raw + ctx->mp3_raw_used_len, read_len);
-        tal_mutex_unlock(sg_player.spk_rb_mutex);
-        //  PR_DEBUG("read_len=%d rt_len: %d", read_len, rt_len);
+    in = ctx->stream + ctx->stream_rd;
+    tail_len = MP3_STREAM_BUFF_MAX_LEN - ctx->stream_rd;
+    in_len = GET_MIN_LEN(used, tail_len);
+    if (in_len < used && in_len < ctx->decoder->in_frame_max) {
+        // the frame may cross the end of the ring
+        in_len = GET_MIN_LEN(used, ctx->decoder->in_frame_max);
+        memcpy(ctx->stream_wrap, in, tail_len);
+        memcpy(ctx->stream_wrap + tail_len, ctx->stream, in_len - tail_len);
+        in = ctx->stream_wrap;
+    }
 
-        ctx->mp3_raw_used_len += rt_len;
+    start_ms = tal_system_get_millisecond();
+    ctx->decoder->decode(ctx->dec_hdl, in, in_len, &consumed, pcm->data, &pcm->len);
+    if (0 == consumed) {
+        if (ctx->is_eof && in_len == used) {
+            // the rest of the stream is not a whole frame
+            ctx->stream_hold = used;
+        } else {
+            // no frame in the window searched, drop it but keep its end, a frame may start there
+            ctx->stream_hold =
+                (in_len > ctx->decoder->in_frame_max) ? in_len - ctx->decoder->in_frame_max + 1 : 1;
+        }
+        return OPRT_COM_ERROR;
     }
 
-    int samples = mp3dec_decode_frame(ctx->mp3_dec, ctx->mp3_raw_head, ctx->mp3_raw_used_len,
-                                      (mp3d_sample_t *)ctx->mp3_pcm, &ctx->mp3_frame_info);
-    if (samples == 0) {
-        ctx->mp3_raw_used_len = 0;
-        ctx->mp3_raw_head = ctx->mp3_raw;
-        rt = OPRT_COM_ERROR;
-        goto __EXIT;
+    ctx->stream_hold = consumed;
+    if (0 == pcm->len) {
+        // skipped tag or invalid data
+        return OPRT_OK;
     }
 
-    ctx->mp3_raw_used_len -= ctx->mp3_frame_info.frame_bytes;
-    ctx->mp3_raw_head += ctx->mp3_frame_info.frame_bytes;
+    __ai_audio_player_frame_done(ctx, tal_system_get_millisecond() - start_ms);
 
-    tdl_audio_play(ctx->audio_hdl, ctx->mp3_pcm, samples * 2);
+    pcm->gen = ctx->pcm_gen;
+    __ai_audio_player_pcm_put(ctx);
 
-__EXIT:
-    return rt;
+    return OPRT_OK;
 }
 
-static OPERATE_RET __ai_audio_player_mp3_init(void)
+static OPERATE_RET __ai_audio_player_buffer_init(void)
 {
-    OPERATE_RET rt = OPRT_OK;
+    uint32_t i = 0;
 
-    PR_DEBUG("app player mp3 init...");
+    PR_DEBUG("app player buffer init...");
 
-    sg_player.mp3_raw = (uint8_t *)tkl_system_psram_malloc(MAINBUF_SIZE);
-    TUYA_CHECK_NULL_GOTO(sg_player.mp3_raw, __ERR);
+    sg_player.stream = (uint8_t *)tkl_system_psram_malloc(MP3_STREAM_BUFF_MAX_LEN);
+    TUYA_CHECK_NULL_GOTO(sg_player.stream, __ERR);
 
-    sg_player.mp3_pcm = (uint8_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
-    TUYA_CHECK_NULL_GOTO(sg_player.mp3_pcm, __ERR);
+    sg_player.stream_wrap = (uint8_t *)tkl_system_psram_malloc(AI_AUDIO_DECODER_IN_FRAME_MAX);
+    TUYA_CHECK_NULL_GOTO(sg_player.stream_wrap, __ERR);
 
-    return rt;
+    for (i = 0; i < AI_AUDIO_PLAYER_PCM_BUF_NUM; i++) {
+        sg_player.pcm[i].data = (uint8_t *)tkl_system_psram_malloc(AI_AUDIO_DECODER_PCM_FRAME_MAX);
+        TUYA_CHECK_NULL_GOTO(sg_player.pcm[i].data, __ERR);
+    }
+
+    return OPRT_OK;
 
 __ERR:
-    if (sg_player.mp3_pcm) {
-        tkl_system_psram_free(sg_player.mp3_pcm);
-        sg_player.mp3_pcm = NULL;
+    for (i = 0; i < AI_AUDIO_PLAYER_PCM_BUF_NUM; i++) {
+        if (sg_player.pcm[i].data) {
+            tkl_system_psram_free(sg_player.pcm[i].data);
+            sg_player.pcm[i].data = NULL;
+        }
+    }
+
+    if (sg_player.stream_wrap) {
+        tkl_system_psram_free(sg_player.stream_wrap);
+        sg_player.stream_wrap = NULL;
     }
 
-    if (sg_player.mp3_raw) {
-        tkl_system_psram_free(sg_player.mp3_raw);
-        sg_player.mp3_raw = NULL;
+    if (sg_player.stream) {
+        tkl_system_psram_free(sg_player.stream);
+        sg_player.stream = NULL;
     }
 
     return OPRT_COM_ERROR;
 }
 
+static void __ai_audio_player_output_task(void *arg)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    APP_PLAYER_PCM_T *pcm = NULL;
+
+    for (;;) {
+        tal_semaphore_wait(ctx->pcm_sem, SEM_WAIT_FOREVER);
+
+        for (;;) {
+            tal_mutex_lock(ctx->pcm_mutex);
+            pcm = (ctx->pcm_num > 0) ? &ctx->pcm[ctx->pcm_rd] : NULL;
+            tal_mutex_unlock(ctx->pcm_mutex);
+            if (NULL == pcm) {
+                break;
+            }
+
+            // frames decoded before a stop are dropped
+            if (pcm->gen == ctx->pcm_gen) {
+                tdl_audio_play(ctx->audio_hdl, pcm->data, pcm->len);
+            }
+
+            tal_mutex_lock(ctx->pcm_mutex);
+            ctx->pcm_rd = (ctx->pcm_rd + 1) % AI_AUDIO_PLAYER_PCM_BUF_NUM;
+            ctx->pcm_num--;
+            tal_mutex_unlock(ctx->pcm_mutex);
+
+            tal_semaphore_post(ctx->wake_sem);
+        }
+    }
+}
+
 static void __ai_audio_player_task(void *arg)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -197,6 +421,8 @@ static void __ai_audio_player_task(void *arg)
     ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
 
     for (;;) {
+        rt = OPRT_OK;
+
         tal_mutex_lock(sg_player.mutex);
 
         AI_AUDIO_PLAYER_STAT_CHANGE(last_state, ctx->stat);
@@ -210,7 +436,7 @@ static void __ai_audio_player_task(void *arg)
             ctx->is_eof = 0;
         } break;
         case AI_AUDIO_PLAYER_STAT_START: {
-            rt = __ai_audio_player_mp3_start();
+            rt = __ai_audio_player_decoder_start();
             if (rt != OPRT_OK) {
                 ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
             } else {
@@ -218,7 +444,7 @@ static void __ai_audio_player_task(void *arg)
             }
         } break;
         case AI_AUDIO_PLAYER_STAT_PLAY: {
-            rt = __ai_audio_player_mp3_playing();
+            rt = __ai_audio_player_playing();
             if (OPRT_RECV_DA_NOT_ENOUGH == rt) {
                 tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
             } else if (OPRT_OK == rt) {
@@ -226,10 +452,8 @@ static void __ai_audio_player_task(void *arg)
                     tal_sw_timer_stop(ctx->tm_id);
                 }
             }
-            tal_mutex_lock(ctx->spk_rb_mutex);
-            uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-            tal_mutex_unlock(ctx->spk_rb_mutex);
-            if (rb_used_len == 0 && 0 == ctx->mp3_raw_used_len && ctx->is_eof) {
+            // the stream is drained, wait for the speaker to play the rest
+            if (OPRT_RECV_DA_NOT_ENOUGH == rt && ctx->is_eof && 0 == ctx->pcm_num) {
                 PR_DEBUG("app player end");
                 ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
             }
@@ -240,6 +464,8 @@ static void __ai_audio_player_task(void *arg)
             ctx->is_playing = false;
             ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
             ctx->is_eof = 0;
+            PR_DEBUG("app player frames:%d under-runs:%d jitter:%d", ctx->stats.frame_num, ctx->stats.underrun_num,
+                     ctx->jitter_len);
         } break;
         case AI_AUDIO_PLAYER_STAT_PAUSE:
             // do nothing
@@ -250,7 +476,11 @@ static void __ai_audio_player_task(void *arg)
 
         tal_mutex_unlock(sg_player.mutex);
 
-        tal_system_sleep(10);
+        // keep decoding while frames come out and pcm buffers are free,
+        // otherwise wait for stream data or the speaker
+        if (AI_AUDIO_PLAYER_STAT_PLAY != ctx->stat || OPRT_OK != rt) {
+            tal_semaphore_wait(ctx->wake_sem, 10);
+        }
     }
 }
 
@@ -301,14 +531,19 @@ OPERATE_RET ai_audio_player_init(void)
 
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__app_playing_tm_cb, NULL, &sg_player.tm_id), __ERR);
 
-    TUYA_CALL_ERR_GOTO(__ai_audio_player_mp3_init(), __ERR);
-    // ring buffer init
-    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(MP3_STREAM_BUFF_MAX_LEN, OVERFLOW_PSRAM_STOP_TYPE, &sg_player.rb_hdl),
-                       __ERR);
-    // ring buffer mutex init
+    sg_player.decoder = &sg_mp3_decoder;
+    sg_player.jitter_len = AI_AUDIO_PLAYER_JITTER_MIN;
+    TUYA_CALL_ERR_GOTO(__ai_audio_player_buffer_init(), __ERR);
+    // stream ring mutex init
     TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.spk_rb_mutex), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.pcm_mutex), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.wake_sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.pcm_sem, 0, 1), __ERR);
 
     // thread init
+    TUYA_CALL_ERR_GOTO(tkl_thread_create_in_psram(&sg_player.out_thrd_hdl, "ai_player_out", 1024 * 4, THREAD_PRIO_1,
+                                                  __ai_audio_player_output_task, NULL),
+                       __ERR);
     TUYA_CALL_ERR_GOTO(tkl_thread_create_in_psram(&sg_player.thrd_hdl, "ai_player", 1024 * 4, THREAD_PRIO_1,
                                                   __ai_audio_player_task, NULL),
                        __ERR);
@@ -328,9 +563,19 @@ __ERR:
         sg_player.spk_rb_mutex = NULL;
     }
 
-    if (sg_player.rb_hdl) {
-        tuya_ring_buff_free(sg_player.rb_hdl);
-        sg_player.rb_hdl = NULL;
+    if (sg_player.pcm_mutex) {
+        tal_mutex_release(sg_player.pcm_mutex);
+        sg_player.pcm_mutex = NULL;
+    }
+
+    if (sg_player.wake_sem) {
+        tal_semaphore_release(sg_player.wake_sem);
+        sg_player.wake_sem = NULL;
+    }
+
+    if (sg_player.pcm_sem) {
+        tal_semaphore_release(sg_player.pcm_sem);
+        sg_player.pcm_sem = NULL;
     }
 
     return rt;
@@ -410,10 +655,8 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
                (AI_AUDIO_PLAYER_STAT_PLAY == sg_player.stat || AI_AUDIO_PLAYER_STAT_START == sg_player.stat)) {
 
             sg_player.is_writing = true;
-            tal_mutex_lock(sg_player.spk_rb_mutex);
-            uint32_t rb_free_len = tuya_ring_buff_free_size_get(sg_player.rb_hdl);
-            tal_mutex_unlock(sg_player.spk_rb_mutex);
-            if (0 == rb_free_len) {
+            write_len = __ai_audio_player_stream_write(&sg_player, data + alreay_write_len, len - alreay_write_len);
+            if (0 == write_len) {
                 // need unlock mutex before sleep
                 tal_mutex_unlock(sg_player.mutex);
                 tal_system_sleep(3);
@@ -421,12 +664,6 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
                 continue;
             }
 
-            write_len = GET_MIN_LEN(rb_free_len, (len - alreay_write_len));
-
-            tal_mutex_lock(sg_player.spk_rb_mutex);
-            tuya_ring_buff_write(sg_player.rb_hdl, data + alreay_write_len, write_len);
-            tal_mutex_unlock(sg_player.spk_rb_mutex);
-
             alreay_write_len += write_len;
         };
         sg_player.is_writing = false;
@@ -435,6 +672,8 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
     sg_player.is_eof = is_eof;
     tal_mutex_unlock(sg_player.mutex);
 
+    tal_semaphore_post(sg_player.wake_sem);
+
     return OPRT_OK;
 }
 
@@ -468,9 +707,8 @@ OPERATE_RET ai_audio_player_stop(void)
         tal_mutex_lock(sg_player.mutex);
     }
 
-    tal_mutex_lock(sg_player.spk_rb_mutex);
-    tuya_ring_buff_reset(sg_player.rb_hdl);
-    tal_mutex_unlock(sg_player.spk_rb_mutex);
+    __ai_audio_player_stream_reset(&sg_player);
+    sg_player.pcm_gen++;
 
     tdl_audio_play_stop(sg_player.audio_hdl);
 
@@ -577,3 +815,61 @@ uint8_t ai_audio_player_is_playing(void)
 {
     return sg_player.is_playing;
 }
+
+/**
+ * @brief Sets the decoder used for the following streams.
+ *
+ * @param decoder   The decoder, must stay valid while it is in use.
+ *
+ * @return OPERATE_RET - Returns OPRT_OK if the decoder is set, OPRT_RESOURCE_NOT_READY if a stream is playing.
+ */
+OPERATE_RET ai_audio_player_set_decoder(const AI_AUDIO_DECODER_T *decoder)
+{
+    TUYA_CHECK_NULL_RETURN(decoder, OPRT_INVALID_PARM);
+    TUYA_CHECK_NULL_RETURN(sg_player.mutex, OPRT_COM_ERROR);
+
+    if (decoder->in_frame_max > AI_AUDIO_DECODER_IN_FRAME_MAX ||
+        decoder->pcm_frame_max > AI_AUDIO_DECODER_PCM_FRAME_MAX) {
+        PR_ERR("%s decoder frame is too large", decoder->name);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    tal_mutex_lock(sg_player.mutex);
+
+    if (sg_player.is_playing) {
+        tal_mutex_unlock(sg_player.mutex);
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    if (sg_player.dec_hdl) {
+        sg_player.decoder->close(sg_player.dec_hdl);
+        sg_player.dec_hdl = NULL;
+    }
+    sg_player.decoder = decoder;
+
+    tal_mutex_unlock(sg_player.mutex);
+
+    PR_NOTICE("ai audio player decoder: %s", decoder->name);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the playback statistics since the player was initialized.
+ *
+ * @param stats     Pointer to the statistics to fill.
+ *
+ * @return None
+ */
+void ai_audio_player_get_stats(AI_AUDIO_PLAYER_STATS_T *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    tal_mutex_lock(sg_player.mutex);
+    *stats = sg_player.stats;
+    stats->jitter_len = sg_player.jitter_len;
+    stats->decode_avg_ms = sg_player.stats.frame_num ? sg_player.decode_ms_sum / sg_player.stats.frame_num : 0;
+    tal_mutex_unlock(sg_player.mutex);
+}
@@ -0,0 +1,161 @@
+/**
+ * @file ut_ai_audio_player.cpp
+ * @brief audio player test cases, a captured stream is replayed in random chunks
+ * and what reaches the speaker is compared with a one-shot decode, reporting the
+ * under-runs and the decode time per frame.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ai_audio_player.h"
+#include "ai_media_alert.h"
+#include "ut_ai_audio_player_drv.h"
+}
+
+#define PLAYER_UT_COPIES  12
+#define PLAYER_UT_OUT_MAX (64 * 1024 * 1024)
+
+class AiAudioPlayerTest : public ::testing::Test {
+  protected:
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> ref;
+    uint32_t frames = 0;
+    double decode_us_sum = 0;
+    double decode_us_max = 0;
+
+    void SetUp() override
+    {
+        // several copies so the ring wraps and frames cross its end
+        for (int i = 0; i < PLAYER_UT_COPIES; i++) {
+            stream.insert(stream.end(), media_src_power_on, media_src_power_on + sizeof(media_src_power_on));
+        }
+        decode_ref();
+
+        ASSERT_EQ(OPRT_OK, ut_player_open(PLAYER_UT_OUT_MAX));
+    }
+
+    void decode_ref()
+    {
+        ref.resize(PLAYER_UT_OUT_MAX);
+        ref.resize(ut_mp3_decode(stream.data(), stream.size(), ref.data(), ref.size()));
+        ASSERT_GT(ref.size(), 0u);
+    }
+
+    void TearDown() override
+    {
+        ut_player_close();
+    }
+
+    OPERATE_RET step()
+    {
+        uint32_t pcm_num = ut_player_pcm_num();
+        auto begin = std::chrono::steady_clock::now();
+        OPERATE_RET rt = ut_player_step();
+        auto end = std::chrono::steady_clock::now();
+
+        if (ut_player_pcm_num() > pcm_num) {
+            double us = std::chrono::duration<double, std::micro>(end - begin).count();
+            decode_us_sum += us;
+            decode_us_max = std::max(decode_us_max, us);
+            frames++;
+        }
+
+        return rt;
+    }
+
+    // feed chunk bytes at most between decode steps, drain the speaker every play_every steps
+    void replay(uint32_t chunk, uint32_t play_every)
+    {
+        size_t wr = 0;
+
+        for (uint32_t loop = 1;; loop++) {
+            if (wr < stream.size()) {
+                uint32_t len = std::min<size_t>(1 + rand() % chunk, stream.size() - wr);
+                wr += ut_player_write(stream.data() + wr, len);
+                if (wr == stream.size()) {
+                    ut_player_set_eof();
+                }
+            }
+
+            OPERATE_RET rt = step();
+            if (OPRT_RECV_DA_NOT_ENOUGH == rt && wr == stream.size() && 0 == ut_player_pcm_num()) {
+                break;
+            }
+            if (OPRT_RESOURCE_NOT_READY == rt || 0 == (loop % play_every)) {
+                ut_player_drain();
+            }
+        }
+    }
+
+    void expect_played_ref(const char *name)
+    {
+        uint32_t out_len = 0;
+        const uint8_t *out = ut_player_output(&out_len);
+        AI_AUDIO_PLAYER_STATS_T stats;
+
+        ASSERT_EQ(ref.size(), out_len);
+        EXPECT_EQ(0, memcmp(ref.data(), out, out_len));
+
+        ai_audio_player_get_stats(&stats);
+        EXPECT_EQ(frames, stats.frame_num);
+        printf("[ BENCH    ] %s: %u frames, %u under-runs, jitter %u bytes, decode avg %.1f us max %.1f us\n", name,
+               stats.frame_num, stats.underrun_num, stats.jitter_len, frames ? decode_us_sum / frames : 0,
+               decode_us_max);
+    }
+};
+
+TEST_F(AiAudioPlayerTest, replay_random_chunks)
+{
+    srand(1);
+    replay(3000, 2);
+    expect_played_ref("random chunks");
+}
+
+TEST_F(AiAudioPlayerTest, replay_one_byte_chunks)
+{
+    // frames are only decoded once complete, a trickling stream must not drop any
+    srand(2);
+    replay(1, 1);
+    expect_played_ref("one byte chunks");
+}
+
+TEST_F(AiAudioPlayerTest, resync_after_garbage)
+{
+    // runs of garbage longer than a frame, a window without any frame only drops
+    // what cannot start one, the frames buffered behind it or past the end of
+    // the ring are still played
+    size_t clip = sizeof(media_src_power_on);
+    for (int i = PLAYER_UT_COPIES - 1; i > 0; i -= 3) {
+        stream.insert(stream.begin() + i * clip, 20000 + i * 100, 0);
+    }
+    decode_ref();
+    ut_player_use_strict_decoder();
+
+    srand(4);
+    replay(3000, 2);
+    expect_played_ref("resync");
+}
+
+TEST_F(AiAudioPlayerTest, slow_feed_grows_jitter_buffer)
+{
+    AI_AUDIO_PLAYER_STATS_T stats;
+
+    // the speaker outruns the network, every under-run doubles the jitter buffer
+    srand(3);
+    replay(64, 1);
+    expect_played_ref("slow feed");
+
+    ai_audio_player_get_stats(&stats);
+    EXPECT_GT(stats.underrun_num, 0u);
+    EXPECT_GT(stats.jitter_len, (uint32_t)(1024 * 2));
+}
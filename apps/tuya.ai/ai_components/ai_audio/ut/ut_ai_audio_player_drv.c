@@ -0,0 +1,235 @@
+/**
+ * @file ut_ai_audio_player_drv.c
+ * @brief builds the audio player with its speaker, timer and threads replaced, so
+ * the cases can drive the decode loop step by step and capture what is played.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "tal_memory.h"
+
+#define tdl_audio_find             __ut_audio_find
+#define tdl_audio_play             __ut_audio_play
+#define tdl_audio_play_stop        __ut_audio_play_stop
+#define tal_sw_timer_create        __ut_timer_create
+#define tal_sw_timer_start         __ut_timer_start
+#define tal_sw_timer_stop          __ut_timer_stop
+#define tal_sw_timer_is_running    __ut_timer_is_running
+#define tkl_thread_create_in_psram __ut_thread_create
+#define tkl_system_psram_malloc    tal_malloc
+#define tkl_system_psram_free      tal_free
+
+// set by Kconfig on boards with a codec, the fake speaker takes any name
+#ifndef AUDIO_CODEC_NAME
+#define AUDIO_CODEC_NAME "ut_codec"
+#endif
+
+#include "tdl_audio_manage.h"
+#include "tal_sw_timer.h"
+#include "tkl_thread.h"
+
+OPERATE_RET __ut_audio_find(char *name, TDL_AUDIO_HANDLE_T *handle);
+OPERATE_RET __ut_audio_play(TDL_AUDIO_HANDLE_T handle, uint8_t *data, uint32_t len);
+OPERATE_RET __ut_audio_play_stop(TDL_AUDIO_HANDLE_T handle);
+OPERATE_RET __ut_timer_create(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id);
+OPERATE_RET __ut_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type);
+OPERATE_RET __ut_timer_stop(TIMER_ID timer_id);
+BOOL_T __ut_timer_is_running(TIMER_ID timer_id);
+OPERATE_RET __ut_thread_create(TKL_THREAD_HANDLE *thread, const char *name, uint32_t stack_size,
+                               uint32_t priority, const THREAD_FUNC_T func, void *const arg);
+
+#include "../src/ai_audio_player.c"
+
+#include "ut_ai_audio_player_drv.h"
+
+static OPERATE_RET __ut_mp3_strict_decode(void *handle, uint8_t *in, uint32_t in_len, uint32_t *consumed,
+                                          uint8_t *pcm, uint32_t *pcm_len)
+{
+    __ai_audio_mp3_decode(handle, in, in_len, consumed, pcm, pcm_len);
+    if (0 == *pcm_len) {
+        *consumed = 0;
+    }
+
+    return OPRT_OK;
+}
+
+// same handle as the mp3 decoder, it can be swapped in while playing
+static const AI_AUDIO_DECODER_T sg_ut_strict_decoder = {
+    .name = "mp3 strict",
+    .in_frame_max = MAINBUF_SIZE,
+    .pcm_frame_max = MP3_PCM_SIZE_MAX,
+    .start = __ai_audio_mp3_start,
+    .decode = __ut_mp3_strict_decode,
+    .close = __ai_audio_mp3_close,
+};
+
+static uint8_t *sg_out = NULL;
+static uint32_t sg_out_len = 0;
+static uint32_t sg_out_max = 0;
+
+OPERATE_RET __ut_audio_find(char *name, TDL_AUDIO_HANDLE_T *handle)
+{
+    *handle = (TDL_AUDIO_HANDLE_T)&sg_out;
+    return OPRT_OK;
+}
+
+// the speaker, keep everything played for the comparison
+OPERATE_RET __ut_audio_play(TDL_AUDIO_HANDLE_T handle, uint8_t *data, uint32_t len)
+{
+    if (sg_out_len + len > sg_out_max) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    memcpy(sg_out + sg_out_len, data, len);
+    sg_out_len += len;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET __ut_audio_play_stop(TDL_AUDIO_HANDLE_T handle)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET __ut_timer_create(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id)
+{
+    *timer_id = (TIMER_ID)&sg_player;
+    return OPRT_OK;
+}
+
+OPERATE_RET __ut_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET __ut_timer_stop(TIMER_ID timer_id)
+{
+    return OPRT_OK;
+}
+
+BOOL_T __ut_timer_is_running(TIMER_ID timer_id)
+{
+    return FALSE;
+}
+
+// the cases run the player loop themselves
+OPERATE_RET __ut_thread_create(TKL_THREAD_HANDLE *thread, const char *name, uint32_t stack_size,
+                               uint32_t priority, const THREAD_FUNC_T func, void *const arg)
+{
+    *thread = (TKL_THREAD_HANDLE)&sg_player;
+    return OPRT_OK;
+}
+
+OPERATE_RET ut_player_open(uint32_t out_max)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    sg_out = tal_malloc(out_max);
+    TUYA_CHECK_NULL_RETURN(sg_out, OPRT_MALLOC_FAILED);
+    sg_out_len = 0;
+    sg_out_max = out_max;
+
+    TUYA_CALL_ERR_RETURN(ai_audio_player_init());
+    TUYA_CALL_ERR_RETURN(ai_audio_player_start("ut"));
+
+    // what the player task does in AI_AUDIO_PLAYER_STAT_START
+    TUYA_CALL_ERR_RETURN(__ai_audio_player_decoder_start());
+    sg_player.stat = AI_AUDIO_PLAYER_STAT_PLAY;
+
+    return rt;
+}
+
+void ut_player_close(void)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < AI_AUDIO_PLAYER_PCM_BUF_NUM; i++) {
+        tal_free(sg_player.pcm[i].data);
+    }
+    tal_free(sg_player.stream_wrap);
+    tal_free(sg_player.stream);
+    tal_free(sg_player.dec_hdl);
+    tkl_system_free(sg_player.id);
+
+    tal_mutex_release(sg_player.mutex);
+    tal_mutex_release(sg_player.spk_rb_mutex);
+    tal_mutex_release(sg_player.pcm_mutex);
+    tal_semaphore_release(sg_player.wake_sem);
+    tal_semaphore_release(sg_player.pcm_sem);
+    memset(&sg_player, 0, sizeof(sg_player));
+
+    tal_free(sg_out);
+    sg_out = NULL;
+}
+
+uint32_t ut_player_write(const uint8_t *data, uint32_t len)
+{
+    return __ai_audio_player_stream_write(&sg_player, (uint8_t *)data, len);
+}
+
+void ut_player_set_eof(void)
+{
+    sg_player.is_eof = 1;
+}
+
+OPERATE_RET ut_player_step(void)
+{
+    return __ai_audio_player_playing();
+}
+
+uint32_t ut_player_pcm_num(void)
+{
+    return sg_player.pcm_num;
+}
+
+void ut_player_use_strict_decoder(void)
+{
+    sg_player.decoder = &sg_ut_strict_decoder;
+}
+
+// what the output task does once woken up
+uint32_t ut_player_drain(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    APP_PLAYER_PCM_T *pcm = NULL;
+    uint32_t num = 0;
+
+    while (ctx->pcm_num > 0) {
+        pcm = &ctx->pcm[ctx->pcm_rd];
+        if (pcm->gen == ctx->pcm_gen) {
+            tdl_audio_play(ctx->audio_hdl, pcm->data, pcm->len);
+        }
+        ctx->pcm_rd = (ctx->pcm_rd + 1) % AI_AUDIO_PLAYER_PCM_BUF_NUM;
+        ctx->pcm_num--;
+        num++;
+    }
+
+    return num;
+}
+
+const uint8_t *ut_player_output(uint32_t *len)
+{
+    *len = sg_out_len;
+    return sg_out;
+}
+
+uint32_t ut_mp3_decode(const uint8_t *data, uint32_t len, uint8_t *pcm, uint32_t pcm_max)
+{
+    mp3dec_t dec;
+    mp3dec_frame_info_t info;
+    uint32_t offset = 0, pcm_len = 0;
+    int samples = 0;
+
+    mp3dec_init(&dec);
+    while (offset < len && pcm_len + MP3_PCM_SIZE_MAX <= pcm_max) {
+        samples = mp3dec_decode_frame(&dec, data + offset, len - offset, (mp3d_sample_t *)(pcm + pcm_len), &info);
+        if (0 == info.frame_bytes) {
+            break;
+        }
+        offset += info.frame_bytes;
+        pcm_len += samples * sizeof(mp3d_sample_t);
+    }
+
+    return pcm_len;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file ut_ai_audio_player_drv.h
+ * @brief hooks into the audio player for the test cases, see ut_ai_audio_player_drv.c
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_AI_AUDIO_PLAYER_DRV_H__
+#define __UT_AI_AUDIO_PLAYER_DRV_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief init and start the player, with room for out_max bytes of played pcm
+ */
+OPERATE_RET ut_player_open(uint32_t out_max);
+
+void ut_player_close(void);
+
+/**
+ * @brief write to the stream ring, returns the bytes that fit
+ */
+uint32_t ut_player_write(const uint8_t *data, uint32_t len);
+
+void ut_player_set_eof(void);
+
+/**
+ * @brief run one decode step of the player task
+ */
+OPERATE_RET ut_player_step(void);
+
+uint32_t ut_player_pcm_num(void);
+
+/**
+ * @brief switch to an mp3 decoder that does not skip garbage itself, it reports
+ * nothing consumed for a window without a whole frame and the player has to resync
+ */
+void ut_player_use_strict_decoder(void);
+
+/**
+ * @brief play the decoded frames like the output task, returns the frames played
+ */
+uint32_t ut_player_drain(void);
+
+const uint8_t *ut_player_output(uint32_t *len);
+
+/**
+ * @brief decode a whole mp3 stream in one go, the reference for the player
+ */
+uint32_t ut_mp3_decode(const uint8_t *data, uint32_t len, uint8_t *pcm, uint32_t pcm_max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_AI_AUDIO_PLAYER_DRV_H__ */
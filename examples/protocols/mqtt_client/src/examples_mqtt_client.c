@@ -82,7 +82,7 @@ static void mqtt_client_disconnected_cb(void *client, void *userdata)
 
 static void mqtt_client_message_cb(void *client, uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
 {
-    PR_DEBUG("recv message TopicName:%s, payload len:%d", msg->topic, msg->length);
+    PR_DEBUG("recv message TopicName:%.*s, payload len:%d", (int)msg->topic_length, msg->topic, msg->length);
 }
 
 static void mqtt_client_subscribed_cb(void *client, uint16_t msgid, void *userdata)
@@ -0,0 +1,160 @@
+/**
+ * @file ut_crc.cpp
+ * @brief CRC32 and CRC-16/MODBUS test cases against bit-serial references:
+ * check values, every length and alignment of the table paths, split
+ * updates, and a MB/s benchmark.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include "crc32i.h"
+#include "crc_16.h"
+}
+
+#define CRC_UT_LEN_MAX    (300)
+#define CRC_UT_OFFSET_MAX (8)
+
+// reflected IEEE 802.3, one bit at a time
+static unsigned int __crc32_ref(const unsigned char *data, size_t size)
+{
+    unsigned int crc = 0xffffffff;
+
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc ^ 0xffffffff;
+}
+
+// CRC-16/MODBUS, one bit at a time
+static unsigned short __crc16_ref(const unsigned char *data, size_t size)
+{
+    unsigned short crc = 0xffff;
+
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+class CrcTest : public ::testing::Test {
+  protected:
+    std::vector<unsigned char> data;
+
+    void SetUp() override
+    {
+        srand(24);
+        data.resize(CRC_UT_LEN_MAX + CRC_UT_OFFSET_MAX);
+        for (auto &c : data) {
+            c = (unsigned char)rand();
+        }
+    }
+};
+
+TEST_F(CrcTest, check_value)
+{
+    static const char check[] = "123456789";
+
+    EXPECT_EQ(0xcbf43926u, hash_crc32i_total(check, 9));
+    EXPECT_EQ(0x4b37, get_crc_16((unsigned char *)check, 9));
+    EXPECT_EQ(0u, hash_crc32i_total(check, 0));
+    EXPECT_EQ(CRC_16_INIT_VALUE, get_crc_16((unsigned char *)check, 0));
+}
+
+TEST_F(CrcTest, every_length_and_alignment)
+{
+    for (size_t offset = 0; offset <= CRC_UT_OFFSET_MAX; offset++) {
+        for (size_t len = 0; len <= CRC_UT_LEN_MAX; len++) {
+            const unsigned char *p = data.data() + offset;
+            ASSERT_EQ(__crc32_ref(p, len), hash_crc32i_total(p, len)) << "offset " << offset << " len " << len;
+            ASSERT_EQ(__crc16_ref(p, len), get_crc_16((unsigned char *)p, len))
+                << "offset " << offset << " len " << len;
+        }
+    }
+}
+
+TEST_F(CrcTest, split_update)
+{
+    const unsigned char *p = data.data();
+    const size_t len = CRC_UT_LEN_MAX;
+    unsigned int crc32_ref = __crc32_ref(p, len);
+    unsigned short crc16_ref = __crc16_ref(p, len);
+
+    // every two way split, the second piece starts at any alignment
+    for (size_t cut = 0; cut <= len; cut++) {
+        unsigned int hash = hash_crc32i_update(hash_crc32i_init(), p, cut);
+        hash = hash_crc32i_update(hash, p + cut, len - cut);
+        ASSERT_EQ(crc32_ref, hash_crc32i_finish(hash)) << "cut " << cut;
+
+        unsigned short crc = crc_16_update(CRC_16_INIT_VALUE, p, cut);
+        ASSERT_EQ(crc16_ref, crc_16_update(crc, p + cut, len - cut)) << "cut " << cut;
+    }
+
+    // random pieces, as a frame arrives from a stream
+    for (int round = 0; round < 100; round++) {
+        unsigned int hash = hash_crc32i_init();
+        unsigned short crc = CRC_16_INIT_VALUE;
+        for (size_t pos = 0, piece = 0; pos < len; pos += piece) {
+            piece = std::min(len - pos, (size_t)(rand() % 20));
+            hash = hash_crc32i_update(hash, p + pos, piece);
+            crc = crc_16_update(crc, p + pos, piece);
+        }
+        ASSERT_EQ(crc32_ref, hash_crc32i_finish(hash));
+        ASSERT_EQ(crc16_ref, crc);
+    }
+}
+
+TEST_F(CrcTest, benchmark)
+{
+    const size_t size = 1024 * 1024;
+    std::vector<unsigned char> buf(size + 1);
+    volatile unsigned int sink = 0;
+
+    for (auto &c : buf) {
+        c = (unsigned char)rand();
+    }
+
+    // best of three runs, MB/s
+    auto bench = [size](const std::function<void()> &fn) {
+        double best = 0;
+        for (int r = 0; r < 3; r++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = (0 == r || sec < best) ? sec : best;
+        }
+        return size / best / (1024 * 1024);
+    };
+
+    // aligned and one byte off, as a payload after an odd sized header
+    for (size_t offset : {0, 1}) {
+        unsigned char *p = buf.data() + offset;
+        double crc32_ref = bench([&] { sink = __crc32_ref(p, size); });
+        double crc32 = bench([&] { sink = hash_crc32i_total(p, size); });
+        double crc16_ref = bench([&] { sink = __crc16_ref(p, size); });
+        double crc16 = bench([&] { sink = crc_16_update(CRC_16_INIT_VALUE, p, size); });
+        printf("[ BENCH    ] 1 MB at offset %zu: CRC32 bitwise %.0f MB/s, table %.0f MB/s; CRC16 bitwise %.0f MB/s, "
+               "table %.0f MB/s\n",
+               offset, crc32_ref, crc32, crc16_ref, crc16);
+        EXPECT_GT(crc32, crc32_ref);
+        EXPECT_GT(crc16, crc16_ref);
+    }
+    (void)sink;
+}
@@ -18,6 +18,22 @@ extern "C" {
 #define __CRC_16_MODULE_EXT extern
 #endif
 
+#define CRC_16_INIT_VALUE 0xffff
+
+/**
+ * @brief Updates a CRC-16 checksum with the given data.
+ *
+ * Blocks fed in order give the same result as get_crc_16 over their
+ * concatenation.
+ *
+ * @param crc The current checksum, CRC_16_INIT_VALUE for the first block.
+ * @param data The data to be incorporated into the checksum.
+ * @param size The size of the data in bytes.
+ * @return The updated CRC-16 checksum.
+ */
+__CRC_16_MODULE_EXT
+unsigned short crc_16_update(unsigned short crc, const unsigned char *data, unsigned int size);
+
 /**
  * @brief Calculates the CRC-16 checksum for the given data.
  *
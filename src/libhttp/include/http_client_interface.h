@@ -60,8 +60,44 @@ typedef struct http_client_response {
     uint16_t status_code;
 } http_client_response_t;
 
+/**
+ * @brief keep-alive connection pool statistics
+ *
+ */
+typedef struct http_client_pool_stat {
+    uint32_t connect_num; // new connections
+    uint32_t reuse_num;   // requests sent on a kept connection
+    uint32_t retry_num;   // kept connections found closed by the server
+    uint32_t expire_num;  // kept connections closed after idle timeout
+} http_client_pool_stat_t;
+
+/**
+ * @brief init the keep-alive connection pool, requests made before use their
+ * own connection
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int http_client_init(void);
+
 http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response);
 
 int http_client_free(http_client_response_t *response);
 
+/**
+ * @brief close every idle kept connection, e.g. when the network is lost
+ *
+ */
+void http_client_pool_flush(void);
+
+/**
+ * @brief get the connection pool statistics
+ *
+ * @param[out] stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int http_client_pool_stat_get(http_client_pool_stat_t *stat);
+
 #endif /* ifndef HTTP_CLIENT_INTERFACE_H */
@@ -17,6 +17,12 @@ typedef enum {
     DL_EVENT_FAULT,
 } http_download_event_id_t;
 
+typedef enum {
+    DL_DIGEST_NONE,
+    DL_DIGEST_SHA256,
+    DL_DIGEST_MD5,
+} http_download_digest_t;
+
 typedef struct {
     void *data;
     size_t offset;
@@ -24,6 +30,8 @@ typedef struct {
     size_t file_size;
     uint32_t remain_len;
     void *user_data;
+    const uint8_t *digest; // DL_EVENT_FINISH, NULL when not asked for or resumed from a checkpoint
+    size_t digest_len;
 } http_download_event_t;
 
 typedef void (*http_download_event_cb_t)(http_download_event_id_t id, http_download_event_t *event);
@@ -37,6 +45,9 @@ typedef struct {
     size_t file_size;
     void *user_data;
     http_download_event_cb_t event_handler;
+    uint8_t worker_num;            // concurrent range connections, 0 for HTTP_DOWNLOAD_WORKER_NUM
+    http_download_digest_t digest; // digest of the data the user consumed
+    const char *checkpoint;        // kv key to resume an interrupted download from, NULL disables
 } http_download_config_t;
 
 int http_file_download(http_download_config_t *config);
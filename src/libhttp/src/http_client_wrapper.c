@@ -4,6 +4,9 @@
 #include "core_http_client.h"
 #include "tuya_tls.h"
 #include "tal_log.h"
+#include "tal_mutex.h"
+#include "tal_system.h"
+#include "crc32i.h"
 
 #define log_debug PR_DEBUG
 #define log_error PR_ERR
@@ -11,10 +14,46 @@
 #define HEADER_BUFFER_LENGTH (255)
 #define DEFAULT_HTTP_PORT    (80)
 #define DEFAULT_HTTPS_PORT   (443)
+
+/* keep-alive connections kept per host:port:cert, 0 closes every connection */
+#ifndef HTTP_CLIENT_POOL_NUM
+#define HTTP_CLIENT_POOL_NUM 2
+#endif
+
+/* an idle connection is closed after this, kept below the usual server side
+ * keep-alive timeout so a reused connection is rarely closed under us */
+#ifndef HTTP_CLIENT_KEEPALIVE_MS
+#define HTTP_CLIENT_KEEPALIVE_MS (20 * 1000)
+#endif
+
+#define HTTP_CLIENT_HOST_LEN (128)
+
+typedef struct {
+    NetworkContext_t network; // first, the transport callbacks get a pointer to it
+    bool busy;
+    size_t recv_len; // response bytes received for the request
+    uint16_t port;
+    char host[HTTP_CLIENT_HOST_LEN];
+    size_t cacert_len;
+    uint32_t cacert_crc;
+    SYS_TIME_T idle_ms; // when the connection went back to the pool
+} http_client_conn_t;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+#if HTTP_CLIENT_POOL_NUM > 0
+    http_client_conn_t conn[HTTP_CLIENT_POOL_NUM];
+#endif
+    http_client_pool_stat_t stat;
+} http_client_pool_t;
+
+static http_client_pool_t s_http_pool;
+
 static http_client_status_t core_http_request_send(const TransportInterface_t *pTransportInterface,
                                                    const HTTPRequestInfo_t *requestInfo, http_client_header_t *headers,
                                                    uint8_t headers_count, const uint8_t *pRequestBodyBuf,
-                                                   size_t reqBodyBufLen, HTTPResponse_t *response)
+                                                   size_t reqBodyBufLen, HTTPResponse_t *response,
+                                                   HTTPStatus_t *status)
 {
     /* Represents header data that will be sent in an HTTP request. */
     HTTPRequestHeaders_t requestHeaders;
@@ -22,6 +61,8 @@ static http_client_status_t core_http_request_send(const TransportInterface_t *p
     /* Return value of all methods from the HTTP Client library API. */
     HTTPStatus_t httpStatus = HTTPSuccess;
 
+    *status = HTTPSuccess;
+
     if (NULL == requestInfo || NULL == response) {
         return HTTP_CLIENT_SERIALIZE_FAULT;
     }
@@ -58,6 +99,7 @@ static http_client_status_t core_http_request_send(const TransportInterface_t *p
     /* Release headers buffer */
     tal_free(requestHeaders.pBuffer);
 
+    *status = httpStatus;
     if (httpStatus != HTTPSuccess) {
         log_error("Failed to send HTTP %.*s request to %.*s%.*s: Error=%s.", (int32_t)requestInfo->methodLen,
                   requestInfo->pMethod, (int32_t)requestInfo->hostLen, requestInfo->pHost,
@@ -74,16 +116,25 @@ static http_client_status_t core_http_request_send(const TransportInterface_t *p
     return HTTP_CLIENT_SUCCESS;
 }
 
-http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+static int32_t __http_client_recv(NetworkContext_t *network, void *buf, size_t len)
+{
+    http_client_conn_t *conn = (http_client_conn_t *)network;
+    int32_t ret = NetworkTransportRecv(network, buf, len);
+
+    if (ret > 0) {
+        conn->recv_len += ret;
+    }
+    return ret;
+}
+
+static http_client_status_t __http_client_connect(const http_client_request_t *request, NetworkContext_t *network)
 {
-    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
     int ret = OPRT_OK;
 
     /* TLS pre init */
-    NetworkContext_t network;
     TUYA_TRANSPORT_TYPE_E transport_type = (request->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    network = tuya_transporter_create(transport_type, NULL);
-    if (NULL == network) {
+    *network = tuya_transporter_create(transport_type, NULL);
+    if (NULL == *network) {
         return HTTP_CLIENT_MALLOC_FAULT;
     }
 
@@ -98,32 +149,203 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
             .verify = true,
         };
 
-        ret = tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
+        ret = tuya_transporter_ctrl(*network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config);
         if (OPRT_OK != ret) {
             log_error("network_tls_init fail:%d", ret);
+            tuya_transporter_destroy(*network);
+            *network = NULL;
             return ret;
         }
 
-        ret = tuya_transporter_connect(network, tls_config.hostname, tls_config.port, tls_config.timeout);
-        if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
-            return HTTP_CLIENT_SEND_FAULT;
+        ret = tuya_transporter_connect(*network, tls_config.hostname, tls_config.port, tls_config.timeout);
+    } else {
+        ret = tuya_transporter_connect(*network, request->host, (request->port == 0) ? DEFAULT_HTTP_PORT : request->port,
+                                       request->timeout_ms);
+    }
+
+    if (OPRT_OK != ret) {
+        tuya_transporter_close(*network);
+        tuya_transporter_destroy(*network);
+        *network = NULL;
+        return HTTP_CLIENT_SEND_FAULT;
+    }
+
+    log_debug("http connencted!");
+    if (s_http_pool.mutex) {
+        tal_mutex_lock(s_http_pool.mutex);
+        s_http_pool.stat.connect_num++;
+        tal_mutex_unlock(s_http_pool.mutex);
+    }
+
+    return HTTP_CLIENT_SUCCESS;
+}
+
+static void __http_client_disconnect(NetworkContext_t *network)
+{
+    if (*network) {
+        tuya_transporter_close(*network);
+        tuya_transporter_destroy(*network);
+        *network = NULL;
+    }
+}
+
+/**
+ * @brief take an idle connection to the same host:port:cert out of the pool,
+ * or a free slot to connect on
+ *
+ * @param[in] request the request
+ * @param[out] reused the slot holds an established connection
+ *
+ * @return the slot, NULL when every slot is busy
+ */
+static http_client_conn_t *__http_client_pool_acquire(const http_client_request_t *request, bool *reused)
+{
+    http_client_conn_t *conn = NULL;
+
+    *reused = false;
+
+#if HTTP_CLIENT_POOL_NUM > 0
+    NetworkContext_t expired[HTTP_CLIENT_POOL_NUM] = {0};
+    uint16_t port = request->port;
+    uint32_t crc = request->cacert ? hash_crc32i_total(request->cacert, request->cacert_len) : 0;
+    SYS_TIME_T now = tal_system_get_millisecond();
+    int i;
+
+    // not initialized, every request uses its own connection
+    if (NULL == s_http_pool.mutex || strlen(request->host) >= HTTP_CLIENT_HOST_LEN) {
+        return NULL;
+    }
+    if (0 == port) {
+        port = request->cacert ? DEFAULT_HTTPS_PORT : DEFAULT_HTTP_PORT;
+    }
+
+    tal_mutex_lock(s_http_pool.mutex);
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        http_client_conn_t *item = &s_http_pool.conn[i];
+        if (item->busy || NULL == item->network) {
+            continue;
         }
+        if (now - item->idle_ms >= HTTP_CLIENT_KEEPALIVE_MS) {
+            expired[i] = item->network;
+            item->network = NULL;
+            s_http_pool.stat.expire_num++;
+            continue;
+        }
+        if (NULL == conn && item->port == port && item->cacert_len == request->cacert_len &&
+            item->cacert_crc == crc && !strcmp(item->host, request->host)) {
+            conn = item;
+        }
+    }
 
-        log_debug("tls connencted!");
+    if (conn) {
+        *reused = true;
+        s_http_pool.stat.reuse_num++;
     } else {
-        ret = tuya_transporter_connect(network, request->host, (request->port == 0) ? DEFAULT_HTTP_PORT : request->port,
-                                       request->timeout_ms);
-        if (OPRT_OK != ret) {
-            tuya_transporter_close(network);
-            tuya_transporter_destroy(network);
-            return HTTP_CLIENT_SEND_FAULT;
+        // a free slot, or the connection idle for longest
+        for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+            http_client_conn_t *item = &s_http_pool.conn[i];
+            if (item->busy) {
+                continue;
+            }
+            if (NULL == item->network) {
+                conn = item;
+                break;
+            }
+            if (NULL == conn || item->idle_ms < conn->idle_ms) {
+                conn = item;
+            }
+        }
+        if (conn) {
+            if (conn->network) {
+                expired[conn - s_http_pool.conn] = conn->network;
+                conn->network = NULL;
+            }
+            strcpy(conn->host, request->host);
+            conn->port = port;
+            conn->cacert_len = request->cacert_len;
+            conn->cacert_crc = crc;
+        }
+    }
+    if (conn) {
+        conn->busy = true;
+    }
+    tal_mutex_unlock(s_http_pool.mutex);
+
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        __http_client_disconnect(&expired[i]);
+    }
+#endif
+
+    return conn;
+}
+
+/**
+ * @brief hand a slot back, the connection stays open for the next request when
+ * keep is set
+ *
+ * @param[in] conn slot from __http_client_pool_acquire
+ * @param[in] keep the connection can be reused
+ */
+static void __http_client_pool_release(http_client_conn_t *conn, bool keep)
+{
+    if (!keep) {
+        __http_client_disconnect(&conn->network);
+    }
+
+    tal_mutex_lock(s_http_pool.mutex);
+    conn->idle_ms = tal_system_get_millisecond();
+    conn->busy = false;
+    tal_mutex_unlock(s_http_pool.mutex);
+}
+
+/**
+ * @brief init the keep-alive connection pool, requests made before use their
+ * own connection
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int http_client_init(void)
+{
+    if (s_http_pool.mutex) {
+        return OPRT_OK;
+    }
+
+    return tal_mutex_create_init(&s_http_pool.mutex);
+}
+
+http_client_status_t http_client_request(const http_client_request_t *request, http_client_response_t *response)
+{
+    http_client_status_t rt = HTTP_CLIENT_SUCCESS;
+    HTTPStatus_t http_status = HTTPSuccess;
+    http_client_conn_t local = {0};
+    http_client_conn_t *conn = NULL;
+    bool reused = false;
+
+    conn = __http_client_pool_acquire(request, &reused);
+    if (NULL == conn) {
+        conn = &local;
+    }
+
+    if (!reused) {
+        rt = __http_client_connect(request, &conn->network);
+        if (HTTP_CLIENT_SUCCESS != rt) {
+            if (conn != &local) {
+                __http_client_pool_release(conn, false);
+            }
+            return rt;
+        }
+    } else {
+        tuya_tls_config_t *tls_config = NULL;
+        tuya_transporter_ctrl(conn->network, TUYA_TRANSPORTER_GET_TLS_CONFIG, &tls_config);
+        if (tls_config) {
+            tls_config->timeout = request->timeout_ms;
         }
     }
+
     /* http client TransportInterface */
-    TransportInterface_t pTransportInterface = {.pNetworkContext = (NetworkContext_t *)&network,
-                                                .recv = (TransportRecv_t)NetworkTransportRecv,
+    TransportInterface_t pTransportInterface = {.pNetworkContext = &conn->network,
+                                                .recv = __http_client_recv,
                                                 .send = (TransportSend_t)NetworkTransportSend};
 
     /* http client request object make */
@@ -134,19 +356,46 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
         .hostLen = strlen(request->host),
         .pPath = request->path,
         .pathLen = strlen(request->path),
+        .reqFlags = (conn != &local) ? HTTP_REQUEST_KEEP_ALIVE_FLAG : 0,
     };
 
     HTTPResponse_t http_response = {0};
 
     /* HTTP request send */
     log_debug("http request send!");
+    conn->recv_len = 0;
     rt = core_http_request_send((const TransportInterface_t *)&pTransportInterface,
                                 (const HTTPRequestInfo_t *)&requestInfo, request->headers, request->headers_count,
-                                (const uint8_t *)request->body, request->body_length, &http_response);
+                                (const uint8_t *)request->body, request->body_length, &http_response, &http_status);
 
-    /* tls disconnect */
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
+    /* the server may have closed an idle connection just before we wrote on
+     * it, that costs one new connection and never reaches the caller. Only
+     * when the send failed or not a byte of response came back, otherwise the
+     * server may have acted on the request and a POST must not be replayed */
+    if (HTTP_CLIENT_SEND_FAULT == rt && reused && HTTPNetworkError == http_status && 0 == conn->recv_len) {
+        log_debug("kept connection lost, reconnect");
+        tal_mutex_lock(s_http_pool.mutex);
+        s_http_pool.stat.retry_num++;
+        tal_mutex_unlock(s_http_pool.mutex);
+
+        __http_client_disconnect(&conn->network);
+        rt = __http_client_connect(request, &conn->network);
+        if (HTTP_CLIENT_SUCCESS == rt) {
+            conn->recv_len = 0;
+            rt = core_http_request_send((const TransportInterface_t *)&pTransportInterface,
+                                        (const HTTPRequestInfo_t *)&requestInfo, request->headers,
+                                        request->headers_count, (const uint8_t *)request->body,
+                                        request->body_length, &http_response, &http_status);
+        }
+    }
+
+    if (conn != &local) {
+        __http_client_pool_release(conn, HTTP_CLIENT_SUCCESS == rt &&
+                                              !(http_response.respFlags & HTTP_RESPONSE_CONNECTION_CLOSE_FLAG));
+    } else {
+        /* tls disconnect */
+        __http_client_disconnect(&conn->network);
+    }
 
     if (OPRT_OK != rt) {
         log_error("http_request_send error:%d", rt);
@@ -165,6 +414,56 @@ http_client_status_t http_client_request(const http_client_request_t *request, h
     return HTTP_CLIENT_SUCCESS;
 }
 
+/**
+ * @brief close every idle kept connection, e.g. when the network is lost
+ *
+ */
+void http_client_pool_flush(void)
+{
+#if HTTP_CLIENT_POOL_NUM > 0
+    NetworkContext_t idle[HTTP_CLIENT_POOL_NUM] = {0};
+    int i;
+
+    if (NULL == s_http_pool.mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_http_pool.mutex);
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        if (!s_http_pool.conn[i].busy) {
+            idle[i] = s_http_pool.conn[i].network;
+            s_http_pool.conn[i].network = NULL;
+        }
+    }
+    tal_mutex_unlock(s_http_pool.mutex);
+
+    for (i = 0; i < HTTP_CLIENT_POOL_NUM; i++) {
+        __http_client_disconnect(&idle[i]);
+    }
+#endif
+}
+
+/**
+ * @brief get the connection pool statistics
+ *
+ * @param[out] stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int http_client_pool_stat_get(http_client_pool_stat_t *stat)
+{
+    if (NULL == stat || NULL == s_http_pool.mutex) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(s_http_pool.mutex);
+    *stat = s_http_pool.stat;
+    tal_mutex_unlock(s_http_pool.mutex);
+
+    return OPRT_OK;
+}
+
 int http_client_free(http_client_response_t *response)
 {
     if (NULL == response) {
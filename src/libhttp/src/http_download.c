@@ -3,6 +3,7 @@
 #include "tuya_error_code.h"
 #include "core_http_client.h"
 #include "transport_interface.h"
+#include "backoff_algorithm.h"
 #include "http_download.h"
 #include "http_parser.h"
 
@@ -14,28 +15,77 @@ typedef enum {
     DL_STATE_FILESIZE_GET,
     DL_STATE_RANGE_REQUEST,
     DL_STATE_DATE_GET,
+    DL_STATE_PARALLEL,
     DL_STATE_COMPLETE,
 } http_download_state_t;
 
+typedef enum {
+    DL_BLOCK_FREE,
+    DL_BLOCK_FETCH,
+    DL_BLOCK_READY,
+} http_download_block_state_t;
+
 typedef struct {
-    http_download_config_t config;
-    http_download_event_t event;
+    NetworkContext_t network;
     TransportInterface_t transport;
     HTTPRequestHeaders_t requestHeaders;
-    HTTPRequestInfo_t requestInfo;
     HTTPResponse_t response;
+    BackoffAlgorithmContext_t backoff;
+} http_download_conn_t;
+
+typedef struct {
+    uint8_t state;
+    size_t offset;
+    size_t len;
+    uint8_t *data;
+} http_download_block_t;
+
+typedef struct http_download {
+    http_download_config_t config;
+    http_download_event_t event;
+    http_download_conn_t conn;
+    HTTPRequestInfo_t requestInfo;
     char *host;
     char *path;
     uint16_t port;
     size_t file_size;
     size_t received_size;
     size_t remain_len;
-    size_t offset;
+    size_t checkpoint_size; // data handled when the checkpoint was saved
     uint8_t state;
     uint8_t *buffer;
+    TKL_HASH_HANDLE hash;
+    uint8_t digest[32];
+    SYS_TIME_T active_ms; // last time data arrived, the retry budget counts from there
+
+    /* parallel download, the blocks are an ordered window over the file */
+    MUTEX_HANDLE mutex;
+    SEM_HANDLE sem_ready;
+    SEM_HANDLE sem_free;
+    http_download_block_t *block;
+    uint8_t block_num;
+    size_t fetch_offset; // next range handed to a worker
+    bool stop;
+    bool fault;
 } http_download_t;
 
-#define MAX_RETRY_TIMES (8u)
+/* a worker keeps its own connection alive across its ranges rather than taking
+ * one of the http_client pool, the pool hands out whole request/response pairs
+ * and holds HTTP_CLIENT_POOL_NUM slots for ATOP, a download streaming for
+ * minutes would keep them busy and push every ATOP request to a new handshake */
+typedef struct {
+    http_download_t *ctx;
+    http_download_conn_t conn;
+    THREAD_HANDLE thread;
+} http_download_worker_t;
+
+typedef struct {
+    uint32_t file_size;
+    uint32_t offset;
+} http_download_checkpoint_t;
+
+/* retries are not counted, HTTP_DOWNLOAD_TIMEOUT_MS bounds them */
+#define MAX_RETRY_TIMES (0xffffffffu)
 /*-----------------------------------------------------------*/
 /**
  * @brief The size of the range of the file to download, with each request.
@@ -66,11 +116,145 @@ typedef struct {
  */
 #define HTTP_STATUS_CODE_PARTIAL_CONTENT 206
 
-//! timeout sec
-#define HTTP_DOWNLOAD_TIMEOUT 180
+/**
+ * @brief Retry budget, the download gives up when no data arrived for this
+ * long.
+ */
+#define HTTP_DOWNLOAD_TIMEOUT_MS (180 * 1000)
+
+/**
+ * @brief Range connections used when the config leaves worker_num 0.
+ */
+#ifndef HTTP_DOWNLOAD_WORKER_NUM
+#define HTTP_DOWNLOAD_WORKER_NUM 1
+#endif
+
+#define HTTP_DOWNLOAD_WORKER_MAX   (4)
+#define HTTP_DOWNLOAD_WORKER_STACK (4 * 1024)
+
+/**
+ * @brief Size of the range a worker fetches at once, the window holds one
+ * block more than there are workers.
+ */
+#ifndef HTTP_DOWNLOAD_BLOCK_SIZE
+#define HTTP_DOWNLOAD_BLOCK_SIZE (16 * 1024)
+#endif
+
+/**
+ * @brief Data handled between two checkpoint saves.
+ */
+#ifndef HTTP_DOWNLOAD_CHECKPOINT_SIZE
+#define HTTP_DOWNLOAD_CHECKPOINT_SIZE (64 * 1024)
+#endif
+
+#define HTTP_DOWNLOAD_RETRY_MIN_DELAY_MS (500U)
+#define HTTP_DOWNLOAD_RETRY_MAX_DELAY_MS (16000U)
 
 /*-----------------------------------------------------------*/
-static int http_download_filesize_get(http_download_t *ctx)
+static int http_download_conn_init(http_download_t *ctx, http_download_conn_t *conn)
+{
+    int rt = OPRT_OK;
+    TUYA_TRANSPORT_TYPE_E transport_type = (ctx->config.cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
+
+    /* Set the buffer used for storing request headers. */
+    conn->requestHeaders.bufferLen = 512;
+    conn->requestHeaders.pBuffer = tal_malloc(conn->requestHeaders.bufferLen);
+    TUYA_CHECK_NULL_RETURN(conn->requestHeaders.pBuffer, OPRT_MALLOC_FAILED);
+
+    /* TLS pre init */
+    conn->network = tuya_transporter_create(transport_type, NULL);
+    TUYA_CHECK_NULL_RETURN(conn->network, OPRT_MALLOC_FAILED);
+    if (transport_type == TRANSPORT_TYPE_TLS) {
+        tuya_tls_config_t tls_config = {
+            .ca_cert = (char *)ctx->config.cacert,
+            .ca_cert_size = ctx->config.cacert_len,
+            .hostname = (char *)ctx->host,
+            .port = ctx->port,
+            .mode = TUYA_TLS_SERVER_CERT_MODE,
+            .verify = true,
+        };
+
+        TUYA_CALL_ERR_RETURN(tuya_transporter_ctrl(conn->network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config));
+    }
+
+    /* http client TransportInterface */
+    conn->transport.pNetworkContext = &conn->network;
+    conn->transport.send = NetworkTransportSend;
+    conn->transport.recv = NetworkTransportRecv;
+
+    BackoffAlgorithm_InitializeParams(&conn->backoff, HTTP_DOWNLOAD_RETRY_MIN_DELAY_MS,
+                                      HTTP_DOWNLOAD_RETRY_MAX_DELAY_MS, MAX_RETRY_TIMES);
+
+    return OPRT_OK;
+}
+
+static void http_download_response_free(http_download_conn_t *conn)
+{
+    if (conn->response.pBuffer) {
+        tal_free(conn->response.pBuffer);
+    }
+    if (conn->response.pBody) {
+        tal_free((void *)conn->response.pBody);
+    }
+    memset(&conn->response, 0, sizeof(conn->response));
+}
+
+static void http_download_conn_deinit(http_download_conn_t *conn)
+{
+    if (conn->network) {
+        tuya_transporter_close(conn->network);
+        tuya_transporter_destroy(conn->network);
+        conn->network = NULL;
+    }
+    if (conn->requestHeaders.pBuffer) {
+        tal_free(conn->requestHeaders.pBuffer);
+        conn->requestHeaders.pBuffer = NULL;
+    }
+    http_download_response_free(conn);
+}
+
+/* data arrived, the next failure starts the backoff over */
+static void http_download_conn_progress(http_download_t *ctx, http_download_conn_t *conn)
+{
+    BackoffAlgorithm_InitializeParams(&conn->backoff, HTTP_DOWNLOAD_RETRY_MIN_DELAY_MS,
+                                      HTTP_DOWNLOAD_RETRY_MAX_DELAY_MS, MAX_RETRY_TIMES);
+    ctx->active_ms = tal_system_get_millisecond();
+}
+
+/* time since data last arrived, the workers move active_ms on concurrently */
+static SYS_TIME_T http_download_idle_ms(http_download_t *ctx)
+{
+    SYS_TIME_T active = ctx->active_ms;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    return (now > active) ? (now - active) : 0;
+}
+
+/* close the connection and wait for the next backoff, false when nothing
+ * arrived for HTTP_DOWNLOAD_TIMEOUT_MS, the last wait ends with the budget */
+static bool http_download_conn_retry(http_download_t *ctx, http_download_conn_t *conn)
+{
+    uint16_t delay = 0;
+    SYS_TIME_T idle = http_download_idle_ms(ctx);
+
+    tuya_transporter_close(conn->network);
+    if (idle >= HTTP_DOWNLOAD_TIMEOUT_MS ||
+        BackoffAlgorithmSuccess !=
+            BackoffAlgorithm_GetNextBackoff(&conn->backoff, tal_system_get_random(0xffff), &delay)) {
+        PR_ERR("download stalled for %d ms", (int)idle);
+        return false;
+    }
+    if (delay > HTTP_DOWNLOAD_TIMEOUT_MS - idle) {
+        delay = HTTP_DOWNLOAD_TIMEOUT_MS - idle;
+    }
+
+    PR_WARN("download retry after %d ms", delay);
+    tal_system_sleep(delay);
+
+    return true;
+}
+
+static int http_download_filesize_get(http_download_t *ctx, http_download_conn_t *conn)
 {
     int rt = 0;
     /* The location of the file size in contentRangeValStr. */
@@ -80,19 +264,21 @@ static int http_download_filesize_get(http_download_t *ctx)
     size_t contentRangeValStrLength = 0;
 
     PR_DEBUG("Getting file object size from host...");
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, 0, 0), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response, 0), __exit);
+    http_download_response_free(conn);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&conn->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&conn->requestHeaders, 0, 0), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&conn->transport, &conn->requestHeaders, NULL, 0, &conn->response, 0),
+                       __exit);
     PR_DEBUG("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_DEBUG("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
-    if (ctx->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+    PR_DEBUG("Response Headers:\n%.*s", (int32_t)conn->response.headersLen, conn->response.pHeaders);
+    if (conn->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
         PR_ERR("Received an invalid response from the server "
                "(Status Code: %u).",
-               ctx->response.statusCode);
+               conn->response.statusCode);
         rt = OPRT_NOT_SUPPORTED;
         goto __exit;
     }
-    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&ctx->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
+    TUYA_CALL_ERR_GOTO(HTTPClient_ReadHeader(&conn->response, (char *)HTTP_CONTENT_RANGE_HEADER_FIELD,
                                              (size_t)HTTP_CONTENT_RANGE_HEADER_FIELD_LENGTH,
                                              (const char **)&contentRangeValStr, &contentRangeValStrLength),
                        __exit);
@@ -105,31 +291,405 @@ static int http_download_filesize_get(http_download_t *ctx)
     pFileSizeStr += sizeof(char);
     ctx->file_size = (size_t)strtoul(pFileSizeStr, NULL, 10);
     PR_INFO("The file is %d bytes long.", (int32_t)ctx->file_size);
-    if (ctx->response.pBuffer) {
-        tal_free(ctx->response.pBuffer);
-    }
-    memset(&ctx->response, 0, sizeof(ctx->response));
+    http_download_response_free(conn);
 __exit:
     return rt;
 }
 
-static int http_download_range_request(http_download_t *ctx, uint32_t range_start, uint32_t range_end)
+static int http_download_range_request(http_download_t *ctx, http_download_conn_t *conn, uint32_t range_start,
+                                       uint32_t range_end)
 {
     int rt = OPRT_OK;
 
     PR_DEBUG("Downloading bytes %d-%d, from %s...: ", range_start, range_end, ctx->host);
-    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&ctx->requestHeaders, &ctx->requestInfo), __exit);
-    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&ctx->requestHeaders, range_start, range_end), __exit);
-    PR_TRACE("Request Headers:\n%.*s", (int32_t)ctx->requestHeaders.headersLen, (char *)ctx->requestHeaders.pBuffer);
-    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&ctx->transport, &ctx->requestHeaders, NULL, 0, &ctx->response,
+    http_download_response_free(conn);
+    TUYA_CALL_ERR_GOTO(HTTPClient_InitializeRequestHeaders(&conn->requestHeaders, &ctx->requestInfo), __exit);
+    TUYA_CALL_ERR_GOTO(HTTPClient_AddRangeHeader(&conn->requestHeaders, range_start, range_end), __exit);
+    PR_TRACE("Request Headers:\n%.*s", (int32_t)conn->requestHeaders.headersLen, (char *)conn->requestHeaders.pBuffer);
+    TUYA_CALL_ERR_GOTO(HTTPClient_Request(&conn->transport, &conn->requestHeaders, NULL, 0, &conn->response,
                                           HTTP_SEND_DISABLE_RECV_BODY_FLAG),
                        __exit);
     PR_TRACE("Received HTTP response from %s%s...", ctx->host, ctx->path);
-    PR_TRACE("Response Headers:\n%.*s", (int32_t)ctx->response.headersLen, ctx->response.pHeaders);
+    PR_TRACE("Response Headers:\n%.*s", (int32_t)conn->response.headersLen, conn->response.pHeaders);
 __exit:
     return rt;
 }
 
+/*-----------------------------------------------------------*/
+static void http_download_digest_init(http_download_t *ctx)
+{
+    if (DL_DIGEST_SHA256 == ctx->config.digest) {
+        tal_sha256_create_init(&ctx->hash);
+        tal_sha256_starts_ret(ctx->hash, 0);
+    } else if (DL_DIGEST_MD5 == ctx->config.digest) {
+        tal_md5_create_init(&ctx->hash);
+        tal_md5_starts_ret(ctx->hash);
+    }
+}
+
+static void http_download_digest_update(http_download_t *ctx, const uint8_t *data, size_t len)
+{
+    if (NULL == ctx->hash || 0 == len) {
+        return;
+    }
+
+    if (DL_DIGEST_SHA256 == ctx->config.digest) {
+        tal_sha256_update_ret(ctx->hash, data, len);
+    } else {
+        tal_md5_update_ret(ctx->hash, data, len);
+    }
+}
+
+static void http_download_digest_finish(http_download_t *ctx)
+{
+    if (NULL == ctx->hash) {
+        return;
+    }
+
+    if (DL_DIGEST_SHA256 == ctx->config.digest) {
+        tal_sha256_finish_ret(ctx->hash, ctx->digest);
+        tal_sha256_free(ctx->hash);
+        ctx->event.digest_len = 32;
+    } else {
+        tal_md5_finish_ret(ctx->hash, ctx->digest);
+        tal_md5_free(ctx->hash);
+        ctx->event.digest_len = 16;
+    }
+    ctx->hash = NULL;
+    ctx->event.digest = ctx->digest;
+}
+
+/* continue from the checkpoint of an earlier attempt on the same file, the
+ * digest can not be resumed so it is not reported then */
+static void http_download_checkpoint_load(http_download_t *ctx)
+{
+    http_download_checkpoint_t checkpoint;
+    uint8_t *value = NULL;
+    size_t length = 0;
+
+    if (NULL == ctx->config.checkpoint || OPRT_OK != tal_kv_get(ctx->config.checkpoint, &value, &length)) {
+        return;
+    }
+
+    if (length == sizeof(checkpoint)) {
+        memcpy(&checkpoint, value, sizeof(checkpoint));
+        if (checkpoint.file_size == ctx->file_size && checkpoint.offset < ctx->file_size) {
+            PR_NOTICE("download resume from %d", checkpoint.offset);
+            ctx->received_size = checkpoint.offset;
+            ctx->checkpoint_size = checkpoint.offset;
+        }
+    }
+    tal_kv_free(value);
+}
+
+static void http_download_checkpoint_save(http_download_t *ctx)
+{
+    http_download_checkpoint_t checkpoint;
+
+    if (NULL == ctx->config.checkpoint) {
+        return;
+    }
+
+    checkpoint.file_size = ctx->file_size;
+    checkpoint.offset = ctx->received_size - ctx->remain_len;
+    if (checkpoint.offset - ctx->checkpoint_size >= HTTP_DOWNLOAD_CHECKPOINT_SIZE) {
+        tal_kv_set(ctx->config.checkpoint, (const uint8_t *)&checkpoint, sizeof(checkpoint));
+        ctx->checkpoint_size = checkpoint.offset;
+    }
+}
+
+/* hand read_size new bytes after the kept remain to the user, the bytes the
+ * user left in remain_len are handed again in front of the next data */
+static void http_download_data_emit(http_download_t *ctx, size_t read_size)
+{
+    ctx->event.data = (uint8_t *)ctx->buffer;
+    ctx->event.data_len = read_size + ctx->remain_len;
+    ctx->event.offset = ctx->received_size - ctx->remain_len;
+    ctx->event.remain_len = ctx->remain_len;
+    if (ctx->config.event_handler) {
+        ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
+    } else {
+        ctx->event.remain_len = 0;
+    }
+    http_download_digest_update(ctx, ctx->buffer, ctx->event.data_len - ctx->event.remain_len);
+    if (ctx->event.remain_len) {
+        memmove(ctx->buffer, ctx->buffer + (ctx->event.data_len - ctx->event.remain_len), ctx->event.remain_len);
+    }
+    ctx->remain_len = ctx->event.remain_len;
+    ctx->received_size += read_size;
+    http_download_checkpoint_save(ctx);
+}
+
+/* feed a block through the user buffer in range_length pieces */
+static int http_download_block_emit(http_download_t *ctx, const uint8_t *data, size_t len)
+{
+    size_t size = 0;
+
+    while (len) {
+        size = ctx->config.range_length - ctx->remain_len;
+        if (0 == size) {
+            PR_ERR("download buffer full of remain");
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+        size = (size < len) ? size : len;
+        memcpy(ctx->buffer + ctx->remain_len, data, size);
+        http_download_data_emit(ctx, size);
+        data += size;
+        len -= size;
+    }
+
+    return OPRT_OK;
+}
+
+/*-----------------------------------------------------------*/
+static http_download_block_t *http_download_block_take(http_download_t *ctx)
+{
+    http_download_block_t *block = NULL;
+    int i;
+
+    tal_mutex_lock(ctx->mutex);
+    if (ctx->fetch_offset < ctx->file_size) {
+        for (i = 0; i < ctx->block_num; i++) {
+            if (DL_BLOCK_FREE == ctx->block[i].state) {
+                block = &ctx->block[i];
+                break;
+            }
+        }
+    }
+    if (block) {
+        block->state = DL_BLOCK_FETCH;
+        block->offset = ctx->fetch_offset;
+        block->len = ctx->file_size - ctx->fetch_offset;
+        if (block->len > HTTP_DOWNLOAD_BLOCK_SIZE) {
+            block->len = HTTP_DOWNLOAD_BLOCK_SIZE;
+        }
+        ctx->fetch_offset += block->len;
+    }
+    tal_mutex_unlock(ctx->mutex);
+
+    return block;
+}
+
+static void http_download_worker_fault(http_download_t *ctx)
+{
+    ctx->fault = true;
+    tal_semaphore_post(ctx->sem_ready);
+}
+
+static void http_download_worker_task(void *arg)
+{
+    http_download_worker_t *worker = (http_download_worker_t *)arg;
+    http_download_t *ctx = worker->ctx;
+    http_download_conn_t *conn = &worker->conn;
+    http_download_block_t *block = NULL;
+    bool connected = false;
+    size_t filled = 0;
+    int32_t read_size = 0;
+    int rt = OPRT_OK;
+
+    while (!ctx->stop && !ctx->fault) {
+        if (NULL == block) {
+            if (ctx->fetch_offset >= ctx->file_size) {
+                break;
+            }
+            if (OPRT_OK != tal_semaphore_wait(ctx->sem_free, 1000)) {
+                continue;
+            }
+            block = http_download_block_take(ctx);
+            if (NULL == block) {
+                break;
+            }
+            filled = 0;
+        }
+
+        if (!connected) {
+            rt = tuya_transporter_connect(conn->network, ctx->host, ctx->port, ctx->config.timeout_ms);
+            if (OPRT_OK != rt) {
+                if (!http_download_conn_retry(ctx, conn)) {
+                    http_download_worker_fault(ctx);
+                }
+                continue;
+            }
+            connected = true;
+        }
+
+        rt = http_download_range_request(ctx, conn, block->offset + filled, block->offset + block->len - 1);
+        if (OPRT_OK == rt && conn->response.statusCode != HTTP_STATUS_CODE_PARTIAL_CONTENT) {
+            PR_ERR("range not supported, status %d", conn->response.statusCode);
+            http_download_worker_fault(ctx);
+            break;
+        }
+        while (OPRT_OK == rt && filled < block->len && !ctx->stop) {
+            read_size = HTTPClient_Recv(&conn->transport, &conn->response, block->data + filled, block->len - filled);
+            if (read_size <= 0) {
+                rt = OPRT_COM_ERROR;
+                break;
+            }
+            filled += read_size;
+            http_download_conn_progress(ctx, conn);
+        }
+
+        if (OPRT_OK == rt && filled == block->len) {
+            tal_mutex_lock(ctx->mutex);
+            block->state = DL_BLOCK_READY;
+            tal_mutex_unlock(ctx->mutex);
+            tal_semaphore_post(ctx->sem_ready);
+            block = NULL;
+        } else if (OPRT_OK != rt) {
+            PR_WARN("range %d+%d get error:%d, goto retry", block->offset, filled, rt);
+            connected = false;
+            if (!http_download_conn_retry(ctx, conn)) {
+                http_download_worker_fault(ctx);
+            }
+        }
+    }
+
+    tuya_transporter_close(conn->network);
+}
+
+static void http_download_parallel_deinit(http_download_t *ctx, http_download_worker_t *worker, uint8_t worker_num)
+{
+    int i;
+
+    ctx->stop = true;
+    for (i = 0; worker && i < worker_num; i++) {
+        if (worker[i].thread) {
+            while (OPRT_OK != tal_thread_delete(worker[i].thread)) {
+                tal_system_sleep(10);
+            }
+            while (THREAD_STATE_DELETE != tal_thread_get_state(worker[i].thread)) {
+                tal_system_sleep(10);
+            }
+        }
+        http_download_conn_deinit(&worker[i].conn);
+    }
+    if (worker) {
+        tal_free(worker);
+    }
+
+    for (i = 0; ctx->block && i < ctx->block_num; i++) {
+        if (ctx->block[i].data) {
+            tal_free(ctx->block[i].data);
+        }
+    }
+    if (ctx->block) {
+        tal_free(ctx->block);
+        ctx->block = NULL;
+    }
+    if (ctx->sem_ready) {
+        tal_semaphore_release(ctx->sem_ready);
+        ctx->sem_ready = NULL;
+    }
+    if (ctx->sem_free) {
+        tal_semaphore_release(ctx->sem_free);
+        ctx->sem_free = NULL;
+    }
+    if (ctx->mutex) {
+        tal_mutex_release(ctx->mutex);
+        ctx->mutex = NULL;
+    }
+}
+
+/**
+ * @brief fetch the rest of the file with worker_num range connections, the
+ * blocks they fill are handed to the user in file order
+ *
+ * @return OPRT_OK when the file is complete, OPRT_MALLOC_FAILED before any
+ * data was handed to the user, others on download fault
+ */
+static int http_download_parallel(http_download_t *ctx)
+{
+    int rt = OPRT_OK;
+    uint8_t worker_num = ctx->config.worker_num;
+    http_download_worker_t *worker = NULL;
+    http_download_block_t *head = NULL;
+    THREAD_CFG_T thread_cfg = {
+        .stackDepth = HTTP_DOWNLOAD_WORKER_STACK, .priority = THREAD_PRIO_3, .thrdname = "dl_worker"};
+    int i;
+
+    ctx->stop = false;
+    ctx->fault = false;
+    ctx->block_num = worker_num + 1;
+    ctx->fetch_offset = ctx->received_size;
+
+    ctx->block = tal_calloc(ctx->block_num, sizeof(http_download_block_t));
+    worker = tal_calloc(worker_num, sizeof(http_download_worker_t));
+    if (NULL == ctx->block || NULL == worker) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __exit;
+    }
+    for (i = 0; i < ctx->block_num; i++) {
+        ctx->block[i].data = tal_malloc(HTTP_DOWNLOAD_BLOCK_SIZE);
+        if (NULL == ctx->block[i].data) {
+            rt = OPRT_MALLOC_FAILED;
+            goto __exit;
+        }
+    }
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ctx->mutex), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ctx->sem_ready, 0, ctx->block_num), __exit);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ctx->sem_free, ctx->block_num, ctx->block_num), __exit);
+    for (i = 0; i < worker_num; i++) {
+        worker[i].ctx = ctx;
+        TUYA_CALL_ERR_GOTO(http_download_conn_init(ctx, &worker[i].conn), __exit);
+    }
+    for (i = 0; i < worker_num; i++) {
+        rt = tal_thread_create_and_start(&worker[i].thread, NULL, NULL, http_download_worker_task, &worker[i],
+                                         &thread_cfg);
+        if (OPRT_OK != rt) {
+            // the workers already running do the job
+            PR_WARN("download worker %d create fail:%d", i, rt);
+            worker[i].thread = NULL;
+            if (0 == i) {
+                rt = OPRT_MALLOC_FAILED;
+                goto __exit;
+            }
+            rt = OPRT_OK;
+            break;
+        }
+    }
+    PR_DEBUG("download with %d workers", i);
+
+    while (ctx->received_size < ctx->file_size && !ctx->fault) {
+        head = NULL;
+        tal_mutex_lock(ctx->mutex);
+        for (i = 0; i < ctx->block_num; i++) {
+            if (DL_BLOCK_READY == ctx->block[i].state && ctx->block[i].offset == ctx->received_size) {
+                head = &ctx->block[i];
+                break;
+            }
+        }
+        tal_mutex_unlock(ctx->mutex);
+
+        if (NULL == head) {
+            if (OPRT_OK != tal_semaphore_wait(ctx->sem_ready, 1000) &&
+                http_download_idle_ms(ctx) >= HTTP_DOWNLOAD_TIMEOUT_MS) {
+                PR_ERR("download stalled");
+                ctx->fault = true;
+            }
+            continue;
+        }
+
+        rt = http_download_block_emit(ctx, head->data, head->len);
+        if (OPRT_OK != rt) {
+            ctx->fault = true;
+            break;
+        }
+        tal_mutex_lock(ctx->mutex);
+        head->state = DL_BLOCK_FREE;
+        tal_mutex_unlock(ctx->mutex);
+        tal_semaphore_post(ctx->sem_free);
+    }
+
+    if (ctx->fault && OPRT_OK == rt) {
+        rt = OPRT_COM_ERROR;
+    }
+
+__exit:
+    http_download_parallel_deinit(ctx, worker, worker_num);
+
+    return rt;
+}
+
 /*-----------------------------------------------------------*/
 static int http_file_download_init(http_download_t *ctx, http_download_config_t *config)
 {
@@ -145,6 +705,12 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     if (config->range_length == 0) {
         ctx->config.range_length = RANGE_REQUEST_LENGTH_DEFAULT;
     }
+    if (0 == ctx->config.worker_num) {
+        ctx->config.worker_num = HTTP_DOWNLOAD_WORKER_NUM;
+    }
+    if (ctx->config.worker_num > HTTP_DOWNLOAD_WORKER_MAX) {
+        ctx->config.worker_num = HTTP_DOWNLOAD_WORKER_MAX;
+    }
     ctx->event.user_data = ctx->config.user_data;
 
     /* url parse to host port path */
@@ -195,48 +761,25 @@ static int http_file_download_init(http_download_t *ctx, http_download_config_t
     requestInfo->pPath = ctx->path;
     requestInfo->pathLen = strlen(ctx->path);
     requestInfo->reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
-    /* Set the buffer used for storing request headers. */
-
-    HTTPRequestHeaders_t *requestHeaders = &ctx->requestHeaders;
-    requestHeaders->bufferLen = 512;
-    requestHeaders->pBuffer = tal_malloc(requestHeaders->bufferLen);
-    TUYA_CHECK_NULL_RETURN(requestHeaders->pBuffer, OPRT_MALLOC_FAILED);
 
-    return rt;
+    return http_download_conn_init(ctx, &ctx->conn);
 }
 
 int http_file_download(http_download_config_t *config)
 {
     int rt = OPRT_OK;
+    http_download_conn_t *conn = NULL;
 
     http_download_t *ctx = tal_calloc(1, sizeof(http_download_t));
     TUYA_CHECK_NULL_GOTO(ctx, __exit);
     TUYA_CALL_ERR_GOTO(http_file_download_init(ctx, config), __exit);
-    /* TLS pre init */
-    TUYA_TRANSPORT_TYPE_E transport_type = (config->cacert == NULL) ? TRANSPORT_TYPE_TCP : TRANSPORT_TYPE_TLS;
-    NetworkContext_t network;
-    TUYA_CHECK_NULL_GOTO(network = tuya_transporter_create(transport_type, NULL), __exit);
-    if (transport_type == TRANSPORT_TYPE_TLS) {
-        tuya_tls_config_t tls_config = {
-            .ca_cert = (char *)config->cacert,
-            .ca_cert_size = config->cacert_len,
-            .hostname = (char *)ctx->host,
-            .port = ctx->port,
-            .mode = TUYA_TLS_SERVER_CERT_MODE,
-            .verify = true,
-        };
-
-        TUYA_CALL_ERR_GOTO(tuya_transporter_ctrl(network, TUYA_TRANSPORTER_SET_TLS_CONFIG, &tls_config), __exit);
-    }
-    /* http client TransportInterface */
-    ctx->transport.pNetworkContext = (NetworkContext_t *)&network;
-    ctx->transport.send = NetworkTransportSend;
-    ctx->transport.recv = NetworkTransportRecv;
+    conn = &ctx->conn;
 
     ctx->state = DL_STATE_NETWORK_CONNECT;
-    TIME_T download_time = tal_time_get_posix();
+    ctx->active_ms = tal_system_get_millisecond();
 
     bool is_completed = false;
+    bool is_sized = false; // DL_EVENT_ON_FILESIZE sent
 
     int32_t read_size = 0;
 
@@ -249,9 +792,9 @@ int http_file_download(http_download_config_t *config)
         switch (ctx->state) {
 
         case DL_STATE_NETWORK_CONNECT:
-            rt = tuya_transporter_connect(network, ctx->host, ctx->port, config->timeout_ms);
+            rt = tuya_transporter_connect(conn->network, ctx->host, ctx->port, config->timeout_ms);
             if (OPRT_OK == rt) {
-                ctx->state = DL_STATE_FILESIZE_GET;
+                ctx->state = is_sized ? DL_STATE_RANGE_REQUEST : DL_STATE_FILESIZE_GET;
             } else {
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
             }
@@ -259,21 +802,40 @@ int http_file_download(http_download_config_t *config)
 
         case DL_STATE_FILESIZE_GET:
             if (0 == ctx->file_size) {
-                rt = http_download_filesize_get(ctx);
+                rt = http_download_filesize_get(ctx, conn);
             }
             if (OPRT_OK != rt) {
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
                 break;
             }
+            http_download_checkpoint_load(ctx);
+            if (0 == ctx->received_size) {
+                http_download_digest_init(ctx);
+            }
             if (ctx->config.event_handler) {
                 ctx->event.file_size = ctx->file_size;
                 ctx->config.event_handler(DL_EVENT_ON_FILESIZE, &ctx->event);
             }
-            ctx->state = DL_STATE_RANGE_REQUEST;
+            is_sized = true;
+            ctx->state = (ctx->config.worker_num > 1) ? DL_STATE_PARALLEL : DL_STATE_RANGE_REQUEST;
+            break;
+
+        case DL_STATE_PARALLEL:
+            tuya_transporter_close(conn->network);
+            rt = http_download_parallel(ctx);
+            if (OPRT_OK == rt) {
+                ctx->state = DL_STATE_COMPLETE;
+            } else if (OPRT_MALLOC_FAILED == rt) {
+                PR_WARN("parallel download unavailable, download in serial");
+                ctx->config.worker_num = 1;
+                ctx->state = DL_STATE_NETWORK_CONNECT;
+            } else {
+                ctx->fault = true;
+            }
             break;
 
         case DL_STATE_RANGE_REQUEST:
-            rt = http_download_range_request(ctx, ctx->received_size, ctx->file_size);
+            rt = http_download_range_request(ctx, conn, ctx->received_size, ctx->file_size);
             if (OPRT_OK != rt) {
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
                 break;
@@ -281,29 +843,16 @@ int http_file_download(http_download_config_t *config)
             ctx->state = DL_STATE_DATE_GET;
 
         case DL_STATE_DATE_GET: {
-            read_size = HTTPClient_Recv(&ctx->transport, &ctx->response, ctx->buffer + ctx->remain_len,
+            read_size = HTTPClient_Recv(&conn->transport, &conn->response, ctx->buffer + ctx->remain_len,
                                         ctx->config.range_length - ctx->remain_len);
 
             if (read_size <= 0) {
-                PR_WARN("file download range get error:%d, goto retry", rt);
+                PR_WARN("file download range get error:%d, goto retry", read_size);
                 ctx->state = DL_STATE_NETWORK_RECONNECT;
                 break;
             }
-            if (ctx->config.event_handler) {
-                ctx->event.data = (uint8_t *)ctx->buffer;
-                ctx->event.data_len = read_size + ctx->remain_len;
-                ctx->event.offset = ctx->received_size - ctx->remain_len;
-                ctx->event.remain_len = ctx->remain_len;
-                ctx->config.event_handler(DL_EVENT_ON_DATA, &ctx->event);
-                if (ctx->event.remain_len) {
-                    memmove(ctx->buffer, ctx->buffer + (ctx->event.data_len - ctx->event.remain_len),
-                            ctx->event.remain_len);
-                }
-                ctx->remain_len = ctx->event.remain_len;
-                ctx->received_size += read_size;
-            }
-            //! reset time
-            download_time = tal_time_get_posix();
+            http_download_conn_progress(ctx, conn);
+            http_download_data_emit(ctx, read_size);
             /* File download complete? */
             if (ctx->received_size >= ctx->file_size) {
                 ctx->state = DL_STATE_COMPLETE;
@@ -312,25 +861,29 @@ int http_file_download(http_download_config_t *config)
         }
 
         case DL_STATE_NETWORK_RECONNECT:
-            tuya_transporter_close(network);
-            tal_system_sleep(3000);
-            ctx->state = DL_STATE_NETWORK_CONNECT;
+            if (http_download_conn_retry(ctx, conn)) {
+                ctx->state = DL_STATE_NETWORK_CONNECT;
+            } else {
+                ctx->fault = true;
+            }
             break;
 
         case DL_STATE_COMPLETE:
             PR_INFO("Download Complete!");
             is_completed = true;
+            http_download_digest_finish(ctx);
+            if (ctx->config.checkpoint) {
+                tal_kv_del(ctx->config.checkpoint);
+            }
             if (ctx->config.event_handler) {
                 ctx->config.event_handler(DL_EVENT_FINISH, &ctx->event);
             }
             break;
         }
-    } while (((tal_time_get_posix() - download_time) < HTTP_DOWNLOAD_TIMEOUT) && !is_completed);
-
-    tuya_transporter_close(network);
-    tuya_transporter_destroy(network);
+    } while (!ctx->fault && !is_completed);
 
     if (!is_completed) {
+        rt = (OPRT_OK == rt) ? OPRT_COM_ERROR : rt;
         if (ctx->config.event_handler) {
             ctx->config.event_handler(DL_EVENT_FAULT, &ctx->event);
         }
@@ -338,17 +891,22 @@ int http_file_download(http_download_config_t *config)
 
 __exit:
     if (ctx) {
+        http_download_conn_deinit(&ctx->conn);
+        if (ctx->hash) {
+            if (DL_DIGEST_SHA256 == ctx->config.digest) {
+                tal_sha256_free(ctx->hash);
+            } else {
+                tal_md5_free(ctx->hash);
+            }
+        }
         if (ctx->host) {
             tal_free(ctx->host);
         }
         if (ctx->path) {
             tal_free(ctx->path);
         }
-        if (ctx->requestHeaders.pBuffer) {
-            tal_free(ctx->requestHeaders.pBuffer);
-        }
-        if (ctx->response.pBuffer) {
-            tal_free(ctx->response.pBuffer);
+        if (ctx->buffer) {
+            tal_free(ctx->buffer);
         }
 
         tal_free(ctx);
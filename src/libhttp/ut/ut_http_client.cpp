@@ -0,0 +1,202 @@
+/**
+ * @file ut_http_client.cpp
+ * @brief http_client test cases against the local server stand-in: reuse of
+ * kept connections, when a failed request is sent again and when it is not,
+ * and a startup benchmark of back-to-back ATOP calls with and without them.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "http_client_interface.h"
+#include "ut_http_server.h"
+}
+
+static const uint8_t s_cacert[] = "ut cacert";
+
+class HttpClientTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        http_client_pool_flush();
+        ut_http_server_reset();
+    }
+
+    void TearDown() override
+    {
+        http_client_pool_flush();
+    }
+
+    // an ATOP style POST, the response is freed
+    http_client_status_t post(const char *path)
+    {
+        static const char body[] = "data=0123456789abcdef0123456789abcdef";
+        http_client_header_t header = {.key = "Content-Type", .value = "application/x-www-form-urlencoded"};
+        http_client_request_t request = {};
+        http_client_response_t response = {};
+
+        request.host = "h3.iot-dns.com";
+        request.port = 443;
+        request.path = path;
+        request.cacert = s_cacert;
+        request.cacert_len = sizeof(s_cacert);
+        request.method = "POST";
+        request.headers = &header;
+        request.headers_count = 1;
+        request.body = (const uint8_t *)body;
+        request.body_length = strlen(body);
+        request.timeout_ms = 5000;
+
+        http_client_status_t rt = http_client_request(&request, &response);
+        if (HTTP_CLIENT_SUCCESS == rt) {
+            EXPECT_EQ(200, response.status_code);
+            EXPECT_TRUE(NULL != strstr((const char *)response.body, "\"success\":true"));
+            http_client_free(&response);
+        }
+        return rt;
+    }
+
+    UT_HTTP_SERVER_STAT_T server()
+    {
+        UT_HTTP_SERVER_STAT_T stat;
+        ut_http_server_stat(&stat);
+        return stat;
+    }
+
+    http_client_pool_stat_t pool()
+    {
+        http_client_pool_stat_t stat = {};
+        EXPECT_EQ(OPRT_OK, http_client_pool_stat_get(&stat));
+        return stat;
+    }
+};
+
+// runs first, nothing has called http_client_init yet
+TEST_F(HttpClientTest, own_connection_before_init)
+{
+    http_client_pool_stat_t stat;
+
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().connect_num);
+    EXPECT_NE(OPRT_OK, http_client_pool_stat_get(&stat));
+
+    ASSERT_EQ(OPRT_OK, http_client_init());
+    ASSERT_EQ(OPRT_OK, http_client_init());
+}
+
+TEST_F(HttpClientTest, reuse_kept_connection)
+{
+    http_client_pool_stat_t before = pool();
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    }
+    EXPECT_EQ(1u, server().connect_num);
+    EXPECT_EQ(5u, server().request_num);
+    EXPECT_EQ(before.reuse_num + 4, pool().reuse_num);
+}
+
+TEST_F(HttpClientTest, retry_when_server_closed_idle)
+{
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    http_client_pool_stat_t before = pool();
+
+    // the request written on the closed connection never reached the server
+    ut_http_server_close_idle();
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().connect_num);
+    EXPECT_EQ(2u, server().request_num);
+    EXPECT_EQ(before.retry_num + 1, pool().retry_num);
+}
+
+TEST_F(HttpClientTest, no_replay_after_partial_response)
+{
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    http_client_pool_stat_t before = pool();
+
+    // the server acted on the request, part of the answer came back
+    ut_http_server_cut(1, 16);
+    EXPECT_NE(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().request_num);
+    EXPECT_EQ(before.retry_num, pool().retry_num);
+
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().connect_num);
+}
+
+TEST_F(HttpClientTest, no_retry_on_fresh_connection)
+{
+    ut_http_server_cut(1, 0);
+    EXPECT_NE(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(1u, server().connect_num);
+    EXPECT_EQ(1u, server().request_num);
+}
+
+TEST_F(HttpClientTest, connection_close_not_kept)
+{
+    ut_http_server_close_after(true);
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().connect_num);
+    EXPECT_EQ(2u, server().request_num);
+}
+
+TEST_F(HttpClientTest, idle_connection_expires)
+{
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    http_client_pool_stat_t before = pool();
+
+    ut_http_clock_advance(60 * 1000);
+    ASSERT_EQ(HTTP_CLIENT_SUCCESS, post("/d.json"));
+    EXPECT_EQ(2u, server().connect_num);
+    EXPECT_EQ(before.expire_num + 1, pool().expire_num);
+    EXPECT_EQ(before.retry_num, pool().retry_num);
+}
+
+TEST_F(HttpClientTest, benchmark_startup)
+{
+    // activation, dynamic config, version update and upgrade info of a start
+    static const char *startup[] = {"/d.json?a=tuya.device.active",      "/d.json?a=tuya.device.dynamic.config.get",
+                                    "/d.json?a=tuya.device.versions.update", "/d.json?a=tuya.device.upgrade.get",
+                                    "/d.json?a=tuya.device.timer.count",  "/d.json?a=tuya.device.dev.dp.get"};
+    const uint32_t handshake_ms = 20;
+    const int rounds = 5;
+    double cost[2] = {0, 0};
+    uint32_t handshake[2] = {0, 0};
+
+    ut_http_server_set_handshake(handshake_ms);
+    for (int kept = 0; kept < 2; kept++) {
+        for (int r = 0; r < rounds; r++) {
+            ut_http_server_reset();
+            ut_http_server_set_handshake(handshake_ms);
+            http_client_pool_flush();
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto path : startup) {
+                ASSERT_EQ(HTTP_CLIENT_SUCCESS, post(path));
+                if (!kept) {
+                    // every call on its own connection, as before the pool
+                    http_client_pool_flush();
+                }
+            }
+            cost[kept] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            handshake[kept] += server().handshake_num;
+        }
+    }
+
+    printf("[ BENCH    ] startup %d calls, %u ms handshake: connection per call %.1f ms %u handshakes, kept "
+           "connection %.1f ms %u handshakes\n",
+           (int)(sizeof(startup) / sizeof(startup[0])), handshake_ms, cost[0] / rounds, handshake[0] / rounds,
+           cost[1] / rounds, handshake[1] / rounds);
+    EXPECT_EQ(sizeof(startup) / sizeof(startup[0]), handshake[0] / rounds);
+    EXPECT_EQ(1u, handshake[1] / rounds);
+    EXPECT_LT(cost[1], cost[0]);
+}
@@ -0,0 +1,13 @@
+/**
+ * @file ut_http_client_drv.c
+ * @brief builds http_client_wrapper.c on the local server stand-in and its
+ * clock, see ut_http_server.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "ut_http_server.h"
+
+#define tal_system_get_millisecond ut_http_clock_ms
+
+#include "../src/http_client_wrapper.c"
@@ -0,0 +1,198 @@
+/**
+ * @file ut_http_download.cpp
+ * @brief http_file_download test cases against the local server stand-in
+ * with injected faults: cut responses, refused connects and the time bound
+ * retry budget, serial and over parallel range workers.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+extern "C" {
+#include "http_download.h"
+#include "ut_http_server.h"
+}
+
+#define DL_UT_BUDGET_MS (180 * 1000)
+
+typedef struct {
+    size_t offset;    // next byte expected
+    size_t file_size; // DL_EVENT_ON_FILESIZE
+    uint32_t data_num;
+    uint32_t advance_ms; // moved on the clock by every data event
+    bool refuse_sized;   // refuse every connect once the size is known
+    bool intact;
+    bool finish;
+    bool fault;
+} DL_UT_RESULT_T;
+
+static void __dl_ut_event(http_download_event_id_t id, http_download_event_t *event)
+{
+    DL_UT_RESULT_T *result = (DL_UT_RESULT_T *)event->user_data;
+
+    switch (id) {
+    case DL_EVENT_ON_FILESIZE:
+        result->file_size = event->file_size;
+        if (result->refuse_sized) {
+            ut_http_server_refuse(-1);
+        }
+        break;
+    case DL_EVENT_ON_DATA:
+        // in file order, every byte once
+        if (event->offset != result->offset) {
+            result->intact = false;
+        }
+        for (size_t i = 0; i < event->data_len; i++) {
+            if (((uint8_t *)event->data)[i] != ut_http_file_byte(event->offset + i)) {
+                result->intact = false;
+                break;
+            }
+        }
+        result->offset = event->offset + event->data_len;
+        result->data_num++;
+        event->remain_len = 0;
+        if (result->advance_ms) {
+            ut_http_clock_advance(result->advance_ms);
+        }
+        break;
+    case DL_EVENT_FINISH:
+        result->finish = true;
+        break;
+    case DL_EVENT_FAULT:
+        result->fault = true;
+        break;
+    default:
+        break;
+    }
+}
+
+class HttpDownloadTest : public ::testing::Test {
+  protected:
+    DL_UT_RESULT_T result;
+
+    void SetUp() override
+    {
+        ut_http_server_reset();
+        memset(&result, 0, sizeof(result));
+        result.intact = true;
+    }
+
+    int download(uint8_t worker_num)
+    {
+        http_download_config_t config = {};
+
+        config.url = (char *)"http://images.tuyacn.com/smart/firmware/ut.bin";
+        config.timeout_ms = 5000;
+        config.user_data = &result;
+        config.event_handler = __dl_ut_event;
+        config.worker_num = worker_num;
+        return http_file_download(&config);
+    }
+
+    UT_HTTP_SERVER_STAT_T server()
+    {
+        UT_HTTP_SERVER_STAT_T stat;
+        ut_http_server_stat(&stat);
+        return stat;
+    }
+};
+
+TEST_F(HttpDownloadTest, serial_intact)
+{
+    ut_http_server_set_file(100 * 1024 + 17);
+
+    ASSERT_EQ(OPRT_OK, download(1));
+    EXPECT_TRUE(result.finish);
+    EXPECT_TRUE(result.intact);
+    EXPECT_EQ(100u * 1024 + 17, result.file_size);
+    EXPECT_EQ(result.file_size, result.offset);
+    EXPECT_EQ(1u, server().connect_num);
+}
+
+TEST_F(HttpDownloadTest, serial_resume_after_cut)
+{
+    ut_http_server_set_file(100 * 1024 + 17);
+    // three range responses cut in the body, each resumes where it stopped
+    ut_http_server_cut(3, 3000);
+    ASSERT_EQ(OPRT_OK, download(1));
+    EXPECT_TRUE(result.finish);
+    EXPECT_TRUE(result.intact);
+    EXPECT_EQ(result.file_size, result.offset);
+    EXPECT_EQ(4u, server().connect_num);
+}
+
+TEST_F(HttpDownloadTest, serial_retry_refused)
+{
+    ut_http_server_set_file(10 * 1024);
+    ut_http_server_refuse(12);
+
+    // more refusals than the old fixed attempt count, well within the budget
+    ASSERT_EQ(OPRT_OK, download(1));
+    EXPECT_TRUE(result.intact);
+    EXPECT_EQ(12u, server().refuse_num);
+    EXPECT_EQ(1u, server().connect_num);
+}
+
+TEST_F(HttpDownloadTest, give_up_when_budget_used)
+{
+    ut_http_server_set_file(10 * 1024);
+    ut_http_server_refuse(-1);
+
+    SYS_TIME_T start = ut_http_clock_ms();
+    EXPECT_NE(OPRT_OK, download(1));
+    SYS_TIME_T cost = ut_http_clock_ms() - start;
+
+    EXPECT_TRUE(result.fault);
+    EXPECT_FALSE(result.finish);
+    EXPECT_GE(cost, (SYS_TIME_T)DL_UT_BUDGET_MS);
+    EXPECT_LT(cost, (SYS_TIME_T)DL_UT_BUDGET_MS + 5000);
+    EXPECT_GT(server().refuse_num, 8u);
+}
+
+TEST_F(HttpDownloadTest, data_restarts_budget)
+{
+    ut_http_server_set_file(64 * 1024);
+    ut_http_server_cut(3, 4000);
+    // a slow link, each piece of data takes most of the budget
+    result.advance_ms = 100 * 1000;
+
+    SYS_TIME_T start = ut_http_clock_ms();
+    ASSERT_EQ(OPRT_OK, download(1));
+    EXPECT_TRUE(result.intact);
+    EXPECT_EQ(result.file_size, result.offset);
+    EXPECT_GT(ut_http_clock_ms() - start, (SYS_TIME_T)DL_UT_BUDGET_MS);
+}
+
+TEST_F(HttpDownloadTest, parallel_intact_with_faults)
+{
+    ut_http_server_set_file(300 * 1024 + 5);
+    ut_http_server_cut(4, 5000);
+    ut_http_server_refuse(2);
+
+    ASSERT_EQ(OPRT_OK, download(3));
+    EXPECT_TRUE(result.finish);
+    EXPECT_TRUE(result.intact);
+    EXPECT_EQ(result.file_size, result.offset);
+    EXPECT_EQ(2u, server().refuse_num);
+}
+
+TEST_F(HttpDownloadTest, parallel_give_up_when_budget_used)
+{
+    ut_http_server_set_file(300 * 1024);
+    // the size probe gets through, every range connection is refused
+    result.refuse_sized = true;
+
+    SYS_TIME_T start = ut_http_clock_ms();
+    EXPECT_NE(OPRT_OK, download(3));
+    SYS_TIME_T cost = ut_http_clock_ms() - start;
+
+    EXPECT_TRUE(result.fault);
+    EXPECT_EQ(0u, result.data_num);
+    // the workers wait on one clock, the last waits may overlap the budget
+    EXPECT_GE(cost, (SYS_TIME_T)DL_UT_BUDGET_MS);
+    EXPECT_LT(cost, (SYS_TIME_T)DL_UT_BUDGET_MS + 3 * 16000);
+}
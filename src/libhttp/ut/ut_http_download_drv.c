@@ -0,0 +1,15 @@
+/**
+ * @file ut_http_download_drv.c
+ * @brief builds http_download.c on the local server stand-in, its backoff
+ * waits run on the clock of the stand-in so a case can use up the retry
+ * budget at once
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "ut_http_server.h"
+
+#define tal_system_get_millisecond ut_http_clock_ms
+#define tal_system_sleep           ut_http_clock_sleep
+
+#include "../src/http_download.c"
@@ -0,0 +1,403 @@
+/**
+ * @file ut_http_server.c
+ * @brief a local HTTP(S) server stand-in behind the transporter interface.
+ * Requests are answered as soon as they are written: POSTs with a small JSON
+ * body, range requests with a slice of a generated file. A TLS connect only
+ * costs the configured handshake time, the cases decide when connections are
+ * refused, closed or cut.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "ut_http_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "tal_api.h"
+#include "tuya_transporter.h"
+#include "tuya_tls.h"
+
+#define UT_HTTP_CONN_MAX (16)
+#define UT_HTTP_REQ_MAX  (4096)
+
+typedef struct {
+    TUYA_TRANSPORT_TYPE_E type;
+    tuya_tls_config_t tls_config;
+    bool connected;
+    bool reset;       // closed by the server, the peer sees it on read
+    bool reset_drain; // closed by the server once the response is read
+    char req[UT_HTTP_REQ_MAX + 1];
+    size_t req_len;
+    uint8_t *resp;
+    size_t resp_len;
+    size_t resp_off;
+} UT_HTTP_CONN_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    UT_HTTP_CONN_T *conn[UT_HTTP_CONN_MAX];
+    uint32_t handshake_ms;
+    size_t file_size;
+    bool close_after;
+    uint32_t cut_num;
+    size_t cut_len;
+    int32_t refuse_num;
+    UT_HTTP_SERVER_STAT_T stat;
+    SYS_TIME_T clock_offset;
+} UT_HTTP_SERVER_T;
+
+static UT_HTTP_SERVER_T sg_server;
+
+uint8_t ut_http_file_byte(size_t offset)
+{
+    return (uint8_t)(offset ^ (offset >> 8) ^ (offset >> 16));
+}
+
+static void __ut_http_conn_drop(UT_HTTP_CONN_T *conn)
+{
+    conn->connected = false;
+    conn->reset = false;
+    conn->reset_drain = false;
+    conn->req_len = 0;
+    if (conn->resp) {
+        free(conn->resp);
+        conn->resp = NULL;
+    }
+    conn->resp_len = 0;
+    conn->resp_off = 0;
+}
+
+static void __ut_http_resp_append(UT_HTTP_CONN_T *conn, const void *data, size_t len)
+{
+    conn->resp = realloc(conn->resp, conn->resp_len + len);
+    memcpy(conn->resp + conn->resp_len, data, len);
+    conn->resp_len += len;
+}
+
+static const char *__ut_http_header_find(const char *header, const char *name)
+{
+    size_t len = strlen(name);
+    const char *line = strstr(header, "\r\n");
+
+    while (line && strncmp(line, "\r\n\r\n", 4)) {
+        line += 2;
+        if (0 == strncasecmp(line, name, len) && ':' == line[len]) {
+            return line + len + 1;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return NULL;
+}
+
+/* act on one complete request, the answer is queued for the client to read */
+static void __ut_http_request_handle(UT_HTTP_CONN_T *conn, const char *header)
+{
+    char head[256];
+    char body[64];
+    size_t resp_start = conn->resp_len;
+    const char *range = __ut_http_header_find(header, "Range");
+    const char *connection = __ut_http_header_find(header, "Connection");
+    bool close = sg_server.close_after || (connection && 0 == strncmp(connection, " close", 6));
+    int len = 0;
+
+    sg_server.stat.request_num++;
+
+    if (range) {
+        unsigned long start = 0, end = 0;
+        sscanf(range, " bytes=%lu-%lu", &start, &end);
+        if (end >= sg_server.file_size) {
+            end = sg_server.file_size - 1;
+        }
+        len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lu-%lu/%lu\r\nContent-Length: %lu\r\n%s\r\n",
+                       start, end, (unsigned long)sg_server.file_size, end - start + 1,
+                       close ? "Connection: close\r\n" : "");
+        __ut_http_resp_append(conn, head, len);
+        for (size_t i = start; i <= end; i++) {
+            uint8_t byte = ut_http_file_byte(i);
+            __ut_http_resp_append(conn, &byte, 1);
+        }
+    } else {
+        int body_len = snprintf(body, sizeof(body), "{\"success\":true,\"t\":%u}", sg_server.stat.request_num);
+        len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n%s\r\n", body_len,
+                       close ? "Connection: close\r\n" : "");
+        __ut_http_resp_append(conn, head, len);
+        __ut_http_resp_append(conn, body, body_len);
+    }
+
+    if (sg_server.cut_num && conn->resp_len - resp_start > sg_server.cut_len) {
+        sg_server.cut_num--;
+        conn->resp_len = resp_start + sg_server.cut_len;
+        close = true;
+    }
+    if (close) {
+        conn->reset_drain = true;
+    }
+}
+
+/* take the complete requests out of what the client wrote */
+static void __ut_http_request_parse(UT_HTTP_CONN_T *conn)
+{
+    char *end = NULL;
+
+    while (!conn->reset_drain && NULL != (end = strstr(conn->req, "\r\n\r\n"))) {
+        size_t header_len = end + 4 - conn->req;
+        const char *value = __ut_http_header_find(conn->req, "Content-Length");
+        size_t body_len = value ? strtoul(value, NULL, 10) : 0;
+
+        if (conn->req_len < header_len + body_len) {
+            break;
+        }
+        *end = 0;
+        __ut_http_request_handle(conn, conn->req);
+        conn->req_len -= header_len + body_len;
+        memmove(conn->req, conn->req + header_len + body_len, conn->req_len);
+        conn->req[conn->req_len] = 0;
+    }
+}
+
+/*-----------------------------------------------------------*/
+tuya_transporter_t tuya_transporter_create(TUYA_TRANSPORT_TYPE_E transport_type, tuya_transporter_t dependency)
+{
+    UT_HTTP_CONN_T *conn = calloc(1, sizeof(UT_HTTP_CONN_T));
+    int i;
+
+    conn->type = transport_type;
+    tal_mutex_lock(sg_server.mutex);
+    for (i = 0; i < UT_HTTP_CONN_MAX; i++) {
+        if (NULL == sg_server.conn[i]) {
+            sg_server.conn[i] = conn;
+            break;
+        }
+    }
+    tal_mutex_unlock(sg_server.mutex);
+
+    return (tuya_transporter_t)conn;
+}
+
+OPERATE_RET tuya_transporter_destroy(tuya_transporter_t transporter)
+{
+    UT_HTTP_CONN_T *conn = (UT_HTTP_CONN_T *)transporter;
+    int i;
+
+    tal_mutex_lock(sg_server.mutex);
+    for (i = 0; i < UT_HTTP_CONN_MAX; i++) {
+        if (conn == sg_server.conn[i]) {
+            sg_server.conn[i] = NULL;
+        }
+    }
+    __ut_http_conn_drop(conn);
+    tal_mutex_unlock(sg_server.mutex);
+    free(conn);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_transporter_connect(tuya_transporter_t transporter, const char *host, int port, int timeout_ms)
+{
+    UT_HTTP_CONN_T *conn = (UT_HTTP_CONN_T *)transporter;
+    bool refuse = false;
+
+    tal_mutex_lock(sg_server.mutex);
+    __ut_http_conn_drop(conn);
+    if (sg_server.refuse_num) {
+        refuse = true;
+        sg_server.stat.refuse_num++;
+        if (sg_server.refuse_num > 0) {
+            sg_server.refuse_num--;
+        }
+    }
+    tal_mutex_unlock(sg_server.mutex);
+
+    if (refuse) {
+        return OPRT_COM_ERROR;
+    }
+    if (TRANSPORT_TYPE_TLS == conn->type) {
+        tal_system_sleep(sg_server.handshake_ms);
+    }
+
+    tal_mutex_lock(sg_server.mutex);
+    conn->connected = true;
+    sg_server.stat.connect_num++;
+    if (TRANSPORT_TYPE_TLS == conn->type) {
+        sg_server.stat.handshake_num++;
+    }
+    tal_mutex_unlock(sg_server.mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_transporter_read(tuya_transporter_t transporter, uint8_t *buf, int len, int timeout_ms)
+{
+    UT_HTTP_CONN_T *conn = (UT_HTTP_CONN_T *)transporter;
+    OPERATE_RET rt = OPRT_RESOURCE_NOT_READY;
+
+    tal_mutex_lock(sg_server.mutex);
+    if (!conn->connected || conn->reset) {
+        rt = OPRT_COM_ERROR;
+    } else if (conn->resp_off < conn->resp_len) {
+        rt = conn->resp_len - conn->resp_off;
+        rt = (rt < len) ? rt : len;
+        memcpy(buf, conn->resp + conn->resp_off, rt);
+        conn->resp_off += rt;
+    } else if (conn->reset_drain) {
+        conn->reset = true;
+        rt = OPRT_COM_ERROR;
+    }
+    tal_mutex_unlock(sg_server.mutex);
+
+    return rt;
+}
+
+OPERATE_RET tuya_transporter_write(tuya_transporter_t transporter, uint8_t *buf, int len, int timeout_ms)
+{
+    UT_HTTP_CONN_T *conn = (UT_HTTP_CONN_T *)transporter;
+    OPERATE_RET rt = len;
+
+    tal_mutex_lock(sg_server.mutex);
+    if (!conn->connected) {
+        rt = OPRT_COM_ERROR;
+    } else if (!conn->reset && !conn->reset_drain) {
+        // a connection closed by the server takes the write, the data is lost
+        if (conn->req_len + len > UT_HTTP_REQ_MAX) {
+            conn->reset = true;
+        } else {
+            memcpy(conn->req + conn->req_len, buf, len);
+            conn->req_len += len;
+            conn->req[conn->req_len] = 0;
+            __ut_http_request_parse(conn);
+        }
+    }
+    tal_mutex_unlock(sg_server.mutex);
+
+    return rt;
+}
+
+OPERATE_RET tuya_transporter_close(tuya_transporter_t transporter)
+{
+    tal_mutex_lock(sg_server.mutex);
+    __ut_http_conn_drop((UT_HTTP_CONN_T *)transporter);
+    tal_mutex_unlock(sg_server.mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_transporter_ctrl(tuya_transporter_t transporter, uint32_t cmd, void *args)
+{
+    UT_HTTP_CONN_T *conn = (UT_HTTP_CONN_T *)transporter;
+
+    if (TUYA_TRANSPORTER_SET_TLS_CONFIG == cmd && TRANSPORT_TYPE_TLS == conn->type) {
+        conn->tls_config = *(tuya_tls_config_t *)args;
+        return OPRT_OK;
+    }
+    if (TUYA_TRANSPORTER_GET_TLS_CONFIG == cmd && TRANSPORT_TYPE_TLS == conn->type) {
+        *(tuya_tls_config_t **)args = &conn->tls_config;
+        return OPRT_OK;
+    }
+
+    return OPRT_NOT_SUPPORTED;
+}
+
+/*-----------------------------------------------------------*/
+void ut_http_server_reset(void)
+{
+    int i;
+
+    if (NULL == sg_server.mutex) {
+        tal_mutex_create_init(&sg_server.mutex);
+    }
+
+    tal_mutex_lock(sg_server.mutex);
+    for (i = 0; i < UT_HTTP_CONN_MAX; i++) {
+        if (sg_server.conn[i]) {
+            sg_server.conn[i]->reset = true;
+        }
+    }
+    sg_server.handshake_ms = 0;
+    sg_server.file_size = 0;
+    sg_server.close_after = false;
+    sg_server.cut_num = 0;
+    sg_server.cut_len = 0;
+    sg_server.refuse_num = 0;
+    memset(&sg_server.stat, 0, sizeof(sg_server.stat));
+    tal_mutex_unlock(sg_server.mutex);
+}
+
+void ut_http_server_set_handshake(uint32_t ms)
+{
+    sg_server.handshake_ms = ms;
+}
+
+void ut_http_server_set_file(size_t size)
+{
+    sg_server.file_size = size;
+}
+
+void ut_http_server_close_after(bool close)
+{
+    sg_server.close_after = close;
+}
+
+void ut_http_server_close_idle(void)
+{
+    int i;
+
+    tal_mutex_lock(sg_server.mutex);
+    for (i = 0; i < UT_HTTP_CONN_MAX; i++) {
+        if (sg_server.conn[i] && sg_server.conn[i]->connected) {
+            sg_server.conn[i]->reset = true;
+        }
+    }
+    tal_mutex_unlock(sg_server.mutex);
+}
+
+void ut_http_server_cut(uint32_t num, size_t len)
+{
+    tal_mutex_lock(sg_server.mutex);
+    sg_server.cut_num = num;
+    sg_server.cut_len = len;
+    tal_mutex_unlock(sg_server.mutex);
+}
+
+void ut_http_server_refuse(int32_t num)
+{
+    tal_mutex_lock(sg_server.mutex);
+    sg_server.refuse_num = num;
+    tal_mutex_unlock(sg_server.mutex);
+}
+
+void ut_http_server_stat(UT_HTTP_SERVER_STAT_T *stat)
+{
+    tal_mutex_lock(sg_server.mutex);
+    *stat = sg_server.stat;
+    tal_mutex_unlock(sg_server.mutex);
+}
+
+/*-----------------------------------------------------------*/
+SYS_TIME_T ut_http_clock_ms(void)
+{
+    return tal_system_get_millisecond() + sg_server.clock_offset;
+}
+
+TIME_T ut_http_clock_posix(void)
+{
+    return tal_time_get_posix() + sg_server.clock_offset / 1000;
+}
+
+void ut_http_clock_sleep(uint32_t ms)
+{
+    ut_http_clock_advance(ms);
+    // let the other threads run, the cases do not wait for the delay
+    tal_system_sleep(1);
+}
+
+void ut_http_clock_advance(uint32_t ms)
+{
+    tal_mutex_lock(sg_server.mutex);
+    sg_server.clock_offset += ms;
+    tal_mutex_unlock(sg_server.mutex);
+}
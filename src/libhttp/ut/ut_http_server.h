@@ -0,0 +1,91 @@
+/**
+ * @file ut_http_server.h
+ * @brief a local HTTP(S) server stand-in behind the transporter interface and
+ * a clock the cases can move, see ut_http_server.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_HTTP_SERVER_H__
+#define __UT_HTTP_SERVER_H__
+
+#include "tuya_cloud_types.h"
+
+/* the sources under test reach the stand-in instead of a socket */
+#define tuya_transporter_create  __ut_http_transporter_create
+#define tuya_transporter_destroy __ut_http_transporter_destroy
+#define tuya_transporter_connect __ut_http_transporter_connect
+#define tuya_transporter_read    __ut_http_transporter_read
+#define tuya_transporter_write   __ut_http_transporter_write
+#define tuya_transporter_close   __ut_http_transporter_close
+#define tuya_transporter_ctrl    __ut_http_transporter_ctrl
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t connect_num;   // connections accepted
+    uint32_t handshake_num; // TLS handshakes, every TLS connect costs one
+    uint32_t request_num;   // requests the server acted on
+    uint32_t refuse_num;    // connects refused
+} UT_HTTP_SERVER_STAT_T;
+
+/**
+ * @brief drop every connection, clear the faults and the statistics
+ */
+void ut_http_server_reset(void);
+
+/**
+ * @brief time a TLS connect takes, standing in for the handshake
+ */
+void ut_http_server_set_handshake(uint32_t ms);
+
+/**
+ * @brief size of the file served to range requests, see ut_http_file_byte
+ */
+void ut_http_server_set_file(size_t size);
+
+/**
+ * @brief answer with "Connection: close" and close after every response
+ */
+void ut_http_server_close_after(bool close);
+
+/**
+ * @brief close every open connection from the server side, a request
+ * written on one is lost and the read fails without a byte
+ */
+void ut_http_server_close_idle(void);
+
+/**
+ * @brief the next num responses longer than len are cut after len bytes and
+ * the connection reset, the server acted on the requests
+ */
+void ut_http_server_cut(uint32_t num, size_t len);
+
+/**
+ * @brief refuse the next num connects, -1 refuses all
+ */
+void ut_http_server_refuse(int32_t num);
+
+void ut_http_server_stat(UT_HTTP_SERVER_STAT_T *stat);
+
+/**
+ * @brief the byte at offset of the served file
+ */
+uint8_t ut_http_file_byte(size_t offset);
+
+/**
+ * @brief the clock of the sources under test, tal_system_sleep on it returns
+ * at once and moves it on
+ */
+SYS_TIME_T ut_http_clock_ms(void);
+TIME_T ut_http_clock_posix(void);
+void ut_http_clock_sleep(uint32_t ms);
+void ut_http_clock_advance(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_HTTP_SERVER_H__ */
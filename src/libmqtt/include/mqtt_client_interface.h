@@ -34,7 +34,8 @@ typedef enum mqtt_cleint_qos {
 } mqtt_client_qos_t;
 
 typedef struct mqtt_client_message {
-    const char *topic;
+    const char *topic; // points into the packet, not NUL terminated
+    size_t topic_length;
     const uint8_t *payload;
     size_t length;
     mqtt_client_qos_t qos;
@@ -35,22 +35,15 @@ static void core_mqtt_library_callback(struct MQTTContext *pContext, struct MQTT
             return;
         }
 
-        char *topic = tal_malloc(pDeserializedInfo->pPublishInfo->topicNameLength + 1);
-        if (topic == NULL) {
-            return;
-        }
-        memcpy(topic, pDeserializedInfo->pPublishInfo->pTopicName, pDeserializedInfo->pPublishInfo->topicNameLength);
-        topic[pDeserializedInfo->pPublishInfo->topicNameLength] = '\0';
-
         context->config.on_message(context, msgid,
                                    &(const mqtt_client_message_t){
-                                       .topic = topic,
+                                       .topic = pDeserializedInfo->pPublishInfo->pTopicName,
+                                       .topic_length = pDeserializedInfo->pPublishInfo->topicNameLength,
                                        .payload = pDeserializedInfo->pPublishInfo->pPayload,
                                        .length = pDeserializedInfo->pPublishInfo->payloadLength,
                                        .qos = pDeserializedInfo->pPublishInfo->qos,
                                    },
                                    context->config.userdata);
-        tal_free(topic);
 
     } else {
         switch (pPacketInfo->type) {
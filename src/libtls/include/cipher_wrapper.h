@@ -9,6 +9,11 @@ extern "C" {
 #include "mbedtls/platform.h"
 #include "mbedtls/cipher.h"
 #include "mbedtls/md.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/aes.h"
+#if defined(MBEDTLS_CHACHAPOLY_C)
+#include "mbedtls/chachapoly.h"
+#endif
 
 typedef struct {
     unsigned char *key;
@@ -22,12 +27,50 @@ typedef struct {
     mbedtls_cipher_type_t cipher_type;
 } cipher_params_t;
 
+/* cipher bound to one key, the key schedule is expanded once at create */
+typedef struct cipher_keyed cipher_keyed_t;
+
+/* hmac bound to one key, the padded key blocks are computed once at create */
+typedef struct hmac_keyed hmac_keyed_t;
+
 int mbedtls_cipher_auth_encrypt_wrapper(const cipher_params_t *input, unsigned char *output, size_t *olen,
                                         unsigned char *tag, size_t tag_len);
 
 int mbedtls_cipher_auth_decrypt_wrapper(const cipher_params_t *input, unsigned char *output, size_t *olen,
                                         unsigned char *tag, size_t tag_len);
 
+/*
+ * Keyed handles: AES GCM, AES CBC (no padding) and CHACHA20_POLY1305 ciphers.
+ * Each handle is serialized by its own mutex and may be shared between threads.
+ * The auth functions follow the wrapper contract above, input->key, key_len
+ * and cipher_type are ignored, and output may equal input->data.
+ */
+int mbedtls_cipher_keyed_create(mbedtls_cipher_type_t cipher_type, const unsigned char *key, size_t key_len,
+                                cipher_keyed_t **keyed);
+
+/* rebind to a new key of the same size, callers sharing the handle keep it */
+int mbedtls_cipher_keyed_setkey(cipher_keyed_t *keyed, const unsigned char *key, size_t key_len);
+
+void mbedtls_cipher_keyed_free(cipher_keyed_t *keyed);
+
+int mbedtls_cipher_keyed_auth_encrypt(cipher_keyed_t *keyed, const cipher_params_t *input, unsigned char *output,
+                                      size_t *olen, unsigned char *tag, size_t tag_len);
+
+int mbedtls_cipher_keyed_auth_decrypt(cipher_keyed_t *keyed, const cipher_params_t *input, unsigned char *output,
+                                      size_t *olen, unsigned char *tag, size_t tag_len);
+
+/* length must be a multiple of 16, iv is updated as by mbedtls_aes_crypt_cbc */
+int mbedtls_cipher_keyed_crypt_cbc(cipher_keyed_t *keyed, mbedtls_operation_t mode, size_t length,
+                                   unsigned char iv[16], const unsigned char *input, unsigned char *output);
+
+int mbedtls_hmac_keyed_create(mbedtls_md_type_t md_type, const uint8_t *key, size_t keylen, hmac_keyed_t **keyed);
+
+int mbedtls_hmac_keyed_setkey(hmac_keyed_t *keyed, const uint8_t *key, size_t keylen);
+
+void mbedtls_hmac_keyed_free(hmac_keyed_t *keyed);
+
+int mbedtls_hmac_keyed_digest(hmac_keyed_t *keyed, const uint8_t *input, size_t ilen, uint8_t *digest);
+
 int mbedtls_message_digest(mbedtls_md_type_t md_type, const uint8_t *input, size_t ilen, uint8_t *digest);
 
 int mbedtls_message_digest_hmac(mbedtls_md_type_t md_type, const uint8_t *key, size_t keylen, const uint8_t *input,
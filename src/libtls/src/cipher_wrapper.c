@@ -2,6 +2,27 @@
 #include "cipher_wrapper.h"
 #include "tal_log.h"
 #include "tal_memory.h"
+#include "tal_mutex.h"
+
+struct cipher_keyed {
+    mbedtls_cipher_type_t cipher_type;
+    MUTEX_HANDLE mutex;
+    union {
+        mbedtls_gcm_context gcm;
+        struct {
+            mbedtls_aes_context enc;
+            mbedtls_aes_context dec;
+        } cbc;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+        mbedtls_chachapoly_context chachapoly;
+#endif
+    } ctx;
+};
+
+struct hmac_keyed {
+    MUTEX_HANDLE mutex;
+    mbedtls_md_context_t md_ctx;
+};
 
 int mbedtls_cipher_auth_encrypt_wrapper(const cipher_params_t *input, unsigned char *output, size_t *olen,
                                         unsigned char *tag, size_t tag_len)
@@ -136,6 +157,248 @@ EXIT:
     return (ret);
 }
 
+static void __cipher_keyed_ctx_free(cipher_keyed_t *keyed)
+{
+    switch (keyed->cipher_type) {
+    case MBEDTLS_CIPHER_AES_128_GCM:
+    case MBEDTLS_CIPHER_AES_192_GCM:
+    case MBEDTLS_CIPHER_AES_256_GCM:
+        mbedtls_gcm_free(&keyed->ctx.gcm);
+        break;
+    case MBEDTLS_CIPHER_AES_128_CBC:
+    case MBEDTLS_CIPHER_AES_192_CBC:
+    case MBEDTLS_CIPHER_AES_256_CBC:
+        mbedtls_aes_free(&keyed->ctx.cbc.enc);
+        mbedtls_aes_free(&keyed->ctx.cbc.dec);
+        break;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    case MBEDTLS_CIPHER_CHACHA20_POLY1305:
+        mbedtls_chachapoly_free(&keyed->ctx.chachapoly);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+static int __cipher_keyed_setkey(cipher_keyed_t *keyed, const unsigned char *key, size_t key_len)
+{
+    int ret = OPRT_NOT_SUPPORTED;
+
+    switch (keyed->cipher_type) {
+    case MBEDTLS_CIPHER_AES_128_GCM:
+    case MBEDTLS_CIPHER_AES_192_GCM:
+    case MBEDTLS_CIPHER_AES_256_GCM:
+        ret = mbedtls_gcm_setkey(&keyed->ctx.gcm, MBEDTLS_CIPHER_ID_AES, key, key_len * 8);
+        break;
+    case MBEDTLS_CIPHER_AES_128_CBC:
+    case MBEDTLS_CIPHER_AES_192_CBC:
+    case MBEDTLS_CIPHER_AES_256_CBC:
+        ret = mbedtls_aes_setkey_enc(&keyed->ctx.cbc.enc, key, key_len * 8);
+        if (ret == 0) {
+            ret = mbedtls_aes_setkey_dec(&keyed->ctx.cbc.dec, key, key_len * 8);
+        }
+        break;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    case MBEDTLS_CIPHER_CHACHA20_POLY1305:
+        ret = mbedtls_chachapoly_setkey(&keyed->ctx.chachapoly, key);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    if (ret != 0) {
+        PR_ERR("cipher setkey error:-0x%04x", -ret);
+    }
+    return ret;
+}
+
+int mbedtls_cipher_keyed_create(mbedtls_cipher_type_t cipher_type, const unsigned char *key, size_t key_len,
+                                cipher_keyed_t **keyed)
+{
+    if (key == NULL || keyed == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    const mbedtls_cipher_info_t *cipher_info = mbedtls_cipher_info_from_type(cipher_type);
+    if (cipher_info == NULL || (key_len * 8) != mbedtls_cipher_info_get_key_bitlen(cipher_info)) {
+        PR_ERR("cipher:%d key_len:%d unsupported", cipher_type, key_len);
+        return OPRT_INVALID_PARM;
+    }
+
+    cipher_keyed_t *ctx = tal_calloc(1, sizeof(cipher_keyed_t));
+    if (ctx == NULL) {
+        return OPRT_MALLOC_FAILED;
+    }
+    ctx->cipher_type = cipher_type;
+
+    switch (cipher_type) {
+    case MBEDTLS_CIPHER_AES_128_GCM:
+    case MBEDTLS_CIPHER_AES_192_GCM:
+    case MBEDTLS_CIPHER_AES_256_GCM:
+        mbedtls_gcm_init(&ctx->ctx.gcm);
+        break;
+    case MBEDTLS_CIPHER_AES_128_CBC:
+    case MBEDTLS_CIPHER_AES_192_CBC:
+    case MBEDTLS_CIPHER_AES_256_CBC:
+        mbedtls_aes_init(&ctx->ctx.cbc.enc);
+        mbedtls_aes_init(&ctx->ctx.cbc.dec);
+        break;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    case MBEDTLS_CIPHER_CHACHA20_POLY1305:
+        mbedtls_chachapoly_init(&ctx->ctx.chachapoly);
+        break;
+#endif
+    default:
+        PR_ERR("cipher:%d not supported by keyed handle", cipher_type);
+        tal_free(ctx);
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    int ret = __cipher_keyed_setkey(ctx, key, key_len);
+    if (ret == 0) {
+        ret = tal_mutex_create_init(&ctx->mutex);
+    }
+
+    if (ret != 0) {
+        __cipher_keyed_ctx_free(ctx);
+        tal_free(ctx);
+        return ret;
+    }
+
+    *keyed = ctx;
+    return OPRT_OK;
+}
+
+int mbedtls_cipher_keyed_setkey(cipher_keyed_t *keyed, const unsigned char *key, size_t key_len)
+{
+    if (keyed == NULL || key == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    const mbedtls_cipher_info_t *cipher_info = mbedtls_cipher_info_from_type(keyed->cipher_type);
+    if (cipher_info == NULL || (key_len * 8) != mbedtls_cipher_info_get_key_bitlen(cipher_info)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(keyed->mutex);
+    int ret = __cipher_keyed_setkey(keyed, key, key_len);
+    tal_mutex_unlock(keyed->mutex);
+
+    return ret;
+}
+
+void mbedtls_cipher_keyed_free(cipher_keyed_t *keyed)
+{
+    if (keyed == NULL) {
+        return;
+    }
+
+    __cipher_keyed_ctx_free(keyed);
+    if (keyed->mutex) {
+        tal_mutex_release(keyed->mutex);
+    }
+    tal_free(keyed);
+}
+
+int mbedtls_cipher_keyed_auth_encrypt(cipher_keyed_t *keyed, const cipher_params_t *input, unsigned char *output,
+                                      size_t *olen, unsigned char *tag, size_t tag_len)
+{
+    if (keyed == NULL || input == NULL || output == NULL || olen == NULL || tag == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    int ret = OPRT_OK;
+
+    tal_mutex_lock(keyed->mutex);
+    switch (keyed->cipher_type) {
+    case MBEDTLS_CIPHER_AES_128_GCM:
+    case MBEDTLS_CIPHER_AES_192_GCM:
+    case MBEDTLS_CIPHER_AES_256_GCM:
+        ret = mbedtls_gcm_crypt_and_tag(&keyed->ctx.gcm, MBEDTLS_GCM_ENCRYPT, input->data_len, input->nonce,
+                                        input->nonce_len, input->ad, input->ad_len, input->data, output, tag_len, tag);
+        break;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    case MBEDTLS_CIPHER_CHACHA20_POLY1305:
+        if (input->nonce_len != 12 || tag_len != 16) {
+            ret = OPRT_INVALID_PARM;
+            break;
+        }
+        ret = mbedtls_chachapoly_encrypt_and_tag(&keyed->ctx.chachapoly, input->data_len, input->nonce, input->ad,
+                                                 input->ad_len, input->data, output, tag);
+        break;
+#endif
+    default:
+        ret = OPRT_NOT_SUPPORTED;
+        break;
+    }
+    tal_mutex_unlock(keyed->mutex);
+
+    *olen = (ret == 0) ? input->data_len : 0;
+    return ret;
+}
+
+int mbedtls_cipher_keyed_auth_decrypt(cipher_keyed_t *keyed, const cipher_params_t *input, unsigned char *output,
+                                      size_t *olen, unsigned char *tag, size_t tag_len)
+{
+    if (keyed == NULL || input == NULL || output == NULL || olen == NULL || tag == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    int ret = OPRT_OK;
+
+    tal_mutex_lock(keyed->mutex);
+    switch (keyed->cipher_type) {
+    case MBEDTLS_CIPHER_AES_128_GCM:
+    case MBEDTLS_CIPHER_AES_192_GCM:
+    case MBEDTLS_CIPHER_AES_256_GCM:
+        ret = mbedtls_gcm_auth_decrypt(&keyed->ctx.gcm, input->data_len, input->nonce, input->nonce_len, input->ad,
+                                       input->ad_len, tag, tag_len, input->data, output);
+        break;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    case MBEDTLS_CIPHER_CHACHA20_POLY1305:
+        if (input->nonce_len != 12 || tag_len != 16) {
+            ret = OPRT_INVALID_PARM;
+            break;
+        }
+        ret = mbedtls_chachapoly_auth_decrypt(&keyed->ctx.chachapoly, input->data_len, input->nonce, input->ad,
+                                              input->ad_len, tag, input->data, output);
+        break;
+#endif
+    default:
+        ret = OPRT_NOT_SUPPORTED;
+        break;
+    }
+    tal_mutex_unlock(keyed->mutex);
+
+    *olen = (ret == 0) ? input->data_len : 0;
+    return ret;
+}
+
+int mbedtls_cipher_keyed_crypt_cbc(cipher_keyed_t *keyed, mbedtls_operation_t mode, size_t length,
+                                   unsigned char iv[16], const unsigned char *input, unsigned char *output)
+{
+    if (keyed == NULL || iv == NULL || input == NULL || output == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (keyed->cipher_type != MBEDTLS_CIPHER_AES_128_CBC && keyed->cipher_type != MBEDTLS_CIPHER_AES_192_CBC &&
+        keyed->cipher_type != MBEDTLS_CIPHER_AES_256_CBC) {
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    /* the aes round keys are only read, the lock covers platform AES_ALT
+     * implementations that keep per-context hardware state */
+    tal_mutex_lock(keyed->mutex);
+    int ret = mbedtls_aes_crypt_cbc((mode == MBEDTLS_ENCRYPT) ? &keyed->ctx.cbc.enc : &keyed->ctx.cbc.dec,
+                                    (mode == MBEDTLS_ENCRYPT) ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, length, iv,
+                                    input, output);
+    tal_mutex_unlock(keyed->mutex);
+
+    return ret;
+}
+
 int mbedtls_message_digest(mbedtls_md_type_t md_type, const uint8_t *input, size_t ilen, uint8_t *digest)
 {
     if (input == NULL || ilen == 0 || digest == NULL) {
@@ -181,4 +444,86 @@ int mbedtls_message_digest_hmac(mbedtls_md_type_t md_type, const uint8_t *key, s
 exit:
     mbedtls_md_free(&md_ctx);
     return ret;
-}
\ No newline at end of file
+}
+
+int mbedtls_hmac_keyed_create(mbedtls_md_type_t md_type, const uint8_t *key, size_t keylen, hmac_keyed_t **keyed)
+{
+    if (key == NULL || keylen == 0 || keyed == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    hmac_keyed_t *ctx = tal_calloc(1, sizeof(hmac_keyed_t));
+    if (ctx == NULL) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    mbedtls_md_init(&ctx->md_ctx);
+    int ret = mbedtls_md_setup(&ctx->md_ctx, mbedtls_md_info_from_type(md_type), 1);
+    if (ret != 0) {
+        PR_ERR("mbedtls_md_setup() returned -0x%04x\n", -ret);
+        goto exit;
+    }
+
+    /* ipad/opad are kept in the context, mbedtls_md_hmac_reset restarts from them */
+    ret = mbedtls_md_hmac_starts(&ctx->md_ctx, key, keylen);
+    if (ret != 0) {
+        goto exit;
+    }
+
+    ret = tal_mutex_create_init(&ctx->mutex);
+
+exit:
+    if (ret != 0) {
+        mbedtls_md_free(&ctx->md_ctx);
+        tal_free(ctx);
+        return ret;
+    }
+
+    *keyed = ctx;
+    return OPRT_OK;
+}
+
+int mbedtls_hmac_keyed_setkey(hmac_keyed_t *keyed, const uint8_t *key, size_t keylen)
+{
+    if (keyed == NULL || key == NULL || keylen == 0) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(keyed->mutex);
+    int ret = mbedtls_md_hmac_starts(&keyed->md_ctx, key, keylen);
+    tal_mutex_unlock(keyed->mutex);
+
+    return ret;
+}
+
+void mbedtls_hmac_keyed_free(hmac_keyed_t *keyed)
+{
+    if (keyed == NULL) {
+        return;
+    }
+
+    mbedtls_md_free(&keyed->md_ctx);
+    if (keyed->mutex) {
+        tal_mutex_release(keyed->mutex);
+    }
+    tal_free(keyed);
+}
+
+int mbedtls_hmac_keyed_digest(hmac_keyed_t *keyed, const uint8_t *input, size_t ilen, uint8_t *digest)
+{
+    if (keyed == NULL || (input == NULL && ilen != 0) || digest == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(keyed->mutex);
+    int ret = mbedtls_md_hmac_reset(&keyed->md_ctx);
+    if (ret == 0) {
+        ret = mbedtls_md_hmac_update(&keyed->md_ctx, input, ilen);
+    }
+    if (ret == 0) {
+        ret = mbedtls_md_hmac_finish(&keyed->md_ctx, digest);
+    }
+    tal_mutex_unlock(keyed->mutex);
+
+    return ret;
+}
@@ -0,0 +1,282 @@
+/**
+ * @file ut_cipher_keyed.cpp
+ * @brief keyed cipher and hmac handle test cases, results must match the one
+ * shot wrappers byte for byte, and a benchmark of both paths.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "tuya_cloud_types.h"
+#include "cipher_wrapper.h"
+}
+
+#define CIPHER_UT_DATA_MAX (1024)
+
+static uint8_t s_key[32];
+static uint8_t s_nonce[12];
+static uint8_t s_ad[16];
+static uint8_t s_data[CIPHER_UT_DATA_MAX];
+
+static const size_t s_lens[] = {0, 1, 15, 16, 17, 100, 256, CIPHER_UT_DATA_MAX};
+
+class CipherKeyedTest : public ::testing::Test {
+  protected:
+    static void SetUpTestCase()
+    {
+        for (size_t i = 0; i < sizeof(s_key); i++) {
+            s_key[i] = (uint8_t)(i * 7 + 1);
+        }
+        for (size_t i = 0; i < sizeof(s_nonce); i++) {
+            s_nonce[i] = (uint8_t)('a' + i);
+        }
+        memset(s_ad, 'A', sizeof(s_ad));
+        for (size_t i = 0; i < sizeof(s_data); i++) {
+            s_data[i] = (uint8_t)(i * 31);
+        }
+    }
+
+    static cipher_params_t params(mbedtls_cipher_type_t type, size_t key_len, uint8_t *data, size_t len)
+    {
+        cipher_params_t p = {};
+        p.key = s_key;
+        p.key_len = key_len;
+        p.nonce = s_nonce;
+        p.nonce_len = sizeof(s_nonce);
+        p.ad = s_ad;
+        p.ad_len = sizeof(s_ad);
+        p.data = data;
+        p.data_len = len;
+        p.cipher_type = type;
+        return p;
+    }
+
+    // keyed encrypt equals the one shot wrapper, decrypt restores, in place too
+    static void check_aead(mbedtls_cipher_type_t type, size_t key_len)
+    {
+        static uint8_t c1[CIPHER_UT_DATA_MAX], c2[CIPHER_UT_DATA_MAX], plain[CIPHER_UT_DATA_MAX];
+        uint8_t t1[16], t2[16];
+        size_t o1 = 0, o2 = 0;
+        cipher_keyed_t *keyed = NULL;
+
+        ASSERT_EQ(OPRT_OK, mbedtls_cipher_keyed_create(type, s_key, key_len, &keyed));
+        for (size_t len : s_lens) {
+            SCOPED_TRACE(len);
+            cipher_params_t p = params(type, key_len, s_data, len);
+
+            ASSERT_EQ(0, mbedtls_cipher_auth_encrypt_wrapper(&p, c1, &o1, t1, sizeof(t1)));
+            ASSERT_EQ(0, mbedtls_cipher_keyed_auth_encrypt(keyed, &p, c2, &o2, t2, sizeof(t2)));
+            EXPECT_EQ(o1, o2);
+            EXPECT_EQ(0, memcmp(c1, c2, len));
+            EXPECT_EQ(0, memcmp(t1, t2, sizeof(t1)));
+
+            cipher_params_t q = params(type, key_len, c2, len);
+            ASSERT_EQ(0, mbedtls_cipher_keyed_auth_decrypt(keyed, &q, plain, &o2, t2, sizeof(t2)));
+            EXPECT_EQ(len, o2);
+            EXPECT_EQ(0, memcmp(plain, s_data, len));
+
+            memcpy(plain, c2, len);
+            q.data = plain;
+            ASSERT_EQ(0, mbedtls_cipher_keyed_auth_decrypt(keyed, &q, plain, &o2, t2, sizeof(t2)));
+            EXPECT_EQ(0, memcmp(plain, s_data, len));
+
+            t2[0] ^= 1;
+            q.data = c2;
+            EXPECT_NE(0, mbedtls_cipher_keyed_auth_decrypt(keyed, &q, plain, &o2, t2, sizeof(t2)));
+            EXPECT_EQ(0u, o2);
+        }
+        mbedtls_cipher_keyed_free(keyed);
+    }
+};
+
+TEST_F(CipherKeyedTest, gcm_matches_one_shot)
+{
+    check_aead(MBEDTLS_CIPHER_AES_128_GCM, 16);
+    check_aead(MBEDTLS_CIPHER_AES_256_GCM, 32);
+}
+
+#if defined(MBEDTLS_CHACHAPOLY_C)
+TEST_F(CipherKeyedTest, chachapoly_matches_one_shot)
+{
+    check_aead(MBEDTLS_CIPHER_CHACHA20_POLY1305, 32);
+}
+#endif
+
+TEST_F(CipherKeyedTest, cbc_matches_aes)
+{
+    uint8_t iv[16] = {0}, iv_ref[16] = {0};
+    uint8_t c1[256], c2[256];
+    cipher_keyed_t *keyed = NULL;
+    mbedtls_aes_context aes;
+
+    ASSERT_EQ(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_256_CBC, s_key, 32, &keyed));
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, s_key, 256);
+
+    // chained over two calls, the iv carries on as in mbedtls_aes_crypt_cbc
+    ASSERT_EQ(0, mbedtls_cipher_keyed_crypt_cbc(keyed, MBEDTLS_ENCRYPT, 96, iv, s_data, c1));
+    ASSERT_EQ(0, mbedtls_cipher_keyed_crypt_cbc(keyed, MBEDTLS_ENCRYPT, 160, iv, s_data + 96, c1 + 96));
+    ASSERT_EQ(0, mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, 256, iv_ref, s_data, c2));
+    EXPECT_EQ(0, memcmp(c1, c2, sizeof(c1)));
+    EXPECT_EQ(0, memcmp(iv, iv_ref, sizeof(iv)));
+
+    memset(iv, 0, sizeof(iv));
+    ASSERT_EQ(0, mbedtls_cipher_keyed_crypt_cbc(keyed, MBEDTLS_DECRYPT, sizeof(c1), iv, c1, c1));
+    EXPECT_EQ(0, memcmp(c1, s_data, sizeof(c1)));
+    EXPECT_NE(0, mbedtls_cipher_keyed_crypt_cbc(keyed, MBEDTLS_ENCRYPT, 15, iv, s_data, c1));
+
+    mbedtls_aes_free(&aes);
+    mbedtls_cipher_keyed_free(keyed);
+}
+
+TEST_F(CipherKeyedTest, setkey_rebinds)
+{
+    uint8_t key2[16] = {9, 8, 7};
+    uint8_t c1[100], c2[100], t1[16], t2[16];
+    size_t o1 = 0, o2 = 0;
+    cipher_keyed_t *keyed = NULL;
+
+    ASSERT_EQ(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, s_key, 16, &keyed));
+    ASSERT_EQ(0, mbedtls_cipher_keyed_setkey(keyed, key2, sizeof(key2)));
+    EXPECT_NE(0, mbedtls_cipher_keyed_setkey(keyed, s_key, 32));
+
+    cipher_params_t p = params(MBEDTLS_CIPHER_AES_128_GCM, 16, s_data, sizeof(c1));
+    p.key = key2;
+    ASSERT_EQ(0, mbedtls_cipher_auth_encrypt_wrapper(&p, c1, &o1, t1, sizeof(t1)));
+    ASSERT_EQ(0, mbedtls_cipher_keyed_auth_encrypt(keyed, &p, c2, &o2, t2, sizeof(t2)));
+    EXPECT_EQ(0, memcmp(c1, c2, sizeof(c1)));
+    EXPECT_EQ(0, memcmp(t1, t2, sizeof(t1)));
+
+    mbedtls_cipher_keyed_free(keyed);
+}
+
+TEST_F(CipherKeyedTest, create_rejects_bad_key)
+{
+    cipher_keyed_t *keyed = NULL;
+
+    EXPECT_NE(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, s_key, 32, &keyed));
+    EXPECT_NE(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, NULL, 16, &keyed));
+    EXPECT_EQ(NULL, keyed);
+}
+
+TEST_F(CipherKeyedTest, hmac_matches_one_shot)
+{
+    uint8_t h1[32], h2[32];
+    hmac_keyed_t *keyed = NULL;
+
+    ASSERT_EQ(OPRT_OK, mbedtls_hmac_keyed_create(MBEDTLS_MD_SHA256, s_key, 32, &keyed));
+    for (size_t len : s_lens) {
+        SCOPED_TRACE(len);
+        if (0 == len) {
+            continue; // the one shot wrapper refuses empty input
+        }
+        ASSERT_EQ(0, mbedtls_message_digest_hmac(MBEDTLS_MD_SHA256, s_key, 32, s_data, len, h1));
+        // twice, each digest restarts from the kept key state
+        for (int i = 0; i < 2; i++) {
+            ASSERT_EQ(0, mbedtls_hmac_keyed_digest(keyed, s_data, len, h2));
+            EXPECT_EQ(0, memcmp(h1, h2, sizeof(h1)));
+        }
+    }
+
+    // a key longer than the block is hashed first
+    ASSERT_EQ(0, mbedtls_hmac_keyed_setkey(keyed, s_data, 100));
+    ASSERT_EQ(0, mbedtls_message_digest_hmac(MBEDTLS_MD_SHA256, s_data, 100, s_key, 32, h1));
+    ASSERT_EQ(0, mbedtls_hmac_keyed_digest(keyed, s_key, 32, h2));
+    EXPECT_EQ(0, memcmp(h1, h2, sizeof(h1)));
+
+    mbedtls_hmac_keyed_free(keyed);
+}
+
+TEST_F(CipherKeyedTest, shared_between_threads)
+{
+    const int thread_num = 4;
+    const int loop = 500;
+    uint8_t ref[256], ref_tag[16], ref_mac[32];
+    size_t olen = 0;
+    cipher_keyed_t *cipher = NULL;
+    hmac_keyed_t *hmac = NULL;
+    std::vector<std::thread> threads;
+    std::vector<int> bad(thread_num, 0);
+
+    cipher_params_t p = params(MBEDTLS_CIPHER_AES_128_GCM, 16, s_data, sizeof(ref));
+    ASSERT_EQ(0, mbedtls_cipher_auth_encrypt_wrapper(&p, ref, &olen, ref_tag, sizeof(ref_tag)));
+    ASSERT_EQ(0, mbedtls_message_digest_hmac(MBEDTLS_MD_SHA256, s_key, 32, s_data, sizeof(ref), ref_mac));
+    ASSERT_EQ(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, s_key, 16, &cipher));
+    ASSERT_EQ(OPRT_OK, mbedtls_hmac_keyed_create(MBEDTLS_MD_SHA256, s_key, 32, &hmac));
+
+    for (int t = 0; t < thread_num; t++) {
+        threads.emplace_back([&, t] {
+            uint8_t out[256], tag[16], mac[32];
+            size_t len = 0;
+            for (int i = 0; i < loop; i++) {
+                mbedtls_cipher_keyed_auth_encrypt(cipher, &p, out, &len, tag, sizeof(tag));
+                mbedtls_hmac_keyed_digest(hmac, s_data, sizeof(out), mac);
+                if (memcmp(out, ref, sizeof(out)) || memcmp(tag, ref_tag, sizeof(tag)) ||
+                    memcmp(mac, ref_mac, sizeof(mac))) {
+                    bad[t]++;
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    for (int t = 0; t < thread_num; t++) {
+        EXPECT_EQ(0, bad[t]);
+    }
+
+    mbedtls_hmac_keyed_free(hmac);
+    mbedtls_cipher_keyed_free(cipher);
+}
+
+TEST_F(CipherKeyedTest, benchmark_keyed_vs_one_shot)
+{
+    const int loop = 20000;
+    uint8_t out[CIPHER_UT_DATA_MAX], tag[16], mac[32];
+    size_t olen = 0;
+    cipher_keyed_t *cipher = NULL;
+    hmac_keyed_t *hmac = NULL;
+
+    ASSERT_EQ(OPRT_OK, mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, s_key, 16, &cipher));
+    ASSERT_EQ(OPRT_OK, mbedtls_hmac_keyed_create(MBEDTLS_MD_SHA256, s_key, 32, &hmac));
+
+    // best of three runs, ns per call
+    auto bench = [loop](const std::function<void()> &fn) {
+        double best = 0;
+        for (int r = 0; r < 3; r++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < loop; i++) {
+                fn();
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best = (0 == r || ns < best) ? ns : best;
+        }
+        return best / loop;
+    };
+
+    // a typical MQTT/LAN frame and an AI packet sign
+    for (size_t len : {64, 256, 1024}) {
+        cipher_params_t p = params(MBEDTLS_CIPHER_AES_128_GCM, 16, s_data, len);
+        double one_shot = bench([&] { mbedtls_cipher_auth_encrypt_wrapper(&p, out, &olen, tag, sizeof(tag)); });
+        double keyed = bench([&] { mbedtls_cipher_keyed_auth_encrypt(cipher, &p, out, &olen, tag, sizeof(tag)); });
+        printf("[ BENCH    ] AES-128-GCM %4zu B: one shot %.0f ns, keyed %.0f ns\n", len, one_shot, keyed);
+    }
+    for (size_t len : {64, 256}) {
+        double one_shot = bench([&] { mbedtls_message_digest_hmac(MBEDTLS_MD_SHA256, s_key, 32, s_data, len, mac); });
+        double keyed = bench([&] { mbedtls_hmac_keyed_digest(hmac, s_data, len, mac); });
+        printf("[ BENCH    ] HMAC-SHA256 %4zu B: one shot %.0f ns, keyed %.0f ns\n", len, one_shot, keyed);
+    }
+
+    mbedtls_hmac_keyed_free(hmac);
+    mbedtls_cipher_keyed_free(cipher);
+}
@@ -60,6 +60,16 @@ typedef struct {
     char key[TAL_LV_KEY_LEN + 1];
 } tal_kv_cfg_t;
 
+/**
+ * @brief one key-value pair of tal_kv_set_batch, value NULL means delete
+ *
+ */
+typedef struct {
+    const char *key;
+    const uint8_t *value;
+    size_t length;
+} tal_kv_batch_t;
+
 /**
  * @brief Initializes the TAL Key-Value (KV) module.
  *
@@ -84,6 +94,19 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg);
  */
 int tal_kv_set(const char *key, const uint8_t *value, size_t length);
 
+/**
+ * @brief Sets several key-value pairs in the TAL Key-Value store at once.
+ *
+ * With ENABLE_KV_LOG the batch is written as one transaction: one flash sync
+ * for all pairs, and all or none of them survive a power loss.
+ *
+ * @param batch The key-value pairs, a NULL value deletes the key.
+ * @param num The number of pairs in the batch.
+ * @return 0 if all pairs were successfully set, or a negative error code if
+ * an error occurred.
+ */
+int tal_kv_set_batch(const tal_kv_batch_t *batch, size_t num);
+
 /**
  * @brief Retrieves the value associated with the specified key from the
  * key-value store.
@@ -102,6 +125,32 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length);
  */
 int tal_kv_get(const char *key, uint8_t **value, size_t *length);
 
+/**
+ * @brief Retrieves a read-only view of the value associated with the specified
+ * key, without copying it.
+ *
+ * With ENABLE_KV_CACHE the view points into the decrypted read cache and stays
+ * valid until released, even if the key is set or deleted meanwhile.
+ *
+ * @param key The key to retrieve the value for.
+ * @param value A pointer that will store the view of the value.
+ * @param length A pointer to a variable that will store the length of the
+ * value.
+ *
+ * @return 0 if the value was successfully retrieved, or a negative error code
+ * if an error occurred. The view must be released by tal_kv_release.
+ */
+int tal_kv_get_ref(const char *key, const uint8_t **value, size_t *length);
+
+/**
+ * @brief Releases a view returned by tal_kv_get_ref.
+ *
+ * @param value The view to be released.
+ * @return 0 if the view was successfully released, or a negative error code
+ * if an error occurred.
+ */
+int tal_kv_release(const uint8_t *value);
+
 /**
  * @brief Frees the memory allocated for a value in the TAL Key-Value store.
  *
@@ -0,0 +1,252 @@
+/**
+ * @file kv_cache.c
+ * @brief Decrypted value cache used by tal_kv.
+ *
+ * Entries are allocated as [entry][value][key] in one block, a view is a
+ * pointer to the value so release finds the entry without a lookup. The cache
+ * itself holds one reference on every entry in the LRU list.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "tuya_list.h"
+#include "kv_cache.h"
+
+/***********************************************************************
+ ********************* constant ( macro and enum ) *********************
+ **********************************************************************/
+#ifndef KV_CACHE_SIZE
+#define KV_CACHE_SIZE 2048
+#endif
+
+// values larger than this are handed out but never kept
+#define KV_CACHE_ITEM_MAX (KV_CACHE_SIZE / 2)
+
+/***********************************************************************
+ ********************* struct ******************************************
+ **********************************************************************/
+typedef struct {
+    LIST_HEAD node; // lru list, most recently used first
+    uint32_t hash;
+    uint16_t ref;
+    char *key;
+    size_t len;
+    uint8_t value[0];
+} KV_CACHE_ENTRY_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    LIST_HEAD lru;
+    KV_CACHE_STAT_T stat;
+} KV_CACHE_MGR_T;
+
+/***********************************************************************
+ ********************* variable ****************************************
+ **********************************************************************/
+static KV_CACHE_MGR_T s_kv_cache;
+
+/***********************************************************************
+ ********************* function ****************************************
+ **********************************************************************/
+static uint32_t __kv_cache_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*key) {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static KV_CACHE_ENTRY_T *__kv_cache_entry(const uint8_t *value)
+{
+    return (KV_CACHE_ENTRY_T *)(value - offsetof(KV_CACHE_ENTRY_T, value));
+}
+
+static KV_CACHE_ENTRY_T *__kv_cache_find(const char *key, uint32_t hash)
+{
+    struct tuya_list_head *pos = NULL;
+    KV_CACHE_ENTRY_T *entry = NULL;
+
+    tuya_list_for_each(pos, &s_kv_cache.lru)
+    {
+        entry = tuya_list_entry(pos, KV_CACHE_ENTRY_T, node);
+        if (entry->hash == hash && 0 == strcmp(entry->key, key)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void __kv_cache_unref(KV_CACHE_ENTRY_T *entry)
+{
+    if (0 == --entry->ref) {
+        tal_free(entry);
+    }
+}
+
+static void __kv_cache_remove(KV_CACHE_ENTRY_T *entry)
+{
+    tuya_list_del(&entry->node);
+    s_kv_cache.stat.entry_num--;
+    s_kv_cache.stat.used -= entry->len;
+    __kv_cache_unref(entry);
+}
+
+/**
+ * @brief kv cache initialization
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_cache_init(void)
+{
+    if (s_kv_cache.mutex) {
+        return OPRT_OK;
+    }
+
+    INIT_LIST_HEAD(&s_kv_cache.lru);
+
+    return tal_mutex_create_init(&s_kv_cache.mutex);
+}
+
+/**
+ * @brief find a key in the cache and take a reference on its value
+ *
+ * @param[in] key: the key
+ * @param[out] length: value length
+ * @return the value, NULL on miss
+ */
+const uint8_t *kv_cache_get(const char *key, size_t *length)
+{
+    KV_CACHE_ENTRY_T *entry = NULL;
+
+    tal_mutex_lock(s_kv_cache.mutex);
+    entry = __kv_cache_find(key, __kv_cache_hash(key));
+    if (NULL == entry) {
+        s_kv_cache.stat.miss++;
+        tal_mutex_unlock(s_kv_cache.mutex);
+        return NULL;
+    }
+    tuya_list_del(&entry->node);
+    tuya_list_add(&entry->node, &s_kv_cache.lru);
+    entry->ref++;
+    s_kv_cache.stat.ref_num++;
+    s_kv_cache.stat.hit++;
+    tal_mutex_unlock(s_kv_cache.mutex);
+
+    *length = entry->len;
+    return entry->value;
+}
+
+/**
+ * @brief allocate a referenced entry for a key, not visible until inserted
+ *
+ * @param[in] key: the key
+ * @param[in] size: value buffer size, one extra byte is reserved for '\0'
+ * @return the value buffer to fill, NULL on malloc failed
+ */
+uint8_t *kv_cache_alloc(const char *key, size_t size)
+{
+    size_t key_len = strlen(key);
+    KV_CACHE_ENTRY_T *entry = tal_malloc(sizeof(KV_CACHE_ENTRY_T) + size + 1 + key_len + 1);
+
+    if (NULL == entry) {
+        return NULL;
+    }
+    memset(entry, 0, sizeof(KV_CACHE_ENTRY_T));
+    INIT_LIST_HEAD(&entry->node);
+    entry->hash = __kv_cache_hash(key);
+    entry->ref = 1;
+    entry->key = (char *)entry->value + size + 1;
+    memcpy(entry->key, key, key_len + 1);
+
+    tal_mutex_lock(s_kv_cache.mutex);
+    s_kv_cache.stat.ref_num++;
+    tal_mutex_unlock(s_kv_cache.mutex);
+
+    return entry->value;
+}
+
+/**
+ * @brief publish an entry from kv_cache_alloc, the caller keeps its reference
+ *
+ * @param[in] value: value buffer returned by kv_cache_alloc
+ * @param[in] length: actual value length
+ */
+void kv_cache_insert(uint8_t *value, size_t length)
+{
+    KV_CACHE_ENTRY_T *entry = __kv_cache_entry(value);
+    KV_CACHE_ENTRY_T *old = NULL;
+
+    entry->len = length;
+    value[length] = 0;
+    if (length > KV_CACHE_ITEM_MAX) {
+        return;
+    }
+
+    tal_mutex_lock(s_kv_cache.mutex);
+    old = __kv_cache_find(entry->key, entry->hash);
+    if (old) {
+        __kv_cache_remove(old);
+    }
+    while (s_kv_cache.stat.used + length > KV_CACHE_SIZE && !tuya_list_empty(&s_kv_cache.lru)) {
+        __kv_cache_remove(tuya_list_entry(s_kv_cache.lru.prev, KV_CACHE_ENTRY_T, node));
+        s_kv_cache.stat.evict++;
+    }
+    tuya_list_add(&entry->node, &s_kv_cache.lru);
+    entry->ref++;
+    s_kv_cache.stat.entry_num++;
+    s_kv_cache.stat.used += length;
+    tal_mutex_unlock(s_kv_cache.mutex);
+}
+
+/**
+ * @brief release a reference taken by kv_cache_get or kv_cache_alloc
+ *
+ * @param[in] value: the value
+ */
+void kv_cache_release(const uint8_t *value)
+{
+    if (NULL == value) {
+        return;
+    }
+
+    tal_mutex_lock(s_kv_cache.mutex);
+    s_kv_cache.stat.ref_num--;
+    __kv_cache_unref(__kv_cache_entry(value));
+    tal_mutex_unlock(s_kv_cache.mutex);
+}
+
+/**
+ * @brief drop a key from the cache, must be called after the key is written
+ *
+ * @param[in] key: the key
+ */
+void kv_cache_invalidate(const char *key)
+{
+    KV_CACHE_ENTRY_T *entry = NULL;
+
+    tal_mutex_lock(s_kv_cache.mutex);
+    entry = __kv_cache_find(key, __kv_cache_hash(key));
+    if (entry) {
+        __kv_cache_remove(entry);
+    }
+    tal_mutex_unlock(s_kv_cache.mutex);
+}
+
+/**
+ * @brief get the cache statistics
+ *
+ * @param[out] stat: the statistics
+ */
+void kv_cache_get_stat(KV_CACHE_STAT_T *stat)
+{
+    tal_mutex_lock(s_kv_cache.mutex);
+    *stat = s_kv_cache.stat;
+    tal_mutex_unlock(s_kv_cache.mutex);
+}
@@ -0,0 +1,93 @@
+/**
+ * @file kv_cache.h
+ * @brief Decrypted value cache used by tal_kv.
+ *
+ * Values are kept decrypted in a byte bounded LRU list. Every value handed
+ * out is a reference counted view into a cache entry, an entry evicted or
+ * invalidated while still referenced is freed by its last release.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __KV_CACHE_H__
+#define __KV_CACHE_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief cache statistics
+ *
+ */
+typedef struct {
+    uint32_t hit;
+    uint32_t miss;
+    uint32_t evict;
+    uint32_t entry_num; // entries in the cache
+    uint32_t used;      // bytes of values in the cache
+    uint32_t ref_num;   // views not released yet
+} KV_CACHE_STAT_T;
+
+/**
+ * @brief kv cache initialization
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_cache_init(void);
+
+/**
+ * @brief find a key in the cache and take a reference on its value
+ *
+ * @param[in] key: the key
+ * @param[out] length: value length
+ * @return the value, NULL on miss
+ */
+const uint8_t *kv_cache_get(const char *key, size_t *length);
+
+/**
+ * @brief allocate a referenced entry for a key, not visible until inserted
+ *
+ * @param[in] key: the key
+ * @param[in] size: value buffer size, one extra byte is reserved for '\0'
+ * @return the value buffer to fill, NULL on malloc failed
+ */
+uint8_t *kv_cache_alloc(const char *key, size_t size);
+
+/**
+ * @brief publish an entry from kv_cache_alloc, the caller keeps its reference
+ *
+ * @param[in] value: value buffer returned by kv_cache_alloc
+ * @param[in] length: actual value length
+ */
+void kv_cache_insert(uint8_t *value, size_t length);
+
+/**
+ * @brief release a reference taken by kv_cache_get or kv_cache_alloc
+ *
+ * @param[in] value: the value
+ */
+void kv_cache_release(const uint8_t *value);
+
+/**
+ * @brief drop a key from the cache, must be called after the key is written
+ *
+ * @param[in] key: the key
+ */
+void kv_cache_invalidate(const char *key);
+
+/**
+ * @brief get the cache statistics
+ *
+ * @param[out] stat: the statistics
+ */
+void kv_cache_get_stat(KV_CACHE_STAT_T *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KV_CACHE_H__ */
@@ -0,0 +1,676 @@
+/**
+ * @file kv_log.c
+ * @brief Log-structured storage engine used by tal_kv.
+ *
+ * Every set/delete is appended to one littlefs file as a record
+ * [header][key][value], the RAM hash index maps each key to its latest
+ * record. Records of a batch carry the transaction flag and only take effect
+ * when the trailing commit record is found, so a batch is applied all or
+ * nothing after a power loss. A torn tail is detected by crc and truncated
+ * when the index is rebuilt at boot.
+ *
+ * When obsolete records take up more than KV_LOG_COMPACT_RATIO percent of the
+ * log, the live records are copied into a new file in the system workqueue
+ * and the new file atomically replaces the old one by rename.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "crc32i.h"
+#include "kv_log.h"
+
+/***********************************************************************
+ ********************* constant ( macro and enum ) *********************
+ **********************************************************************/
+#define KV_LOG_FILE     "kvlog.dat"
+#define KV_LOG_TMP_FILE "kvlog.tmp"
+
+#define KV_LOG_MAGIC 0xA5
+
+#define KV_LOG_TYPE_PUT    1
+#define KV_LOG_TYPE_DEL    2
+#define KV_LOG_TYPE_COMMIT 3 // end of a transaction, val_len is the record number
+
+#define KV_LOG_FLAG_TXN 0x01 // record belongs to a transaction
+
+#define KV_LOG_KEY_MAX 255
+
+#ifndef KV_LOG_HASH_BUCKET_NUM
+#define KV_LOG_HASH_BUCKET_NUM 32 // must be power of 2
+#endif
+
+#ifndef KV_LOG_COMPACT_RATIO
+#define KV_LOG_COMPACT_RATIO 50
+#endif
+
+#ifndef KV_LOG_COMPACT_MIN_SIZE
+#define KV_LOG_COMPACT_MIN_SIZE 8192
+#endif
+
+#define KV_LOG_CRC_BUF_SIZE 64
+
+/***********************************************************************
+ ********************* struct ******************************************
+ **********************************************************************/
+typedef struct {
+    uint8_t magic;
+    uint8_t type;
+    uint8_t key_len;
+    uint8_t flag;
+    uint32_t val_len;
+    uint32_t crc; // crc of header (crc as 0), key and value
+} KV_LOG_HDR_T;
+
+typedef struct kv_log_node {
+    struct kv_log_node *next;
+    uint32_t hash;
+    uint32_t offset; // record offset in the log
+    uint32_t len;    // value length
+    uint8_t type;    // record type, only used by pending transaction records
+    uint8_t key_len;
+    char key[0];
+} KV_LOG_NODE_T;
+
+typedef struct {
+    lfs_t *lfs;
+    MUTEX_HANDLE mutex;
+    lfs_file_t file;
+    BOOL_T opened;
+    BOOL_T compact_scheduled;
+
+    uint32_t size;  // log size
+    uint32_t live;  // bytes of records still referenced by the index
+    uint32_t count; // key number
+
+    KV_LOG_NODE_T *bucket[KV_LOG_HASH_BUCKET_NUM];
+} KV_LOG_MGR_T;
+
+/***********************************************************************
+ ********************* variable ****************************************
+ **********************************************************************/
+static KV_LOG_MGR_T s_kv_log;
+
+/***********************************************************************
+ ********************* function ****************************************
+ **********************************************************************/
+static uint32_t __kv_log_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*key) {
+        hash ^= (uint8_t)*key++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t __kv_log_rec_len(uint8_t key_len, uint32_t val_len)
+{
+    return sizeof(KV_LOG_HDR_T) + key_len + val_len;
+}
+
+static KV_LOG_NODE_T **__kv_log_node_link(const char *key, uint32_t hash)
+{
+    KV_LOG_NODE_T **link = &s_kv_log.bucket[hash & (KV_LOG_HASH_BUCKET_NUM - 1)];
+
+    while (*link) {
+        if ((*link)->hash == hash && 0 == strcmp((*link)->key, key)) {
+            break;
+        }
+        link = &(*link)->next;
+    }
+
+    return link;
+}
+
+static int __kv_log_index_put(const char *key, uint8_t key_len, uint32_t offset, uint32_t len)
+{
+    uint32_t hash = __kv_log_hash(key);
+    KV_LOG_NODE_T **link = __kv_log_node_link(key, hash);
+    KV_LOG_NODE_T *node = *link;
+
+    if (node) {
+        s_kv_log.live -= __kv_log_rec_len(node->key_len, node->len);
+    } else {
+        node = tal_malloc(sizeof(KV_LOG_NODE_T) + key_len + 1);
+        if (NULL == node) {
+            PR_ERR("kv log index %s malloc failed", key);
+            return OPRT_MALLOC_FAILED;
+        }
+        memset(node, 0, sizeof(KV_LOG_NODE_T));
+        node->hash = hash;
+        node->key_len = key_len;
+        memcpy(node->key, key, key_len + 1);
+        *link = node;
+        s_kv_log.count++;
+    }
+    node->offset = offset;
+    node->len = len;
+    s_kv_log.live += __kv_log_rec_len(key_len, len);
+
+    return OPRT_OK;
+}
+
+static void __kv_log_index_del(const char *key)
+{
+    KV_LOG_NODE_T **link = __kv_log_node_link(key, __kv_log_hash(key));
+    KV_LOG_NODE_T *node = *link;
+
+    if (NULL == node) {
+        return;
+    }
+
+    *link = node->next;
+    s_kv_log.live -= __kv_log_rec_len(node->key_len, node->len);
+    s_kv_log.count--;
+    tal_free(node);
+}
+
+static int __kv_log_file_read(lfs_file_t *file, uint32_t offset, void *buf, uint32_t len)
+{
+    if (lfs_file_seek(s_kv_log.lfs, file, offset, LFS_SEEK_SET) < 0) {
+        return OPRT_KVS_RD_FAIL;
+    }
+    if (lfs_file_read(s_kv_log.lfs, file, buf, len) != (lfs_ssize_t)len) {
+        return OPRT_KVS_RD_FAIL;
+    }
+
+    return OPRT_OK;
+}
+
+static int __kv_log_file_write(lfs_file_t *file, const void *buf, uint32_t len)
+{
+    lfs_ssize_t rt = lfs_file_write(s_kv_log.lfs, file, buf, len);
+    if (rt < 0) {
+        return rt;
+    }
+
+    return (rt == (lfs_ssize_t)len) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+static int __kv_log_rec_write(lfs_file_t *file, uint8_t type, uint8_t flag, const char *key, uint8_t key_len,
+                              const uint8_t *data, uint32_t len)
+{
+    KV_LOG_HDR_T hdr;
+    uint32_t crc;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = KV_LOG_MAGIC;
+    hdr.type = type;
+    hdr.key_len = key_len;
+    hdr.flag = flag;
+    hdr.val_len = len;
+
+    crc = hash_crc32i_init();
+    crc = hash_crc32i_update(crc, &hdr, sizeof(hdr));
+    crc = hash_crc32i_update(crc, key, key_len);
+    if (data) {
+        crc = hash_crc32i_update(crc, data, len);
+    }
+    hdr.crc = hash_crc32i_finish(crc);
+
+    int ret = __kv_log_file_write(file, &hdr, sizeof(hdr));
+    if (LFS_ERR_OK == ret && key_len) {
+        ret = __kv_log_file_write(file, key, key_len);
+    }
+    if (LFS_ERR_OK == ret && data && len) {
+        ret = __kv_log_file_write(file, data, len);
+    }
+
+    return ret;
+}
+
+static BOOL_T __kv_log_rec_check(uint32_t offset, KV_LOG_HDR_T *hdr, const char *key)
+{
+    uint8_t buf[KV_LOG_CRC_BUF_SIZE];
+    KV_LOG_HDR_T tmp = *hdr;
+    uint32_t crc, left, chunk;
+
+    tmp.crc = 0;
+    crc = hash_crc32i_init();
+    crc = hash_crc32i_update(crc, &tmp, sizeof(tmp));
+    crc = hash_crc32i_update(crc, key, hdr->key_len);
+
+    // value of a commit record is the record number, not stored
+    left = (KV_LOG_TYPE_COMMIT == hdr->type) ? 0 : hdr->val_len;
+    offset += sizeof(KV_LOG_HDR_T) + hdr->key_len;
+    while (left) {
+        chunk = left > sizeof(buf) ? sizeof(buf) : left;
+        if (OPRT_OK != __kv_log_file_read(&s_kv_log.file, offset, buf, chunk)) {
+            return FALSE;
+        }
+        crc = hash_crc32i_update(crc, buf, chunk);
+        offset += chunk;
+        left -= chunk;
+    }
+
+    return hash_crc32i_finish(crc) == hdr->crc ? TRUE : FALSE;
+}
+
+static int __kv_log_pending_apply(KV_LOG_NODE_T *pending, BOOL_T apply)
+{
+    int ret = OPRT_OK;
+    KV_LOG_NODE_T *next;
+
+    while (pending) {
+        next = pending->next;
+        if (apply && (OPRT_OK == ret)) {
+            if (KV_LOG_TYPE_PUT == pending->type) {
+                ret = __kv_log_index_put(pending->key, pending->key_len, pending->offset, pending->len);
+            } else {
+                __kv_log_index_del(pending->key);
+            }
+        }
+        tal_free(pending);
+        pending = next;
+    }
+
+    return ret;
+}
+
+static int __kv_log_scan(void)
+{
+    int ret = OPRT_OK;
+    KV_LOG_HDR_T hdr;
+    char key[KV_LOG_KEY_MAX + 1];
+    KV_LOG_NODE_T *pending = NULL, **pending_tail = &pending;
+    uint32_t pending_num = 0;
+    uint32_t offset = 0, good = 0, rec_len;
+    uint32_t size = lfs_file_size(s_kv_log.lfs, &s_kv_log.file);
+
+    while (offset + sizeof(hdr) <= size) {
+        if (OPRT_OK != __kv_log_file_read(&s_kv_log.file, offset, &hdr, sizeof(hdr)) || KV_LOG_MAGIC != hdr.magic) {
+            break;
+        }
+        rec_len = __kv_log_rec_len(hdr.key_len, (KV_LOG_TYPE_COMMIT == hdr.type) ? 0 : hdr.val_len);
+        if (rec_len > size - offset) {
+            break;
+        }
+        if (hdr.key_len &&
+            OPRT_OK != __kv_log_file_read(&s_kv_log.file, offset + sizeof(hdr), key, hdr.key_len)) {
+            break;
+        }
+        key[hdr.key_len] = '\0';
+        if (!__kv_log_rec_check(offset, &hdr, key)) {
+            break;
+        }
+
+        if (KV_LOG_TYPE_COMMIT == hdr.type) {
+            // a commit never follows a partial transaction, the tail is rolled back on failure
+            ret = __kv_log_pending_apply(pending, pending_num == hdr.val_len);
+            pending = NULL;
+            pending_tail = &pending;
+            pending_num = 0;
+            if (OPRT_OK != ret) {
+                break;
+            }
+            good = offset + rec_len;
+        } else if (KV_LOG_TYPE_PUT == hdr.type || KV_LOG_TYPE_DEL == hdr.type) {
+            if (hdr.flag & KV_LOG_FLAG_TXN) {
+                KV_LOG_NODE_T *node = tal_malloc(sizeof(KV_LOG_NODE_T) + hdr.key_len + 1);
+                if (NULL == node) {
+                    break;
+                }
+                memset(node, 0, sizeof(KV_LOG_NODE_T));
+                node->offset = offset;
+                node->len = hdr.val_len;
+                node->type = hdr.type;
+                node->key_len = hdr.key_len;
+                memcpy(node->key, key, hdr.key_len + 1);
+                *pending_tail = node;
+                pending_tail = &node->next;
+                pending_num++;
+            } else {
+                if (KV_LOG_TYPE_PUT == hdr.type) {
+                    ret = __kv_log_index_put(key, hdr.key_len, offset, hdr.val_len);
+                    if (OPRT_OK != ret) {
+                        break;
+                    }
+                } else {
+                    __kv_log_index_del(key);
+                }
+                good = offset + rec_len;
+            }
+        } else {
+            break;
+        }
+        offset += rec_len;
+    }
+    // uncommitted transaction records are dropped with the torn tail
+    __kv_log_pending_apply(pending, FALSE);
+
+    // the records past good are intact, only the index is short of memory, never truncate them
+    if (OPRT_OK != ret) {
+        PR_ERR("kv log index rebuild err %d", ret);
+        return ret;
+    }
+
+    if (good < size) {
+        PR_WARN("kv log truncate %u -> %u", size, good);
+        if (lfs_file_truncate(s_kv_log.lfs, &s_kv_log.file, good) < 0 ||
+            lfs_file_sync(s_kv_log.lfs, &s_kv_log.file) < 0) {
+            PR_ERR("kv log truncate failed");
+            return OPRT_KVS_WR_FAIL;
+        }
+    }
+    s_kv_log.size = good;
+
+    PR_DEBUG("kv log keys:%u size:%u live:%u", s_kv_log.count, s_kv_log.size, s_kv_log.live);
+
+    return OPRT_OK;
+}
+
+static void __kv_log_compact_work(void *data)
+{
+    tal_mutex_lock(s_kv_log.mutex);
+    s_kv_log.compact_scheduled = FALSE;
+    kv_log_compact();
+    tal_mutex_unlock(s_kv_log.mutex);
+}
+
+static void __kv_log_compact_check(void)
+{
+    if (s_kv_log.compact_scheduled || s_kv_log.size < KV_LOG_COMPACT_MIN_SIZE) {
+        return;
+    }
+    if ((uint64_t)(s_kv_log.size - s_kv_log.live) * 100 < (uint64_t)s_kv_log.size * KV_LOG_COMPACT_RATIO) {
+        return;
+    }
+
+    // retried by the next append if the workqueue is not ready yet
+    s_kv_log.compact_scheduled = TRUE;
+    if (OPRT_OK != tal_workq_schedule(WORKQ_SYSTEM, __kv_log_compact_work, NULL)) {
+        s_kv_log.compact_scheduled = FALSE;
+    }
+}
+
+static int __kv_log_append(const KV_LOG_ITEM_T *item, uint32_t num)
+{
+    int ret = OPRT_OK, idx_ret = OPRT_OK;
+    uint32_t i, offset;
+    uint32_t start = s_kv_log.size;
+    uint8_t flag = (num > 1) ? KV_LOG_FLAG_TXN : 0;
+
+    for (i = 0; i < num; i++) {
+        ret = __kv_log_rec_write(&s_kv_log.file, item[i].data ? KV_LOG_TYPE_PUT : KV_LOG_TYPE_DEL, flag, item[i].key,
+                                 strlen(item[i].key), item[i].data, item[i].data ? item[i].len : 0);
+        if (OPRT_OK != ret) {
+            goto __ROLLBACK;
+        }
+    }
+    if (flag) {
+        ret = __kv_log_rec_write(&s_kv_log.file, KV_LOG_TYPE_COMMIT, 0, NULL, 0, NULL, num);
+        if (OPRT_OK != ret) {
+            goto __ROLLBACK;
+        }
+    }
+    // one metadata commit for the whole batch
+    ret = lfs_file_sync(s_kv_log.lfs, &s_kv_log.file);
+    if (ret < 0) {
+        goto __ROLLBACK;
+    }
+
+    offset = start;
+    for (i = 0; i < num; i++) {
+        uint8_t key_len = strlen(item[i].key);
+        if (item[i].data) {
+            ret = __kv_log_index_put(item[i].key, key_len, offset, item[i].len);
+            if (OPRT_OK != ret) {
+                idx_ret = ret;
+            }
+            offset += __kv_log_rec_len(key_len, item[i].len);
+        } else {
+            __kv_log_index_del(item[i].key);
+            offset += __kv_log_rec_len(key_len, 0);
+        }
+    }
+    if (flag) {
+        offset += __kv_log_rec_len(0, 0);
+    }
+    s_kv_log.size = offset;
+
+    // the records are durable and indexed by the next scan, but the caller must know they are not visible yet
+    return idx_ret;
+
+__ROLLBACK:
+    if (lfs_file_truncate(s_kv_log.lfs, &s_kv_log.file, start) < 0 ||
+        lfs_file_sync(s_kv_log.lfs, &s_kv_log.file) < 0) {
+        PR_ERR("kv log rollback failed");
+    }
+    return ret;
+}
+
+/**
+ * @brief open the log file and rebuild the index from it
+ *
+ * @param[in] lfs: mounted littlefs
+ * @param[in] mutex: kv mutex, taken by the background compaction
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_init(lfs_t *lfs, MUTEX_HANDLE mutex)
+{
+    int ret;
+
+    if (s_kv_log.opened) {
+        return OPRT_OK;
+    }
+
+    memset(&s_kv_log, 0, sizeof(s_kv_log));
+    s_kv_log.lfs = lfs;
+    s_kv_log.mutex = mutex;
+
+    // leftover of an interrupted compaction, the old log is still complete
+    lfs_remove(lfs, KV_LOG_TMP_FILE);
+
+    ret = lfs_file_open(lfs, &s_kv_log.file, KV_LOG_FILE, LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND);
+    if (LFS_ERR_OK != ret) {
+        PR_ERR("kv log open err %d", ret);
+        return ret;
+    }
+    s_kv_log.opened = TRUE;
+
+    return __kv_log_scan();
+}
+
+/**
+ * @brief append records to the log, more than one record is written as an
+ * atomic transaction
+ *
+ * @param[in] item: records to append
+ * @param[in] num: record number
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_append(const KV_LOG_ITEM_T *item, uint32_t num)
+{
+    int ret;
+    uint32_t i;
+
+    if (!s_kv_log.opened) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    if (NULL == item || 0 == num) {
+        return OPRT_INVALID_PARM;
+    }
+    for (i = 0; i < num; i++) {
+        if (NULL == item[i].key || 0 == item[i].key[0] || strlen(item[i].key) > KV_LOG_KEY_MAX) {
+            return OPRT_INVALID_PARM;
+        }
+    }
+
+    ret = __kv_log_append(item, num);
+    if (LFS_ERR_NOSPC == ret && OPRT_OK == kv_log_compact()) {
+        ret = __kv_log_append(item, num);
+    }
+    if (OPRT_OK != ret) {
+        PR_ERR("kv log append fail %d", ret);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    __kv_log_compact_check();
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief read the value of a key
+ *
+ * @param[in] key: the key
+ * @param[out] data: value buffer, one extra byte allocated, free by tal_free
+ * @param[out] len: value length
+ * @return OPRT_OK on success, OPRT_NOT_FOUND if the key is not in the log.
+ * Others on error, please refer to tuya_error_code.h
+ */
+int kv_log_read(const char *key, uint8_t **data, uint32_t *len)
+{
+    KV_LOG_NODE_T *node;
+    uint8_t *buf;
+
+    if (!s_kv_log.opened) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    node = *__kv_log_node_link(key, __kv_log_hash(key));
+    if (NULL == node) {
+        return OPRT_NOT_FOUND;
+    }
+
+    buf = tal_malloc(node->len + 1);
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+    if (OPRT_OK !=
+        __kv_log_file_read(&s_kv_log.file, node->offset + sizeof(KV_LOG_HDR_T) + node->key_len, buf, node->len)) {
+        PR_ERR("kv log read %s fail", key);
+        tal_free(buf);
+        return OPRT_KVS_RD_FAIL;
+    }
+    *data = buf;
+    *len = node->len;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief check if the key is in the log
+ *
+ * @param[in] key: the key
+ * @return TRUE or FALSE
+ */
+BOOL_T kv_log_exist(const char *key)
+{
+    return (*__kv_log_node_link(key, __kv_log_hash(key))) ? TRUE : FALSE;
+}
+
+/**
+ * @brief compact the log now, keeping only the live records
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_compact(void)
+{
+    int ret = OPRT_OK;
+    lfs_file_t tmp;
+    KV_LOG_NODE_T *node;
+    uint32_t *offsets = NULL;
+    uint8_t *buf = NULL;
+    uint32_t i, idx = 0, offset = 0;
+
+    if (!s_kv_log.opened) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    PR_DEBUG("kv log compact size:%u live:%u", s_kv_log.size, s_kv_log.live);
+
+    if (s_kv_log.count) {
+        offsets = tal_malloc(s_kv_log.count * sizeof(uint32_t));
+        if (NULL == offsets) {
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+
+    ret = lfs_file_open(s_kv_log.lfs, &tmp, KV_LOG_TMP_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != ret) {
+        tal_free(offsets);
+        return ret;
+    }
+
+    for (i = 0; i < KV_LOG_HASH_BUCKET_NUM && OPRT_OK == ret; i++) {
+        for (node = s_kv_log.bucket[i]; node && OPRT_OK == ret; node = node->next) {
+            buf = tal_malloc(node->len ? node->len : 1);
+            if (NULL == buf) {
+                ret = OPRT_MALLOC_FAILED;
+                break;
+            }
+            ret = __kv_log_file_read(&s_kv_log.file, node->offset + sizeof(KV_LOG_HDR_T) + node->key_len, buf,
+                                     node->len);
+            if (OPRT_OK == ret) {
+                ret = __kv_log_rec_write(&tmp, KV_LOG_TYPE_PUT, 0, node->key, node->key_len, buf, node->len);
+            }
+            tal_free(buf);
+            offsets[idx++] = offset;
+            offset += __kv_log_rec_len(node->key_len, node->len);
+        }
+    }
+    if (OPRT_OK == ret) {
+        ret = lfs_file_sync(s_kv_log.lfs, &tmp);
+    }
+    lfs_file_close(s_kv_log.lfs, &tmp);
+    if (OPRT_OK != ret) {
+        PR_ERR("kv log compact fail %d", ret);
+        lfs_remove(s_kv_log.lfs, KV_LOG_TMP_FILE);
+        tal_free(offsets);
+        return ret;
+    }
+
+    lfs_file_close(s_kv_log.lfs, &s_kv_log.file);
+    ret = lfs_rename(s_kv_log.lfs, KV_LOG_TMP_FILE, KV_LOG_FILE);
+    if (LFS_ERR_OK != ret) {
+        PR_ERR("kv log rename fail %d", ret);
+        lfs_remove(s_kv_log.lfs, KV_LOG_TMP_FILE);
+    }
+    if (LFS_ERR_OK != lfs_file_open(s_kv_log.lfs, &s_kv_log.file, KV_LOG_FILE, LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND)) {
+        PR_ERR("kv log reopen fail");
+        s_kv_log.opened = FALSE;
+        tal_free(offsets);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    if (LFS_ERR_OK == ret) {
+        idx = 0;
+        for (i = 0; i < KV_LOG_HASH_BUCKET_NUM; i++) {
+            for (node = s_kv_log.bucket[i]; node; node = node->next) {
+                node->offset = offsets[idx++];
+            }
+        }
+        s_kv_log.size = offset;
+        s_kv_log.live = offset;
+    }
+    tal_free(offsets);
+
+    PR_DEBUG("kv log compact done size:%u", s_kv_log.size);
+
+    return ret;
+}
+
+/**
+ * @brief dump keys and space usage of the log
+ *
+ */
+void kv_log_dump(void)
+{
+    KV_LOG_NODE_T *node;
+    uint32_t i;
+
+    for (i = 0; i < KV_LOG_HASH_BUCKET_NUM; i++) {
+        for (node = s_kv_log.bucket[i]; node; node = node->next) {
+            PR_DEBUG_RAW("%s(%u)  ", node->key, node->len);
+        }
+    }
+    PR_DEBUG_RAW("\r\n");
+    PR_DEBUG("kv log keys:%u size:%u live:%u", s_kv_log.count, s_kv_log.size, s_kv_log.live);
+}
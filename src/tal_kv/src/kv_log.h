@@ -0,0 +1,96 @@
+/**
+ * @file kv_log.h
+ * @brief Log-structured storage engine used by tal_kv.
+ *
+ * All key-value records are appended to a single littlefs file and located
+ * through a RAM hash index, so a write costs one append and one metadata
+ * commit instead of a file create/truncate per key. Obsolete records are
+ * reclaimed by compaction in the system workqueue.
+ *
+ * The engine stores opaque (already encrypted) values, encryption stays in
+ * tal_kv.c. All functions except kv_log_init() must be called with the kv
+ * mutex held.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __KV_LOG_H__
+#define __KV_LOG_H__
+
+#include "tuya_cloud_types.h"
+#include "tal_mutex.h"
+#include "lfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief one record of an append, data NULL means delete the key
+ *
+ */
+typedef struct {
+    const char *key;
+    const uint8_t *data;
+    uint32_t len;
+} KV_LOG_ITEM_T;
+
+/**
+ * @brief open the log file and rebuild the index from it
+ *
+ * @param[in] lfs: mounted littlefs
+ * @param[in] mutex: kv mutex, taken by the background compaction
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_init(lfs_t *lfs, MUTEX_HANDLE mutex);
+
+/**
+ * @brief append records to the log, more than one record is written as an
+ * atomic transaction
+ *
+ * @param[in] item: records to append
+ * @param[in] num: record number
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_append(const KV_LOG_ITEM_T *item, uint32_t num);
+
+/**
+ * @brief read the value of a key
+ *
+ * @param[in] key: the key
+ * @param[out] data: value buffer, one extra byte allocated, free by tal_free
+ * @param[out] len: value length
+ * @return OPRT_OK on success, OPRT_NOT_FOUND if the key is not in the log.
+ * Others on error, please refer to tuya_error_code.h
+ */
+int kv_log_read(const char *key, uint8_t **data, uint32_t *len);
+
+/**
+ * @brief check if the key is in the log
+ *
+ * @param[in] key: the key
+ * @return TRUE or FALSE
+ */
+BOOL_T kv_log_exist(const char *key);
+
+/**
+ * @brief compact the log now, keeping only the live records
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+int kv_log_compact(void);
+
+/**
+ * @brief dump keys and space usage of the log
+ *
+ */
+void kv_log_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KV_LOG_H__ */
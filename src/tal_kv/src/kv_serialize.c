@@ -26,6 +26,20 @@
 #include "cJSON.h"
 #include "mix_method.h"
 
+/***********************************************************************
+ ********************* constant ( macro and enum ) *********************
+ **********************************************************************/
+// first byte of a binary record, a json record always starts with '{'
+#define KV_BIN_MAGIC   0xA7
+#define KV_BIN_VERSION 1
+
+// magic + version
+#define KV_BIN_HEAD_LEN 2
+
+// key_len(1) + type(1) + value_len(2)
+#define KV_BIN_FIELD_HEAD_LEN 4
+
+#if !defined(KV_SERIALIZE_BINARY) || (KV_SERIALIZE_BINARY == 0)
 /**
  * Serializes the key-value pairs in the given database into a JSON-formatted
  * string.
@@ -37,7 +51,7 @@
  * @return Returns OPRT_OK if serialization is successful, otherwise returns an
  * error code.
  */
-int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len)
+static int __kv_serialize_json(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len)
 {
     int i = 0;
     // conut need buf size
@@ -149,6 +163,7 @@ int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *
 
     return OPRT_OK;
 }
+#endif
 
 /**
  * @brief Deserialize a JSON string and populate a key-value database.
@@ -165,7 +180,7 @@ int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *
  * @return Returns OPRT_OK if the deserialization is successful. Otherwise, it
  * returns an error code indicating the failure reason.
  */
-int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt)
+static int __kv_deserialize_json(const char *in, kv_db_t *db, const uint32_t dbcnt)
 {
     cJSON *root = cJSON_Parse(in);
     if (NULL == root) {
@@ -275,3 +290,332 @@ ERR_EXIT:
 
     return op_ret;
 }
+
+#if defined(KV_SERIALIZE_BINARY) && (KV_SERIALIZE_BINARY == 1)
+static uint32_t __kv_bin_value_len(const kv_db_t *item)
+{
+    switch (item->tp) {
+    case KV_CHAR:
+    case KV_BYTE:
+    case KV_BOOL:
+        return 1;
+    case KV_SHORT:
+    case KV_USHORT:
+        return 2;
+    case KV_INT:
+        return 4;
+    case KV_STRING:
+        return strlen((char *)item->val);
+    case KV_RAW:
+        return item->len;
+    default:
+        return 0;
+    }
+}
+
+static void __kv_bin_put_le(uint8_t *buf, uint32_t val, uint8_t len)
+{
+    uint8_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+/**
+ * @brief Serializes the key-value pairs into the binary record format.
+ *
+ * The record is [magic][version] followed by one field per pair:
+ * [key_len:1][key][type:1][value_len:2 LE][value]. Integers are stored in
+ * little endian with their own width, strings without the terminator, and an
+ * empty string or raw is stored with value_len 0.
+ *
+ * @param db The pointer to the database containing the key-value pairs.
+ * @param dbcnt The number of key-value pairs in the database.
+ * @param out The pointer to store the record.
+ * @param out_len The pointer to store the record length.
+ * @return Returns OPRT_OK if serialization is successful, otherwise returns an
+ * error code.
+ */
+static int __kv_serialize_bin(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len)
+{
+    uint32_t i, key_len, val_len;
+    uint32_t len = KV_BIN_HEAD_LEN;
+
+    for (i = 0; i < dbcnt; i++) {
+        key_len = strlen(db[i].key);
+        if (key_len > 0xFF || db[i].tp > KV_RAW) {
+            PR_ERR("invalid item %s %d", db[i].key, db[i].tp);
+            return OPRT_INVALID_PARM;
+        }
+        // the field length is stored in 2 bytes
+        val_len = __kv_bin_value_len(&db[i]);
+        if (val_len > 0xFFFF) {
+            PR_ERR("item %s too long %u", db[i].key, val_len);
+            return OPRT_EXCEED_UPPER_LIMIT;
+        }
+        len += KV_BIN_FIELD_HEAD_LEN + key_len + val_len;
+    }
+
+    uint8_t *buf = tal_malloc(len + 1);
+    if (NULL == buf) {
+        PR_ERR("maloc fails %d", len);
+        return OPRT_MALLOC_FAILED;
+    }
+
+    uint8_t *pos = buf;
+    *pos++ = KV_BIN_MAGIC;
+    *pos++ = KV_BIN_VERSION;
+    for (i = 0; i < dbcnt; i++) {
+        key_len = strlen(db[i].key);
+        val_len = __kv_bin_value_len(&db[i]);
+
+        *pos++ = key_len;
+        memcpy(pos, db[i].key, key_len);
+        pos += key_len;
+        *pos++ = db[i].tp;
+        __kv_bin_put_le(pos, val_len, 2);
+        pos += 2;
+
+        switch (db[i].tp) {
+        case KV_CHAR:
+        case KV_BYTE:
+            *pos = *((uint8_t *)db[i].val);
+            break;
+        case KV_BOOL:
+            *pos = (FALSE == *((BOOL_T *)db[i].val)) ? 0 : 1;
+            break;
+        case KV_SHORT:
+        case KV_USHORT:
+            __kv_bin_put_le(pos, *((uint16_t *)db[i].val), 2);
+            break;
+        case KV_INT:
+            __kv_bin_put_le(pos, *((uint32_t *)db[i].val), 4);
+            break;
+        default:
+            memcpy(pos, db[i].val, val_len);
+            break;
+        }
+        pos += val_len;
+    }
+    // keep the record printable by PR_TRACE like the json one
+    *pos = 0;
+
+    *out = (char *)buf;
+    *out_len = len;
+
+    return OPRT_OK;
+}
+
+#endif
+
+static uint32_t __kv_bin_get_le(const uint8_t *buf, uint8_t len)
+{
+    uint32_t val = 0;
+    uint8_t i;
+
+    for (i = 0; i < len; i++) {
+        val |= (uint32_t)buf[i] << (8 * i);
+    }
+
+    return val;
+}
+
+static int __kv_deserialize_bin_field(uint8_t tp, const uint8_t *val, uint16_t val_len, kv_db_t *item)
+{
+    int32_t num = 0;
+
+    if (item->tp <= KV_INT) {
+        // integers can be read back into another integer type if the value fits
+        if (tp > KV_INT || val_len > 4) {
+            return OPRT_CJSON_GET_ERR;
+        }
+        num = (int32_t)__kv_bin_get_le(val, val_len);
+        if (KV_CHAR == tp) {
+            num = (int8_t)num;
+        } else if (KV_SHORT == tp) {
+            num = (int16_t)num;
+        }
+    } else if (item->tp != tp) {
+        return OPRT_CJSON_GET_ERR;
+    }
+
+    switch (item->tp) {
+    case KV_CHAR:
+        if (num < -128 || num > 127) {
+            return OPRT_COM_ERROR;
+        }
+        *((char *)item->val) = num;
+        break;
+    case KV_BYTE:
+        if (num < 0 || num > 255) {
+            return OPRT_COM_ERROR;
+        }
+        *((uint8_t *)item->val) = num;
+        break;
+    case KV_SHORT:
+        if (num < -32768 || num > 32767) {
+            return OPRT_COM_ERROR;
+        }
+        *((int16_t *)item->val) = num;
+        break;
+    case KV_USHORT:
+        if (num < 0 || num > 65535) {
+            return OPRT_COM_ERROR;
+        }
+        *((uint16_t *)item->val) = num;
+        break;
+    case KV_INT:
+        *((int *)item->val) = num;
+        break;
+    case KV_BOOL:
+        *((BOOL_T *)item->val) = (val_len && val[0]) ? 1 : 0;
+        break;
+    case KV_STRING:
+        if (item->len < val_len + 1) {
+            return OPRT_COM_ERROR;
+        }
+        memcpy(item->val, val, val_len);
+        ((char *)item->val)[val_len] = 0;
+        break;
+    case KV_RAW:
+        if (0 == val_len) {
+            item->len = 0;
+        } else if (item->len < val_len) {
+            return OPRT_COM_ERROR;
+        } else {
+            memcpy(item->val, val, val_len);
+        }
+        break;
+    default:
+        return OPRT_COM_ERROR;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Deserializes a binary record into the key-value database.
+ *
+ * The fields are usually stored in the same order as the database, so each
+ * pair is first matched against the field following the previous match and
+ * the record is only searched from the start when that fails. Pairs missing
+ * from the record are set to zero, same as the json format.
+ *
+ * @param[in] in The binary record.
+ * @param[in] in_len The record length.
+ * @param[in,out] db The key-value database to populate.
+ * @param[in] dbcnt The number of elements in the key-value database.
+ * @return Returns OPRT_OK if the deserialization is successful. Otherwise, it
+ * returns an error code indicating the failure reason.
+ */
+static int __kv_deserialize_bin(const uint8_t *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt)
+{
+    int op_ret = OPRT_OK;
+    const uint8_t *end = in + in_len;
+    const uint8_t *start = in + KV_BIN_HEAD_LEN;
+    const uint8_t *cursor = start;
+    const uint8_t *field, *val;
+    uint8_t key_len, tp;
+    uint16_t val_len;
+    uint32_t i, db_key_len;
+    BOOL_T wrapped;
+
+    if (in_len < KV_BIN_HEAD_LEN || KV_BIN_VERSION != in[1]) {
+        PR_ERR("unknown record version");
+        return OPRT_CJSON_PARSE_ERR;
+    }
+
+    for (i = 0; i < dbcnt; i++) {
+        db_key_len = strlen(db[i].key);
+        field = cursor;
+        wrapped = FALSE;
+        val = NULL;
+        while (TRUE) {
+            if (field >= end) {
+                if (wrapped || cursor == start) {
+                    break;
+                }
+                field = start;
+                wrapped = TRUE;
+            }
+            if (wrapped && field == cursor) {
+                break;
+            }
+            if (end - field < KV_BIN_FIELD_HEAD_LEN) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            key_len = field[0];
+            if (end - field < KV_BIN_FIELD_HEAD_LEN + key_len) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            tp = field[1 + key_len];
+            val_len = __kv_bin_get_le(field + 2 + key_len, 2);
+            if (end - field < KV_BIN_FIELD_HEAD_LEN + key_len + val_len) {
+                return OPRT_CJSON_PARSE_ERR;
+            }
+            if (key_len == db_key_len && 0 == memcmp(field + 1, db[i].key, key_len)) {
+                val = field + KV_BIN_FIELD_HEAD_LEN + key_len;
+                field = val + val_len;
+                break;
+            }
+            field += KV_BIN_FIELD_HEAD_LEN + key_len + val_len;
+        }
+
+        if (NULL == val) {
+            // default set zero
+            memset(db[i].val, 0, db[i].len);
+            continue;
+        }
+        cursor = field;
+
+        op_ret = __kv_deserialize_bin_field(tp, val, val_len, &db[i]);
+        if (OPRT_OK != op_ret) {
+            PR_ERR("deserial %s fails %d", db[i].key, op_ret);
+            return op_ret;
+        }
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Serializes the key-value pairs for tal_kv_serialize_set.
+ *
+ * The binary format is written when KV_SERIALIZE_BINARY is enabled, otherwise
+ * the json format. Both formats are always readable by kv_deserialize.
+ *
+ * @param db The pointer to the database containing the key-value pairs.
+ * @param dbcnt The number of key-value pairs in the database.
+ * @param out The pointer to store the serialized record.
+ * @param out_len The pointer to store the length of the serialized record.
+ * @return Returns OPRT_OK if serialization is successful, otherwise returns an
+ * error code.
+ */
+int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len)
+{
+#if defined(KV_SERIALIZE_BINARY) && (KV_SERIALIZE_BINARY == 1)
+    return __kv_serialize_bin(db, dbcnt, out, out_len);
+#else
+    return __kv_serialize_json(db, dbcnt, out, out_len);
+#endif
+}
+
+/**
+ * @brief Deserializes a record written by kv_serialize, in either format.
+ *
+ * @param[in] in The serialized record, '\0' terminated.
+ * @param[in] in_len The record length.
+ * @param[in,out] db The key-value database to populate.
+ * @param[in] dbcnt The number of elements in the key-value database.
+ * @return Returns OPRT_OK if the deserialization is successful. Otherwise, it
+ * returns an error code indicating the failure reason.
+ */
+int kv_deserialize(const char *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt)
+{
+    if (in_len > 0 && KV_BIN_MAGIC == (uint8_t)in[0]) {
+        return __kv_deserialize_bin((const uint8_t *)in, in_len, db, dbcnt);
+    }
+
+    return __kv_deserialize_json(in, db, dbcnt);
+}
@@ -29,6 +29,8 @@
 #include "tkl_flash.h"
 #include "tal_api.h"
 #include "tal_security.h"
+#include "kv_log.h"
+#include "kv_cache.h"
 
 // variables used by the filesystem
 static lfs_t lfs;
@@ -37,7 +39,7 @@ static tal_kv_cfg_t lfs_kv_cfg;
 static MUTEX_HANDLE lfs_mutex;
 
 extern int kv_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
-extern int kv_deserialize(const char *in, kv_db_t *db, const uint32_t dbcnt);
+extern int kv_deserialize(const char *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt);
 
 /**
  * Reads data from a user-provided block device.
@@ -178,9 +180,177 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
         err = lfs_mount(&lfs, &lfs_cfg);
     }
 
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    if (LFS_ERR_OK == err) {
+        err = kv_log_init(&lfs, lfs_mutex);
+    }
+#endif
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    if (LFS_ERR_OK == err) {
+        err = kv_cache_init();
+    }
+#endif
+
     return err;
 }
 
+static int __kv_encrypt(const uint8_t *value, size_t length, uint8_t **ec_data, uint32_t *ec_len)
+{
+    uint8_t iv[16];
+
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    return tal_aes128_cbc_encode((uint8_t *)value, length, (uint8_t *)lfs_kv_cfg.key, iv, ec_data, ec_len);
+}
+
+// dec_data needs ec_len + 1 bytes and may be ec_data itself
+static int __kv_decrypt(const char *key, uint8_t *ec_data, uint32_t ec_len, uint8_t *dec_data, size_t *length)
+{
+    int result;
+    int32_t dec_len = 0;
+    uint8_t iv[16];
+
+    memcpy(iv, lfs_kv_cfg.seed, 16);
+    result = tal_aes128_cbc_decode_raw(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, dec_data);
+    dec_len = tal_aes_get_actual_length(dec_data, ec_len);
+    if (OPRT_OK != result || dec_len < 0) {
+        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    *length = (size_t)dec_len;
+    dec_data[dec_len] = 0;
+
+    return OPRT_OK;
+}
+
+#if !defined(ENABLE_KV_LOG) || (ENABLE_KV_LOG == 0)
+// one file per key, caller holds lfs_mutex
+static int __kv_file_write(const char *key, const uint8_t *ec_data, uint32_t ec_len)
+{
+    int result;
+    lfs_file_t file;
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open %s err", key);
+        return result;
+    }
+    lfs_file_rewind(&lfs, &file);
+    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
+    lfs_file_close(&lfs, &file);
+    if (result != ec_len) {
+        PR_ERR("kv write fail %d", result);
+        return OPRT_KVS_WR_FAIL;
+    }
+
+    return OPRT_OK;
+}
+#endif
+
+// one file per key, caller holds lfs_mutex
+static int __kv_file_read(const char *key, uint8_t **ec_data, uint32_t *ec_len)
+{
+    int result;
+    lfs_file_t file;
+    uint8_t *data = NULL;
+    uint32_t len;
+
+    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
+    if (LFS_ERR_OK != result) {
+        PR_ERR("lfs open %s %d err", key, result);
+        return result;
+    }
+    len = lfs_file_size(&lfs, &file);
+
+    data = tal_malloc(len + 1);
+    if (NULL == data) {
+        lfs_file_close(&lfs, &file);
+        return OPRT_MALLOC_FAILED;
+    }
+    PR_DEBUG("key:%s, len:%d", key, len);
+    result = lfs_file_read(&lfs, &file, data, len);
+    lfs_file_close(&lfs, &file);
+    if (result <= 0) {
+        tal_free(data);
+        PR_ERR("kv read error %d", result);
+        return OPRT_KVS_RD_FAIL;
+    }
+    *ec_data = data;
+    *ec_len = len;
+
+    return OPRT_OK;
+}
+
+// drop the cached value after the key is written, caller holds lfs_mutex
+static void __kv_invalidate(const char *key)
+{
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    kv_cache_invalidate(key);
+#endif
+}
+
+// read the encrypted value, caller holds lfs_mutex
+static int __kv_storage_read(const char *key, uint8_t **ec_data, uint32_t *ec_len)
+{
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    int result = kv_log_read(key, ec_data, ec_len);
+    if (OPRT_NOT_FOUND == result) {
+        result = __kv_file_read(key, ec_data, ec_len);
+        if (OPRT_OK == result) {
+            // move the file written before the log was enabled into the log
+            KV_LOG_ITEM_T item = {key, *ec_data, *ec_len};
+            if (OPRT_OK == kv_log_append(&item, 1)) {
+                lfs_remove(&lfs, key);
+            }
+        }
+    }
+    return result;
+#else
+    return __kv_file_read(key, ec_data, ec_len);
+#endif
+}
+
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+static int __kv_get_ref(const char *key, const uint8_t **value, size_t *length)
+{
+    int result;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
+    uint8_t *dec_data = NULL;
+
+    *value = kv_cache_get(key, length);
+    if (*value) {
+        return OPRT_OK;
+    }
+
+    // filled under lfs_mutex so a concurrent set cannot be overwritten by a stale value
+    tal_mutex_lock(lfs_mutex);
+    result = __kv_storage_read(key, &ec_data, &ec_len);
+    if (OPRT_OK == result) {
+        dec_data = kv_cache_alloc(key, ec_len);
+        if (NULL == dec_data) {
+            result = OPRT_MALLOC_FAILED;
+        } else {
+            result = __kv_decrypt(key, ec_data, ec_len, dec_data, length);
+            if (OPRT_OK == result) {
+                kv_cache_insert(dec_data, *length);
+            } else {
+                kv_cache_release(dec_data);
+                dec_data = NULL;
+            }
+        }
+        tal_free(ec_data);
+    }
+    tal_mutex_unlock(lfs_mutex);
+    if (OPRT_OK != result) {
+        *length = 0;
+        return result;
+    }
+    *value = dec_data;
+
+    return OPRT_OK;
+}
+#endif
+
 /**
  * @brief Sets a key-value pair in the key-value store.
  *
@@ -197,7 +367,8 @@ int tal_kv_init(tal_kv_cfg_t *kv_cfg)
 int tal_kv_set(const char *key, const uint8_t *value, size_t length)
 {
     int result;
-    lfs_file_t file;
+    uint8_t *ec_data = NULL;
+    uint32_t ec_len = 0;
 
     PR_DEBUG("key:%s, len %d", key, length);
 
@@ -205,37 +376,112 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
-    if (LFS_ERR_OK != result) {
-        tal_mutex_unlock(lfs_mutex);
-        PR_ERR("lfs open %s err", key);
-        return result;
-    }
-    uint8_t *ec_data = NULL;
-    uint32_t ec_len = 0;
-    uint8_t iv[16];
-
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result =
-        tal_aes128_cbc_encode((uint8_t *)value, length, (uint8_t *)lfs_kv_cfg.key, iv, &ec_data, (uint32_t *)&ec_len);
+    result = __kv_encrypt(value, length, &ec_data, &ec_len);
     if (OPRT_OK != result) {
-        lfs_file_close(&lfs, &file);
-        tal_mutex_unlock(lfs_mutex);
         PR_DEBUG("key %s encrypt failed", key);
         return result;
     }
-    lfs_file_rewind(&lfs, &file);
-    result = lfs_file_write(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
+
+    tal_mutex_lock(lfs_mutex);
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    BOOL_T in_log = kv_log_exist(key);
+    KV_LOG_ITEM_T item = {key, ec_data, ec_len};
+
+    result = kv_log_append(&item, 1);
+    if (OPRT_OK == result && !in_log) {
+        // drop the file written before the log was enabled
+        lfs_remove(&lfs, key);
+    }
+#else
+    result = __kv_file_write(key, ec_data, ec_len);
+#endif
+    __kv_invalidate(key);
+    tal_mutex_unlock(lfs_mutex);
     tal_aes_free_data(ec_data);
+
+    return result;
+}
+
+/**
+ * @brief Sets several key-value pairs in the key-value store at once.
+ *
+ * With ENABLE_KV_LOG the whole batch is committed by one append and one flash
+ * sync, and after a power loss either all or none of the pairs are present.
+ * Otherwise the pairs are written one by one and the first failure stops the
+ * batch.
+ *
+ * @param batch The key-value pairs, a NULL value deletes the key.
+ * @param num The number of pairs in the batch.
+ * @return Returns OPRT_OK if all pairs are set successfully, or an error code
+ * if an error occurs.
+ */
+int tal_kv_set_batch(const tal_kv_batch_t *batch, size_t num)
+{
+    int result = OPRT_OK;
+    KV_LOG_ITEM_T *item = NULL;
+    size_t i;
+
+    if (NULL == batch || 0 == num) {
+        return OPRT_INVALID_PARM;
+    }
+    for (i = 0; i < num; i++) {
+        if (NULL == batch[i].key || (batch[i].value && 0 == batch[i].length)) {
+            return OPRT_INVALID_PARM;
+        }
+    }
+
+    item = tal_calloc(num, sizeof(KV_LOG_ITEM_T) + sizeof(BOOL_T));
+    if (NULL == item) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    for (i = 0; i < num && OPRT_OK == result; i++) {
+        item[i].key = batch[i].key;
+        if (batch[i].value) {
+            result = __kv_encrypt(batch[i].value, batch[i].length, (uint8_t **)&item[i].data, &item[i].len);
+        }
+    }
+    if (OPRT_OK != result) {
+        PR_ERR("kv batch encrypt failed %d", result);
+        goto __EXIT;
+    }
+
+    tal_mutex_lock(lfs_mutex);
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    BOOL_T *in_log = (BOOL_T *)(item + num);
+
+    for (i = 0; i < num; i++) {
+        in_log[i] = kv_log_exist(item[i].key);
+    }
+    result = kv_log_append(item, num);
+    for (i = 0; i < num && OPRT_OK == result; i++) {
+        if (!in_log[i]) {
+            lfs_remove(&lfs, item[i].key);
+        }
+    }
+#else
+    for (i = 0; i < num && OPRT_OK == result; i++) {
+        if (item[i].data) {
+            result = __kv_file_write(item[i].key, item[i].data, item[i].len);
+        } else {
+            lfs_remove(&lfs, item[i].key);
+        }
+    }
+#endif
+    for (i = 0; i < num; i++) {
+        __kv_invalidate(item[i].key);
+    }
     tal_mutex_unlock(lfs_mutex);
-    if (result != ec_len) {
-        PR_ERR("kv write fail %d", result);
-        return OPRT_KVS_WR_FAIL;
+
+__EXIT:
+    for (i = 0; i < num; i++) {
+        if (item[i].data) {
+            tal_aes_free_data((uint8_t *)item[i].data);
+        }
     }
+    tal_free(item);
 
-    return OPRT_OK;
+    return result;
 }
 
 /**
@@ -257,53 +503,98 @@ int tal_kv_set(const char *key, const uint8_t *value, size_t length)
 int tal_kv_get(const char *key, uint8_t **value, size_t *length)
 {
     int result;
-    lfs_file_t file;
 
     if (NULL == key || NULL == value || NULL == length) {
         return OPRT_INVALID_PARM;
     }
 
-    tal_mutex_lock(lfs_mutex);
-    result = lfs_file_open(&lfs, &file, key, LFS_O_RDONLY);
-    if (LFS_ERR_OK != result) {
-        PR_ERR("lfs open %s %d err", key, result);
-        tal_mutex_unlock(lfs_mutex);
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    const uint8_t *ref = NULL;
+
+    result = __kv_get_ref(key, &ref, length);
+    if (OPRT_OK != result) {
         return result;
     }
+    *value = tal_malloc(*length + 1);
+    if (NULL == *value) {
+        kv_cache_release(ref);
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(*value, ref, *length + 1);
+    kv_cache_release(ref);
+
+    return OPRT_OK;
+#else
     uint8_t *ec_data = NULL;
-    uint32_t ec_len = lfs_file_size(&lfs, &file);
+    uint32_t ec_len = 0;
 
-    ec_data = tal_malloc(ec_len + 1);
-    if (NULL == ec_data) {
-        result = OPRT_MALLOC_FAILED;
-        tal_mutex_unlock(lfs_mutex);
-        return result;
-    }
-    PR_DEBUG("key:%s, len:%d", key, ec_len);
-    result = lfs_file_read(&lfs, &file, ec_data, ec_len);
-    lfs_file_close(&lfs, &file);
+    tal_mutex_lock(lfs_mutex);
+    result = __kv_storage_read(key, &ec_data, &ec_len);
     tal_mutex_unlock(lfs_mutex);
-    if (result <= 0) {
+    if (OPRT_OK != result) {
         *length = 0;
+        return result;
+    }
+
+    // decrypt in place, the buffer is handed to the caller
+    result = __kv_decrypt(key, ec_data, ec_len, ec_data, length);
+    if (OPRT_OK != result) {
         tal_free(ec_data);
-        PR_ERR("kv read error %d", result);
-        return OPRT_KVS_RD_FAIL;
+        return result;
     }
-    uint8_t *dec_data = NULL;
-    uint32_t dec_len = 0;
-    uint8_t iv[16];
+    *value = ec_data;
 
-    memcpy(iv, lfs_kv_cfg.seed, 16);
-    result = tal_aes128_cbc_decode(ec_data, ec_len, (uint8_t *)lfs_kv_cfg.key, iv, &dec_data, (uint32_t *)&dec_len);
-    dec_len = tal_aes_get_actual_length(dec_data, dec_len);
-    tal_free(ec_data);
-    if (OPRT_OK != result || dec_len > ec_len) {
-        PR_ERR("key %s decrypt failed %d, %d-%d", key, result, dec_len, ec_len);
-        return OPRT_BUFFER_NOT_ENOUGH;
+    return OPRT_OK;
+#endif
+}
+
+/**
+ * @brief Retrieves a read-only view of the value associated with the specified
+ * key, without copying it.
+ *
+ * With ENABLE_KV_CACHE the view points into the decrypted read cache and stays
+ * valid until released, even if the key is set or deleted meanwhile.
+ * Otherwise it is a private copy, same as tal_kv_get.
+ *
+ * @param key The key to retrieve the value for.
+ * @param value A pointer that will store the view of the value.
+ * @param length A pointer to a variable that will store the length of the
+ * value.
+ *
+ * @return 0 if the value was successfully retrieved, or a negative error code
+ * if an error occurred. The view must be released by tal_kv_release.
+ */
+int tal_kv_get_ref(const char *key, const uint8_t **value, size_t *length)
+{
+    if (NULL == key || NULL == value || NULL == length) {
+        return OPRT_INVALID_PARM;
     }
-    *value = dec_data;
-    *length = (size_t)dec_len;
-    dec_data[dec_len] = 0;
+
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    return __kv_get_ref(key, value, length);
+#else
+    return tal_kv_get(key, (uint8_t **)value, length);
+#endif
+}
+
+/**
+ * @brief Releases a view returned by tal_kv_get_ref.
+ *
+ * @param value The view to be released.
+ * @return 0 if the view was successfully released, or a negative error code
+ * if an error occurred.
+ */
+int tal_kv_release(const uint8_t *value)
+{
+    if (NULL == value) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    kv_cache_release(value);
+#else
+    tal_free((void *)value);
+#endif
 
     return OPRT_OK;
 }
@@ -323,6 +614,13 @@ int tal_kv_del(const char *key)
 
     tal_mutex_lock(lfs_mutex);
     int result = lfs_remove(&lfs, key);
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+    if (kv_log_exist(key)) {
+        KV_LOG_ITEM_T item = {key, NULL, 0};
+        result = kv_log_append(&item, 1);
+    }
+#endif
+    __kv_invalidate(key);
     tal_mutex_unlock(lfs_mutex);
     if (LFS_ERR_OK == result) {
         PR_DEBUG("Deleted successfully");
@@ -365,6 +663,16 @@ int tal_kv_free(uint8_t *value)
  */
 void tal_kv_cmd(int argc, char *argv[])
 {
+#if defined(ENABLE_KV_CACHE) && (ENABLE_KV_CACHE == 1)
+    if (argc >= 2 && 0 == strcmp("stat", argv[1])) {
+        KV_CACHE_STAT_T stat;
+        kv_cache_get_stat(&stat);
+        PR_NOTICE("kv cache hit:%u miss:%u evict:%u entry:%u used:%u ref:%u", stat.hit, stat.miss, stat.evict,
+                  stat.entry_num, stat.used, stat.ref_num);
+        return;
+    }
+#endif
+
     if (argc < 3) {
         return;
     }
@@ -389,6 +697,11 @@ void tal_kv_cmd(int argc, char *argv[])
         }
         PR_DEBUG_RAW("\r\n", info.name);
         lfs_dir_close(&lfs, &dir);
+#if defined(ENABLE_KV_LOG) && (ENABLE_KV_LOG == 1)
+        tal_mutex_lock(lfs_mutex);
+        kv_log_dump();
+        tal_mutex_unlock(lfs_mutex);
+#endif
     }
 }
 
@@ -458,7 +771,7 @@ int tal_kv_serialize_get(const char *key, kv_db_t *db, size_t dbcnt)
         PR_ERR("kv_get fails %s %d", key, ret);
         return ret;
     }
-    ret = kv_deserialize((char *)buf, db, dbcnt);
+    ret = kv_deserialize((char *)buf, len, db, dbcnt);
     tal_free(buf);
     if (OPRT_OK != ret) {
         PR_ERR("kv_deserialize fail. %d", ret);
@@ -0,0 +1,374 @@
+/**
+ * @file ut_kv_log.cpp
+ * @brief kv_log test cases on littlefs over the Linux file-backed flash
+ * port: index rebuild, torn tail and uncommitted batches, compaction, and a
+ * flash-wear and throughput benchmark against one file per key.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "tkl_flash.h"
+#include "ut_kv_log_drv.h"
+}
+
+#define KV_UT_BLOCK_MAX 64
+#define KV_UT_KEY_NUM   32
+#define KV_UT_SET_NUM   1000
+#define KV_UT_BATCH_NUM 8
+
+// what the flash saw, erases are counted per block for the wear
+typedef struct {
+    uint32_t base;
+    uint64_t read_bytes;
+    uint64_t prog_bytes;
+    uint32_t prog_num;
+    uint32_t erase[KV_UT_BLOCK_MAX];
+} KV_UT_FLASH_T;
+
+static KV_UT_FLASH_T s_flash;
+
+static void __kv_ut_flash_reset(uint32_t base)
+{
+    memset(&s_flash, 0, sizeof(s_flash));
+    s_flash.base = base;
+}
+
+// same block device as tal_kv.c, on the KV data partition
+static int __kv_ut_flash_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer,
+                              lfs_size_t size)
+{
+    s_flash.read_bytes += size;
+    return (OPRT_OK == tkl_flash_read(s_flash.base + c->block_size * block + off, (uint8_t *)buffer, size))
+               ? LFS_ERR_OK
+               : LFS_ERR_IO;
+}
+
+static int __kv_ut_flash_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer,
+                              lfs_size_t size)
+{
+    s_flash.prog_bytes += size;
+    s_flash.prog_num++;
+    return (OPRT_OK == tkl_flash_write(s_flash.base + c->block_size * block + off, (const uint8_t *)buffer, size))
+               ? LFS_ERR_OK
+               : LFS_ERR_IO;
+}
+
+static int __kv_ut_flash_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    if (block < KV_UT_BLOCK_MAX) {
+        s_flash.erase[block]++;
+    }
+    return (OPRT_OK == tkl_flash_erase(s_flash.base + c->block_size * block, c->block_size)) ? LFS_ERR_OK
+                                                                                              : LFS_ERR_IO;
+}
+
+static int __kv_ut_flash_sync(const struct lfs_config *c)
+{
+    return LFS_ERR_OK;
+}
+
+class KvLogTest : public ::testing::Test {
+  protected:
+    lfs_t lfs;
+    struct lfs_config cfg;
+    MUTEX_HANDLE mutex = NULL;
+
+    void SetUp() override
+    {
+        TUYA_FLASH_BASE_INFO_T info;
+
+        ASSERT_EQ(OPRT_OK, tkl_flash_get_one_type_info(TUYA_FLASH_TYPE_KV_DATA, &info));
+        ASSERT_EQ(OPRT_OK, tal_mutex_create_init(&mutex));
+
+        __kv_ut_flash_reset(info.partition[0].start_addr);
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.read = __kv_ut_flash_read;
+        cfg.prog = __kv_ut_flash_prog;
+        cfg.erase = __kv_ut_flash_erase;
+        cfg.sync = __kv_ut_flash_sync;
+        cfg.read_size = info.partition[0].block_size;
+        cfg.prog_size = info.partition[0].block_size;
+        cfg.block_size = info.partition[0].block_size;
+        cfg.block_count = info.partition[0].size / info.partition[0].block_size;
+        cfg.cache_size = info.partition[0].block_size;
+        cfg.lookahead_size = cfg.block_count / 8 + (8 - (cfg.block_count / 8));
+        cfg.block_cycles = 500;
+        ASSERT_LE(cfg.block_count, (lfs_size_t)KV_UT_BLOCK_MAX);
+
+        ASSERT_EQ(LFS_ERR_OK, lfs_format(&lfs, &cfg));
+        ASSERT_EQ(LFS_ERR_OK, lfs_mount(&lfs, &cfg));
+    }
+
+    void TearDown() override
+    {
+        ut_kv_log_close();
+        lfs_unmount(&lfs);
+        tal_mutex_release(mutex);
+    }
+
+    // append, then what the workqueue would do after it
+    int set(const char *key, const std::string &value)
+    {
+        KV_LOG_ITEM_T item = {key, (const uint8_t *)value.data(), (uint32_t)value.size()};
+        int ret = ut_kv_log_append(&item, 1);
+        ut_kv_log_work_run();
+        return ret;
+    }
+
+    std::string get(const char *key)
+    {
+        uint8_t *data = NULL;
+        uint32_t len = 0;
+        if (OPRT_OK != ut_kv_log_read(key, &data, &len)) {
+            return "<none>";
+        }
+        std::string value((const char *)data, len);
+        tal_free(data);
+        return value;
+    }
+
+    void reopen()
+    {
+        ut_kv_log_close();
+        ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    }
+
+    // a power loss in the middle of a write: cut the tail of the log, or leave garbage after it
+    void cut_tail(uint32_t len)
+    {
+        lfs_file_t file;
+        ut_kv_log_close();
+        ASSERT_EQ(LFS_ERR_OK, lfs_file_open(&lfs, &file, "kvlog.dat", LFS_O_RDWR));
+        ASSERT_EQ(LFS_ERR_OK, lfs_file_truncate(&lfs, &file, lfs_file_size(&lfs, &file) - len));
+        ASSERT_EQ(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+        ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    }
+
+    void append_raw(const void *data, uint32_t len)
+    {
+        lfs_file_t file;
+        ut_kv_log_close();
+        ASSERT_EQ(LFS_ERR_OK, lfs_file_open(&lfs, &file, "kvlog.dat", LFS_O_WRONLY | LFS_O_APPEND));
+        ASSERT_EQ((lfs_ssize_t)len, lfs_file_write(&lfs, &file, data, len));
+        ASSERT_EQ(LFS_ERR_OK, lfs_file_close(&lfs, &file));
+        ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    }
+};
+
+TEST_F(KvLogTest, rebuild_index)
+{
+    ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    ASSERT_EQ(OPRT_OK, set("a", "1"));
+    ASSERT_EQ(OPRT_OK, set("b", "22"));
+    ASSERT_EQ(OPRT_OK, set("a", "333"));
+
+    KV_LOG_ITEM_T del = {"b", NULL, 0};
+    ASSERT_EQ(OPRT_OK, ut_kv_log_append(&del, 1));
+
+    KV_LOG_ITEM_T batch[] = {{"c", (const uint8_t *)"cc", 2}, {"d", (const uint8_t *)"ddd", 3}};
+    ASSERT_EQ(OPRT_OK, ut_kv_log_append(batch, 2));
+
+    reopen();
+    EXPECT_EQ("333", get("a"));
+    EXPECT_FALSE(ut_kv_log_exist("b"));
+    EXPECT_EQ("cc", get("c"));
+    EXPECT_EQ("ddd", get("d"));
+}
+
+TEST_F(KvLogTest, torn_tail)
+{
+    ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    ASSERT_EQ(OPRT_OK, set("a", "1"));
+    ASSERT_EQ(OPRT_OK, set("b", "22"));
+
+    // the last record is short, the log is truncated before it
+    cut_tail(1);
+    EXPECT_EQ("1", get("a"));
+    EXPECT_FALSE(ut_kv_log_exist("b"));
+    ASSERT_EQ(OPRT_OK, set("b", "3"));
+
+    uint8_t garbage[16];
+    memset(garbage, 0, sizeof(garbage));
+    append_raw(garbage, sizeof(garbage));
+    reopen();
+    EXPECT_EQ("1", get("a"));
+    EXPECT_EQ("3", get("b"));
+}
+
+TEST_F(KvLogTest, uncommitted_batch)
+{
+    ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+    ASSERT_EQ(OPRT_OK, set("a", "1"));
+
+    // a batch whose commit record is torn leaves the old values
+    KV_LOG_ITEM_T batch[] = {{"a", (const uint8_t *)"2", 1}, {"b", (const uint8_t *)"2", 1}};
+    ASSERT_EQ(OPRT_OK, ut_kv_log_append(batch, 2));
+    cut_tail(1);
+    EXPECT_EQ("1", get("a"));
+    EXPECT_FALSE(ut_kv_log_exist("b"));
+}
+
+TEST_F(KvLogTest, compaction)
+{
+    std::string value(100, 'x');
+    uint32_t compact_num = 0;
+
+    ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+
+    // rewrite few keys until the log is mostly obsolete records
+    for (int i = 0; i < 400; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "k%d", i % 4);
+        value[0] = (char)('a' + i % 26);
+        KV_LOG_ITEM_T item = {key, (const uint8_t *)value.data(), (uint32_t)value.size()};
+        ASSERT_EQ(OPRT_OK, ut_kv_log_append(&item, 1));
+        compact_num += ut_kv_log_work_run() ? 1 : 0;
+    }
+    EXPECT_GT(compact_num, 0u);
+
+    reopen();
+    for (int i = 396; i < 400; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "k%d", i % 4);
+        value[0] = (char)('a' + i % 26);
+        EXPECT_EQ(value, get(key)) << key;
+    }
+}
+
+// one littlefs file per key, the store the log replaced
+static int __kv_ut_file_set(lfs_t *lfs, const char *key, const uint8_t *data, uint32_t len)
+{
+    lfs_file_t file;
+
+    int ret = lfs_file_open(lfs, &file, key, LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC);
+    if (LFS_ERR_OK != ret) {
+        return ret;
+    }
+    lfs_ssize_t written = lfs_file_write(lfs, &file, data, len);
+    ret = lfs_file_close(lfs, &file);
+
+    return (written == (lfs_ssize_t)len) ? ret : LFS_ERR_IO;
+}
+
+static std::string __kv_ut_file_get(lfs_t *lfs, const char *key)
+{
+    lfs_file_t file;
+    std::string value;
+
+    if (LFS_ERR_OK != lfs_file_open(lfs, &file, key, LFS_O_RDONLY)) {
+        return "<none>";
+    }
+    value.resize(lfs_file_size(lfs, &file));
+    lfs_file_read(lfs, &file, &value[0], value.size());
+    lfs_file_close(lfs, &file);
+
+    return value;
+}
+
+TEST_F(KvLogTest, benchmark)
+{
+    std::vector<std::string> keys, values;
+    char key[16];
+
+    // encrypted values are padded to the AES block, 16 to 128 bytes
+    srand(4);
+    for (int i = 0; i < KV_UT_KEY_NUM; i++) {
+        snprintf(key, sizeof(key), "key.%02d", i);
+        keys.push_back(key);
+    }
+    for (int i = 0; i < KV_UT_SET_NUM; i++) {
+        values.push_back(std::string(16 * (1 + rand() % 8), (char)('a' + i % 26)));
+    }
+
+    struct {
+        const char *name;
+        std::function<int(int)> set; // set i, returns the records written
+        std::function<std::string(int)> get;
+    } stores[] = {
+        {"file per key",
+         [&](int i) {
+             const std::string &v = values[i];
+             return (LFS_ERR_OK ==
+                     __kv_ut_file_set(&lfs, keys[i % KV_UT_KEY_NUM].c_str(), (const uint8_t *)v.data(), v.size()))
+                        ? 1
+                        : -1;
+         },
+         [&](int k) { return __kv_ut_file_get(&lfs, keys[k].c_str()); }},
+        {"log",
+         [&](int i) {
+             KV_LOG_ITEM_T item = {keys[i % KV_UT_KEY_NUM].c_str(), (const uint8_t *)values[i].data(),
+                                   (uint32_t)values[i].size()};
+             int ret = ut_kv_log_append(&item, 1);
+             ut_kv_log_work_run();
+             return (OPRT_OK == ret) ? 1 : -1;
+         },
+         [&](int k) { return get(keys[k].c_str()); }},
+        {"log batch",
+         [&](int i) {
+             if (i % KV_UT_BATCH_NUM) {
+                 return 0;
+             }
+             KV_LOG_ITEM_T item[KV_UT_BATCH_NUM];
+             int num = std::min(KV_UT_BATCH_NUM, KV_UT_SET_NUM - i);
+             for (int j = 0; j < num; j++) {
+                 item[j] = {keys[(i + j) % KV_UT_KEY_NUM].c_str(), (const uint8_t *)values[i + j].data(),
+                            (uint32_t)values[i + j].size()};
+             }
+             int ret = ut_kv_log_append(item, num);
+             ut_kv_log_work_run();
+             return (OPRT_OK == ret) ? num : -1;
+         },
+         [&](int k) { return get(keys[k].c_str()); }},
+    };
+
+    for (auto &store : stores) {
+        // every store starts on a fresh file system
+        ut_kv_log_close();
+        lfs_unmount(&lfs);
+        ASSERT_EQ(LFS_ERR_OK, lfs_format(&lfs, &cfg));
+        ASSERT_EQ(LFS_ERR_OK, lfs_mount(&lfs, &cfg));
+        ASSERT_EQ(OPRT_OK, ut_kv_log_init(&lfs, mutex));
+        __kv_ut_flash_reset(s_flash.base);
+
+        int written = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < KV_UT_SET_NUM; i++) {
+            int num = store.set(i);
+            ASSERT_GE(num, 0) << store.name << " set " << i;
+            written += num;
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ASSERT_EQ(KV_UT_SET_NUM, written) << store.name;
+
+        // the last value of every key
+        for (int k = 0; k < KV_UT_KEY_NUM; k++) {
+            int last = KV_UT_SET_NUM - KV_UT_KEY_NUM + k;
+            EXPECT_EQ(values[last], store.get(last % KV_UT_KEY_NUM)) << store.name << " " << keys[last % KV_UT_KEY_NUM];
+        }
+
+        uint32_t erase_sum = 0, erase_max = 0;
+        for (uint32_t b = 0; b < cfg.block_count; b++) {
+            erase_sum += s_flash.erase[b];
+            erase_max = std::max(erase_max, s_flash.erase[b]);
+        }
+        printf("[ BENCH    ] %-12s %u sets: %.0f sets/s, programmed %.0f B and %.2f progs per set, erases %.3f per set, "
+               "hottest block %u of %u erases\n",
+               store.name, KV_UT_SET_NUM, KV_UT_SET_NUM / sec, (double)s_flash.prog_bytes / KV_UT_SET_NUM,
+               (double)s_flash.prog_num / KV_UT_SET_NUM, (double)erase_sum / KV_UT_SET_NUM, erase_max, erase_sum);
+    }
+}
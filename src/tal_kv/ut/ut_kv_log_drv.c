@@ -0,0 +1,59 @@
+/**
+ * @file ut_kv_log_drv.c
+ * @brief kv_log with the public functions renamed, so the copy in tal_kv
+ * stays untouched, and the system workqueue replaced by a slot the cases run
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+#include "ut_kv_log_drv.h"
+
+static WORKQUEUE_CB s_ut_kv_log_work = NULL;
+
+static OPERATE_RET __ut_kv_log_workq_schedule(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data)
+{
+    s_ut_kv_log_work = cb;
+    return OPRT_OK;
+}
+
+#define tal_workq_schedule __ut_kv_log_workq_schedule
+#define kv_log_init        ut_kv_log_init
+#define kv_log_append      ut_kv_log_append
+#define kv_log_read        ut_kv_log_read
+#define kv_log_exist       ut_kv_log_exist
+#define kv_log_compact     ut_kv_log_compact
+#define kv_log_dump        ut_kv_log_dump
+
+#include "../src/kv_log.c"
+
+BOOL_T ut_kv_log_work_run(void)
+{
+    WORKQUEUE_CB work = s_ut_kv_log_work;
+
+    if (NULL == work) {
+        return FALSE;
+    }
+    s_ut_kv_log_work = NULL;
+    work(NULL);
+
+    return TRUE;
+}
+
+void ut_kv_log_close(void)
+{
+    KV_LOG_NODE_T *node, *next;
+    uint32_t i;
+
+    for (i = 0; i < KV_LOG_HASH_BUCKET_NUM; i++) {
+        for (node = s_kv_log.bucket[i]; node; node = next) {
+            next = node->next;
+            tal_free(node);
+        }
+    }
+    if (s_kv_log.opened) {
+        lfs_file_close(s_kv_log.lfs, &s_kv_log.file);
+    }
+    memset(&s_kv_log, 0, sizeof(s_kv_log));
+    s_ut_kv_log_work = NULL;
+}
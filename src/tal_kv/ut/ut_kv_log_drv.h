@@ -0,0 +1,48 @@
+/**
+ * @file ut_kv_log_drv.h
+ * @brief kv_log built again for the test cases, the compaction work is kept
+ * to be run by the cases instead of the system workqueue and the engine can
+ * be closed to rebuild its index from the log, see ut_kv_log_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_KV_LOG_DRV_H__
+#define __UT_KV_LOG_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "../src/kv_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int ut_kv_log_init(lfs_t *lfs, MUTEX_HANDLE mutex);
+
+int ut_kv_log_append(const KV_LOG_ITEM_T *item, uint32_t num);
+
+int ut_kv_log_read(const char *key, uint8_t **data, uint32_t *len);
+
+BOOL_T ut_kv_log_exist(const char *key);
+
+int ut_kv_log_compact(void);
+
+/**
+ * @brief run the compaction scheduled by the last append, as the workqueue
+ * would
+ *
+ * @return TRUE if a compaction ran
+ */
+BOOL_T ut_kv_log_work_run(void);
+
+/**
+ * @brief close the log and drop the index, the next init scans the log again
+ *
+ */
+void ut_kv_log_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_KV_LOG_DRV_H__ */
@@ -0,0 +1,328 @@
+/**
+ * @file ut_kv_serialize.cpp
+ * @brief kv_serialize test cases on the json and the binary record: round
+ * trip of every type, records read by the other build, missing and reordered
+ * fields, the 65535-byte field limit, truncated records, and a size and CPU
+ * benchmark of both formats.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_kv_serialize_drv.h"
+}
+
+#define KV_UT_RAW_LEN 20
+
+typedef struct {
+    const char *name;
+    int (*serialize)(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
+    int (*deserialize)(const char *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt);
+} KV_UT_FMT_T;
+
+static const KV_UT_FMT_T s_json = {"json", ut_kv_json_serialize, ut_kv_json_deserialize};
+static const KV_UT_FMT_T s_bin = {"bin", ut_kv_bin_serialize, ut_kv_bin_deserialize};
+
+// one field of every type, with the extremes of each
+typedef struct {
+    char ch;
+    uint8_t byte;
+    int16_t sht;
+    uint16_t usht;
+    int32_t num;
+    BOOL_T on;
+    BOOL_T off;
+    char name[32];
+    char empty[8];
+    uint8_t raw[KV_UT_RAW_LEN];
+} KV_UT_REC_T;
+
+static std::vector<kv_db_t> __kv_ut_db(KV_UT_REC_T *r, uint16_t raw_len)
+{
+    return {
+        {(char *)"ch", KV_CHAR, &r->ch, sizeof(r->ch)},
+        {(char *)"byte", KV_BYTE, &r->byte, sizeof(r->byte)},
+        {(char *)"sht", KV_SHORT, &r->sht, sizeof(r->sht)},
+        {(char *)"usht", KV_USHORT, &r->usht, sizeof(r->usht)},
+        {(char *)"num", KV_INT, &r->num, sizeof(r->num)},
+        {(char *)"on", KV_BOOL, &r->on, sizeof(r->on)},
+        {(char *)"off", KV_BOOL, &r->off, sizeof(r->off)},
+        {(char *)"name", KV_STRING, r->name, sizeof(r->name)},
+        {(char *)"empty", KV_STRING, r->empty, sizeof(r->empty)},
+        {(char *)"raw", KV_RAW, r->raw, raw_len},
+    };
+}
+
+static void __kv_ut_rec_fill(KV_UT_REC_T *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->ch = -128;
+    r->byte = 255;
+    r->sht = -32768;
+    r->usht = 65535;
+    r->num = INT32_MIN;
+    r->on = TRUE;
+    r->off = FALSE;
+    strcpy(r->name, "desk light 4.1.16");
+    for (int i = 0; i < KV_UT_RAW_LEN; i++) {
+        r->raw[i] = (uint8_t)(i * 37 + (i & 1 ? 0 : 0xff));
+    }
+}
+
+static void __kv_ut_rec_expect(const KV_UT_REC_T &exp, const KV_UT_REC_T &act, const char *name)
+{
+    EXPECT_EQ(exp.ch, act.ch) << name;
+    EXPECT_EQ(exp.byte, act.byte) << name;
+    EXPECT_EQ(exp.sht, act.sht) << name;
+    EXPECT_EQ(exp.usht, act.usht) << name;
+    EXPECT_EQ(exp.num, act.num) << name;
+    EXPECT_EQ(exp.on, act.on) << name;
+    EXPECT_EQ(exp.off, act.off) << name;
+    EXPECT_STREQ(exp.name, act.name) << name;
+    EXPECT_STREQ(exp.empty, act.empty) << name;
+    EXPECT_EQ(0, memcmp(exp.raw, act.raw, sizeof(exp.raw))) << name;
+}
+
+class KvSerializeTest : public ::testing::TestWithParam<const KV_UT_FMT_T *> {
+  protected:
+    const KV_UT_FMT_T *fmt = nullptr;
+
+    void SetUp() override
+    {
+        fmt = GetParam();
+    }
+
+    std::string write(std::vector<kv_db_t> db)
+    {
+        char *out = NULL;
+        uint32_t len = 0;
+        EXPECT_EQ(OPRT_OK, fmt->serialize(db.data(), db.size(), &out, &len));
+        std::string rec(out ? out : "", len);
+        tal_free(out);
+        return rec;
+    }
+};
+
+TEST_P(KvSerializeTest, round_trip)
+{
+    KV_UT_REC_T in, out;
+
+    __kv_ut_rec_fill(&in);
+    std::string rec = write(__kv_ut_db(&in, KV_UT_RAW_LEN));
+
+    memset(&out, 0x5a, sizeof(out));
+    auto db = __kv_ut_db(&out, KV_UT_RAW_LEN);
+    ASSERT_EQ(OPRT_OK, fmt->deserialize(rec.c_str(), rec.size(), db.data(), db.size()));
+    __kv_ut_rec_expect(in, out, fmt->name);
+
+    // an empty raw reads back with length 0
+    rec = write(__kv_ut_db(&in, 0));
+    db = __kv_ut_db(&out, KV_UT_RAW_LEN);
+    ASSERT_EQ(OPRT_OK, fmt->deserialize(rec.c_str(), rec.size(), db.data(), db.size()));
+    EXPECT_EQ(0, db[9].len) << fmt->name;
+}
+
+TEST_P(KvSerializeTest, read_by_other_build)
+{
+    KV_UT_REC_T in, out;
+    const KV_UT_FMT_T *other = (fmt == &s_json) ? &s_bin : &s_json;
+
+    // a rollback or an upgrade reads the record of the other setting
+    __kv_ut_rec_fill(&in);
+    std::string rec = write(__kv_ut_db(&in, KV_UT_RAW_LEN));
+    memset(&out, 0, sizeof(out));
+    auto db = __kv_ut_db(&out, KV_UT_RAW_LEN);
+    ASSERT_EQ(OPRT_OK, other->deserialize(rec.c_str(), rec.size(), db.data(), db.size()));
+    __kv_ut_rec_expect(in, out, fmt->name);
+}
+
+TEST_P(KvSerializeTest, missing_and_reordered)
+{
+    int32_t a = 7, b = -9, a_out = 0, b_out = 0, c_out = 123;
+    char s[16] = "x", s_out[16] = "junk";
+
+    std::string rec = write({{(char *)"a", KV_INT, &a, sizeof(a)},
+                             {(char *)"s", KV_STRING, s, sizeof(s)},
+                             {(char *)"b", KV_INT, &b, sizeof(b)}});
+
+    // fields in another order, one of them not in the record
+    std::vector<kv_db_t> db = {{(char *)"b", KV_INT, &b_out, sizeof(b_out)},
+                               {(char *)"c", KV_INT, &c_out, sizeof(c_out)},
+                               {(char *)"s", KV_STRING, s_out, sizeof(s_out)},
+                               {(char *)"a", KV_INT, &a_out, sizeof(a_out)}};
+    ASSERT_EQ(OPRT_OK, fmt->deserialize(rec.c_str(), rec.size(), db.data(), db.size()));
+    EXPECT_EQ(a, a_out) << fmt->name;
+    EXPECT_EQ(b, b_out) << fmt->name;
+    EXPECT_EQ(0, c_out) << fmt->name;
+    EXPECT_STREQ(s, s_out) << fmt->name;
+}
+
+TEST_P(KvSerializeTest, integer_width)
+{
+    int16_t sht = -5;
+    int32_t num = 0;
+    uint8_t byte = 0;
+
+    // an integer field can change its type if the value still fits
+    std::string rec = write({{(char *)"v", KV_SHORT, &sht, sizeof(sht)}});
+    kv_db_t wide = {(char *)"v", KV_INT, &num, sizeof(num)};
+    ASSERT_EQ(OPRT_OK, fmt->deserialize(rec.c_str(), rec.size(), &wide, 1));
+    EXPECT_EQ(-5, num) << fmt->name;
+
+    kv_db_t narrow = {(char *)"v", KV_BYTE, &byte, sizeof(byte)};
+    EXPECT_EQ(OPRT_COM_ERROR, fmt->deserialize(rec.c_str(), rec.size(), &narrow, 1)) << fmt->name;
+}
+
+INSTANTIATE_TEST_SUITE_P(Format, KvSerializeTest, ::testing::Values(&s_json, &s_bin),
+                         [](const ::testing::TestParamInfo<const KV_UT_FMT_T *> &info) {
+                             return std::string(info.param->name);
+                         });
+
+TEST(KvSerializeBinTest, field_length_limit)
+{
+    std::vector<uint8_t> raw(65535), raw_out(65535);
+    std::string str(65536, 's');
+    std::vector<char> str_out(65535);
+    char *out = NULL;
+    uint32_t len = 0;
+
+    for (size_t i = 0; i < raw.size(); i++) {
+        raw[i] = (uint8_t)(i * 7);
+    }
+
+    // the longest raw a kv_db_t can hold fills the 2-byte length
+    kv_db_t db = {(char *)"raw", KV_RAW, raw.data(), (uint16_t)raw.size()};
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_serialize(&db, 1, &out, &len));
+    db.val = raw_out.data();
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_deserialize(out, len, &db, 1));
+    EXPECT_EQ(raw, raw_out);
+    tal_free(out);
+
+    // a string is only bounded by its terminator, one byte more does not fit
+    db = {(char *)"str", KV_STRING, &str[0], 0};
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, ut_kv_bin_serialize(&db, 1, &out, &len));
+
+    str.resize(65535);
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_serialize(&db, 1, &out, &len));
+    // no kv_db_t buffer holds 65535 bytes and the terminator
+    db = {(char *)"str", KV_STRING, str_out.data(), (uint16_t)str_out.size()};
+    EXPECT_EQ(OPRT_COM_ERROR, ut_kv_bin_deserialize(out, len, &db, 1));
+    tal_free(out);
+
+    str.resize(65534);
+    db = {(char *)"str", KV_STRING, &str[0], 0};
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_serialize(&db, 1, &out, &len));
+    db = {(char *)"str", KV_STRING, str_out.data(), (uint16_t)str_out.size()};
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_deserialize(out, len, &db, 1));
+    EXPECT_EQ(str, std::string(str_out.data()));
+    tal_free(out);
+}
+
+TEST(KvSerializeBinTest, truncated_record)
+{
+    KV_UT_REC_T in, out;
+    char *rec = NULL;
+    uint32_t len = 0;
+
+    __kv_ut_rec_fill(&in);
+    auto db = __kv_ut_db(&in, KV_UT_RAW_LEN);
+    ASSERT_EQ(OPRT_OK, ut_kv_bin_serialize(db.data(), db.size(), &rec, &len));
+
+    // a cut at a field boundary is a shorter record, anywhere else it is rejected
+    for (uint32_t cut = 0; cut < len; cut++) {
+        std::vector<char> part(rec, rec + cut);
+        part.push_back(0);
+        db = __kv_ut_db(&out, KV_UT_RAW_LEN);
+        int rt = ut_kv_bin_deserialize(part.data(), cut, db.data(), db.size());
+        EXPECT_TRUE(OPRT_OK == rt || OPRT_CJSON_PARSE_ERR == rt) << "cut " << cut << " rt " << rt;
+        if (cut < 2) {
+            EXPECT_NE(OPRT_OK, rt) << "cut " << cut;
+        }
+    }
+    tal_free(rec);
+}
+
+TEST(KvSerializeBench, benchmark)
+{
+    // a device config record: numbers, switches and a few strings
+    int32_t brightness = 800, temp = 6500, countdown = 3600, scene = 12;
+    uint8_t mode = 2;
+    BOOL_T power = TRUE, relay = FALSE;
+    char swv[] = "4.1.16", tz[] = "+08:00", name[] = "living room light";
+    std::vector<kv_db_t> config = {
+        {(char *)"power", KV_BOOL, &power, sizeof(power)},
+        {(char *)"relay_status", KV_BOOL, &relay, sizeof(relay)},
+        {(char *)"mode", KV_BYTE, &mode, sizeof(mode)},
+        {(char *)"bright_value", KV_INT, &brightness, sizeof(brightness)},
+        {(char *)"temp_value", KV_INT, &temp, sizeof(temp)},
+        {(char *)"countdown", KV_INT, &countdown, sizeof(countdown)},
+        {(char *)"scene", KV_INT, &scene, sizeof(scene)},
+        {(char *)"swv", KV_STRING, swv, sizeof(swv)},
+        {(char *)"timezone", KV_STRING, tz, sizeof(tz)},
+        {(char *)"name", KV_STRING, name, sizeof(name)},
+    };
+
+    // a record carrying a blob, as a schedule table or a certificate
+    std::vector<uint8_t> blob(1024);
+    int32_t ver = 3;
+    for (size_t i = 0; i < blob.size(); i++) {
+        blob[i] = (uint8_t)(i * 131);
+    }
+    std::vector<kv_db_t> table = {
+        {(char *)"ver", KV_INT, &ver, sizeof(ver)},
+        {(char *)"table", KV_RAW, blob.data(), (uint16_t)blob.size()},
+    };
+
+    const int iter = 20000;
+    // best of three runs, ns per call
+    auto bench = [iter](const std::function<void()> &fn) {
+        double best = 0;
+        for (int r = 0; r < 3; r++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iter; i++) {
+                fn();
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best = (0 == r || ns < best) ? ns : best;
+        }
+        return best / iter;
+    };
+
+    for (auto *rec : {&config, &table}) {
+        double enc_ns[2], dec_ns[2];
+        uint32_t size[2];
+        const KV_UT_FMT_T *fmts[] = {&s_json, &s_bin};
+
+        for (int f = 0; f < 2; f++) {
+            const KV_UT_FMT_T *fmt = fmts[f];
+            char *out = NULL;
+            ASSERT_EQ(OPRT_OK, fmt->serialize(rec->data(), rec->size(), &out, &size[f]));
+
+            enc_ns[f] = bench([&] {
+                char *buf = NULL;
+                uint32_t len = 0;
+                fmt->serialize(rec->data(), rec->size(), &buf, &len);
+                tal_free(buf);
+            });
+            // read back into the same variables, the values do not change
+            dec_ns[f] = bench([&] { fmt->deserialize(out, size[f], rec->data(), rec->size()); });
+            tal_free(out);
+        }
+
+        printf("[ BENCH    ] %-6s record: json %u B, bin %u B; serialize json %.0f ns, bin %.0f ns; deserialize json "
+               "%.0f ns, bin %.0f ns\n",
+               (rec == &config) ? "config" : "blob", size[0], size[1], enc_ns[0], enc_ns[1], dec_ns[0], dec_ns[1]);
+        EXPECT_LT(size[1], size[0]);
+    }
+}
@@ -0,0 +1,17 @@
+/**
+ * @file ut_kv_serialize_bin_drv.c
+ * @brief kv_serialize writing the binary record of KV_SERIALIZE_BINARY
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "ut_kv_serialize_drv.h"
+
+#undef KV_SERIALIZE_BINARY
+#define KV_SERIALIZE_BINARY 1
+
+#define kv_serialize   ut_kv_bin_serialize
+#define kv_deserialize ut_kv_bin_deserialize
+
+#include "../src/kv_serialize.c"
@@ -0,0 +1,32 @@
+/**
+ * @file ut_kv_serialize_drv.h
+ * @brief kv_serialize built twice, writing the json and the binary record,
+ * both read back by either build, see ut_kv_serialize_json_drv.c and
+ * ut_kv_serialize_bin_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_KV_SERIALIZE_DRV_H__
+#define __UT_KV_SERIALIZE_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "tal_kv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int ut_kv_json_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
+
+int ut_kv_json_deserialize(const char *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt);
+
+int ut_kv_bin_serialize(const kv_db_t *db, const uint32_t dbcnt, char **out, uint32_t *out_len);
+
+int ut_kv_bin_deserialize(const char *in, uint32_t in_len, kv_db_t *db, const uint32_t dbcnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_KV_SERIALIZE_DRV_H__ */
@@ -0,0 +1,18 @@
+/**
+ * @file ut_kv_serialize_json_drv.c
+ * @brief kv_serialize writing the json record, the format before
+ * KV_SERIALIZE_BINARY
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "ut_kv_serialize_drv.h"
+
+#undef KV_SERIALIZE_BINARY
+#define KV_SERIALIZE_BINARY 0
+
+#define kv_serialize   ut_kv_json_serialize
+#define kv_deserialize ut_kv_json_deserialize
+
+#include "../src/kv_serialize.c"
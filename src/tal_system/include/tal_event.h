@@ -50,6 +50,10 @@ extern "C" {
  */
 #define EVENT_DESC_MAX_LEN (32)
 
+#ifndef EVENT_HASH_BUCKET_NUM
+#define EVENT_HASH_BUCKET_NUM (16) // must be power of 2
+#endif
+
 /**
  * @brief subscriber type
  *
@@ -89,16 +93,43 @@ typedef struct {
     struct tuya_list_head node;        // list node, used to attch to the event node
 } SUBSCRIBE_NODE_T;
 
+/**
+ * @brief the subscriber in a dispatch snapshot
+ *
+ */
+typedef struct {
+    SUBSCRIBE_TYPE_E type;   // the subscribe type
+    EVENT_SUBSCRIBE_CB cb;   // the subscribe callback function
+    SUBSCRIBE_NODE_T *owner; // the subscribe node in the list, only used as identity
+} SUBSCRIBE_ENTRY_T;
+
+/**
+ * @brief the dispatch snapshot, never modified once published
+ *
+ */
+typedef struct subscribe_array {
+    struct subscribe_array *next; // next retired snapshot
+    uint16_t num;                 // subscriber number
+    SUBSCRIBE_ENTRY_T entry[0];   // subscribers in dispatch order
+} SUBSCRIBE_ARRAY_T;
+
 /**
  * @brief the event node
  *
  */
 typedef struct {
-    MUTEX_HANDLE mutex; // mutex, protection the event publish and subscribe
+    MUTEX_HANDLE mutex; // mutex, protection the subscribe list and snapshot update
 
     char name[EVENT_NAME_MAX_LEN + 1];    // name, the event name
+    uint32_t hash;                        // hash of the event name
     struct tuya_list_head node;           // list node, used to attach to the event manage module
+    struct tuya_list_head hash_node;      // list node, used to attach to the hash bucket
     struct tuya_list_head subscribe_root; // subscibe root, used to manage the subscriber
+
+    SUBSCRIBE_ARRAY_T *subscribers; // copy-on-write snapshot of subscribe_root, read by publish
+    SUBSCRIBE_ARRAY_T *retired;     // replaced snapshots, freed when no publisher is reading
+    uint16_t readers;               // publishers currently walking a snapshot
+    BOOL_T stale;                   // snapshot rebuild failed, publish walks subscribe_root under the mutex
 } EVENT_NODE_T;
 
 /**
@@ -112,8 +143,15 @@ typedef struct {
     struct tuya_list_head event_root;          // event root, used to manage the event
     struct tuya_list_head free_subscribe_root; // free subscriber list, used to manage the
                                                // subscribe which not found the event
+    struct tuya_list_head hash_root[EVENT_HASH_BUCKET_NUM]; // event hash buckets, used to find event by name
 } EVENT_MANAGE_T;
 
+/**
+ * @brief the event handle, resolved once by name
+ *
+ */
+typedef void *EVENT_HANDLE;
+
 /**
  * @brief event initialization
  *
@@ -132,6 +170,37 @@ OPERATE_RET tal_event_init(void);
  */
 OPERATE_RET tal_event_publish(const char *name, void *data);
 
+/**
+ * @brief: get event handle, the event will be created if not exist
+ *
+ * @param[in] name: event name
+ * @param[out] handle: event handle, valid for the whole lifetime
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_get_handle(const char *name, EVENT_HANDLE *handle);
+
+/**
+ * @brief: publish event by handle, without name lookup
+ *
+ * @param[in] handle: event handle
+ * @param[in] data: event data
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_handle(EVENT_HANDLE handle, void *data);
+
+/**
+ * @brief: publish event by handle, subscribers are called in the system
+ * workqueue instead of the caller context
+ *
+ * @param[in] handle: event handle
+ * @param[in] data: event data, must stay valid until all subscribers return
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_event_publish_async(EVENT_HANDLE handle, void *data);
+
 /**
  * @brief: subscribe event
  *
@@ -147,6 +216,12 @@ OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_
 /**
  * @brief: unsubscribe event
  *
+ * @note the callback may still run after this function returns: a publish
+ * that took the subscriber snapshot before the unsubscribe goes on with it,
+ * and works already queued by tal_event_publish_async are not cancelled. Keep
+ * what the callback uses valid until such deliveries are over, the callback
+ * itself may unsubscribe.
+ *
  * @param[in] name: event name
  * @param[in] desc: subscribe description
  * @param[in] cb: subscribe callback function
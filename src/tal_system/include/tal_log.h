@@ -168,6 +168,15 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
  */
 OPERATE_RET tal_log_add_output_term(const char *name, const TAL_LOG_OUTPUT_CB term);
 
+/**
+ * @brief get the number of logs dropped because the async log ring was full.
+ *
+ * @note Logs are only dropped when ENABLE_LOG_ASYNC is on.
+ *
+ * @return the drop number
+ */
+uint32_t tal_log_get_drop_num(void);
+
 /**
  * @brief delete one output terminal.
  *
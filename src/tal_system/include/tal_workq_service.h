@@ -78,6 +78,19 @@ OPERATE_RET tal_workq_schedule(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *d
  */
 OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue, works with the same key run in order
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the ordering key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_keyed(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -39,6 +39,15 @@ typedef struct {
 } WORK_ITEM_T;
 typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
 
+typedef struct {
+    uint16_t depth;       // items waiting in the worker queue
+    uint16_t max_depth;   // high-water mark of depth
+    uint32_t done;        // items executed
+    uint32_t stolen;      // items taken from other workers
+    uint32_t avg_latency; // average schedule-to-run latency, ms
+    uint32_t max_latency; // worst schedule-to-run latency, ms
+} WORKQUEUE_STAT_T;
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -52,6 +61,23 @@ typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle);
 
+/**
+ * @brief create and initialize a workqueue served by a pool of worker threads
+ *
+ * @param[in] queue_len the maximum number of items each worker can contain
+ * @param[in] worker_num the number of worker threads, 1 ~ 8
+ * @param[in] thread_cfg thread param, shared by all workers
+ * @param[out] handle the workqueue handle
+ *
+ * @note each worker owns a queue, idle workers steal unkeyed work from busy
+ * ones, so works scheduled without a key may run concurrently and out of order
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, const uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle);
+
 /**
  * @brief put work task in workqueue
  *
@@ -76,6 +102,19 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue, works with the same key run in order
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the ordering key, e.g. a hash of the device id
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_keyed(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -109,6 +148,27 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
  */
 uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 
+/**
+ * @brief get the worker thread number of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ *
+ * @return the worker number
+ */
+uint8_t tal_workqueue_get_worker_num(WORKQUEUE_HANDLE handle);
+
+/**
+ * @brief get the statistics of one worker
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] index the worker index
+ * @param[out] stat the worker statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_get_stat(WORKQUEUE_HANDLE handle, uint8_t index, WORKQUEUE_STAT_T *stat);
+
 /**
  * @brief release the workqueue
  *
@@ -120,7 +180,7 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle);
 
 /**
- * @brief get thread handle of the workqueue
+ * @brief get thread handle of the workqueue, the first worker for a pool
  *
  * @param[in] handle the workqueue handle
  *
@@ -18,7 +18,9 @@
  * - Event name and description validation
  * - Event node creation and initialization
  * - Subscription management (addition, deletion, retrieval)
- * - Event dispatching to subscribed listeners
+ * - Event lookup through name hash buckets and pre-resolved event handles
+ * - Event dispatching to subscribed listeners through copy-on-write
+ *   subscriber snapshots, without holding the event mutex
  * - Thread-safe operations through mutex locking
  * - Debugging utilities for event and subscription dumping
  *
@@ -36,6 +38,24 @@
 
 static EVENT_MANAGE_T g_event_manager = {0};
 
+typedef struct {
+    EVENT_SUBSCRIBE_CB cb;
+    void *data;
+} EVENT_ASYNC_WORK_T;
+
+static uint32_t _event_name_hash(const char *name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)(*name++);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
 BOOL_T _event_name_is_valid(const char *name)
 {
     if (!name) {
@@ -62,6 +82,115 @@ BOOL_T _event_desc_is_valid(const char *desc)
     return TRUE;
 }
 
+EVENT_NODE_T *_event_node_get_by_hash(const char *name, uint32_t hash)
+{
+    // try to get event from the hash bucket
+    EVENT_NODE_T *entry = NULL;
+    struct tuya_list_head *pos = NULL;
+    tuya_list_for_each(pos, &g_event_manager.hash_root[hash & (EVENT_HASH_BUCKET_NUM - 1)])
+    {
+        // find by hash, then by name
+        entry = tuya_list_entry(pos, EVENT_NODE_T, hash_node);
+        if (entry->hash == hash && 0 == strcmp(entry->name, name)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+EVENT_NODE_T *_event_node_get(const char *name)
+{
+    return _event_node_get_by_hash(name, _event_name_hash(name));
+}
+
+void _event_node_reclaim(EVENT_NODE_T *event)
+{
+    // must be called with event mutex locked, which serializes all retire operations
+    SUBSCRIBE_ARRAY_T *retired = NULL;
+    SUBSCRIBE_ARRAY_T *next = NULL;
+    uint16_t readers = 0;
+
+    TAL_ENTER_CRITICAL();
+    readers = event->readers;
+    if (0 == readers) {
+        retired = event->retired;
+        event->retired = NULL;
+    }
+    TAL_EXIT_CRITICAL();
+
+    // no publisher is reading, nobody can still hold a retired snapshot
+    while (retired) {
+        next = retired->next;
+        tal_free(retired);
+        retired = next;
+    }
+}
+
+OPERATE_RET _event_node_rebuild(EVENT_NODE_T *event)
+{
+    // must be called with event mutex locked, after the subscribe list changed
+    uint16_t num = 0;
+    struct tuya_list_head *pos = NULL;
+    SUBSCRIBE_NODE_T *entry = NULL;
+    SUBSCRIBE_ARRAY_T *snapshot = NULL;
+    SUBSCRIBE_ARRAY_T *old = NULL;
+
+    tuya_list_for_each(pos, &event->subscribe_root)
+    {
+        num++;
+    }
+
+    if (num) {
+        snapshot = tal_malloc(sizeof(SUBSCRIBE_ARRAY_T) + num * sizeof(SUBSCRIBE_ENTRY_T));
+    }
+
+    // out of memory, the old snapshot no longer matches the list, drop it and publish under the mutex
+    if (num && (NULL == snapshot)) {
+        TAL_ENTER_CRITICAL();
+        old = event->subscribers;
+        event->subscribers = NULL;
+        event->stale = TRUE;
+        if (old) {
+            old->next = event->retired;
+            event->retired = old;
+        }
+        TAL_EXIT_CRITICAL();
+
+        _event_node_reclaim(event);
+
+        return OPRT_MALLOC_FAILED;
+    }
+
+    if (snapshot) {
+        snapshot->next = NULL;
+        snapshot->num = 0;
+        tuya_list_for_each(pos, &event->subscribe_root)
+        {
+            entry = tuya_list_entry(pos, SUBSCRIBE_NODE_T, node);
+            snapshot->entry[snapshot->num].type = entry->type;
+            snapshot->entry[snapshot->num].cb = entry->cb;
+            snapshot->entry[snapshot->num].owner = entry;
+            snapshot->num++;
+        }
+    }
+
+    // publish the new snapshot, the old one is retired until readers leave
+    TAL_ENTER_CRITICAL();
+    old = event->subscribers;
+    event->subscribers = snapshot;
+    event->stale = FALSE;
+    if (old) {
+        old->next = event->retired;
+        event->retired = old;
+    }
+    TAL_EXIT_CRITICAL();
+
+    _event_node_reclaim(event);
+
+    return OPRT_OK;
+}
+
 EVENT_NODE_T *_event_node_create_init(const char *name)
 {
     // allocate memory
@@ -72,11 +201,21 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
     // initialze the event node
     memcpy(event->name, name, strlen(name));
     event->name[strlen(name)] = '\0';
+    event->hash = _event_name_hash(event->name);
     INIT_LIST_HEAD(&event->subscribe_root);
-    tal_mutex_create_init(&event->mutex);
 
     tal_mutex_lock(g_event_manager.mutex);
 
+    // another publisher or subscriber may have created it meanwhile
+    EVENT_NODE_T *exist = _event_node_get_by_hash(event->name, event->hash);
+    if (exist) {
+        tal_mutex_unlock(g_event_manager.mutex);
+        tal_free(event);
+        return exist;
+    }
+
+    tal_mutex_create_init(&event->mutex);
+
     // need check if there have free subscriber which subscribe this event
     struct tuya_list_head *free_pos = NULL;
     struct tuya_list_head *free_next = NULL;
@@ -98,8 +237,11 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
         }
     }
 
+    _event_node_rebuild(event);
+
     // at last, need add this event to event manage root
     tuya_list_add_tail(&event->node, &g_event_manager.event_root);
+    tuya_list_add_tail(&event->hash_node, &g_event_manager.hash_root[event->hash & (EVENT_HASH_BUCKET_NUM - 1)]);
     g_event_manager.event_cnt++;
 
     tal_mutex_unlock(g_event_manager.mutex);
@@ -107,23 +249,6 @@ EVENT_NODE_T *_event_node_create_init(const char *name)
     return event;
 }
 
-EVENT_NODE_T *_event_node_get(const char *name)
-{
-    // try to get event from event root
-    EVENT_NODE_T *entry = NULL;
-    struct tuya_list_head *pos = NULL;
-    tuya_list_for_each(pos, &g_event_manager.event_root)
-    {
-        // find by name
-        entry = tuya_list_entry(pos, EVENT_NODE_T, node);
-        if (0 == strcmp(entry->name, name)) {
-            return entry;
-        }
-    }
-
-    return NULL;
-}
-
 SUBSCRIBE_NODE_T *_event_node_get_free_subscribe(SUBSCRIBE_NODE_T *subscribe)
 {
     struct tuya_list_head *pos = NULL;
@@ -157,20 +282,101 @@ SUBSCRIBE_NODE_T *_event_node_get_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_
     return NULL;
 }
 
-OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data)
+BOOL_T _event_node_claim_onetime(EVENT_NODE_T *event, SUBSCRIBE_ENTRY_T *entry)
 {
-    OPERATE_RET rt = OPRT_OK;
+    // one-time subscriber is removed by the first publisher which reaches it
+    BOOL_T claimed = FALSE;
+    struct tuya_list_head *pos = NULL;
+
+    tal_mutex_lock(event->mutex);
+    tuya_list_for_each(pos, &event->subscribe_root)
+    {
+        // the node may be freed and reused, so check the callback too
+        if (pos == &entry->owner->node && entry->owner->cb == entry->cb) {
+            tuya_list_del(&entry->owner->node);
+            tal_free(entry->owner);
+            _event_node_rebuild(event);
+            claimed = TRUE;
+            break;
+        }
+    }
+    tal_mutex_unlock(event->mutex);
+
+    return claimed;
+}
+
+SUBSCRIBE_ARRAY_T *_event_node_read_begin(EVENT_NODE_T *event, BOOL_T *stale)
+{
+    SUBSCRIBE_ARRAY_T *snapshot = NULL;
+
+    TAL_ENTER_CRITICAL();
+    event->readers++;
+    snapshot = event->subscribers;
+    *stale = event->stale;
+    TAL_EXIT_CRITICAL();
+
+    return snapshot;
+}
+
+void _event_node_read_end(EVENT_NODE_T *event)
+{
+    BOOL_T need_reclaim = FALSE;
+
+    TAL_ENTER_CRITICAL();
+    event->readers--;
+    need_reclaim = (0 == event->readers) && (NULL != event->retired);
+    TAL_EXIT_CRITICAL();
+
+    // the last reader frees snapshots retired while it was dispatching
+    if (need_reclaim) {
+        tal_mutex_lock(event->mutex);
+        _event_node_reclaim(event);
+        tal_mutex_unlock(event->mutex);
+    }
+}
+
+OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data);
+
+OPERATE_RET _event_node_dispatch_async(EVENT_NODE_T *event, void *data);
+
+void _event_async_work_cb(void *data);
 
-    // dispatch in order
+OPERATE_RET _event_node_dispatch_locked(EVENT_NODE_T *event, void *data, BOOL_T async)
+{
+    OPERATE_RET rt = OPRT_OK;
     struct tuya_list_head *p = NULL;
     struct tuya_list_head *n = NULL;
     SUBSCRIBE_NODE_T *entry = NULL;
+    EVENT_ASYNC_WORK_T *work = NULL;
+
+    tal_mutex_lock(event->mutex);
+
+    // memory may be back, go on with the snapshot if it can be rebuilt
+    if (OPRT_OK == _event_node_rebuild(event)) {
+        tal_mutex_unlock(event->mutex);
+        return async ? _event_node_dispatch_async(event, data) : _event_node_dispatch(event, data);
+    }
+
+    // dispatch in order, walking the list under the mutex
     tuya_list_for_each_safe(p, n, &event->subscribe_root)
     {
-        // find and call cb one by one
         entry = tuya_list_entry(p, SUBSCRIBE_NODE_T, node);
         if (entry->cb) {
-            TUYA_CALL_ERR_LOG(entry->cb(data));
+            if (async) {
+                work = tal_malloc(sizeof(EVENT_ASYNC_WORK_T));
+                if (work) {
+                    work->cb = entry->cb;
+                    work->data = data;
+                    TUYA_CALL_ERR_LOG(tal_workq_schedule(WORKQ_SYSTEM, _event_async_work_cb, work));
+                    if (OPRT_OK != rt) {
+                        tal_free(work);
+                    }
+                } else {
+                    rt = OPRT_MALLOC_FAILED;
+                }
+            } else {
+                TUYA_CALL_ERR_LOG(entry->cb(data));
+            }
         }
 
         // one-time event should be removed after dispatch
@@ -181,6 +387,90 @@ OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data)
         }
     }
 
+    tal_mutex_unlock(event->mutex);
+
+    return rt;
+}
+
+OPERATE_RET _event_node_dispatch(EVENT_NODE_T *event, void *data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint16_t i = 0;
+    SUBSCRIBE_ENTRY_T *entry = NULL;
+    BOOL_T stale = FALSE;
+
+    // dispatch in order, on a snapshot, subscribers may (un)subscribe in callback
+    SUBSCRIBE_ARRAY_T *snapshot = _event_node_read_begin(event, &stale);
+    if (stale) {
+        _event_node_read_end(event);
+        return _event_node_dispatch_locked(event, data, FALSE);
+    }
+    for (i = 0; snapshot && (i < snapshot->num); i++) {
+        entry = &snapshot->entry[i];
+
+        // one-time event should be removed after dispatch
+        if (entry->type == SUBSCRIBE_TYPE_ONETIME && !_event_node_claim_onetime(event, entry)) {
+            continue;
+        }
+
+        // find and call cb one by one
+        if (entry->cb) {
+            TUYA_CALL_ERR_LOG(entry->cb(data));
+        }
+    }
+    _event_node_read_end(event);
+
+    return rt;
+}
+
+void _event_async_work_cb(void *data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    EVENT_ASYNC_WORK_T *work = (EVENT_ASYNC_WORK_T *)data;
+
+    TUYA_CALL_ERR_LOG(work->cb(work->data));
+    tal_free(work);
+}
+
+OPERATE_RET _event_node_dispatch_async(EVENT_NODE_T *event, void *data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint16_t i = 0;
+    SUBSCRIBE_ENTRY_T *entry = NULL;
+    EVENT_ASYNC_WORK_T *work = NULL;
+    BOOL_T stale = FALSE;
+
+    // fan out, one work per subscriber, so a pooled workqueue can run them in parallel
+    SUBSCRIBE_ARRAY_T *snapshot = _event_node_read_begin(event, &stale);
+    if (stale) {
+        _event_node_read_end(event);
+        return _event_node_dispatch_locked(event, data, TRUE);
+    }
+    for (i = 0; snapshot && (i < snapshot->num); i++) {
+        entry = &snapshot->entry[i];
+        if (NULL == entry->cb) {
+            continue;
+        }
+
+        if (entry->type == SUBSCRIBE_TYPE_ONETIME && !_event_node_claim_onetime(event, entry)) {
+            continue;
+        }
+
+        work = tal_malloc(sizeof(EVENT_ASYNC_WORK_T));
+        if (NULL == work) {
+            rt = OPRT_MALLOC_FAILED;
+            continue;
+        }
+        work->cb = entry->cb;
+        work->data = data;
+
+        TUYA_CALL_ERR_LOG(tal_workq_schedule(WORKQ_SYSTEM, _event_async_work_cb, work));
+        if (OPRT_OK != rt) {
+            tal_free(work);
+        }
+    }
+    _event_node_read_end(event);
+
     return rt;
 }
 
@@ -225,6 +515,8 @@ OPERATE_RET _event_node_add_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *sub
         tuya_list_add_tail(&new_entry->node, &event->subscribe_root);
     }
 
+    TUYA_CALL_ERR_LOG(_event_node_rebuild(event));
+
     return rt;
 }
 
@@ -259,6 +551,8 @@ OPERATE_RET _event_node_del_subscribe(EVENT_NODE_T *event, SUBSCRIBE_NODE_T *sub
     tuya_list_del(&new_entry->node);
     tal_free(new_entry);
     new_entry = NULL;
+
+    TUYA_CALL_ERR_LOG(_event_node_rebuild(event));
     return rt;
 }
 
@@ -337,6 +631,9 @@ OPERATE_RET tal_event_init(void)
 
     INIT_LIST_HEAD(&g_event_manager.event_root);
     INIT_LIST_HEAD(&g_event_manager.free_subscribe_root);
+    for (int i = 0; i < EVENT_HASH_BUCKET_NUM; i++) {
+        INIT_LIST_HEAD(&g_event_manager.hash_root[i]);
+    }
     tal_mutex_create_init(&g_event_manager.mutex);
     g_event_manager.event_cnt = 0;
     g_event_manager.inited = TRUE;
@@ -382,14 +679,88 @@ OPERATE_RET tal_event_publish(const char *name, void *data)
         TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
     }
 
-    // to keep the consistency, dispatch will done in mutex lock
-    tal_mutex_lock(event->mutex);
     // try to dispatch event to all subscribe
     // if one of the subscribe failed, it will continue but will return failed
     // to record the execute status
     TUYA_CALL_ERR_LOG(_event_node_dispatch(event, data));
 
-    tal_mutex_unlock(event->mutex);
+    return rt;
+}
+
+/**
+ * @brief Gets the handle of an event, creating the event if it does not exist.
+ *
+ * The handle stays valid for the whole lifetime of the event manager, so hot
+ * publishers can resolve the name once and publish by handle afterwards.
+ *
+ * @param[in] name The name of the event.
+ * @param[out] handle The event handle.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_get_handle(const char *name, EVENT_HANDLE *handle)
+{
+    if (g_event_manager.inited != TRUE) {
+        tal_event_init();
+    }
+
+    if (!_event_name_is_valid(name)) {
+        return OPRT_BASE_EVENT_INVALID_EVENT_NAME;
+    }
+
+    TUYA_CHECK_NULL_RETURN(handle, OPRT_INVALID_PARM);
+
+    EVENT_NODE_T *event = _event_node_get(name);
+    if (!event) {
+        event = _event_node_create_init(name);
+        TUYA_CHECK_NULL_RETURN(event, OPRT_MALLOC_FAILED);
+    }
+
+    *handle = event;
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Publishes an event by handle.
+ *
+ * Same as tal_event_publish without the name lookup. Subscribers are called in
+ * the caller context, on a snapshot of the subscriber list, without holding any
+ * lock.
+ *
+ * @param[in] handle The event handle from tal_event_get_handle.
+ * @param[in] data The data associated with the event.
+ * @return The operation result. Returns OPRT_OK on success, or an error code on
+ * failure.
+ */
+OPERATE_RET tal_event_publish_handle(EVENT_HANDLE handle, void *data)
+{
+    TUYA_CHECK_NULL_RETURN(handle, OPRT_INVALID_PARM);
+
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CALL_ERR_LOG(_event_node_dispatch((EVENT_NODE_T *)handle, data));
+
+    return rt;
+}
+
+/**
+ * @brief Publishes an event by handle asynchronously.
+ *
+ * Each subscriber is scheduled as a separate work in the system workqueue, the
+ * function returns once all works are queued. The data is shared by all
+ * subscribers and must stay valid until they have all returned.
+ *
+ * @param[in] handle The event handle from tal_event_get_handle.
+ * @param[in] data The data associated with the event.
+ * @return The operation result. Returns OPRT_OK on success, or an error code if
+ * any work can not be queued.
+ */
+OPERATE_RET tal_event_publish_async(EVENT_HANDLE handle, void *data)
+{
+    TUYA_CHECK_NULL_RETURN(handle, OPRT_INVALID_PARM);
+
+    OPERATE_RET rt = OPRT_OK;
+    TUYA_CALL_ERR_LOG(_event_node_dispatch_async((EVENT_NODE_T *)handle, data));
 
     return rt;
 }
@@ -458,6 +829,12 @@ OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_
  * operation. If the event is found, it is removed from the subscribe list. If
  * the event is not found, the subscription is removed from the free list.
  *
+ * Publishers dispatch on a snapshot without holding the event mutex, so a
+ * publish that took the snapshot before the removal still calls the callback
+ * after this function returns, and works queued by tal_event_publish_async
+ * are delivered anyway. Waiting for the readers to leave is not an option,
+ * callbacks unsubscribe from their own dispatch.
+ *
  * @param[in] name The name of the event to unsubscribe from.
  * @param[in] desc The description of the event to unsubscribe from.
  * @param[in] cb The callback function to be unregistered.
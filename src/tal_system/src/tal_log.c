@@ -13,6 +13,9 @@
  * - Configurable log levels ranging from debug to critical errors.
  * - Support for multiple log output destinations through callback registration.
  * - Thread-safe log message output using mutexes.
+ * - Optional asynchronous mode (ENABLE_LOG_ASYNC), callers reserve a record
+ * in a ring and format the message body into it outside the lock, a
+ * background thread adds the prefix and prints it.
  * - Integration with Tuya's IoT SDK for memory management and system utilities.
  *
  * The logging system is implemented using a linked list to manage output
@@ -38,6 +41,8 @@
 #include "tal_system.h"
 #include "tal_time_service.h"
 #include "tal_memory.h"
+#include "tal_thread.h"
+#include "tal_semaphore.h"
 
 /***********************************************************
 *************************micro define***********************
@@ -51,6 +56,50 @@ typedef struct {
     TAL_LOG_OUTPUT_CB out_term;
 } LOG_OUT_NODE_S;
 
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+#ifndef LOG_ASYNC_RING_SIZE
+#define LOG_ASYNC_RING_SIZE 4096
+#endif
+#ifndef STACK_SIZE_LOG_ASYNC
+#define STACK_SIZE_LOG_ASYNC 3072
+#endif
+
+#define LOG_REC_FMT   0 // prefix and suffix added by the log thread
+#define LOG_REC_RAW   1 // printed as is
+#define LOG_REC_COLOR 2 // wrapped with the record color by the log thread
+
+#define LOG_REC_ALIGN(x)  (((x) + 7) & ~7u)
+#define LOG_REC_SIZE(len) LOG_REC_ALIGN(sizeof(LOG_REC_S) + (len))
+
+typedef struct {
+    uint16_t len;  // body length, the body follows the record
+    uint16_t size; // bytes reserved in the ring for the record and its body
+    uint8_t ready; // body formatted, the log thread may print it
+    uint8_t type;
+    uint8_t level;
+    uint8_t color[3]; // display mode, font and background color of LOG_REC_COLOR
+    uint32_t line;
+    const char *file; // base name, file names are string literals
+    SYS_TICK_T time_ms;
+} LOG_REC_S;
+
+typedef struct {
+    BOOL_T ready;
+    MUTEX_HANDLE mutex; // protects the ring only, never held while printing
+    SEM_HANDLE sem;
+    THREAD_HANDLE thread;
+    BOOL_T idle; // log thread is waiting for the semaphore
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t used;
+    uint32_t wrap; // end of the records before head wrapped, size if not wrapped
+    uint32_t drop_num;
+    char *line_buf; // the line printed by the log thread
+    char *ring;
+} LOG_ASYNC_S;
+#endif
+
 typedef struct {
     TAL_LOG_DISPLAY_MODE_E display_mode;
     TAL_LOG_FONT_COLOR_E font_color;
@@ -73,6 +122,10 @@ typedef struct {
     int log_buf_len;
     BOOL_T ms_level;
     char *log_buf;
+
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    LOG_ASYNC_S async;
+#endif
 } LOG_MANAGE, *P_LOG_MANAGE;
 
 #define DEF_OUTPUT_NAME "def_output"
@@ -83,6 +136,10 @@ typedef struct {
 const char *sLevelStr[] = {"E", "W", "N", "I", "D", "T"};
 P_LOG_MANAGE pLogManage = NULL;
 
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+static OPERATE_RET __log_async_init(void);
+#endif
+
 const LOG_TEXT_STYLE_S sDefaultStyle[LOG_LEVEL_MAX + 1] = {
     {TAL_LOG_DISPLAY_MODE_DEFAULT, TAL_LOG_FONT_COLOR_RED, TAL_LOG_BACKGROUND_COLOR_DEFAULT},
     {TAL_LOG_DISPLAY_MODE_DEFAULT, TAL_LOG_FONT_COLOR_YELLOW, TAL_LOG_BACKGROUND_COLOR_DEFAULT},
@@ -134,6 +191,9 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
         INIT_LIST_HEAD(&(tmp_log_mng->log_list));
         tmp_log_mng->curLogLevel = level;
         tmp_log_mng->ms_level = FALSE;
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+        memset(&tmp_log_mng->async, 0, sizeof(LOG_ASYNC_S));
+#endif
         pLogManage = tmp_log_mng;
 
         // set default log style
@@ -146,6 +206,11 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
             tal_free(tmp_log_mng);
             return op_ret;
         }
+
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+        // logs are printed synchronously if the log thread is not available
+        __log_async_init();
+#endif
     } else {
         pLogManage->curLogLevel = level;
     }
@@ -153,7 +218,7 @@ OPERATE_RET tal_log_init(const TAL_LOG_LEVEL_E level, const int buf_len, const T
     return OPRT_OK;
 }
 
-void __output_logManage_buf(void)
+static void __output_log_buf(const char *buf)
 {
     P_LIST_HEAD pPos;
     LOG_OUT_NODE_S *output_node;
@@ -161,10 +226,354 @@ void __output_logManage_buf(void)
     {
         output_node = tuya_list_entry(pPos, LOG_OUT_NODE_S, node);
         if (output_node->out_term) {
-            output_node->out_term(pLogManage->log_buf);
+            output_node->out_term(buf);
+        }
+    }
+}
+
+void __output_logManage_buf(void)
+{
+    __output_log_buf(pLogManage->log_buf);
+}
+
+static int __log_format_prefix(char *buf, int size, LOG_LEVEL level, const char *filename, uint32_t line,
+                               SYS_TICK_T time_ms)
+{
+    const char *pTmpModuleName = "ty";
+    int len = 0;
+    int cnt = 0;
+
+    // color prefix
+    if (pLogManage->log_color.enable_color) {
+        cnt = snprintf(buf, size, "\033[%d;%d;%dm", pLogManage->log_color.style[level].display_mode,
+                       pLogManage->log_color.style[level].font_color,
+                       pLogManage->log_color.style[level].background_color);
+        if (cnt <= 0) {
+            return -1;
+        }
+        len += cnt;
+    }
+
+    POSIX_TM_S tm;
+    memset(&tm, 0, sizeof(tm));
+
+    // time_ms 0 means now
+    if (pLogManage->ms_level == FALSE) {
+        tal_time_get_local_time_custom((TIME_T)(time_ms / 1000), &tm);
+        cnt = snprintf(buf + len, size - len, "[%02d-%02d %02d:%02d:%02d %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1,
+                       tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[level], filename, line);
+    } else {
+        if (0 == time_ms) {
+            time_ms = tal_time_get_posix_ms();
+        }
+        TIME_T sec = (TIME_T)(time_ms / 1000);
+        uint32_t ms = (uint32_t)(time_ms % 1000);
+        tal_time_get_local_time_custom(sec, &tm);
+        cnt = snprintf(buf + len, size - len, "[%02d-%02d %02d:%02d:%02d:%" PRIu32 " %s %s][%s:%" PRIu32 "] ",
+                       tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName,
+                       sLevelStr[level], filename, line);
+    }
+    if (cnt <= 0) {
+        return -1;
+    }
+
+    return len + cnt;
+}
+
+static int __log_format_suffix(char *buf, int size, int len)
+{
+    int cnt = 0;
+
+    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
+    if (len > (int)(size - strlen(p_suffix) - 1)) { // 1 -> "\0"
+        len = size - strlen(p_suffix) - 1;
+    }
+    cnt = snprintf(buf + len, size - len, "%s", p_suffix);
+    if (cnt <= 0) {
+        return -1;
+    }
+    len += cnt;
+    buf[len] = '\0';
+
+    return len;
+}
+
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+/**
+ * @brief format a log body into the ring, the prefix is added by the log
+ * thread. The ring mutex is only held to reserve the record and to commit it,
+ * the body is formatted into the reserved record without it.
+ *
+ * @param[in] type: record type, LOG_REC_XXX
+ * @param[in] level: log level
+ * @param[in] file: base name of the source file, must be a string literal
+ * @param[in] line: source line
+ * @param[in] color: display mode, font and background color of LOG_REC_COLOR
+ * @param[in] pFmt: format string
+ * @param[in] ap: format arguments
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+static OPERATE_RET __log_async_vpush(uint8_t type, LOG_LEVEL level, const char *file, uint32_t line,
+                                     const uint8_t *color, const char *pFmt, va_list ap)
+{
+    LOG_ASYNC_S *async = &pLogManage->async;
+    uint32_t max_len = pLogManage->log_buf_len + 1;
+    SYS_TICK_T time_ms = tal_time_get_posix_ms();
+    LOG_REC_S *rec = NULL;
+    uint32_t room = 0;
+    uint32_t avail = 0;
+    uint32_t size = 0;
+    int cnt = 0;
+    OPERATE_RET rt = OPRT_OK;
+
+    tal_mutex_lock(async->mutex);
+    if (0 == async->used) {
+        async->head = 0;
+        async->tail = 0;
+        async->wrap = async->size;
+    }
+
+    // contiguous room at head, wrap if the start of the ring has more
+    if (async->used == async->size) {
+        room = 0;
+    } else if (async->head >= async->tail) {
+        room = async->size - async->head;
+        if (room < sizeof(LOG_REC_S) + max_len && async->tail > room) {
+            async->wrap = async->head;
+            async->used += room;
+            async->head = 0;
+            room = async->tail;
+        }
+    } else {
+        room = async->tail - async->head;
+    }
+    if (room <= sizeof(LOG_REC_S)) {
+        goto __DROP;
+    }
+
+    rec = (LOG_REC_S *)(async->ring + async->head);
+    avail = room - sizeof(LOG_REC_S);
+    if (avail > max_len) {
+        avail = max_len;
+    }
+    // reserve for the longest body, the record is shrunk on commit if it is still the last one
+    size = LOG_REC_SIZE(avail);
+    rec->size = size;
+    rec->ready = FALSE;
+    async->head += size;
+    async->used += size;
+    tal_mutex_unlock(async->mutex);
+
+    cnt = vsnprintf((char *)(rec + 1), avail, pFmt, ap);
+    if (cnt < 0) {
+        rt = OPRT_BASE_LOG_MNG_FORMAT_STRING_FAILED;
+    } else if (cnt >= (int)avail) {
+        // longer than a log line is truncated as the sync mode does
+        if (avail < max_len) {
+            rt = OPRT_BUFFER_NOT_ENOUGH;
+        }
+        cnt = avail - 1;
+    }
+    if (OPRT_OK != rt) {
+        // an empty record keeps the slot, the log thread skips it
+        cnt = 0;
+        type = LOG_REC_RAW;
+    }
+
+    rec->len = cnt;
+    rec->type = type;
+    rec->level = level;
+    if (color) {
+        memcpy(rec->color, color, sizeof(rec->color));
+    }
+    rec->line = line;
+    rec->file = file;
+    rec->time_ms = time_ms;
+
+    tal_mutex_lock(async->mutex);
+    if ((char *)rec + size == async->ring + async->head) {
+        async->head -= size - LOG_REC_SIZE(rec->len);
+        async->used -= size - LOG_REC_SIZE(rec->len);
+        rec->size = LOG_REC_SIZE(rec->len);
+    }
+    rec->ready = TRUE;
+    if (OPRT_BUFFER_NOT_ENOUGH == rt) {
+        async->drop_num++;
+    }
+    if (async->idle) {
+        async->idle = FALSE;
+        tal_semaphore_post(async->sem);
+    }
+    tal_mutex_unlock(async->mutex);
+
+    return rt;
+
+__DROP:
+    async->drop_num++;
+    tal_mutex_unlock(async->mutex);
+    return OPRT_BUFFER_NOT_ENOUGH;
+}
+
+static int __log_async_format(const LOG_REC_S *rec, char *buf)
+{
+    const char *body = (const char *)(rec + 1);
+    int size = pLogManage->log_buf_len;
+    int len = 0;
+    int cnt = 0;
+
+    if (LOG_REC_FMT == rec->type) {
+        len = __log_format_prefix(buf, size, rec->level, rec->file, rec->line, rec->time_ms);
+        if (len <= 0) {
+            return -1;
         }
+    } else if (LOG_REC_COLOR == rec->type && pLogManage->log_color.enable_color) {
+        len = snprintf(buf, size, "\033[%d;%d;%dm", rec->color[0], rec->color[1], rec->color[2]);
+        if (len <= 0) {
+            return -1;
+        }
+    }
+
+    cnt = (rec->len < size - 1 - len) ? rec->len : size - 1 - len;
+    if (cnt > 0) {
+        memcpy(buf + len, body, cnt);
+        len += cnt;
+    }
+
+    if (LOG_REC_FMT == rec->type) {
+        return __log_format_suffix(buf, size, len);
+    } else if (LOG_REC_COLOR == rec->type && pLogManage->log_color.enable_color) {
+        if (len > size - 4 - 1) { // 4 -> "\033[0m" 1 -> "\0"
+            len = size - 4 - 1;
+        }
+        len += snprintf(buf + len, size - len, "\033[0m");
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+/**
+ * @brief print the oldest record in the ring
+ *
+ * @return TRUE if a record was consumed, FALSE if the ring is empty
+ */
+static BOOL_T __log_async_drain(void)
+{
+    LOG_ASYNC_S *async = &pLogManage->async;
+    LOG_REC_S *rec = NULL;
+
+    tal_mutex_lock(async->mutex);
+    if (async->used && async->tail == async->wrap) {
+        async->used -= async->size - async->tail;
+        async->tail = 0;
+        async->wrap = async->size;
+    }
+    rec = (LOG_REC_S *)(async->ring + async->tail);
+    if (0 == async->used || !rec->ready) {
+        // the producer of a reserved record posts once it is committed
+        async->idle = TRUE;
+        tal_mutex_unlock(async->mutex);
+        return FALSE;
+    }
+    tal_mutex_unlock(async->mutex);
+
+    // producers never write the committed records between tail and head
+    if (__log_async_format(rec, async->line_buf) > 0) {
+        tal_mutex_lock(pLogManage->mutex);
+        __output_log_buf(async->line_buf);
+        tal_mutex_unlock(pLogManage->mutex);
+    }
+
+    tal_mutex_lock(async->mutex);
+    async->tail += rec->size;
+    async->used -= rec->size;
+    tal_mutex_unlock(async->mutex);
+
+    return TRUE;
+}
+
+static void __log_async_thread(void *arg)
+{
+    LOG_ASYNC_S *async = &pLogManage->async;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(async->thread)) {
+        if (!__log_async_drain()) {
+            tal_semaphore_wait(async->sem, SEM_WAIT_FOREVER);
+        }
+    }
+}
+
+static void __log_async_free(void)
+{
+    LOG_ASYNC_S *async = &pLogManage->async;
+
+    if (async->sem) {
+        tal_semaphore_release(async->sem);
+    }
+    if (async->mutex) {
+        tal_mutex_release(async->mutex);
+    }
+    if (async->ring) {
+        tal_free(async->ring);
+    }
+    if (async->line_buf) {
+        tal_free(async->line_buf);
+    }
+    memset(async, 0, sizeof(LOG_ASYNC_S));
+}
+
+static OPERATE_RET __log_async_init(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    LOG_ASYNC_S *async = &pLogManage->async;
+    THREAD_CFG_T thread_cfg = {
+        .stackDepth = STACK_SIZE_LOG_ASYNC, .priority = THREAD_PRIO_4, .thrdname = "log_async"};
+
+    async->size = LOG_ASYNC_RING_SIZE & ~7u;
+    async->wrap = async->size;
+    async->ring = tal_malloc(async->size);
+    async->line_buf = tal_malloc(pLogManage->log_buf_len + 1);
+    if (NULL == async->ring || NULL == async->line_buf) {
+        rt = OPRT_MALLOC_FAILED;
+        goto __ERR;
+    }
+
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&async->mutex), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&async->sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_thread_create_and_start(&async->thread, NULL, NULL, __log_async_thread, NULL, &thread_cfg),
+                       __ERR);
+    async->ready = TRUE;
+
+    return OPRT_OK;
+
+__ERR:
+    __log_async_free();
+    return rt;
+}
+
+static void __log_async_deinit(void)
+{
+    LOG_ASYNC_S *async = &pLogManage->async;
+
+    if (!async->ready) {
+        return;
     }
+    async->ready = FALSE;
+
+    if (OPRT_OK == tal_thread_delete(async->thread)) {
+        tal_semaphore_post(async->sem);
+        while (THREAD_STATE_DELETE != tal_thread_get_state(async->thread)) {
+            tal_system_sleep(10);
+        }
+    }
+
+    // print what is left in the caller context
+    while (__log_async_drain()) {
+    }
+    __log_async_free();
 }
+#endif
 
 OPERATE_RET __find_out_term_node(const char *name, LOG_OUT_NODE_S **node)
 {
@@ -378,7 +787,6 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
     if (logLevel > tmpLogLevel) {
         return OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER;
     }
-    const char *pTmpModuleName = "ty";
     const char *pTmpFilename = NULL;
 
     if (NULL == pFile) {
@@ -396,57 +804,28 @@ OPERATE_RET PrintLogV(LOG_LEVEL logLevel, char *pFile, uint32_t line, const char
             pTmpFilename = pFile + pos + 1;
         }
     }
-    tal_mutex_lock(pLogManage->mutex);
 
-    // color prefix
-    if (pLogManage->log_color.enable_color) {
-        cnt = snprintf(pLogManage->log_buf, pLogManage->log_buf_len, "\033[%d;%d;%dm",
-                       pLogManage->log_color.style[logLevel].display_mode,
-                       pLogManage->log_color.style[logLevel].font_color,
-                       pLogManage->log_color.style[logLevel].background_color);
-        if (cnt <= 0) {
-            goto ERR_EXIT;
-        }
-        len += cnt;
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    if (pLogManage->async.ready) {
+        return __log_async_vpush(LOG_REC_FMT, logLevel, pTmpFilename, line, NULL, pFmt, ap);
     }
+#endif
 
-    POSIX_TM_S tm;
-    memset(&tm, 0, sizeof(tm));
+    tal_mutex_lock(pLogManage->mutex);
 
-    if (pLogManage->ms_level == FALSE) {
-        tal_time_get_local_time_custom(0, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
-                       "[%02d-%02d %02d:%02d:%02d %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
-                       tm.tm_min, tm.tm_sec, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
-    } else {
-        SYS_TICK_T time_ms = tal_time_get_posix_ms();
-        TIME_T sec = (TIME_T)(time_ms / 1000);
-        uint32_t ms = (uint32_t)(time_ms % 1000);
-        tal_time_get_local_time_custom(sec, &tm);
-        cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len,
-                       "[%02d-%02d %02d:%02d:%02d:%" PRIu32 " %s %s][%s:%" PRIu32 "] ", tm.tm_mon + 1, tm.tm_mday,
-                       tm.tm_hour, tm.tm_min, tm.tm_sec, ms, pTmpModuleName, sLevelStr[logLevel], pTmpFilename, line);
-    }
-    if (cnt <= 0) {
+    len = __log_format_prefix(pLogManage->log_buf, pLogManage->log_buf_len, logLevel, pTmpFilename, line, 0);
+    if (len <= 0) {
         goto ERR_EXIT;
     }
-    len += cnt;
     cnt = vsnprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, pFmt, ap);
     if (cnt <= 0) {
         goto ERR_EXIT;
     }
     len += cnt;
 
-    char *p_suffix = (pLogManage->log_color.enable_color) ? "\033[0m\r\n" : "\r\n";
-    if (len > (int)(pLogManage->log_buf_len - strlen(p_suffix) - 1)) { // 1 -> "\0"
-        len = pLogManage->log_buf_len - strlen(p_suffix) - 1;
-    }
-    cnt = snprintf(pLogManage->log_buf + len, pLogManage->log_buf_len - len, "%s", p_suffix);
-    if (cnt <= 0) {
+    if (__log_format_suffix(pLogManage->log_buf, pLogManage->log_buf_len, len) <= 0) {
         goto ERR_EXIT;
     }
-    len += cnt;
-    pLogManage->log_buf[len] = '\0';
 
     __output_logManage_buf();
     tal_mutex_unlock(pLogManage->mutex);
@@ -522,6 +901,15 @@ OPERATE_RET tal_log_print_raw(const char *pFmt, ...)
     OPERATE_RET opRet = 0;
     va_list ap;
 
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    if (pLogManage->async.ready) {
+        va_start(ap, pFmt);
+        opRet = __log_async_vpush(LOG_REC_RAW, 0, NULL, 0, NULL, pFmt, ap);
+        va_end(ap);
+        return opRet;
+    }
+#endif
+
     tal_mutex_lock(pLogManage->mutex);
     va_start(ap, pFmt);
     opRet = __PrintLogVRaw(pFmt, ap);
@@ -531,6 +919,23 @@ OPERATE_RET tal_log_print_raw(const char *pFmt, ...)
     return opRet;
 }
 
+/**
+ * @brief get the number of logs dropped because the async log ring was full.
+ *
+ * @note Logs are only dropped when ENABLE_LOG_ASYNC is on.
+ *
+ * @return the drop number
+ */
+uint32_t tal_log_get_drop_num(void)
+{
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    if (pLogManage) {
+        return pLogManage->async.drop_num;
+    }
+#endif
+    return 0;
+}
+
 /**
  * @brief Releases the memory allocated for the log management system.
  *
@@ -545,9 +950,13 @@ void tal_log_release(void)
         return;
     }
 
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    __log_async_deinit();
+#endif
+
     while (!tuya_list_empty(&(pLogManage->log_list))) {
         LOG_OUT_NODE_S *log_out_nd = NULL;
-        log_out_nd = tuya_list_entry(&(pLogManage->log_list.next), LOG_OUT_NODE_S, node);
+        log_out_nd = tuya_list_entry(pLogManage->log_list.next, LOG_OUT_NODE_S, node);
         tuya_list_del(&(log_out_nd->node));
         if (log_out_nd->name) {
             tal_free(log_out_nd->name);
@@ -694,6 +1103,16 @@ OPERATE_RET tal_log_color_print_raw(TAL_LOG_DISPLAY_MODE_E display_mode, TAL_LOG
         return OPRT_INVALID_PARM;
     }
 
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+    if (pLogManage->async.ready) {
+        uint8_t color[3] = {display_mode, font_color, background_color};
+        va_start(ap, pFmt);
+        opRet = __log_async_vpush(LOG_REC_COLOR, 0, NULL, 0, color, pFmt, ap);
+        va_end(ap);
+        return opRet;
+    }
+#endif
+
     tal_mutex_lock(pLogManage->mutex);
     va_start(ap, pFmt);
     if (pLogManage->log_color.enable_color) {
@@ -12,6 +12,39 @@
 #define STACK_SIZE_TIMERQ (4 * 1024)
 #endif
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+#define SW_TIMER_USE_WHEEL 1
+#else
+#define SW_TIMER_USE_WHEEL 0
+#endif
+
+#if SW_TIMER_USE_WHEEL
+#ifndef SW_TIMER_WHEEL_TICK_MS
+#define SW_TIMER_WHEEL_TICK_MS 10
+#endif
+
+// hierarchical wheel: one root wheel + TW_LEVEL_NUM cascading wheels
+#define TW_ROOT_BITS  6
+#define TW_LEVEL_BITS 6
+#ifndef TW_LEVEL_NUM
+#define TW_LEVEL_NUM 4
+#endif
+#define TW_ROOT_SIZE  (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_ROOT_MASK  (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK (TW_LEVEL_SIZE - 1)
+#define TW_MAX_TICKS  ((1ULL << (TW_ROOT_BITS + TW_LEVEL_NUM * TW_LEVEL_BITS)) - 1)
+
+typedef struct {
+    LIST_HEAD root[TW_ROOT_SIZE];
+    LIST_HEAD level[TW_LEVEL_NUM][TW_LEVEL_SIZE];
+    LIST_HEAD pending;  // triggered timers, run on the next dispatch
+    LIST_HEAD overflow; // due beyond TW_MAX_TICKS, attached again when the top wheel wraps
+    uint64_t cur_tick;  // next tick to be processed
+    BOOL_T idle;        // no running timer, cur_tick is stale
+} TIMER_WHEEL_T;
+#endif
+
 typedef struct {
     LIST_HEAD node;
 
@@ -26,7 +59,11 @@ typedef struct {
 } TIMER_T;
 
 typedef struct {
+#if SW_TIMER_USE_WHEEL
+    TIMER_WHEEL_T wheel;
+#else
     LIST_HEAD list_active;
+#endif
     LIST_HEAD list_standby;
     MUTEX_HANDLE mutex;
     uint16_t total_cnt;
@@ -40,6 +77,156 @@ typedef struct {
 
 static SW_TIMER_MGR_T s_timer_mgr;
 
+#if SW_TIMER_USE_WHEEL
+static uint64_t __timer_get_ms(void)
+{
+    TIME_S secTime = 0;
+    TIME_MS msTime = 0;
+
+    tal_time_get_system_time(&secTime, &msTime);
+
+    return (uint64_t)secTime * 1000 + (uint64_t)msTime;
+}
+
+static void __timer_attach(TIMER_T *timer)
+{
+    TIMER_WHEEL_T *wheel = &(s_timer_mgr.wheel);
+    uint64_t expire_tick = (timer->expire_time + SW_TIMER_WHEEL_TICK_MS - 1) / SW_TIMER_WHEEL_TICK_MS;
+    uint64_t delta = 0;
+    uint32_t level = 0;
+    uint32_t shift = 0;
+
+    tuya_list_del(&(timer->node));
+
+    if (wheel->idle) {
+        wheel->cur_tick = __timer_get_ms() / SW_TIMER_WHEEL_TICK_MS;
+        wheel->idle = FALSE;
+    }
+
+    if (expire_tick < wheel->cur_tick) {
+        expire_tick = wheel->cur_tick;
+    }
+
+    delta = expire_tick - wheel->cur_tick;
+    if (delta > TW_MAX_TICKS) {
+        // a wrap of the top wheel is at most TW_MAX_TICKS + 1 ticks away, the delta left is still positive
+        tuya_list_add_tail(&(timer->node), &(wheel->overflow));
+        return;
+    }
+
+    if (delta < TW_ROOT_SIZE) {
+        tuya_list_add_tail(&(timer->node), &(wheel->root[expire_tick & TW_ROOT_MASK]));
+        return;
+    }
+
+    for (level = 0; level < TW_LEVEL_NUM - 1; level++) {
+        if (delta < (1ULL << (TW_ROOT_BITS + (level + 1) * TW_LEVEL_BITS))) {
+            break;
+        }
+    }
+
+    shift = TW_ROOT_BITS + level * TW_LEVEL_BITS;
+    tuya_list_add_tail(&(timer->node), &(wheel->level[level][(expire_tick >> shift) & TW_LEVEL_MASK]));
+}
+
+static void __timer_list_move_tail(LIST_HEAD *from, LIST_HEAD *to)
+{
+    tuya_list_splice(from, to->prev);
+    INIT_LIST_HEAD(from);
+}
+
+static uint32_t __timer_wheel_cascade(uint32_t level)
+{
+    TIMER_WHEEL_T *wheel = &(s_timer_mgr.wheel);
+    uint32_t index = (wheel->cur_tick >> (TW_ROOT_BITS + level * TW_LEVEL_BITS)) & TW_LEVEL_MASK;
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    LIST_HEAD list;
+
+    INIT_LIST_HEAD(&list);
+    __timer_list_move_tail(&(wheel->level[level][index]), &list);
+
+    tuya_list_for_each_safe(p, n, &list)
+    {
+        __timer_attach(tuya_list_entry(p, TIMER_T, node));
+    }
+
+    return index;
+}
+
+// the top wheel wrapped, the overflowed timers in range now go to the wheels
+static void __timer_wheel_overflow_attach(void)
+{
+    TIMER_WHEEL_T *wheel = &(s_timer_mgr.wheel);
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    LIST_HEAD list;
+
+    INIT_LIST_HEAD(&list);
+    __timer_list_move_tail(&(wheel->overflow), &list);
+
+    tuya_list_for_each_safe(p, n, &list)
+    {
+        __timer_attach(tuya_list_entry(p, TIMER_T, node));
+    }
+}
+
+// move every timer due up to now_tick into expired, must be called with mutex held
+static void __timer_wheel_collect(uint64_t now_tick, LIST_HEAD *expired)
+{
+    TIMER_WHEEL_T *wheel = &(s_timer_mgr.wheel);
+    uint32_t index = 0;
+    uint32_t level = 0;
+
+    __timer_list_move_tail(&(wheel->pending), expired);
+
+    if (wheel->idle) {
+        return;
+    }
+
+    while (wheel->cur_tick <= now_tick) {
+        index = wheel->cur_tick & TW_ROOT_MASK;
+        if (0 == index) {
+            level = 0;
+            while ((level < TW_LEVEL_NUM) && (0 == __timer_wheel_cascade(level))) {
+                level++;
+            }
+            if (TW_LEVEL_NUM == level) {
+                __timer_wheel_overflow_attach();
+            }
+        }
+
+        __timer_list_move_tail(&(wheel->root[index]), expired);
+        wheel->cur_tick++;
+    }
+}
+
+// time to the next non-empty root slot or cascade point, must be called with mutex held
+static SYS_TIME_T __timer_wheel_next_expired(uint64_t nowMS)
+{
+    TIMER_WHEEL_T *wheel = &(s_timer_mgr.wheel);
+    uint64_t tick = wheel->cur_tick;
+    uint64_t deadline = 0;
+
+    if (0 == s_timer_mgr.running_cnt) {
+        wheel->idle = TRUE;
+        return SEM_WAIT_FOREVER;
+    }
+
+    if (!tuya_list_empty(&(wheel->pending))) {
+        return 0;
+    }
+
+    // the levels cascade at every root wrap, the scan stops there even when it starts there
+    while ((tick & TW_ROOT_MASK) && tuya_list_empty(&(wheel->root[tick & TW_ROOT_MASK]))) {
+        tick++;
+    }
+
+    deadline = tick * SW_TIMER_WHEEL_TICK_MS;
+
+    return (deadline > nowMS) ? (SYS_TIME_T)(deadline - nowMS) : 0;
+}
+#else
 static void __timer_attach(TIMER_T *timer)
 {
     tuya_list_del(&(timer->node));
@@ -64,14 +251,31 @@ static void __timer_attach(TIMER_T *timer)
         }
     }
 }
+#endif
 
-static void __timer_dump(void)
+static void __timer_dump_list(LIST_HEAD *list)
 {
     struct tuya_list_head *p = NULL;
     TIMER_T *timer = NULL;
     TAL_TIMER_CB *cb = NULL;
     TIMER_ID *timer_id = NULL;
 
+    tuya_list_for_each(p, list)
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
+        cb = &(timer->cb);
+        if (timer->data) {
+            timer_id = timer->data;
+            if (*timer_id == timer->timer_id) {
+                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+            }
+        }
+        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+    }
+}
+
+static void __timer_dump(void)
+{
     TIME_S nowSecTime = 0;
     TIME_MS nowMsTime = 0;
 
@@ -86,36 +290,83 @@ static void __timer_dump(void)
     tal_mutex_lock(s_timer_mgr.mutex);
 
     PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_active))
-    {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
+#if SW_TIMER_USE_WHEEL
+    uint32_t i = 0, j = 0;
+    PR_NOTICE("timer wheel tick:%d ms, cur_tick:%llu", SW_TIMER_WHEEL_TICK_MS, s_timer_mgr.wheel.cur_tick);
+    __timer_dump_list(&(s_timer_mgr.wheel.pending));
+    __timer_dump_list(&(s_timer_mgr.wheel.overflow));
+    for (i = 0; i < TW_ROOT_SIZE; i++) {
+        __timer_dump_list(&(s_timer_mgr.wheel.root[i]));
+    }
+    for (i = 0; i < TW_LEVEL_NUM; i++) {
+        for (j = 0; j < TW_LEVEL_SIZE; j++) {
+            __timer_dump_list(&(s_timer_mgr.wheel.level[i][j]));
         }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
+#else
+    __timer_dump_list(&(s_timer_mgr.list_active));
+#endif
 
     PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
-    tuya_list_for_each(p, &(s_timer_mgr.list_standby))
-    {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
-        }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
-    }
+    __timer_dump_list(&(s_timer_mgr.list_standby));
 
     tal_mutex_unlock(s_timer_mgr.mutex);
 }
 
+#if SW_TIMER_USE_WHEEL
+static void __timer_dispatch(SYS_TIME_T *next_expired)
+{
+    uint64_t nowMS = 0;
+    TIMER_T *timer = NULL;
+    TIMER_ID timer_id = NULL;
+    void *data = NULL;
+    TAL_TIMER_CB timer_cb = NULL;
+    LIST_HEAD expired;
+
+    INIT_LIST_HEAD(&expired);
+
+    do {
+        nowMS = __timer_get_ms();
+
+        // collect the whole batch due at this tick once, then run it
+        tal_mutex_lock(s_timer_mgr.mutex);
+        __timer_wheel_collect(nowMS / SW_TIMER_WHEEL_TICK_MS, &expired);
+        tal_mutex_unlock(s_timer_mgr.mutex);
+
+        while (1) {
+            tal_mutex_lock(s_timer_mgr.mutex);
+
+            // timers stopped or deleted by a previous callback already left the batch
+            if (tuya_list_empty(&expired)) {
+                *next_expired = __timer_wheel_next_expired(__timer_get_ms());
+                tal_mutex_unlock(s_timer_mgr.mutex);
+                break;
+            }
+
+            timer = tuya_list_entry(expired.next, TIMER_T, node);
+            timer_cb = timer->cb;
+            timer_id = timer->timer_id;
+            data = timer->data;
+
+            if (TAL_TIMER_ONCE == timer->type) {
+                timer->is_running = FALSE;
+                s_timer_mgr.running_cnt--;
+                tuya_list_del(&(timer->node));
+                tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+            } else {
+                timer->expire_time = nowMS + timer->interval;
+                __timer_attach(timer);
+            }
+
+            tal_mutex_unlock(s_timer_mgr.mutex);
+
+            s_timer_mgr.last_cb = timer_cb;
+            timer_cb(timer_id, data);
+            s_timer_mgr.last_cb = NULL;
+        }
+    } while (0 == *next_expired);
+}
+#else
 static void __timer_dispatch(SYS_TIME_T *next_expired)
 {
     TIME_S nowSecTime = 0;
@@ -168,6 +419,7 @@ static void __timer_dispatch(SYS_TIME_T *next_expired)
         }
     } while (p != &(s_timer_mgr.list_active));
 }
+#endif
 
 static void __timer_thread_cb(void *data)
 {
@@ -201,7 +453,22 @@ OPERATE_RET tal_sw_timer_init(void)
     tal_mutex_create_init(&s_timer_mgr.mutex);
     tal_semaphore_create_init(&s_timer_mgr.sem, 0, 2);
 
+#if SW_TIMER_USE_WHEEL
+    uint32_t i = 0, j = 0;
+    for (i = 0; i < TW_ROOT_SIZE; i++) {
+        INIT_LIST_HEAD(&(s_timer_mgr.wheel.root[i]));
+    }
+    for (i = 0; i < TW_LEVEL_NUM; i++) {
+        for (j = 0; j < TW_LEVEL_SIZE; j++) {
+            INIT_LIST_HEAD(&(s_timer_mgr.wheel.level[i][j]));
+        }
+    }
+    INIT_LIST_HEAD(&(s_timer_mgr.wheel.pending));
+    INIT_LIST_HEAD(&(s_timer_mgr.wheel.overflow));
+    s_timer_mgr.wheel.idle = TRUE;
+#else
     INIT_LIST_HEAD(&(s_timer_mgr.list_active));
+#endif
     INIT_LIST_HEAD(&(s_timer_mgr.list_standby));
 
     THREAD_CFG_T thread_cfg = {.stackDepth = STACK_SIZE_TIMERQ, .priority = THREAD_PRIO_0, .thrdname = "sys_timer"};
@@ -443,7 +710,11 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     timer->expire_time = 0;
     if (timer->is_running) {
         tuya_list_del(&(timer->node));
+#if SW_TIMER_USE_WHEEL
+        tuya_list_add_tail(&(timer->node), &(s_timer_mgr.wheel.pending));
+#else
         tuya_list_add(&(timer->node), &(s_timer_mgr.list_active));
+#endif
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
@@ -104,6 +104,27 @@ void *tal_realloc(void *ptr, size_t size)
 {
     return tkl_system_realloc(ptr, size);
 }
+
+/**
+ * @brief Enters a critical section.
+ *
+ * @return The irq mask to pass to tal_system_exit_critical.
+ */
+uint32_t tal_system_enter_critical(void)
+{
+    return tkl_system_enter_critical();
+}
+
+/**
+ * @brief Exits a critical section.
+ *
+ * @param irq_mask The irq mask returned by tal_system_enter_critical.
+ */
+void tal_system_exit_critical(uint32_t irq_mask)
+{
+    tkl_system_exit_critical(irq_mask);
+}
+
 /**
  * @brief Sleeps for the specified amount of time in milliseconds.
  *
@@ -49,6 +49,10 @@
 #define STACK_SIZE_MSG_QUEUE (4 * 1024)
 #endif
 
+#ifndef WORK_QUEUE_WORKER_NUM
+#define WORK_QUEUE_WORKER_NUM 1
+#endif
+
 static WORKQUEUE_HANDLE wq_system;
 static WORKQUEUE_HANDLE wq_highpri;
 
@@ -73,7 +77,8 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.stackDepth += 1024;
 #endif
     thread_cfg.thrdname = "wq_system";
-    TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_WORK_QUEUE, &thread_cfg, &wq_system), ERR_EXIT);
+    TUYA_CALL_ERR_GOTO(tal_workqueue_create_pool(MAX_NODE_NUM_WORK_QUEUE, WORK_QUEUE_WORKER_NUM, &thread_cfg, &wq_system),
+                       ERR_EXIT);
 
     thread_cfg.priority = THREAD_PRIO_1;
     thread_cfg.stackDepth = STACK_SIZE_MSG_QUEUE;
@@ -151,6 +156,22 @@ OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb,
     return tal_workqueue_schedule_instant(tal_workq_get_handle(service), cb, data);
 }
 
+/**
+ * @brief put work task in workqueue, works with the same key run in order
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the ordering key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_keyed(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    return tal_workqueue_schedule_keyed(tal_workq_get_handle(service), key, cb, data);
+}
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -189,8 +210,18 @@ static BOOL_T _dump_cb(WORK_ITEM_T *item, void *ctx)
 
 void tal_workq_dump(WORKQ_SERVICE_E service)
 {
+    WORKQUEUE_HANDLE handle = tal_workq_get_handle(service);
+    WORKQUEUE_STAT_T stat;
+    uint8_t i = 0;
+
     PR_NOTICE("---------workq-%d dump begin---------", service);
-    tal_workqueue_traverse(tal_workq_get_handle(service), _dump_cb, NULL);
+    tal_workqueue_traverse(handle, _dump_cb, NULL);
+    for (i = 0; i < tal_workqueue_get_worker_num(handle); i++) {
+        if (OPRT_OK == tal_workqueue_get_stat(handle, i, &stat)) {
+            PR_NOTICE("worker-%d depth:%d/%d done:%d stolen:%d latency avg:%d max:%d ms", i, stat.depth, stat.max_depth,
+                      stat.done, stat.stolen, stat.avg_latency, stat.max_latency);
+        }
+    }
     tal_thread_diagnose(tal_workqueue_get_thread(tal_workq_get_handle(service)));
     PR_NOTICE("---------workq-%d dump end---------", service);
 }
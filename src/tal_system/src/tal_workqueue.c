@@ -11,9 +11,10 @@
  * responsive and scalable Tuya IoT applications.
  *
  * Key components include:
- * - Definition of the work queue structure with queue, thread, and semaphore
- * handles.
- * - Implementation of the work queue thread callback for task execution.
+ * - Definition of the work queue structure with one or more workers, each
+ * owning a queue, thread, and semaphore.
+ * - Implementation of the work queue thread callback for task execution, with
+ * work stealing between workers of a pool.
  * - Synchronization mechanisms to ensure thread-safe operation and task
  * execution.
  *
@@ -31,8 +32,10 @@
  *
  */
 
-#include "tuya_queue.h"
+#include <stdio.h>
+#include "tuya_list.h"
 #include "tal_log.h"
+#include "tal_mutex.h"
 #include "tal_memory.h"
 #include "tal_thread.h"
 #include "tal_system.h"
@@ -40,44 +43,236 @@
 #include "tal_workqueue.h"
 #include "tal_sw_timer.h"
 
+#define WORKER_NUM_MAX 8
+
+typedef struct {
+    LIST_HEAD node;
+    WORK_ITEM_T item;
+    BOOL_T pinned;         // keyed work, never stolen so per-key order is kept
+    SYS_TIME_T enqueue_ms; // used for latency statistics
+} WORK_NODE_T;
+
+typedef struct __tal_workqueue TAL_WORKQUEUE_T;
+
 typedef struct {
-    TUYA_QUEUE_HANDLE queue;
+    TAL_WORKQUEUE_T *workqueue;
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
+    MUTEX_HANDLE mutex;
+    LIST_HEAD deque;
+    uint16_t count;
+    uint8_t index;
+    BOOL_T idle; // protected by mutex, set only while the deque is empty
+    char name[16];
+
+    uint64_t total_latency;
+    WORKQUEUE_STAT_T stat;
     WORKQUEUE_CB last_cb; // used to debug which cb is blocked
-} TAL_WORKQUEUE_T;
+} TAL_WORKER_T;
+
+struct __tal_workqueue {
+    MUTEX_HANDLE mutex; // protects rr
+    uint16_t queue_len; // per worker
+    uint8_t worker_num;
+    uint8_t rr;
+    TAL_WORKER_T worker[];
+};
+
+static BOOL_T __worker_pop(TAL_WORKER_T *worker, WORK_NODE_T **node)
+{
+    if (0 == worker->count) {
+        return FALSE;
+    }
+
+    tal_mutex_lock(worker->mutex);
+    if (worker->count) {
+        *node = tuya_list_entry(worker->deque.next, WORK_NODE_T, node);
+        tuya_list_del(&((*node)->node));
+        worker->count--;
+        worker->stat.depth = worker->count;
+    } else {
+        *node = NULL;
+    }
+    tal_mutex_unlock(worker->mutex);
+
+    return (NULL != *node);
+}
+
+static BOOL_T __worker_steal(TAL_WORKER_T *thief, WORK_NODE_T **node)
+{
+    TAL_WORKQUEUE_T *workqueue = thief->workqueue;
+    TAL_WORKER_T *victim = NULL;
+    WORK_NODE_T *tmp = NULL;
+    uint8_t i = 0;
+
+    *node = NULL;
+
+    for (i = 1; (i < workqueue->worker_num) && (NULL == *node); i++) {
+        victim = &workqueue->worker[(thief->index + i) % workqueue->worker_num];
+        if (0 == victim->count) {
+            continue;
+        }
+
+        tal_mutex_lock(victim->mutex);
+        if (victim->count) {
+            // oldest item first, fall back to the newest one if the head is keyed
+            tmp = tuya_list_entry(victim->deque.next, WORK_NODE_T, node);
+            if (tmp->pinned) {
+                tmp = tuya_list_entry(victim->deque.prev, WORK_NODE_T, node);
+            }
+            if (!tmp->pinned) {
+                tuya_list_del(&(tmp->node));
+                victim->count--;
+                victim->stat.depth = victim->count;
+                *node = tmp;
+            }
+        }
+        tal_mutex_unlock(victim->mutex);
+    }
+
+    if (*node) {
+        thief->stat.stolen++;
+    }
+
+    return (NULL != *node);
+}
+
+static void __worker_exec(TAL_WORKER_T *worker, WORK_NODE_T *node)
+{
+    WORK_ITEM_T work_item = node->item;
+    uint32_t latency = (uint32_t)(tal_system_get_millisecond() - node->enqueue_ms);
+
+    tal_free(node);
+
+    // cancelled items stay queued with a NULL callback
+    if (NULL == work_item.cb) {
+        return;
+    }
+
+    worker->stat.done++;
+    worker->total_latency += latency;
+    worker->stat.avg_latency = (uint32_t)(worker->total_latency / worker->stat.done);
+    if (latency > worker->stat.max_latency) {
+        worker->stat.max_latency = latency;
+    }
+
+    worker->last_cb = work_item.cb;
+    work_item.cb(work_item.data);
+    worker->last_cb = NULL;
+}
 
 static void __work_thread_cb(void *data)
 {
     OPERATE_RET op_ret = OPRT_OK;
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)data;
-    WORK_ITEM_T work_item = {0};
+    TAL_WORKER_T *worker = (TAL_WORKER_T *)data;
+    WORK_NODE_T *node = NULL;
 
-    while (THREAD_STATE_RUNNING == tal_thread_get_state(workqueue->thread)) {
-        op_ret = tal_semaphore_wait(workqueue->sem, SEM_WAIT_FOREVER);
-        if (OPRT_OK != op_ret) {
-            tal_system_sleep(10);
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(worker->thread)) {
+        if (__worker_pop(worker, &node) || __worker_steal(worker, &node)) {
+            __worker_exec(worker, node);
+            continue;
+        }
+
+        // the sem is only a wakeup, re-check under the lock so an enqueue can't slip in unseen
+        tal_mutex_lock(worker->mutex);
+        worker->idle = (0 == worker->count);
+        tal_mutex_unlock(worker->mutex);
+        if (!worker->idle) {
             continue;
         }
 
-        op_ret = tuya_queue_output(workqueue->queue, &work_item);
+        op_ret = tal_semaphore_wait(worker->sem, SEM_WAIT_FOREVER);
         if (OPRT_OK != op_ret) {
             tal_system_sleep(10);
-            continue;
         }
+    }
+}
+
+static TAL_WORKER_T *__worker_select(TAL_WORKQUEUE_T *workqueue)
+{
+    TAL_WORKER_T *worker = NULL;
+    BOOL_T idle = FALSE;
+    uint8_t i = 0;
 
-        if (work_item.cb) {
-            workqueue->last_cb = work_item.cb;
-            work_item.cb(work_item.data);
-            workqueue->last_cb = NULL;
+    if (1 == workqueue->worker_num) {
+        return &workqueue->worker[0];
+    }
+
+    tal_mutex_lock(workqueue->mutex);
+
+    // prefer a sleeping worker, otherwise spread round robin and let idle ones steal
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[(workqueue->rr + i) % workqueue->worker_num];
+        tal_mutex_lock(worker->mutex);
+        idle = worker->idle;
+        tal_mutex_unlock(worker->mutex);
+        if (idle) {
+            workqueue->rr = (worker->index + 1) % workqueue->worker_num;
+            tal_mutex_unlock(workqueue->mutex);
+            return worker;
         }
     }
+
+    worker = &workqueue->worker[workqueue->rr];
+    workqueue->rr = (workqueue->rr + 1) % workqueue->worker_num;
+
+    tal_mutex_unlock(workqueue->mutex);
+
+    return worker;
+}
+
+static OPERATE_RET __work_enqueue(TAL_WORKQUEUE_T *workqueue, TAL_WORKER_T *worker, WORKQUEUE_CB cb, void *data,
+                                  BOOL_T instant, BOOL_T pinned)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    BOOL_T wakeup = FALSE;
+
+    WORK_NODE_T *node = (WORK_NODE_T *)tal_malloc(sizeof(WORK_NODE_T));
+    if (NULL == node) {
+        return OPRT_MALLOC_FAILED;
+    }
+
+    node->item.cb = cb;
+    node->item.data = data;
+    node->pinned = pinned;
+    node->enqueue_ms = tal_system_get_millisecond();
+
+    tal_mutex_lock(worker->mutex);
+    if (worker->count < workqueue->queue_len) {
+        if (instant) {
+            tuya_list_add(&(node->node), &(worker->deque));
+        } else {
+            tuya_list_add_tail(&(node->node), &(worker->deque));
+        }
+        worker->count++;
+        worker->stat.depth = worker->count;
+        if (worker->count > worker->stat.max_depth) {
+            worker->stat.max_depth = worker->count;
+        }
+        // only a sleeping worker needs the post, a busy one finds the node on its next pop
+        wakeup = worker->idle;
+        worker->idle = FALSE;
+    } else {
+        op_ret = OPRT_EXCEED_UPPER_LIMIT;
+    }
+    tal_mutex_unlock(worker->mutex);
+
+    if (OPRT_OK != op_ret) {
+        tal_free(node);
+        return op_ret;
+    }
+
+    // the node is queued and will run, a failed post must not be reported as a failed schedule
+    if (wakeup) {
+        tal_semaphore_post(worker->sem);
+    }
+
+    return OPRT_OK;
 }
 
-static BOOL_T __work_cancel_traverse(void *item, void *ctx)
+static BOOL_T __work_cancel_traverse(WORK_ITEM_T *src, void *ctx)
 {
     BOOL_T is_same = FALSE;
-    WORK_ITEM_T *src = (WORK_ITEM_T *)item;
     WORK_ITEM_T *dst = (WORK_ITEM_T *)ctx;
 
     if (src && dst) {
@@ -97,6 +292,65 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
     return TRUE;
 }
 
+static OPERATE_RET __workqueue_stop(TAL_WORKQUEUE_T *workqueue, uint8_t worker_num)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    uint32_t count = 1;
+    TAL_WORKER_T *worker = NULL;
+    uint8_t i = 0;
+
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        op_ret = tal_thread_delete(worker->thread);
+        if (OPRT_OK != op_ret) {
+            return op_ret;
+        }
+
+        tal_semaphore_post(worker->sem);
+    }
+
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        while (THREAD_STATE_DELETE != tal_thread_get_state(worker->thread)) {
+            tal_system_sleep(10);
+            if ((count++) % 500 == 0) {
+                PR_NOTICE("%p still running", worker->thread);
+            }
+        }
+    }
+
+    return OPRT_OK;
+}
+
+static void __workqueue_free(TAL_WORKQUEUE_T *workqueue)
+{
+    TAL_WORKER_T *worker = NULL;
+    struct tuya_list_head *p = NULL;
+    struct tuya_list_head *n = NULL;
+    uint8_t i = 0;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        tuya_list_for_each_safe(p, n, &(worker->deque))
+        {
+            tuya_list_del(p);
+            tal_free(tuya_list_entry(p, WORK_NODE_T, node));
+        }
+        if (worker->sem) {
+            tal_semaphore_release(worker->sem);
+        }
+        if (worker->mutex) {
+            tal_mutex_release(worker->mutex);
+        }
+    }
+
+    if (workqueue->mutex) {
+        tal_mutex_release(workqueue->mutex);
+    }
+
+    tal_free(workqueue);
+}
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -109,42 +363,87 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
  * tuya_error_code.h
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle)
+{
+    return tal_workqueue_create_pool(queue_len, 1, thread_cfg, handle);
+}
+
+/**
+ * @brief create and initialize a workqueue served by a pool of worker threads
+ *
+ * @param[in] queue_len the maximum number of items each worker can contain
+ * @param[in] worker_num the number of worker threads, 1 ~ 8
+ * @param[in] thread_cfg thread param, shared by all workers
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, const uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle)
 {
     OPERATE_RET op_ret = OPRT_OK;
     TAL_WORKQUEUE_T *workqueue = NULL;
+    TAL_WORKER_T *worker = NULL;
+    THREAD_CFG_T worker_cfg;
+    uint8_t i = 0;
 
-    if ((0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+    if ((0 == queue_len) || (0 == worker_num) || (worker_num > WORKER_NUM_MAX) || (NULL == thread_cfg) ||
+        (NULL == handle)) {
         return OPRT_INVALID_PARM;
     }
 
-    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T));
+    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T) + worker_num * sizeof(TAL_WORKER_T));
     if (NULL == workqueue) {
         return OPRT_MALLOC_FAILED;
     }
 
-    op_ret = tuya_queue_create(queue_len, sizeof(WORK_ITEM_T), &workqueue->queue);
+    workqueue->queue_len = queue_len;
+    workqueue->worker_num = worker_num;
+
+    op_ret = tal_mutex_create_init(&workqueue->mutex);
     if (OPRT_OK != op_ret) {
-        tal_free(workqueue);
+        __workqueue_free(workqueue);
         return op_ret;
     }
 
-    op_ret = tal_semaphore_create_init(&workqueue->sem, 0, queue_len);
-    if (OPRT_OK != op_ret) {
-        tuya_queue_release(workqueue->queue);
-        tal_free(workqueue);
-        return op_ret;
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        worker->workqueue = workqueue;
+        worker->index = i;
+        INIT_LIST_HEAD(&(worker->deque));
+
+        op_ret = tal_mutex_create_init(&worker->mutex);
+        if (OPRT_OK != op_ret) {
+            __workqueue_free(workqueue);
+            return op_ret;
+        }
+
+        op_ret = tal_semaphore_create_init(&worker->sem, 0, 1);
+        if (OPRT_OK != op_ret) {
+            __workqueue_free(workqueue);
+            return op_ret;
+        }
     }
 
-    op_ret = tal_thread_create_and_start(&workqueue->thread, NULL, NULL, __work_thread_cb, workqueue, thread_cfg);
-    if (OPRT_OK != op_ret) {
-        tal_semaphore_release(workqueue->sem);
-        tuya_queue_release(workqueue->queue);
-        tal_free(workqueue);
-    } else {
-        *handle = workqueue;
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        worker_cfg = *thread_cfg;
+        if (worker_num > 1) {
+            snprintf(worker->name, sizeof(worker->name), "%s_%d", thread_cfg->thrdname ? thread_cfg->thrdname : "wq", i);
+            worker_cfg.thrdname = worker->name;
+        }
+
+        op_ret = tal_thread_create_and_start(&worker->thread, NULL, NULL, __work_thread_cb, worker, &worker_cfg);
+        if (OPRT_OK != op_ret) {
+            __workqueue_stop(workqueue, i);
+            __workqueue_free(workqueue);
+            return op_ret;
+        }
     }
 
-    return op_ret;
+    *handle = workqueue;
+
+    return OPRT_OK;
 }
 
 /**
@@ -159,21 +458,13 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
  */
 OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
 
-    return op_ret;
+    return __work_enqueue(workqueue, __worker_select(workqueue), cb, data, FALSE, FALSE);
 }
 
 /**
@@ -188,21 +479,35 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
 
-    op_ret = tuya_queue_input_instant(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
+    return __work_enqueue(workqueue, __worker_select(workqueue), cb, data, TRUE, FALSE);
+}
+
+/**
+ * @brief put work task in workqueue, works with the same key run in order
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the ordering key, e.g. a hash of the device id
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_keyed(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    if ((NULL == handle) || (NULL == cb)) {
+        return OPRT_INVALID_PARM;
     }
 
-    return op_ret;
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+
+    return __work_enqueue(workqueue, &workqueue->worker[key % workqueue->worker_num], cb, data, FALSE, TRUE);
 }
 
 /**
@@ -221,10 +526,9 @@ OPERATE_RET tal_workqueue_cancel(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void
         return OPRT_INVALID_PARM;
     }
 
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
     WORK_ITEM_T work_item = {.cb = cb, .data = data};
 
-    return tuya_queue_traverse(workqueue->queue, __work_cancel_traverse, &work_item);
+    return tal_workqueue_traverse(handle, __work_cancel_traverse, &work_item);
 }
 
 /**
@@ -244,7 +548,25 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
+    TAL_WORKER_T *worker = NULL;
+    struct tuya_list_head *p = NULL;
+    BOOL_T go_on = TRUE;
+    uint8_t i = 0;
+
+    for (i = 0; (i < workqueue->worker_num) && go_on; i++) {
+        worker = &workqueue->worker[i];
+        tal_mutex_lock(worker->mutex);
+        tuya_list_for_each(p, &(worker->deque))
+        {
+            go_on = cb(&(tuya_list_entry(p, WORK_NODE_T, node)->item), ctx);
+            if (!go_on) {
+                break;
+            }
+        }
+        tal_mutex_unlock(worker->mutex);
+    }
+
+    return OPRT_OK;
 }
 
 /**
@@ -261,12 +583,59 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    uint16_t num = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        if (workqueue->worker[i].last_cb) {
+            PR_NOTICE("%p:last_cb %p", workqueue->worker[i].thread, workqueue->worker[i].last_cb);
+        }
+        num += workqueue->worker[i].count;
+    }
+
+    return num;
+}
 
-    if (workqueue->last_cb) {
-        PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+/**
+ * @brief get the worker thread number of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ *
+ * @return the worker number
+ */
+uint8_t tal_workqueue_get_worker_num(WORKQUEUE_HANDLE handle)
+{
+    if (NULL == handle) {
+        return 0;
     }
 
-    return tuya_queue_get_used_num(workqueue->queue);
+    return ((TAL_WORKQUEUE_T *)handle)->worker_num;
+}
+
+/**
+ * @brief get the statistics of one worker
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] index the worker index
+ * @param[out] stat the worker statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_get_stat(WORKQUEUE_HANDLE handle, uint8_t index, WORKQUEUE_STAT_T *stat)
+{
+    if (NULL == handle || NULL == stat) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    if (index >= workqueue->worker_num) {
+        return OPRT_INVALID_PARM;
+    }
+
+    *stat = workqueue->worker[index].stat;
+
+    return OPRT_OK;
 }
 
 /**
@@ -284,26 +653,14 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
     }
 
     OPERATE_RET op_ret = OPRT_OK;
-    uint32_t count = 1;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
 
-    op_ret = tal_thread_delete(workqueue->thread);
+    op_ret = __workqueue_stop(workqueue, workqueue->worker_num);
     if (OPRT_OK != op_ret) {
         return op_ret;
     }
 
-    tal_semaphore_post(workqueue->sem);
-
-    while (THREAD_STATE_DELETE != tal_thread_get_state(workqueue->thread)) {
-        tal_system_sleep(10);
-        if ((count++) % 500 == 0) {
-            PR_NOTICE("%p still running", workqueue->thread);
-        }
-    }
-
-    tuya_queue_release(workqueue->queue);
-    tal_semaphore_release(workqueue->sem);
-    tal_free(workqueue);
+    __workqueue_free(workqueue);
 
     return OPRT_OK;
 }
@@ -322,7 +679,7 @@ THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return workqueue->thread;
+    return workqueue->worker[0].thread;
 }
 
 typedef struct {
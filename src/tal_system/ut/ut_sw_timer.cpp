@@ -0,0 +1,275 @@
+/**
+ * @file ut_sw_timer.cpp
+ * @brief tal_sw_timer test cases run on the timing wheel and on the sorted
+ * list: firing time across the wheel levels and past the range of the top
+ * wheel, cycle timers, stop and delete, and a benchmark of both backends at
+ * 10/100/1000/10000 timers.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "tal_semaphore.h"
+#include "ut_sw_timer_drv.h"
+}
+
+/* the top wheel of the cases covers ticks up to here, later timers overflow */
+#define SW_TIMER_UT_WHEEL_MAX_MS                                                                                       \
+    ((((uint64_t)1 << (6 + 6 * UT_SW_TIMER_WHEEL_LEVEL_NUM)) - 1) * UT_SW_TIMER_WHEEL_TICK_MS)
+
+uint64_t ut_sw_timer_now_ms = 1000;
+
+void ut_sw_timer_clock_get(TIME_S *sec, TIME_MS *ms)
+{
+    *sec = (TIME_S)(ut_sw_timer_now_ms / 1000);
+    *ms = (TIME_MS)(ut_sw_timer_now_ms % 1000);
+}
+
+typedef struct {
+    uint64_t deadline;
+    uint64_t fired_at;
+    uint32_t fired_num;
+    uint64_t start;    // cycle timers, fire n at start + n * interval
+    uint64_t interval;
+    uint32_t off_num;  // cycle fires not at their time
+} SW_TIMER_UT_T;
+
+static void __sw_timer_ut_cb(TIMER_ID timer_id, void *arg)
+{
+    SW_TIMER_UT_T *t = (SW_TIMER_UT_T *)arg;
+
+    if (0 == t->fired_num++) {
+        t->fired_at = ut_sw_timer_now_ms;
+    }
+    if (t->interval && ut_sw_timer_now_ms != t->start + t->fired_num * t->interval) {
+        t->off_num++;
+    }
+}
+
+class SwTimerTest : public ::testing::TestWithParam<const UT_SW_TIMER_OPS_T *> {
+  protected:
+    const UT_SW_TIMER_OPS_T *ops = nullptr;
+    std::vector<TIMER_ID> ids;
+
+    void SetUp() override
+    {
+        ops = GetParam();
+        ASSERT_EQ(OPRT_OK, ops->init());
+    }
+
+    void TearDown() override
+    {
+        for (auto id : ids) {
+            ops->del(id);
+        }
+        ids.clear();
+        ops->dispatch();
+    }
+
+    TIMER_ID create(SW_TIMER_UT_T *t)
+    {
+        TIMER_ID id = nullptr;
+        EXPECT_EQ(OPRT_OK, ops->create(__sw_timer_ut_cb, t, &id));
+        ids.push_back(id);
+        return id;
+    }
+
+    // what the timer thread does: dispatch, then sleep the wait it got, until end
+    void run_until(uint64_t end)
+    {
+        for (;;) {
+            SYS_TIME_T wait = ops->dispatch();
+            if (SEM_WAIT_FOREVER == wait || ut_sw_timer_now_ms + wait >= end) {
+                break;
+            }
+            ut_sw_timer_now_ms += wait;
+        }
+        ut_sw_timer_now_ms = end;
+        ops->dispatch();
+    }
+};
+
+TEST_P(SwTimerTest, once_fires_on_time)
+{
+    const uint64_t delays[] = {1,    5,     63,      64,     65,     4095,    4096,   100000,
+                               SW_TIMER_UT_WHEEL_MAX_MS, SW_TIMER_UT_WHEEL_MAX_MS + 1, 600000, 1000003};
+    const size_t num = sizeof(delays) / sizeof(delays[0]);
+    SW_TIMER_UT_T t[num] = {};
+    uint64_t start = ut_sw_timer_now_ms;
+
+    for (size_t i = 0; i < num; i++) {
+        t[i].deadline = start + delays[i];
+        ASSERT_EQ(OPRT_OK, ops->start(create(&t[i]), (TIME_MS)delays[i], TAL_TIMER_ONCE));
+    }
+    EXPECT_EQ((int)num, ops->num());
+
+    // never early, never late, also past the range of the top wheel
+    for (size_t i = 0; i < num; i++) {
+        run_until(t[i].deadline - 1);
+        EXPECT_EQ(0u, t[i].fired_num) << ops->name << " delay " << delays[i];
+        run_until(t[i].deadline);
+        EXPECT_EQ(1u, t[i].fired_num) << ops->name << " delay " << delays[i];
+        EXPECT_EQ(t[i].deadline, t[i].fired_at) << ops->name << " delay " << delays[i];
+    }
+    EXPECT_EQ(0, ops->num());
+}
+
+TEST_P(SwTimerTest, cycle_beyond_wheel_range)
+{
+    const uint64_t interval = SW_TIMER_UT_WHEEL_MAX_MS * 2 + 17;
+    SW_TIMER_UT_T t = {};
+    uint64_t start = ut_sw_timer_now_ms;
+
+    ASSERT_EQ(OPRT_OK, ops->start(create(&t), (TIME_MS)interval, TAL_TIMER_CYCLE));
+    run_until(start + interval - 1);
+    EXPECT_EQ(0u, t.fired_num) << ops->name;
+    run_until(start + interval);
+    EXPECT_EQ(1u, t.fired_num) << ops->name;
+    EXPECT_EQ(start + interval, t.fired_at) << ops->name;
+    run_until(start + 3 * interval);
+    EXPECT_EQ(3u, t.fired_num) << ops->name;
+}
+
+TEST_P(SwTimerTest, cycle_count)
+{
+    SW_TIMER_UT_T fast = {}, slow = {};
+
+    ASSERT_EQ(OPRT_OK, ops->start(create(&fast), 10, TAL_TIMER_CYCLE));
+    ASSERT_EQ(OPRT_OK, ops->start(create(&slow), 700, TAL_TIMER_CYCLE));
+    run_until(ut_sw_timer_now_ms + 7000);
+    EXPECT_EQ(700u, fast.fired_num) << ops->name;
+    EXPECT_EQ(10u, slow.fired_num) << ops->name;
+}
+
+TEST_P(SwTimerTest, cycle_on_time_over_thread_waits)
+{
+    const uint32_t num = 200;
+    std::vector<SW_TIMER_UT_T> t(num);
+    uint32_t fired = 0, off = 0;
+
+    // the clock only moves by the waits the dispatch asks for, across many root wraps
+    srand(2);
+    for (auto &timer : t) {
+        timer.start = ut_sw_timer_now_ms;
+        timer.interval = 5 + rand() % 5000;
+        ASSERT_EQ(OPRT_OK, ops->start(create(&timer), (TIME_MS)timer.interval, TAL_TIMER_CYCLE));
+    }
+    run_until(ut_sw_timer_now_ms + 20000);
+    for (auto &timer : t) {
+        fired += timer.fired_num;
+        off += timer.off_num;
+    }
+    EXPECT_GT(fired, num);
+    EXPECT_EQ(0u, off) << ops->name;
+}
+
+TEST_P(SwTimerTest, stop_and_delete)
+{
+    SW_TIMER_UT_T stopped = {}, deleted = {}, restarted = {};
+    uint64_t start = ut_sw_timer_now_ms;
+
+    TIMER_ID stop_id = create(&stopped);
+    TIMER_ID restart_id = create(&restarted);
+    TIMER_ID delete_id = nullptr;
+    ASSERT_EQ(OPRT_OK, ops->create(__sw_timer_ut_cb, &deleted, &delete_id));
+
+    ASSERT_EQ(OPRT_OK, ops->start(stop_id, 100, TAL_TIMER_ONCE));
+    ASSERT_EQ(OPRT_OK, ops->start(delete_id, SW_TIMER_UT_WHEEL_MAX_MS + 100, TAL_TIMER_ONCE));
+    ASSERT_EQ(OPRT_OK, ops->start(restart_id, 100, TAL_TIMER_ONCE));
+    run_until(start + 50);
+
+    ASSERT_EQ(OPRT_OK, ops->stop(stop_id));
+    ASSERT_EQ(OPRT_OK, ops->del(delete_id));
+    // a start of a running timer moves its deadline
+    ASSERT_EQ(OPRT_OK, ops->start(restart_id, 100, TAL_TIMER_ONCE));
+    run_until(start + 149);
+    EXPECT_EQ(0u, restarted.fired_num) << ops->name;
+    run_until(start + 2 * SW_TIMER_UT_WHEEL_MAX_MS);
+    EXPECT_EQ(0u, stopped.fired_num) << ops->name;
+    EXPECT_EQ(0u, deleted.fired_num) << ops->name;
+    EXPECT_EQ(start + 150, restarted.fired_at) << ops->name;
+}
+
+INSTANTIATE_TEST_SUITE_P(Backend, SwTimerTest, ::testing::Values(&ut_sw_timer_wheel_ops, &ut_sw_timer_list_ops),
+                         [](const ::testing::TestParamInfo<const UT_SW_TIMER_OPS_T *> &info) {
+                             return std::string(info.param->name);
+                         });
+
+static void __sw_timer_ut_count_cb(TIMER_ID timer_id, void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+TEST(SwTimerBench, benchmark)
+{
+    const UT_SW_TIMER_OPS_T *backends[] = {&ut_sw_timer_list_ops, &ut_sw_timer_wheel_ops};
+    const uint32_t sim_ms = 10 * 1000;
+
+    for (uint32_t num : {10, 100, 1000, 10000}) {
+        double start_ns[2], stop_ns[2], run_ns[2];
+        uint32_t fired[2];
+
+        for (int b = 0; b < 2; b++) {
+            const UT_SW_TIMER_OPS_T *ops = backends[b];
+            std::vector<TIMER_ID> ids(num);
+            std::vector<TIME_MS> interval(num);
+            uint32_t count = 0;
+
+            ASSERT_EQ(OPRT_OK, ops->init());
+            srand(1);
+            for (uint32_t i = 0; i < num; i++) {
+                ASSERT_EQ(OPRT_OK, ops->create(__sw_timer_ut_count_cb, &count, &ids[i]));
+                // DP sync, health checks, LED effects and debounce, 20 ms to 60 s
+                interval[i] = 20 + rand() % 60000;
+            }
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < num; i++) {
+                ops->start(ids[i], interval[i], TAL_TIMER_CYCLE);
+            }
+            auto t1 = std::chrono::steady_clock::now();
+
+            // the thread loop over simulated time, the cycle timers restart themselves
+            uint64_t end = ut_sw_timer_now_ms + sim_ms;
+            for (;;) {
+                SYS_TIME_T wait = ops->dispatch();
+                if (SEM_WAIT_FOREVER == wait || ut_sw_timer_now_ms + wait > end) {
+                    break;
+                }
+                ut_sw_timer_now_ms += wait;
+            }
+            ut_sw_timer_now_ms = end;
+            auto t2 = std::chrono::steady_clock::now();
+
+            for (uint32_t i = 0; i < num; i++) {
+                ops->stop(ids[i]);
+            }
+            auto t3 = std::chrono::steady_clock::now();
+
+            for (uint32_t i = 0; i < num; i++) {
+                ops->del(ids[i]);
+            }
+            ops->dispatch();
+
+            start_ns[b] = std::chrono::duration<double, std::nano>(t1 - t0).count() / num;
+            run_ns[b] = std::chrono::duration<double, std::nano>(t2 - t1).count() / (count ? count : 1);
+            stop_ns[b] = std::chrono::duration<double, std::nano>(t3 - t2).count() / num;
+            fired[b] = count;
+        }
+
+        printf("[ BENCH    ] %5u timers: start list %.0f ns wheel %.0f ns, stop list %.0f ns wheel %.0f ns, "
+               "per expiry list %.0f ns wheel %.0f ns (%u expiries in %u s)\n",
+               num, start_ns[0], start_ns[1], stop_ns[0], stop_ns[1], run_ns[0], run_ns[1], fired[1],
+               sim_ms / 1000);
+        // same timers, same simulated time
+        EXPECT_EQ(fired[0], fired[1]);
+    }
+}
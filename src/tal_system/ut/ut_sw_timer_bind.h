@@ -0,0 +1,55 @@
+/**
+ * @file ut_sw_timer_bind.h
+ * @brief included by a driver after UT_SW_TIMER(name) is defined, builds
+ * tal_sw_timer.c under the names UT_SW_TIMER(init) ... and fills
+ * UT_SW_TIMER(ops), the library tal_sw_timer stays as it is for the rest
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_thread.h"
+#include "ut_sw_timer_drv.h"
+
+/* no timer thread, the cases call the dispatch */
+static OPERATE_RET __ut_sw_timer_thread_start(THREAD_HANDLE *handle, const THREAD_ENTER_CB enter,
+                                              const THREAD_EXIT_CB exit, const THREAD_FUNC_CB func, const void *arg,
+                                              const THREAD_CFG_T *cfg)
+{
+    *handle = NULL;
+    return OPRT_OK;
+}
+
+#define tal_thread_create_and_start   __ut_sw_timer_thread_start
+#define tal_time_get_system_time      ut_sw_timer_clock_get
+#define tal_sw_timer_init             UT_SW_TIMER(init)
+#define tal_sw_timer_create           UT_SW_TIMER(create)
+#define tal_sw_timer_delete           UT_SW_TIMER(delete)
+#define tal_sw_timer_stop             UT_SW_TIMER(stop)
+#define tal_sw_timer_is_running       UT_SW_TIMER(is_running)
+#define tal_sw_timer_remain_time_get  UT_SW_TIMER(remain_time_get)
+#define tal_sw_timer_start            UT_SW_TIMER(start)
+#define tal_sw_timer_trigger          UT_SW_TIMER(trigger)
+#define tal_sw_timer_release          UT_SW_TIMER(release)
+#define tal_sw_timer_get_num          UT_SW_TIMER(get_num)
+#define tal_sw_timer_dump             UT_SW_TIMER(dump)
+
+#include "../src/tal_sw_timer.c"
+
+static SYS_TIME_T __ut_sw_timer_dispatch(void)
+{
+    SYS_TIME_T next_expired = SEM_WAIT_FOREVER;
+
+    __timer_dispatch(&next_expired);
+    return next_expired;
+}
+
+const UT_SW_TIMER_OPS_T UT_SW_TIMER(ops) = {
+    .name = UT_SW_TIMER_NAME,
+    .init = tal_sw_timer_init,
+    .create = tal_sw_timer_create,
+    .del = tal_sw_timer_delete,
+    .start = tal_sw_timer_start,
+    .stop = tal_sw_timer_stop,
+    .num = tal_sw_timer_get_num,
+    .dispatch = __ut_sw_timer_dispatch,
+};
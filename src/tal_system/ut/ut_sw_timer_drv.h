@@ -0,0 +1,50 @@
+/**
+ * @file ut_sw_timer_drv.h
+ * @brief tal_sw_timer built twice, on the timing wheel and on the sorted
+ * list, both on a clock the cases move and without the timer thread, the
+ * cases run the dispatch themselves, see ut_sw_timer_bind.h
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_SW_TIMER_DRV_H__
+#define __UT_SW_TIMER_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "tal_sw_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the wheel of the cases, 2 levels cover 2^18 ticks and overflow is reached in seconds */
+#define UT_SW_TIMER_WHEEL_TICK_MS   1
+#define UT_SW_TIMER_WHEEL_LEVEL_NUM 2
+
+typedef struct {
+    const char *name;
+    OPERATE_RET (*init)(void);
+    OPERATE_RET (*create)(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id);
+    OPERATE_RET (*del)(TIMER_ID timer_id);
+    OPERATE_RET (*start)(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type);
+    OPERATE_RET (*stop)(TIMER_ID timer_id);
+    int (*num)(void);
+    /* run the timers due at the clock, returns the wait the thread would do */
+    SYS_TIME_T (*dispatch)(void);
+} UT_SW_TIMER_OPS_T;
+
+extern const UT_SW_TIMER_OPS_T ut_sw_timer_wheel_ops;
+extern const UT_SW_TIMER_OPS_T ut_sw_timer_list_ops;
+
+/**
+ * @brief the clock of both builds, ms since the start of the cases
+ */
+extern uint64_t ut_sw_timer_now_ms;
+
+void ut_sw_timer_clock_get(TIME_S *sec, TIME_MS *ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_SW_TIMER_DRV_H__ */
@@ -0,0 +1,17 @@
+/**
+ * @file ut_sw_timer_list_drv.c
+ * @brief tal_sw_timer on the sorted list, see ut_sw_timer_bind.h
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "ut_sw_timer_drv.h"
+
+#undef ENABLE_SW_TIMER_WHEEL
+#define ENABLE_SW_TIMER_WHEEL 0
+
+#define UT_SW_TIMER(name) ut_sw_timer_list_##name
+#define UT_SW_TIMER_NAME  "list"
+
+#include "ut_sw_timer_bind.h"
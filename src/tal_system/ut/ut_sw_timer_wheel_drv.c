@@ -0,0 +1,19 @@
+/**
+ * @file ut_sw_timer_wheel_drv.c
+ * @brief tal_sw_timer on the timing wheel, see ut_sw_timer_bind.h
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "ut_sw_timer_drv.h"
+
+#undef ENABLE_SW_TIMER_WHEEL
+#define ENABLE_SW_TIMER_WHEEL  1
+#define SW_TIMER_WHEEL_TICK_MS UT_SW_TIMER_WHEEL_TICK_MS
+#define TW_LEVEL_NUM           UT_SW_TIMER_WHEEL_LEVEL_NUM
+
+#define UT_SW_TIMER(name) ut_sw_timer_wheel_##name
+#define UT_SW_TIMER_NAME  "wheel"
+
+#include "ut_sw_timer_bind.h"
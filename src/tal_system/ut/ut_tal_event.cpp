@@ -0,0 +1,196 @@
+/**
+ * @file ut_tal_event.cpp
+ * @brief tal_event test cases, dispatch order, one-time and unsubscribe
+ * semantics of the snapshot dispatch, and a publish latency benchmark from 1
+ * to 64 subscribers.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "tal_event.h"
+}
+
+#define EVENT_UT_SUB_MAX     64
+#define EVENT_UT_THREAD_NUM  4
+#define EVENT_UT_PUBLISH_NUM 20000
+
+static std::vector<int> s_order;
+static std::atomic<uint32_t> s_count(0);
+
+// every callback records its index
+#define EVENT_UT_CB(n)                                                                                                 \
+    static int __event_ut_cb_##n(void *data)                                                                           \
+    {                                                                                                                  \
+        s_order.push_back(n);                                                                                          \
+        return 0;                                                                                                      \
+    }
+EVENT_UT_CB(0)
+EVENT_UT_CB(1)
+EVENT_UT_CB(2)
+EVENT_UT_CB(3)
+
+static int __event_ut_count_cb(void *data)
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+static int __event_ut_self_unsubscribe_cb(void *data)
+{
+    s_order.push_back(10);
+    tal_event_unsubscribe((const char *)data, "self", __event_ut_self_unsubscribe_cb);
+    return 0;
+}
+
+static int __event_ut_other_unsubscribe_cb(void *data)
+{
+    s_order.push_back(11);
+    tal_event_unsubscribe((const char *)data, "other", __event_ut_cb_1);
+    return 0;
+}
+
+class TalEventTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(OPRT_OK, tal_event_init());
+        s_order.clear();
+        s_count = 0;
+    }
+};
+
+TEST_F(TalEventTest, dispatch_order)
+{
+    const char *name = "ut.order";
+
+    // subscribed before the event exists, moved from the free list when it is created
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "a", __event_ut_cb_0, SUBSCRIBE_TYPE_NORMAL));
+    ASSERT_EQ(OPRT_OK, tal_event_publish(name, NULL));
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "b", __event_ut_cb_1, SUBSCRIBE_TYPE_NORMAL));
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "c", __event_ut_cb_2, SUBSCRIBE_TYPE_EMERGENCY));
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "d", __event_ut_cb_3, SUBSCRIBE_TYPE_ONETIME));
+    // a second subscribe of the same desc and callback is ignored
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "b", __event_ut_cb_1, SUBSCRIBE_TYPE_NORMAL));
+
+    s_order.clear();
+    ASSERT_EQ(OPRT_OK, tal_event_publish(name, NULL));
+    EXPECT_EQ((std::vector<int>{2, 0, 1, 3}), s_order);
+
+    // the one-time subscriber is gone, the handle publishes the same event
+    EVENT_HANDLE handle = NULL;
+    ASSERT_EQ(OPRT_OK, tal_event_get_handle(name, &handle));
+    s_order.clear();
+    ASSERT_EQ(OPRT_OK, tal_event_publish_handle(handle, NULL));
+    EXPECT_EQ((std::vector<int>{2, 0, 1}), s_order);
+
+    tal_event_unsubscribe(name, "a", __event_ut_cb_0);
+    tal_event_unsubscribe(name, "b", __event_ut_cb_1);
+    tal_event_unsubscribe(name, "c", __event_ut_cb_2);
+    s_order.clear();
+    ASSERT_EQ(OPRT_OK, tal_event_publish_handle(handle, NULL));
+    EXPECT_TRUE(s_order.empty());
+}
+
+TEST_F(TalEventTest, unsubscribe_in_callback)
+{
+    const char *name = "ut.unsub";
+
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "self", __event_ut_self_unsubscribe_cb, SUBSCRIBE_TYPE_NORMAL));
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "other", __event_ut_other_unsubscribe_cb, SUBSCRIBE_TYPE_NORMAL));
+    ASSERT_EQ(OPRT_OK, tal_event_subscribe(name, "other", __event_ut_cb_1, SUBSCRIBE_TYPE_NORMAL));
+
+    // the publish in progress goes on with its snapshot, so the callback
+    // unsubscribed by another one still runs once after the unsubscribe returned
+    ASSERT_EQ(OPRT_OK, tal_event_publish(name, (void *)name));
+    EXPECT_EQ((std::vector<int>{10, 11, 1}), s_order);
+
+    s_order.clear();
+    ASSERT_EQ(OPRT_OK, tal_event_publish(name, (void *)name));
+    EXPECT_EQ((std::vector<int>{11}), s_order);
+
+    tal_event_unsubscribe(name, "other", __event_ut_other_unsubscribe_cb);
+}
+
+TEST_F(TalEventTest, benchmark)
+{
+    EVENT_HANDLE handle = NULL;
+    char desc[16];
+    uint32_t sub_num = 0;
+
+    ASSERT_EQ(OPRT_OK, tal_event_get_handle("ut.bench", &handle));
+
+    for (uint32_t num : {1, 4, 16, EVENT_UT_SUB_MAX}) {
+        // callbacks with the same pointer are told apart by desc
+        for (; sub_num < num; sub_num++) {
+            snprintf(desc, sizeof(desc), "bench%u", sub_num);
+            ASSERT_EQ(OPRT_OK, tal_event_subscribe("ut.bench", desc, __event_ut_count_cb, SUBSCRIBE_TYPE_NORMAL));
+        }
+
+        // best of three runs, ns per publish
+        auto bench = [](const std::function<void()> &fn, uint32_t publish_num) {
+            double best = 0;
+            for (int r = 0; r < 3; r++) {
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                best = (0 == r || ns < best) ? ns : best;
+            }
+            return best / publish_num;
+        };
+
+        s_count = 0;
+        double by_name = bench(
+            [] {
+                for (int i = 0; i < EVENT_UT_PUBLISH_NUM; i++) {
+                    tal_event_publish("ut.bench", NULL);
+                }
+            },
+            EVENT_UT_PUBLISH_NUM);
+        EXPECT_EQ(3u * EVENT_UT_PUBLISH_NUM * num, s_count.load());
+
+        double by_handle = bench(
+            [handle] {
+                for (int i = 0; i < EVENT_UT_PUBLISH_NUM; i++) {
+                    tal_event_publish_handle(handle, NULL);
+                }
+            },
+            EVENT_UT_PUBLISH_NUM);
+
+        // publishers from several threads do not serialize on the event mutex
+        double parallel = bench(
+            [handle] {
+                std::vector<std::thread> threads;
+                for (int t = 0; t < EVENT_UT_THREAD_NUM; t++) {
+                    threads.emplace_back([handle] {
+                        for (int i = 0; i < EVENT_UT_PUBLISH_NUM; i++) {
+                            tal_event_publish_handle(handle, NULL);
+                        }
+                    });
+                }
+                for (auto &t : threads) {
+                    t.join();
+                }
+            },
+            EVENT_UT_PUBLISH_NUM * EVENT_UT_THREAD_NUM);
+
+        printf("[ BENCH    ] %2u subscribers: publish by name %.0f ns, by handle %.0f ns, %d threads by handle %.0f "
+               "ns per publish\n",
+               num, by_name, by_handle, EVENT_UT_THREAD_NUM, parallel);
+    }
+
+    for (uint32_t i = 0; i < sub_num; i++) {
+        snprintf(desc, sizeof(desc), "bench%u", i);
+        tal_event_unsubscribe("ut.bench", desc, __event_ut_count_cb);
+    }
+}
@@ -0,0 +1,191 @@
+/**
+ * @file ut_tal_log.cpp
+ * @brief tal_log test cases, ordering and drop accounting of the log path and
+ * a throughput/latency benchmark from 1 to 8 threads.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "tal_log.h"
+#include "tal_system.h"
+}
+
+#define LOG_UT_THREAD_MAX 8
+
+static std::mutex s_term_mutex;
+static std::condition_variable s_term_cond;
+static bool s_term_block = false;
+static uint32_t s_term_lines = 0;
+static int s_term_last[LOG_UT_THREAD_MAX];
+static bool s_term_order_ok = true;
+
+static void __log_ut_term(const char *str)
+{
+    std::unique_lock<std::mutex> lock(s_term_mutex);
+    s_term_cond.wait(lock, [] { return !s_term_block; });
+
+    // only count the lines of the cases, tal_thread logs too
+    const char *body = strstr(str, "] ut:");
+    int thread = 0, seq = 0;
+    if (body && 2 == sscanf(body, "] ut:%d:%d", &thread, &seq) && thread < LOG_UT_THREAD_MAX) {
+        // every thread logs an increasing sequence, drops may leave holes but never reorder
+        if (seq <= s_term_last[thread]) {
+            s_term_order_ok = false;
+        }
+        s_term_last[thread] = seq;
+        s_term_lines++;
+        s_term_cond.notify_all();
+    }
+}
+
+static void __log_ut_null_term(const char *str)
+{
+}
+
+class TalLogTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        s_term_block = false;
+        s_term_lines = 0;
+        s_term_order_ok = true;
+        std::fill(s_term_last, s_term_last + LOG_UT_THREAD_MAX, -1);
+    }
+
+    void TearDown() override
+    {
+        tal_log_release();
+    }
+
+    // wait until the log path delivered the expected lines or gave up on them
+    bool wait_lines(uint32_t total)
+    {
+        std::unique_lock<std::mutex> lock(s_term_mutex);
+        return s_term_cond.wait_for(lock, std::chrono::seconds(5),
+                                    [total] { return s_term_lines + tal_log_get_drop_num() >= total; });
+    }
+};
+
+TEST_F(TalLogTest, keep_order_per_thread)
+{
+    const int thread_num = 4;
+    const int log_num = 500;
+    std::vector<std::thread> threads;
+
+    ASSERT_EQ(OPRT_OK, tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, __log_ut_term));
+
+    for (int t = 0; t < thread_num; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < log_num; i++) {
+                PR_DEBUG("ut:%d:%d", t, i);
+                if (0 == (i % 32)) {
+                    tal_system_sleep(1);
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+
+    EXPECT_TRUE(wait_lines(thread_num * log_num));
+    EXPECT_TRUE(s_term_order_ok);
+    EXPECT_EQ((uint32_t)(thread_num * log_num), s_term_lines + tal_log_get_drop_num());
+}
+
+TEST_F(TalLogTest, filter_by_level)
+{
+    ASSERT_EQ(OPRT_OK, tal_log_init(TAL_LOG_LEVEL_NOTICE, 1024, __log_ut_term));
+
+    EXPECT_EQ(OPRT_BASE_LOG_MNG_PRINT_LOG_LEVEL_HIGHER, PR_DEBUG("ut:0:0"));
+    EXPECT_EQ(OPRT_OK, PR_ERR("ut:0:1"));
+
+    EXPECT_TRUE(wait_lines(1));
+    EXPECT_EQ(1u, s_term_lines);
+}
+
+#if defined(ENABLE_LOG_ASYNC) && (ENABLE_LOG_ASYNC == 1)
+TEST_F(TalLogTest, async_count_drop_when_ring_full)
+{
+    const int log_num = 1000;
+    int pushed = 0;
+
+    ASSERT_EQ(OPRT_OK, tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, __log_ut_term));
+
+    // a stalled output must not block callers, the ring fills and logs are dropped
+    {
+        std::lock_guard<std::mutex> lock(s_term_mutex);
+        s_term_block = true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < log_num; i++) {
+        if (OPRT_OK == PR_DEBUG("ut:0:%d", i)) {
+            pushed++;
+        }
+    }
+    auto cost = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(cost).count(), 1000);
+    EXPECT_GT(tal_log_get_drop_num(), 0u);
+    EXPECT_EQ((uint32_t)log_num, pushed + tal_log_get_drop_num());
+
+    {
+        std::lock_guard<std::mutex> lock(s_term_mutex);
+        s_term_block = false;
+        s_term_cond.notify_all();
+    }
+    EXPECT_TRUE(wait_lines(log_num));
+    EXPECT_TRUE(s_term_order_ok);
+    EXPECT_EQ((uint32_t)pushed, s_term_lines);
+}
+#endif
+
+TEST_F(TalLogTest, benchmark_threads)
+{
+    const int log_num = 20000;
+
+    for (int thread_num = 1; thread_num <= LOG_UT_THREAD_MAX; thread_num *= 2) {
+        std::vector<std::thread> threads;
+        std::vector<std::vector<uint32_t>> lat(thread_num, std::vector<uint32_t>(log_num));
+
+        ASSERT_EQ(OPRT_OK, tal_log_init(TAL_LOG_LEVEL_DEBUG, 1024, __log_ut_null_term));
+
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < thread_num; t++) {
+            threads.emplace_back([t, &lat] {
+                for (int i = 0; i < log_num; i++) {
+                    auto begin = std::chrono::steady_clock::now();
+                    PR_DEBUG("ut:%d:%d bench %s", t, i, "payload");
+                    auto end = std::chrono::steady_clock::now();
+                    lat[t][i] = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+                }
+            });
+        }
+        for (auto &th : threads) {
+            th.join();
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<uint32_t> all;
+        for (auto &v : lat) {
+            all.insert(all.end(), v.begin(), v.end());
+        }
+        std::sort(all.begin(), all.end());
+        printf("[ BENCH    ] threads %d: %.0f calls/s, p50 %u ns, p99 %u ns, p99.9 %u ns, drop %u\n", thread_num,
+               all.size() / sec, all[all.size() / 2], all[all.size() * 99 / 100], all[all.size() * 999 / 1000],
+               tal_log_get_drop_num());
+
+        tal_log_release();
+    }
+}
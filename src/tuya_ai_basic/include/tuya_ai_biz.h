@@ -10,7 +10,7 @@
  *
  * Key features include:
  * - AI session management with configurable maximum session limit
- * - Asynchronous task scheduling with configurable delay
+ * - Push based frame sending, per stream queues sent audio first
  * - Thread-safe operations using mutex and event mechanisms
  * - Integration with Tuya AI client and protocol layers
  *
@@ -120,6 +120,17 @@ typedef void (*AI_BIZ_SEND_FREE_CB)(char *data);
  */
 typedef OPERATE_RET (*AI_BIZ_RECV_CB)(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char *data, void *usr_data);
 
+typedef struct {
+    /** frames sent by the send thread */
+    uint32_t frame_num;
+    /** frames not sent, queue full or send failed */
+    uint32_t drop_num;
+    /** max push to wire latency, unit:ms */
+    uint32_t latency_max;
+    /** average push to wire latency, unit:ms */
+    uint32_t latency_avg;
+} AI_BIZ_SEND_STAT_T;
+
 typedef struct {
     /** send packet type */
     AI_PACKET_PT type;
@@ -191,6 +202,58 @@ OPERATE_RET tuya_ai_biz_del_session(AI_SESSION_ID id, AI_STATUS_CODE code);
 OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
                                  char *payload);
 
+/**
+ * @brief alloc a frame buffer for tuya_ai_biz_frame_push, the biz head is
+ * written in place in front of it when sent
+ *
+ * @param[in] len max payload length
+ *
+ * @return payload buffer, NULL on error
+ */
+char *tuya_ai_biz_frame_alloc(uint32_t len);
+
+/**
+ * @brief free a frame buffer which was not pushed
+ *
+ * @param[in] data payload buffer from tuya_ai_biz_frame_alloc
+ *
+ */
+void tuya_ai_biz_frame_free(char *data);
+
+/**
+ * @brief push a frame to the send queue of its stream and wake up the send
+ * thread. Audio frames are sent first, then video, text, image and file.
+ *
+ * @param[in] id channel id
+ * @param[in] type packet type
+ * @param[in] attr attribute, pointers in it must be valid until the frame is sent
+ * @param[in] head data head, head->len is the payload length
+ * @param[in] data payload buffer from tuya_ai_biz_frame_alloc, owned by biz
+ * after push even on error
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_biz_frame_push(uint16_t id, AI_PACKET_PT type, AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head,
+                                   char *data);
+
+/**
+ * @brief wait until the frames pushed are sent, before a packet which must
+ * follow them is sent directly
+ *
+ * @param[in] timeout_ms max time to wait, unit:ms
+ *
+ * @return OPRT_OK on success, OPRT_TIMEOUT if frames are still queued
+ */
+OPERATE_RET tuya_ai_biz_frame_wait(uint32_t timeout_ms);
+
+/**
+ * @brief get the statistics of pushed frames
+ *
+ * @param[out] stat statistics
+ *
+ */
+void tuya_ai_biz_get_send_stat(AI_BIZ_SEND_STAT_T *stat);
+
 /**
  * @brief get send id
  *
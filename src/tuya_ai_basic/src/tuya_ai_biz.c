@@ -10,7 +10,7 @@
  *
  * Key features include:
  * - AI session management with configurable maximum session limit
- * - Asynchronous task scheduling with configurable delay
+ * - Push based frame sending, per stream queues sent audio first
  * - Thread-safe operations using mutex and event mechanisms
  * - Integration with Tuya AI client and protocol layers
  *
@@ -25,6 +25,8 @@
 #include "tal_system.h"
 #include "tal_thread.h"
 #include "tal_mutex.h"
+#include "tal_semaphore.h"
+#include "tuya_list.h"
 #include "uni_random.h"
 #include "tal_log.h"
 #include "tal_memory.h"
@@ -40,36 +42,82 @@
 #ifndef AI_BIZ_TASK_DELAY
 #define AI_BIZ_TASK_DELAY 10
 #endif
+#ifndef AI_BIZ_FRAME_QUEUE_NUM
+#define AI_BIZ_FRAME_QUEUE_NUM 16
+#endif
+#ifndef AI_BIZ_FRAME_POOL_NUM
+#define AI_BIZ_FRAME_POOL_NUM 4
+#endif
+
+// the largest biz head, frames keep this room in front of the payload
+#define AI_BIZ_HEAD_ROOM sizeof(AI_VIDEO_HEAD_T)
+
+// frame queues in send order, audio first
+typedef enum {
+    AI_BIZ_PRIO_AUDIO,
+    AI_BIZ_PRIO_VIDEO,
+    AI_BIZ_PRIO_TEXT,
+    AI_BIZ_PRIO_IMAGE,
+    AI_BIZ_PRIO_FILE,
+    AI_BIZ_PRIO_NUM
+} AI_BIZ_PRIO_E;
 
 typedef struct {
     char id[AI_UUID_V4_LEN];
     AI_SESSION_CFG_T cfg;
 } AI_SESSION_T;
 
+typedef struct {
+    LIST_HEAD node;
+    uint16_t id;
+    AI_PACKET_PT type;
+    AI_BIZ_ATTR_INFO_T attr;
+    AI_BIZ_HEAD_INFO_T head;
+    SYS_TIME_T push_ms;
+    uint32_t size;  // payload capacity
+    char data[0];   // AI_BIZ_HEAD_ROOM bytes head room, then the payload
+} AI_BIZ_FRAME_T;
+
 typedef struct {
     THREAD_HANDLE thread;
     MUTEX_HANDLE mutex;
     AI_SESSION_T session[AI_SESSION_MAX_NUM];
     AI_BIZ_RECV_CB cb;
+
+    SEM_HANDLE send_sem;                    // wakes the send thread
+    MUTEX_HANDLE frame_mutex;               // protects the frame queues, pool and stat
+    LIST_HEAD queue[AI_BIZ_PRIO_NUM];       // pushed frames of each stream
+    uint8_t queue_num[AI_BIZ_PRIO_NUM];
+    uint8_t sending;                        // frames popped and not sent yet
+    LIST_HEAD pool;                         // released frames kept for reuse
+    uint8_t pool_num;
+    AI_BIZ_SEND_STAT_T stat;
 } AI_BASIC_BIZ_T;
 AI_BASIC_BIZ_T *ai_basic_biz;
 
-OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
-                                 char *payload)
+static uint32_t __ai_biz_head_len(AI_PACKET_PT type)
 {
-    OPERATE_RET rt = OPRT_OK;
-    uint32_t payload_len = 0;
-    if (ai_basic_biz == NULL) {
-        PR_ERR("ai biz is null");
-        return OPRT_COM_ERROR;
+    switch (type) {
+    case AI_PT_VIDEO:
+        return sizeof(AI_VIDEO_HEAD_T);
+    case AI_PT_AUDIO:
+        return sizeof(AI_AUDIO_HEAD_T);
+    case AI_PT_IMAGE:
+        return sizeof(AI_IMAGE_HEAD_T);
+    case AI_PT_FILE:
+        return sizeof(AI_FILE_HEAD_T);
+    case AI_PT_TEXT:
+        return sizeof(AI_TEXT_HEAD_T);
+    default:
+        return 0;
     }
-    AI_PROTO_D("biz len:%d", head->len);
-    if (type == AI_PT_VIDEO) {
-        payload_len = sizeof(AI_VIDEO_HEAD_T) + head->len;
-        char *video = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(video, OPRT_MALLOC_FAILED);
-        memset(video, 0, payload_len);
-        AI_VIDEO_HEAD_T *video_head = (AI_VIDEO_HEAD_T *)video;
+}
+
+static void __ai_biz_pack_head(uint16_t id, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head, char *buf)
+{
+    memset(buf, 0, __ai_biz_head_len(type));
+    if ((type == AI_PT_VIDEO) || (type == AI_PT_AUDIO)) {
+        AI_VIDEO_HEAD_T *video_head = (AI_VIDEO_HEAD_T *)buf;
         video_head->id = UNI_HTONS(id);
         video_head->stream_flag = head->stream_flag;
         video_head->timestamp = head->value.video.timestamp;
@@ -77,89 +125,61 @@ OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKE
         UNI_HTONLL(video_head->timestamp);
         UNI_HTONLL(video_head->pts);
         video_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(video + sizeof(AI_VIDEO_HEAD_T), payload, head->len);
-        }
-        if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_video(&(attr->value.video), video, payload_len);
-        } else {
-            rt = tuya_ai_basic_video(NULL, video, payload_len);
-        }
-        Free(video);
-    } else if (type == AI_PT_AUDIO) {
-        payload_len = sizeof(AI_AUDIO_HEAD_T) + head->len;
-        char *audio = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(audio, OPRT_MALLOC_FAILED);
-        memset(audio, 0, payload_len);
-        AI_AUDIO_HEAD_T *audio_head = (AI_AUDIO_HEAD_T *)audio;
-        audio_head->id = UNI_HTONS(id);
-        audio_head->stream_flag = head->stream_flag;
-        audio_head->timestamp = head->value.audio.timestamp;
-        audio_head->pts = head->value.audio.pts;
-        UNI_HTONLL(audio_head->timestamp);
-        UNI_HTONLL(audio_head->pts);
-        audio_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(audio + sizeof(AI_AUDIO_HEAD_T), payload, head->len);
-        }
-        if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_audio(&(attr->value.audio), audio, payload_len);
-        } else {
-            rt = tuya_ai_basic_audio(NULL, audio, payload_len);
-        }
-        Free(audio);
     } else if (type == AI_PT_IMAGE) {
-        payload_len = sizeof(AI_IMAGE_HEAD_T) + head->len;
-        char *image = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(image, OPRT_MALLOC_FAILED);
-        memset(image, 0, payload_len);
-        AI_IMAGE_HEAD_T *image_head = (AI_IMAGE_HEAD_T *)image;
+        AI_IMAGE_HEAD_T *image_head = (AI_IMAGE_HEAD_T *)buf;
         image_head->id = UNI_HTONS(id);
         image_head->stream_flag = head->stream_flag;
         image_head->timestamp = head->value.image.timestamp;
         UNI_HTONLL(image_head->timestamp);
         image_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(image + sizeof(AI_IMAGE_HEAD_T), payload, head->len);
-        }
-        rt = tuya_ai_basic_image(&(attr->value.image), image, payload_len);
-        Free(image);
-    } else if (type == AI_PT_FILE) {
-        payload_len = sizeof(AI_FILE_HEAD_T) + head->len;
-        char *file = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(file, OPRT_MALLOC_FAILED);
-        memset(file, 0, payload_len);
-        AI_FILE_HEAD_T *file_head = (AI_FILE_HEAD_T *)file;
+    } else {
+        AI_FILE_HEAD_T *file_head = (AI_FILE_HEAD_T *)buf;
         file_head->id = UNI_HTONS(id);
         file_head->stream_flag = head->stream_flag;
         file_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(file + sizeof(AI_FILE_HEAD_T), payload, head->len);
-        }
-        rt = tuya_ai_basic_file(&(attr->value.file), file, payload_len);
-        Free(file);
-    } else if (type == AI_PT_TEXT) {
-        payload_len = sizeof(AI_TEXT_HEAD_T) + head->len;
-        char *text = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(text, OPRT_MALLOC_FAILED);
-        memset(text, 0, payload_len);
-        AI_TEXT_HEAD_T *text_head = (AI_TEXT_HEAD_T *)text;
-        text_head->id = UNI_HTONS(id);
-        text_head->stream_flag = head->stream_flag;
-        text_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(text + sizeof(AI_TEXT_HEAD_T), payload, head->len);
-        }
-        if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_text(&(attr->value.text), text, payload_len);
-        } else {
-            rt = tuya_ai_basic_text(NULL, text, payload_len);
-        }
-        Free(text);
+    }
+}
+
+static OPERATE_RET __ai_biz_send_packed(AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, char *buf, uint32_t len)
+{
+    uint8_t has_attr = attr && (attr->flag == AI_HAS_ATTR);
+
+    if (type == AI_PT_VIDEO) {
+        return tuya_ai_basic_video(has_attr ? &(attr->value.video) : NULL, buf, len);
+    } else if (type == AI_PT_AUDIO) {
+        return tuya_ai_basic_audio(has_attr ? &(attr->value.audio) : NULL, buf, len);
+    } else if (type == AI_PT_IMAGE) {
+        return tuya_ai_basic_image(&(attr->value.image), buf, len);
+    } else if (type == AI_PT_FILE) {
+        return tuya_ai_basic_file(&(attr->value.file), buf, len);
     } else {
+        return tuya_ai_basic_text(has_attr ? &(attr->value.text) : NULL, buf, len);
+    }
+}
+
+OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
+                                 char *payload)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t head_len = __ai_biz_head_len(type);
+    if (ai_basic_biz == NULL) {
+        PR_ERR("ai biz is null");
+        return OPRT_COM_ERROR;
+    }
+    if (0 == head_len) {
         PR_ERR("unknow type:%d", type);
-        rt = OPRT_COM_ERROR;
+        return OPRT_COM_ERROR;
     }
+    AI_PROTO_D("biz len:%d", head->len);
+
+    char *buf = Malloc(head_len + head->len);
+    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
+    __ai_biz_pack_head(id, type, head, buf);
+    if (payload && head->len) {
+        memcpy(buf + head_len, payload, head->len);
+    }
+    rt = __ai_biz_send_packed(attr, type, buf, head_len + head->len);
+    Free(buf);
 
     if (rt != OPRT_OK) {
         PR_ERR("send biz data failed, rt:%d", rt);
@@ -167,52 +187,183 @@ OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKE
     return rt;
 }
 
-static void __ai_biz_thread_cb(void *args)
+static AI_BIZ_FRAME_T *__ai_biz_frame_entry(char *data)
+{
+    return (AI_BIZ_FRAME_T *)(data - AI_BIZ_HEAD_ROOM - offsetof(AI_BIZ_FRAME_T, data));
+}
+
+static int __ai_biz_frame_prio(AI_PACKET_PT type)
+{
+    switch (type) {
+    case AI_PT_AUDIO:
+        return AI_BIZ_PRIO_AUDIO;
+    case AI_PT_VIDEO:
+        return AI_BIZ_PRIO_VIDEO;
+    case AI_PT_TEXT:
+        return AI_BIZ_PRIO_TEXT;
+    case AI_PT_IMAGE:
+        return AI_BIZ_PRIO_IMAGE;
+    case AI_PT_FILE:
+        return AI_BIZ_PRIO_FILE;
+    default:
+        return -1;
+    }
+}
+
+static void __ai_biz_frame_release(AI_BIZ_FRAME_T *frame)
+{
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    if (ai_basic_biz->pool_num < AI_BIZ_FRAME_POOL_NUM) {
+        tuya_list_add(&frame->node, &ai_basic_biz->pool);
+        ai_basic_biz->pool_num++;
+        frame = NULL;
+    }
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    if (frame) {
+        Free(frame);
+    }
+}
+
+// pop the oldest frame of the highest priority stream
+static AI_BIZ_FRAME_T *__ai_biz_frame_pop(void)
+{
+    AI_BIZ_FRAME_T *frame = NULL;
+    uint32_t prio = 0;
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    for (prio = 0; prio < AI_BIZ_PRIO_NUM; prio++) {
+        if (!tuya_list_empty(&ai_basic_biz->queue[prio])) {
+            frame = tuya_list_entry(ai_basic_biz->queue[prio].next, AI_BIZ_FRAME_T, node);
+            tuya_list_del(&frame->node);
+            ai_basic_biz->queue_num[prio]--;
+            ai_basic_biz->sending++;
+            break;
+        }
+    }
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    return frame;
+}
+
+static void __ai_biz_frame_send(AI_BIZ_FRAME_T *frame)
 {
     OPERATE_RET rt = OPRT_OK;
-    uint32_t idx = 0, sidx = 0, kdx = 0;
-    while (tal_thread_get_state(ai_basic_biz->thread) == THREAD_STATE_RUNNING) {
-        if (!tuya_ai_client_is_ready()) {
-            tal_system_sleep(200);
-            continue;
+    uint32_t head_len = __ai_biz_head_len(frame->type);
+    char *buf = frame->data + AI_BIZ_HEAD_ROOM - head_len;
+    uint32_t latency = 0;
+
+    // the head is written in place in front of the payload
+    __ai_biz_pack_head(frame->id, frame->type, &frame->head, buf);
+    rt = __ai_biz_send_packed(&frame->attr, frame->type, buf, head_len + frame->head.len);
+    latency = (uint32_t)(tal_system_get_millisecond() - frame->push_ms);
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    ai_basic_biz->sending--;
+    if (OPRT_OK == rt) {
+        AI_BIZ_SEND_STAT_T *stat = &ai_basic_biz->stat;
+        stat->frame_num++;
+        stat->latency_avg = (stat->frame_num == 1) ? latency : (stat->latency_avg * 7 + latency) / 8;
+        if (latency > stat->latency_max) {
+            stat->latency_max = latency;
         }
-        tal_mutex_lock(ai_basic_biz->mutex);
-        uint16_t sent_ids[AI_MAX_SESSION_ID_NUM * AI_SESSION_MAX_NUM] = {0};
-        uint32_t sent_ids_count = 0;
-        for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
-            if (ai_basic_biz->session[idx].id[0] != 0) {
-                AI_SESSION_T *session = &ai_basic_biz->session[idx];
-                for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
-                    uint16_t send_id = session->cfg.send[sidx].id;
-                    uint8_t already_sent = false;
-                    for (kdx = 0; kdx < sent_ids_count; kdx++) {
-                        if (sent_ids[kdx] == send_id) {
-                            already_sent = true;
-                            break;
-                        }
+    } else {
+        ai_basic_biz->stat.drop_num++;
+    }
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    if (rt != OPRT_OK) {
+        PR_ERR("send biz frame failed, type:%d, rt:%d", frame->type, rt);
+    }
+    __ai_biz_frame_release(frame);
+}
+
+static void __ai_biz_frame_flush(void)
+{
+    AI_BIZ_FRAME_T *frame = NULL;
+
+    while (NULL != (frame = __ai_biz_frame_pop())) {
+        Free(frame);
+    }
+    while (!tuya_list_empty(&ai_basic_biz->pool)) {
+        frame = tuya_list_entry(ai_basic_biz->pool.next, AI_BIZ_FRAME_T, node);
+        tuya_list_del(&frame->node);
+        Free(frame);
+    }
+    ai_basic_biz->pool_num = 0;
+}
+
+/**
+ * @brief poll the sessions registered with get_cb
+ *
+ * @return TRUE if any session still needs to be polled
+ */
+static uint8_t __ai_biz_poll_send(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t idx = 0, sidx = 0, kdx = 0;
+    uint8_t need_poll = false;
+
+    tal_mutex_lock(ai_basic_biz->mutex);
+    uint16_t sent_ids[AI_MAX_SESSION_ID_NUM * AI_SESSION_MAX_NUM] = {0};
+    uint32_t sent_ids_count = 0;
+    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+        if (ai_basic_biz->session[idx].id[0] != 0) {
+            AI_SESSION_T *session = &ai_basic_biz->session[idx];
+            for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
+                uint16_t send_id = session->cfg.send[sidx].id;
+                uint8_t already_sent = false;
+                for (kdx = 0; kdx < sent_ids_count; kdx++) {
+                    if (sent_ids[kdx] == send_id) {
+                        already_sent = true;
+                        break;
                     }
-                    if (!already_sent) {
-                        sent_ids[sent_ids_count++] = send_id;
-                        AI_BIZ_SEND_DATA_T *send = &session->cfg.send[sidx];
-                        if (send->get_cb) {
-                            AI_BIZ_ATTR_INFO_T attr = {0};
-                            AI_BIZ_HEAD_INFO_T head = {0};
-                            char *payload = NULL;
-                            rt = send->get_cb(&attr, &head, &payload);
-                            if (rt != OPRT_OK) {
-                                continue;
-                            }
-                            tuya_ai_send_biz_pkt(send->id, &attr, send->type, &head, payload);
-                            if (send->free_cb) {
-                                send->free_cb(payload);
-                            }
+                }
+                if (!already_sent) {
+                    sent_ids[sent_ids_count++] = send_id;
+                    AI_BIZ_SEND_DATA_T *send = &session->cfg.send[sidx];
+                    if (send->get_cb) {
+                        need_poll = true;
+                        AI_BIZ_ATTR_INFO_T attr = {0};
+                        AI_BIZ_HEAD_INFO_T head = {0};
+                        char *payload = NULL;
+                        rt = send->get_cb(&attr, &head, &payload);
+                        if (rt != OPRT_OK) {
+                            continue;
+                        }
+                        tuya_ai_send_biz_pkt(send->id, &attr, send->type, &head, payload);
+                        if (send->free_cb) {
+                            send->free_cb(payload);
                         }
                     }
                 }
             }
         }
-        tal_mutex_unlock(ai_basic_biz->mutex);
-        tal_system_sleep(AI_BIZ_TASK_DELAY);
+    }
+    tal_mutex_unlock(ai_basic_biz->mutex);
+
+    return need_poll;
+}
+
+static void __ai_biz_thread_cb(void *args)
+{
+    AI_BIZ_FRAME_T *frame = NULL;
+    uint32_t timeout = SEM_WAIT_FOREVER;
+
+    while (tal_thread_get_state(ai_basic_biz->thread) == THREAD_STATE_RUNNING) {
+        if (!tuya_ai_client_is_ready()) {
+            tal_system_sleep(200);
+            continue;
+        }
+
+        // pushed frames first, an audio frame pushed meanwhile goes before the next image frame
+        while (NULL != (frame = __ai_biz_frame_pop())) {
+            __ai_biz_frame_send(frame);
+        }
+
+        // only sessions with get_cb need the periodic wakeup
+        timeout = __ai_biz_poll_send() ? AI_BIZ_TASK_DELAY : SEM_WAIT_FOREVER;
+        tal_semaphore_wait(ai_basic_biz->send_sem, timeout);
     }
 
     PR_NOTICE("ai biz thread exit");
@@ -261,9 +412,24 @@ static void __ai_biz_deinit(void)
 {
     if (ai_basic_biz) {
         if (ai_basic_biz->thread) {
-            tal_thread_delete(ai_basic_biz->thread);
+            // the send thread still uses the queues and the sem until it is gone
+            if (OPRT_OK == tal_thread_delete(ai_basic_biz->thread)) {
+                tal_semaphore_post(ai_basic_biz->send_sem);
+                while (THREAD_STATE_DELETE != tal_thread_get_state(ai_basic_biz->thread)) {
+                    tal_system_sleep(10);
+                }
+            }
             ai_basic_biz->thread = NULL;
         }
+        if (ai_basic_biz->frame_mutex) {
+            __ai_biz_frame_flush();
+            tal_mutex_release(ai_basic_biz->frame_mutex);
+            ai_basic_biz->frame_mutex = NULL;
+        }
+        if (ai_basic_biz->send_sem) {
+            tal_semaphore_release(ai_basic_biz->send_sem);
+            ai_basic_biz->send_sem = NULL;
+        }
         if (ai_basic_biz->mutex) {
             tal_mutex_release(ai_basic_biz->mutex);
             ai_basic_biz->mutex = NULL;
@@ -273,6 +439,136 @@ static void __ai_biz_deinit(void)
     }
 }
 
+char *tuya_ai_biz_frame_alloc(uint32_t len)
+{
+    AI_BIZ_FRAME_T *frame = NULL;
+    struct tuya_list_head *pos = NULL;
+
+    if (ai_basic_biz == NULL) {
+        PR_ERR("ai biz is null");
+        return NULL;
+    }
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    tuya_list_for_each(pos, &ai_basic_biz->pool)
+    {
+        if (tuya_list_entry(pos, AI_BIZ_FRAME_T, node)->size >= len) {
+            frame = tuya_list_entry(pos, AI_BIZ_FRAME_T, node);
+            tuya_list_del(&frame->node);
+            ai_basic_biz->pool_num--;
+            break;
+        }
+    }
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    if (NULL == frame) {
+        frame = Malloc(sizeof(AI_BIZ_FRAME_T) + AI_BIZ_HEAD_ROOM + len);
+        TUYA_CHECK_NULL_RETURN(frame, NULL);
+        frame->size = len;
+    }
+
+    return frame->data + AI_BIZ_HEAD_ROOM;
+}
+
+void tuya_ai_biz_frame_free(char *data)
+{
+    if (data) {
+        __ai_biz_frame_release(__ai_biz_frame_entry(data));
+    }
+}
+
+OPERATE_RET tuya_ai_biz_frame_push(uint16_t id, AI_PACKET_PT type, AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head,
+                                   char *data)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_BIZ_FRAME_T *frame = NULL;
+    int prio = __ai_biz_frame_prio(type);
+
+    if (NULL == data) {
+        return OPRT_INVALID_PARM;
+    }
+    frame = __ai_biz_frame_entry(data);
+    if ((ai_basic_biz == NULL) || (prio < 0) || (NULL == head) || (head->len > frame->size)) {
+        PR_ERR("push biz frame invalid, type:%d", type);
+        if (ai_basic_biz) {
+            __ai_biz_frame_release(frame);
+        } else {
+            Free(frame);
+        }
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(ai_basic_biz->mutex);
+    rt = __ai_biz_create_task();
+    tal_mutex_unlock(ai_basic_biz->mutex);
+    if (OPRT_OK != rt) {
+        __ai_biz_frame_release(frame);
+        return rt;
+    }
+
+    frame->id = id;
+    frame->type = type;
+    if (attr) {
+        memcpy(&frame->attr, attr, sizeof(AI_BIZ_ATTR_INFO_T));
+    } else {
+        memset(&frame->attr, 0, sizeof(AI_BIZ_ATTR_INFO_T));
+    }
+    memcpy(&frame->head, head, sizeof(AI_BIZ_HEAD_INFO_T));
+    frame->push_ms = tal_system_get_millisecond();
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    if (ai_basic_biz->queue_num[prio] >= AI_BIZ_FRAME_QUEUE_NUM) {
+        ai_basic_biz->stat.drop_num++;
+        tal_mutex_unlock(ai_basic_biz->frame_mutex);
+        PR_ERR("biz frame queue full, type:%d", type);
+        __ai_biz_frame_release(frame);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    tuya_list_add_tail(&frame->node, &ai_basic_biz->queue[prio]);
+    ai_basic_biz->queue_num[prio]++;
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    tal_semaphore_post(ai_basic_biz->send_sem);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_biz_frame_wait(uint32_t timeout_ms)
+{
+    uint32_t prio = 0;
+    uint32_t pending = 0;
+    SYS_TIME_T start = tal_system_get_millisecond();
+
+    if (ai_basic_biz == NULL) {
+        return OPRT_COM_ERROR;
+    }
+
+    do {
+        tal_mutex_lock(ai_basic_biz->frame_mutex);
+        pending = ai_basic_biz->sending;
+        for (prio = 0; prio < AI_BIZ_PRIO_NUM; prio++) {
+            pending += ai_basic_biz->queue_num[prio];
+        }
+        tal_mutex_unlock(ai_basic_biz->frame_mutex);
+        if (0 == pending) {
+            return OPRT_OK;
+        }
+        tal_system_sleep(AI_BIZ_TASK_DELAY);
+    } while (tal_system_get_millisecond() - start < timeout_ms);
+
+    return OPRT_TIMEOUT;
+}
+
+void tuya_ai_biz_get_send_stat(AI_BIZ_SEND_STAT_T *stat)
+{
+    if ((ai_basic_biz == NULL) || (NULL == stat)) {
+        return;
+    }
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    *stat = ai_basic_biz->stat;
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+}
+
 OPERATE_RET __ai_parse_video_attr(char *de_buf, uint32_t attr_len, AI_VIDEO_ATTR_T *video)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -812,6 +1108,12 @@ static OPERATE_RET __ai_clt_run_evt(void *data)
         TUYA_CHECK_NULL_RETURN(ai_basic_biz, OPRT_MALLOC_FAILED);
         memset(ai_basic_biz, 0, sizeof(AI_BASIC_BIZ_T));
         TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_biz->mutex), EXIT);
+        TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_biz->frame_mutex), EXIT);
+        TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ai_basic_biz->send_sem, 0, 1), EXIT);
+        for (uint32_t prio = 0; prio < AI_BIZ_PRIO_NUM; prio++) {
+            INIT_LIST_HEAD(&ai_basic_biz->queue[prio]);
+        }
+        INIT_LIST_HEAD(&ai_basic_biz->pool);
         tuya_ai_client_reg_cb(__ai_biz_recv_handle);
         PR_NOTICE("ai biz init success");
     }
@@ -904,6 +1206,8 @@ OPERATE_RET tuya_ai_biz_crt_session(uint32_t bizCode, AI_SESSION_CFG_T *cfg, uin
     }
     if (__ai_biz_need_send_task()) {
         __ai_biz_create_task();
+        // an idle send thread only wakes up by push, start polling the new get_cb
+        tal_semaphore_post(ai_basic_biz->send_sem);
     }
     tal_mutex_unlock(ai_basic_biz->mutex);
 
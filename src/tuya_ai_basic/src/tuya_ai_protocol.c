@@ -46,6 +46,12 @@
 #define AI_ADD_PKT_LEN            128
 #define AI_DEFAULT_BIZ_TAG        0
 
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
+#define AI_CRYPT_CIPHER_TYPE MBEDTLS_CIPHER_AES_256_CBC
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+#define AI_CRYPT_CIPHER_TYPE MBEDTLS_CIPHER_AES_256_GCM
+#endif
+
 #ifndef AI_READ_SOCKET_BUF_SIZE
 #define AI_READ_SOCKET_BUF_SIZE 0
 #endif
@@ -59,11 +65,14 @@
  * len:payload+sign
  * payload: AI_PAYLOAD_HEAD_T+(attr_len+AI_ATTRIBUTE_T)+data
  *
+ * send packets are packed, encrypted and signed in place in send_buf
+ *
  **/
 
 typedef struct {
     AI_FRAG_FLAG frag_flag;
     uint32_t offset;
+    uint32_t size;
     char *data;
 } AI_RECV_FRAG_MNG_T;
 
@@ -77,6 +86,8 @@ typedef struct {
     tuya_transporter_t transporter;
     char crypt_key[AI_KEY_LEN + 1];
     char sign_key[AI_KEY_LEN + 1];
+    cipher_keyed_t *crypt_cipher; // bound to crypt_key, CBC or GCM by security level
+    hmac_keyed_t *sign_hmac;      // bound to sign_key
     uint16_t sequence_in;
     uint16_t sequence_out;
     char crypt_random[AI_RANDOM_LEN + 1];
@@ -90,6 +101,7 @@ typedef struct {
     AI_SEND_FRAG_MNG_T send_frag_mng[2]; // 0:image,1:file
     bool frag_flag;
     char recv_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+    char send_buf[AI_MAX_FRAGMENT_LENGTH]; // protected by mutex
 } AI_BASIC_PROTO_T;
 
 static AI_BASIC_PROTO_T *ai_basic_proto = NULL;
@@ -144,6 +156,18 @@ static OPERATE_RET __ai_generate_crypt_key()
     rt = mbedtls_hkdf(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)slat, salt_len,
                       (const unsigned char *)ikm, ikm_len, (const unsigned char *)info, info_len,
                       (unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN);
+#ifdef AI_CRYPT_CIPHER_TYPE
+    if (OPRT_OK == rt) {
+        // expand the key once per connection instead of once per packet
+        if (ai_basic_proto->crypt_cipher) {
+            rt = mbedtls_cipher_keyed_setkey(ai_basic_proto->crypt_cipher,
+                                             (const unsigned char *)ai_basic_proto->crypt_key, AI_KEY_LEN);
+        } else {
+            rt = mbedtls_cipher_keyed_create(AI_CRYPT_CIPHER_TYPE, (const unsigned char *)ai_basic_proto->crypt_key,
+                                             AI_KEY_LEN, &ai_basic_proto->crypt_cipher);
+        }
+    }
+#endif
     return rt;
 }
 
@@ -170,14 +194,18 @@ static OPERATE_RET __ai_generate_sign_key()
     rt = mbedtls_hkdf(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)slat, salt_len,
                       (const unsigned char *)ikm, ikm_len, (const unsigned char *)info, info_len,
                       (unsigned char *)ai_basic_proto->sign_key, AI_KEY_LEN);
+    if (OPRT_OK == rt) {
+        if (ai_basic_proto->sign_hmac) {
+            rt = mbedtls_hmac_keyed_setkey(ai_basic_proto->sign_hmac, (const uint8_t *)ai_basic_proto->sign_key,
+                                           AI_KEY_LEN);
+        } else {
+            rt = mbedtls_hmac_keyed_create(MBEDTLS_MD_SHA256, (const uint8_t *)ai_basic_proto->sign_key, AI_KEY_LEN,
+                                           &ai_basic_proto->sign_hmac);
+        }
+    }
     return rt;
 }
 
-static char *__ai_get_sign_key(void)
-{
-    return ai_basic_proto->sign_key;
-}
-
 static AI_PACKET_SL __ai_get_sl(AI_PACKET_PT type, uint8_t is_decrypt)
 {
     if (is_decrypt) {
@@ -206,6 +234,8 @@ static void __ai_basic_proto_deinit(void)
             Free(ai_basic_proto->connection_id);
             ai_basic_proto->connection_id = NULL;
         }
+        mbedtls_cipher_keyed_free(ai_basic_proto->crypt_cipher);
+        mbedtls_hmac_keyed_free(ai_basic_proto->sign_hmac);
         Free(ai_basic_proto);
         ai_basic_proto = NULL;
     }
@@ -416,8 +446,7 @@ static uint32_t __ai_get_payload_len(char *buf)
 static OPERATE_RET __ai_packet_sign(char *buf, uint8_t *signature)
 {
     OPERATE_RET rt = OPRT_OK;
-    char *sign_key = __ai_get_sign_key();
-    TUYA_CHECK_NULL_RETURN(sign_key, OPRT_COM_ERROR);
+    TUYA_CHECK_NULL_RETURN(ai_basic_proto->sign_hmac, OPRT_COM_ERROR);
 
     uint32_t head_len = __ai_get_head_len(buf);
     uint32_t payload_len = __ai_get_payload_len(buf);
@@ -439,7 +468,7 @@ static OPERATE_RET __ai_packet_sign(char *buf, uint8_t *signature)
         sign_len = sizeof(sign_data);
     }
 
-    rt = tal_sha256_mac((uint8_t *)sign_key, AI_KEY_LEN, (uint8_t *)sign_data, sign_len, signature);
+    rt = mbedtls_hmac_keyed_digest(ai_basic_proto->sign_hmac, sign_data, sign_len, signature);
     if (OPRT_OK != rt) {
         PR_ERR("sign packet failed, rt:%d", rt);
     }
@@ -526,7 +555,7 @@ static int __ai_encrypt_add_pkcs(char *p, uint32_t len)
     return (len + cz);
 }
 
-static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t len, char *output, uint32_t *en_len)
+static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *buf, uint32_t len, uint32_t *en_len)
 {
     OPERATE_RET rt = OPRT_OK;
     int data_out_len = 0;
@@ -536,11 +565,10 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
     AI_PACKET_SL sl = __ai_get_sl(type, false);
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
+        data_out_len = __ai_encrypt_add_pkcs(buf, len);
         char nonce[12] = {0};
         memcpy(nonce, ai_basic_proto->encrypt_iv, sizeof(nonce));
-        rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)data, (uint8_t *)output);
+        rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)buf, (uint8_t *)buf);
         if (OPRT_OK != rt) {
             PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
@@ -549,10 +577,9 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        memcpy(output, data, len);
-        data_out_len = tal_pkcs7padding_buffer((uint8_t *)output, len);
-        rt = tal_aes256_cbc_encode_raw((uint8_t *)output, data_out_len, (uint8_t *)key,
-                                       (uint8_t *)ai_basic_proto->encrypt_iv, (uint8_t *)output);
+        data_out_len = tal_pkcs7padding_buffer((uint8_t *)buf, len);
+        rt = mbedtls_cipher_keyed_crypt_cbc(ai_basic_proto->crypt_cipher, MBEDTLS_ENCRYPT, data_out_len,
+                                            (uint8_t *)ai_basic_proto->encrypt_iv, (uint8_t *)buf, (uint8_t *)buf);
         if (OPRT_OK != rt) {
             PR_ERR("aes128_cbc_encode error:%d", rt);
             return rt;
@@ -562,8 +589,7 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
     } else if (sl == AI_PACKET_SL4) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
         uint8_t tag[AI_GCM_TAG_LEN] = {0};
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
+        data_out_len = __ai_encrypt_add_pkcs(buf, len);
 
         const cipher_params_t en_input = {
             .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
@@ -573,20 +599,22 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
             .nonce_len = AI_IV_LEN,
             .ad = NULL,
             .ad_len = 0,
-            .data = (uint8_t *)output,
+            .data = (uint8_t *)buf,
             .data_len = data_out_len,
         };
-        rt = mbedtls_cipher_auth_encrypt_wrapper(&en_input, (uint8_t *)output, (size_t *)en_len, tag, sizeof(tag));
+        size_t olen = 0;
+        rt = mbedtls_cipher_keyed_auth_encrypt(ai_basic_proto->crypt_cipher, &en_input, (uint8_t *)buf, &olen, tag,
+                                               sizeof(tag));
+        *en_len = olen;
         if (rt != OPRT_OK) {
             PR_ERR("aes128_gcm_encode error:%x", rt);
         }
-        memcpy(output + *en_len, tag, sizeof(tag));
+        memcpy(buf + *en_len, tag, sizeof(tag));
         *en_len += sizeof(tag);
         // tuya_debug_hex_dump("encrypt_data", 64, (uint8_t *)output, *en_len);
 #endif
     } else if (sl == AI_PACKET_SL0) {
         AI_PROTO_D("sl:%d do not need crypt", sl);
-        memcpy(output, data, len);
         *en_len = len;
     } else {
         PR_ERR("sl:%d err", sl);
@@ -616,8 +644,8 @@ static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, u
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        rt = tal_aes256_cbc_decode_raw((uint8_t *)data, len, (uint8_t *)key, (uint8_t *)ai_basic_proto->decrypt_iv,
-                                       (uint8_t *)output);
+        rt = mbedtls_cipher_keyed_crypt_cbc(ai_basic_proto->crypt_cipher, MBEDTLS_DECRYPT, len,
+                                            (uint8_t *)ai_basic_proto->decrypt_iv, (uint8_t *)data, (uint8_t *)output);
         if (OPRT_OK != rt) {
             PR_ERR("aes128_cbc_decode error:%d", rt);
             return rt;
@@ -642,8 +670,10 @@ static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, u
             .data_len = len - AI_GCM_TAG_LEN,
         };
 
-        rt = mbedtls_cipher_auth_decrypt_wrapper(&de_input, (uint8_t *)output, (size_t *)de_len,
-                                                 (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
+        size_t olen = 0;
+        rt = mbedtls_cipher_keyed_auth_decrypt(ai_basic_proto->crypt_cipher, &de_input, (uint8_t *)output, &olen,
+                                               (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
+        *de_len = olen;
         if (rt != OPRT_OK) {
             PR_ERR("aes128_gcm_decode error:%x", rt);
             return rt;
@@ -652,7 +682,9 @@ static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, u
 #endif
     } else if (sl == AI_PACKET_SL0) {
         AI_PROTO_D("sl:%d do not need crypt ", sl);
-        memcpy(output, data, len);
+        if (output != data) {
+            memcpy(output, data, len);
+        }
         *de_len = len;
     } else {
         AI_PROTO_D("sl:%d err", sl);
@@ -671,9 +703,8 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
     TUYA_CHECK_NULL_RETURN(info, OPRT_INVALID_PARM);
     packet_len = __ai_get_send_payload_len(info, frag);
 
-    char *buf = Malloc(packet_len);
-    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
-    memset(buf, 0, packet_len);
+    // packed straight into the packet and encrypted there
+    char *buf = payload_buf;
 
     if (tuya_ai_is_need_attr(frag)) {
         AI_PAYLOAD_HEAD_T payload_head = {0};
@@ -714,7 +745,6 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
                     memcpy(buf + offset, info->attrs[idx]->value.str, attr_idx_len);
                 } else {
                     PR_ERR("unknow payload type:%d", payload_type);
-                    Free(buf);
                     return OPRT_COM_ERROR;
                 }
                 offset += attr_idx_len;
@@ -733,12 +763,11 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
     AI_PROTO_D("payload len:%d, offset:%d", packet_len, offset);
 
     // tuya_debug_hex_dump("payload_uncrypt", 64, (uint8_t *)buf, packet_len);
-    rt = __ai_encrypt_packet(info->type, buf, packet_len, payload_buf, payload_len);
+    rt = __ai_encrypt_packet(info->type, buf, packet_len, payload_len);
     if (OPRT_OK != rt) {
         PR_ERR("encrypt packet failed, rt:%d", rt);
     }
 
-    Free(buf);
     return rt;
 }
 
@@ -864,9 +893,7 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         PR_ERR("send packet too long, len: %d", uncrypt_len);
         return OPRT_COM_ERROR;
     }
-    char *send_pkt_buf = Malloc(uncrypt_len);
-    TUYA_CHECK_NULL_RETURN(send_pkt_buf, OPRT_MALLOC_FAILED);
-    memset(send_pkt_buf, 0, uncrypt_len);
+    char *send_pkt_buf = ai_basic_proto->send_buf;
 
     uint32_t head_len = sizeof(AI_PACKET_HEAD_T);
     // AI_PROTO_D("head len:%d", head_len);
@@ -891,7 +918,7 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
 
     rt = __ai_pack_payload(info, send_pkt_buf + offset, &payload_len, frag, origin_len);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
     length = UNI_HTONL(payload_len + AI_SIGN_LEN);
 
@@ -903,7 +930,7 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
 
     rt = __ai_packet_sign(send_pkt_buf, signature);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
     offset += payload_len;
     memcpy(send_pkt_buf + offset, signature, AI_SIGN_LEN);
@@ -923,8 +950,6 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         rt = OPRT_OK;
     }
 
-EXIT:
-    Free(send_pkt_buf);
     return rt;
 }
 
@@ -1450,20 +1475,19 @@ static bool __ai_basic_get_frag_flag(void)
 {
     return ai_basic_proto->frag_flag;
 }
-OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+
+/* read one packet into recv_buf and check it, returns the head length, or the
+ * read result when nothing usable was read */
+static int __ai_basic_read_pkt(void)
 {
     OPERATE_RET rt = OPRT_OK;
     uint8_t calc_sign[AI_SIGN_LEN] = {0};
-    uint8_t packet_sign[AI_SIGN_LEN] = {0};
-    char *decrypt_buf = NULL;
     char *recv_buf = ai_basic_proto->recv_buf;
-    TUYA_CHECK_NULL_RETURN(recv_buf, OPRT_COM_ERROR);
 
-    memset(recv_buf, 0, sizeof(ai_basic_proto->recv_buf));
     AI_PROTO_D("recv packet ing");
     int recv_len = __ai_baisc_read_pkt_head(recv_buf);
     if (recv_len <= 0) {
-        goto EXIT;
+        return recv_len;
     }
 
     AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
@@ -1479,16 +1503,15 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
     AI_PROTO_D("recv head len:%d", head_len);
     AI_PROTO_D("recv packet len:%d", packet_len);
 
-    if (packet_len + head_len > sizeof(ai_basic_proto->recv_buf)) {
-        PR_ERR("recv packet too long, pkt len:%u, head len:%u", packet_len, head_len);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+    if ((packet_len < AI_SIGN_LEN) || (packet_len + head_len > sizeof(ai_basic_proto->recv_buf))) {
+        PR_ERR("recv packet len invalid, pkt len:%u, head len:%u", packet_len, head_len);
+        return OPRT_RESOURCE_NOT_READY;
     }
 
     uint16_t sequence = UNI_NTOHS(head->sequence);
     if (sequence <= ai_basic_proto->sequence_in) {
         PR_ERR("sequence error, in:%d, pre:%d", sequence, ai_basic_proto->sequence_in);
-        goto EXIT;
+        return OPRT_COM_ERROR;
     }
 
     ai_basic_proto->sequence_in = sequence;
@@ -1507,7 +1530,7 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
                 continue;
             }
             PR_ERR("continue read failed, rt:%d, %d", recv_len, continue_recv_len);
-            goto EXIT;
+            return recv_len;
         }
         offset += recv_len;
     }
@@ -1515,130 +1538,146 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
     rt = __ai_packet_sign(recv_buf, calc_sign);
     if (OPRT_OK != rt) {
         PR_ERR("packet sign failed, rt:%d", rt);
-        goto EXIT;
+        return OPRT_COM_ERROR;
     }
 
     AI_PROTO_D("sign ok");
-    uint32_t payload_len = __ai_get_payload_len(recv_buf);
-    char *payload = recv_buf + head_len;
-    memcpy(packet_sign, payload + payload_len, AI_SIGN_LEN);
-    if (memcmp(calc_sign, packet_sign, sizeof(calc_sign))) {
+    if (memcmp(calc_sign, recv_buf + head_len + packet_len - AI_SIGN_LEN, sizeof(calc_sign))) {
         PR_ERR("packet sign error");
-        // tuya_debug_hex_dump("calc_sign", AI_SIGN_LEN, calc_sign, AI_SIGN_LEN);
-        // tuya_debug_hex_dump("packet_sign", AI_SIGN_LEN, packet_sign, AI_SIGN_LEN);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+        return OPRT_RESOURCE_NOT_READY;
     }
 
-    uint32_t decrypt_len = 0;
-    decrypt_buf = Malloc(packet_len + head_len + AI_ADD_PKT_LEN);
-    TUYA_CHECK_NULL_RETURN(decrypt_buf, OPRT_MALLOC_FAILED);
-    memset(decrypt_buf, 0, packet_len + head_len + AI_ADD_PKT_LEN);
-    rt = __ai_decrypt_packet(payload, payload_len, decrypt_buf, &decrypt_len);
-    if (OPRT_OK != rt) {
-        PR_ERR("decrypt packet failed, rt:%d", rt);
-        goto EXIT;
-    }
-    AI_PROTO_D("decrypt len:%d", decrypt_len);
-    AI_PROTO_D("frag flag:%d, sdk frag flag:%d", head->frag_flag, __ai_basic_get_frag_flag());
+    return head_len;
+}
 
-    if (!__ai_basic_get_frag_flag()) {
+OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+{
+    OPERATE_RET rt = OPRT_OK;
+    char *decrypt_buf = NULL;
+    char *recv_buf = ai_basic_proto->recv_buf;
+    AI_RECV_FRAG_MNG_T *frag_mng = &ai_basic_proto->recv_frag_mng;
+    TUYA_CHECK_NULL_RETURN(recv_buf, OPRT_COM_ERROR);
+
+    // fragments are read in a loop and decrypted straight into the message
+    for (;;) {
+        int head_len = __ai_basic_read_pkt();
+        if (head_len <= 0) {
+            rt = head_len;
+            goto EXIT;
+        }
+
+        AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
         AI_FRAG_FLAG current_frag_flag = head->frag_flag;
-        AI_FRAG_FLAG last_frag_flag = ai_basic_proto->recv_frag_mng.frag_flag;
-        if ((last_frag_flag == AI_PACKET_FRAG_START) || (last_frag_flag == AI_PACKET_FRAG_ING)) {
-            if ((current_frag_flag != AI_PACKET_FRAG_ING) && (current_frag_flag != AI_PACKET_FRAG_END)) {
-                PR_ERR("recv start frag packet, but not continue %d, %d", current_frag_flag, last_frag_flag);
+        char *payload = recv_buf + head_len;
+        uint32_t payload_len = __ai_get_payload_len(recv_buf);
+        uint32_t decrypt_len = 0;
+        AI_PROTO_D("frag flag:%d, sdk frag flag:%d", current_frag_flag, __ai_basic_get_frag_flag());
+
+        bool frag_cont = (current_frag_flag == AI_PACKET_FRAG_ING) || (current_frag_flag == AI_PACKET_FRAG_END);
+        if (!__ai_basic_get_frag_flag()) {
+            AI_FRAG_FLAG last_frag_flag = frag_mng->frag_flag;
+            bool frag_pending = (last_frag_flag == AI_PACKET_FRAG_START) || (last_frag_flag == AI_PACKET_FRAG_ING);
+            if (frag_pending != frag_cont) {
+                PR_ERR("recv frag packet out of order %d, %d", current_frag_flag, last_frag_flag);
+                rt = OPRT_COM_ERROR;
+                goto EXIT;
+            }
+            AI_PROTO_D("frag mng info, flag:%d, offset:%d", frag_mng->frag_flag, frag_mng->offset);
+        }
+
+        if (__ai_basic_get_frag_flag() || ((current_frag_flag != AI_PACKET_FRAG_START) && !frag_cont)) {
+            decrypt_buf = Malloc(payload_len + AI_ADD_PKT_LEN);
+            if (!decrypt_buf) {
+                rt = OPRT_MALLOC_FAILED;
                 goto EXIT;
             }
+            rt = __ai_decrypt_packet(payload, payload_len, decrypt_buf, &decrypt_len);
+            if (OPRT_OK != rt) {
+                PR_ERR("decrypt packet failed, rt:%d", rt);
+                goto EXIT;
+            }
+            *out = decrypt_buf;
+            *out_len = decrypt_len;
+            *out_frag = __ai_basic_get_frag_flag() ? current_frag_flag : AI_PACKET_NO_FRAG;
+            break;
         }
 
-        AI_PROTO_D("frag flag:%d", head->frag_flag);
-        AI_PROTO_D("frag mng info, flag:%d, offset:%d", ai_basic_proto->recv_frag_mng.frag_flag,
-                   ai_basic_proto->recv_frag_mng.offset);
         if (current_frag_flag == AI_PACKET_FRAG_START) {
+            // the message size is only known once the first fragment is decrypted
             uint32_t origin_len = 0, frag_offset = 0, attr_len = 0, frag_total_len = 0;
-            AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)decrypt_buf;
+            rt = __ai_decrypt_packet(payload, payload_len, payload, &decrypt_len);
+            if (OPRT_OK != rt) {
+                PR_ERR("decrypt packet failed, rt:%d", rt);
+                goto EXIT;
+            }
+            AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)payload;
             if (pkt_head->attribute_flag == AI_HAS_ATTR) {
                 frag_offset = sizeof(AI_PAYLOAD_HEAD_T);
-                memcpy(&attr_len, decrypt_buf + frag_offset, sizeof(attr_len));
+                memcpy(&attr_len, payload + frag_offset, sizeof(attr_len));
                 frag_offset += sizeof(attr_len);
                 attr_len = UNI_NTOHL(attr_len);
                 frag_offset += attr_len;
-                memcpy(&origin_len, decrypt_buf + frag_offset, sizeof(origin_len));
+                memcpy(&origin_len, payload + frag_offset, sizeof(origin_len));
                 origin_len = UNI_NTOHL(origin_len);
                 AI_PROTO_D("recv start frag packet with attr, origin len:%d", origin_len);
             } else {
-                memcpy(&origin_len, decrypt_buf + sizeof(AI_PAYLOAD_HEAD_T), sizeof(origin_len));
+                memcpy(&origin_len, payload + sizeof(AI_PAYLOAD_HEAD_T), sizeof(origin_len));
                 origin_len = UNI_NTOHL(origin_len);
                 AI_PROTO_D("recv start frag packet, origin len:%d", origin_len);
             }
             if (origin_len <= decrypt_len) {
                 PR_ERR("origin len error, origin len:%d, decrypt len:%d", origin_len, decrypt_len);
+                rt = OPRT_COM_ERROR;
                 goto EXIT;
             }
-            memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(AI_RECV_FRAG_MNG_T));
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
+            memset(frag_mng, 0, sizeof(AI_RECV_FRAG_MNG_T));
             frag_total_len = origin_len + frag_offset + AI_ADD_PKT_LEN;
             AI_PROTO_D("frag_total_len %d", frag_total_len);
-            ai_basic_proto->recv_frag_mng.data = Malloc(frag_total_len);
-            if (!ai_basic_proto->recv_frag_mng.data) {
-                PR_ERR("malloc origin data failed len:%d", decrypt_len);
+            frag_mng->data = Malloc(frag_total_len);
+            if (!frag_mng->data) {
+                PR_ERR("malloc origin data failed len:%d", frag_total_len);
+                rt = OPRT_MALLOC_FAILED;
                 goto EXIT;
             }
-            AI_PROTO_D("malloc recv_frag_mng data addr %p", ai_basic_proto->recv_frag_mng.data);
-            memset(ai_basic_proto->recv_frag_mng.data, 0, frag_total_len);
-            memcpy(ai_basic_proto->recv_frag_mng.data, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.offset = decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue frag packet failed, rt:%d", rt);
-                goto EXIT;
-            }
-        } else if (current_frag_flag == AI_PACKET_FRAG_ING) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue ing frag packet failed, rt:%d", rt);
-                goto EXIT;
-            }
-        } else if (current_frag_flag == AI_PACKET_FRAG_END) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            *out = ai_basic_proto->recv_frag_mng.data;
-            *out_len = ai_basic_proto->recv_frag_mng.offset;
-            *out_frag = AI_PACKET_NO_FRAG;
-        } else {
-            *out = decrypt_buf;
-            *out_len = decrypt_len;
+            memcpy(frag_mng->data, payload, decrypt_len);
+            frag_mng->frag_flag = current_frag_flag;
+            frag_mng->offset = decrypt_len;
+            frag_mng->size = frag_total_len;
+            continue;
+        }
+
+        if (frag_mng->offset + payload_len > frag_mng->size) {
+            PR_ERR("frag packet overflow, offset:%d, len:%d, size:%d", frag_mng->offset, payload_len, frag_mng->size);
+            rt = OPRT_COM_ERROR;
+            goto EXIT;
+        }
+        rt = __ai_decrypt_packet(payload, payload_len, frag_mng->data + frag_mng->offset, &decrypt_len);
+        if (OPRT_OK != rt) {
+            PR_ERR("decrypt packet failed, rt:%d", rt);
+            goto EXIT;
+        }
+        frag_mng->frag_flag = current_frag_flag;
+        frag_mng->offset += decrypt_len;
+        if (current_frag_flag == AI_PACKET_FRAG_END) {
+            *out = frag_mng->data;
+            *out_len = frag_mng->offset;
             *out_frag = AI_PACKET_NO_FRAG;
+            break;
         }
-    } else {
-        *out = decrypt_buf;
-        *out_len = decrypt_len;
-        *out_frag = head->frag_flag;
     }
     AI_PROTO_D("recv packet len:%d", *out_len);
-    return rt;
+    return OPRT_OK;
 
 EXIT:
     if (decrypt_buf) {
         Free(decrypt_buf);
         decrypt_buf = NULL;
     }
-    if (ai_basic_proto->recv_frag_mng.data) {
-        Free(ai_basic_proto->recv_frag_mng.data);
+    if (frag_mng->data) {
+        Free(frag_mng->data);
     }
-    memset(&ai_basic_proto->recv_frag_mng, 0, SIZEOF(AI_RECV_FRAG_MNG_T));
-    return recv_len;
+    memset(frag_mng, 0, SIZEOF(AI_RECV_FRAG_MNG_T));
+    return rt;
 }
 
 OPERATE_RET tuya_parse_user_attrs(char *in, uint32_t attr_len, AI_ATTRIBUTE_T **attr_out, uint32_t *attr_num)
@@ -0,0 +1,305 @@
+/**
+ * @file ut_ai_biz.cpp
+ * @brief tuya_ai_biz pushed frame test cases, the send order of the stream
+ * queues, a full queue and the frame pool, and the capture to wire latency
+ * of audio frames sent directly and pushed while video frames are sent.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_ai_protocol_drv.h"
+#include "ut_ai_biz_drv.h"
+}
+
+#define BIZ_UT_AUDIO_ID   1
+#define BIZ_UT_VIDEO_ID   3
+#define BIZ_UT_TEXT_ID    5
+#define BIZ_UT_WAIT_MS    2000
+#define BIZ_UT_AUDIO_LEN  640
+#define BIZ_UT_VIDEO_LEN  (16 * 1024)
+#define BIZ_UT_AUDIO_NUM  200
+#define BIZ_UT_AUDIO_US   5000 // one audio frame every 5 ms
+#define BIZ_UT_VIDEO_US   40000
+#define BIZ_UT_WIRE_BYTES 1000 // bytes per ms on the wire, 8 Mbit/s
+
+typedef std::chrono::steady_clock::time_point UT_TIME_T;
+
+typedef struct {
+    uint16_t id;
+    uint32_t tag; // first 4 bytes of the frame payload
+    UT_TIME_T time;
+} BIZ_UT_PKT_T;
+
+static std::mutex s_pkt_mutex;
+static std::vector<BIZ_UT_PKT_T> s_pkts;
+static std::atomic<bool> s_wire_slow(false);
+
+static uint32_t __biz_ut_head_len(AI_PACKET_PT type)
+{
+    switch (type) {
+    case AI_PT_VIDEO:
+    case AI_PT_AUDIO:
+        return sizeof(AI_VIDEO_HEAD_T);
+    case AI_PT_IMAGE:
+        return sizeof(AI_IMAGE_HEAD_T);
+    default:
+        return sizeof(AI_FILE_HEAD_T);
+    }
+}
+
+// the biz head and the tag of every packet written, the wire takes its time if slow
+static void __biz_ut_capture(const uint8_t *buf, uint32_t len)
+{
+    std::vector<char> payload(AI_MAX_FRAGMENT_LENGTH);
+    AI_PACKET_HEAD_T head;
+    uint32_t payload_len = 0;
+    BIZ_UT_PKT_T pkt;
+
+    pkt.time = std::chrono::steady_clock::now();
+    ASSERT_EQ(OPRT_OK, ut_ai_proto_unpack(buf, len, &head, payload.data(), &payload_len));
+
+    // payload head, attributes if any, the whole length then the biz head
+    AI_PAYLOAD_HEAD_T *payload_head = (AI_PAYLOAD_HEAD_T *)payload.data();
+    uint32_t offset = sizeof(AI_PAYLOAD_HEAD_T);
+    if (AI_HAS_ATTR == payload_head->attribute_flag) {
+        uint32_t attr_len = 0;
+        memcpy(&attr_len, payload.data() + offset, sizeof(attr_len));
+        offset += sizeof(attr_len) + UNI_NTOHL(attr_len);
+    }
+    offset += sizeof(uint32_t);
+
+    uint16_t id = 0;
+    memcpy(&id, payload.data() + offset, sizeof(id));
+    pkt.id = UNI_NTOHS(id);
+    pkt.tag = 0;
+    offset += __biz_ut_head_len((AI_PACKET_PT)payload_head->type);
+    if (payload_len >= offset + sizeof(pkt.tag)) {
+        memcpy(&pkt.tag, payload.data() + offset, sizeof(pkt.tag));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_pkt_mutex);
+        s_pkts.push_back(pkt);
+    }
+    if (s_wire_slow) {
+        std::this_thread::sleep_for(std::chrono::microseconds(len * 1000 / BIZ_UT_WIRE_BYTES));
+    }
+}
+
+static OPERATE_RET __biz_ut_push(uint16_t id, AI_PACKET_PT type, uint32_t tag, uint32_t len)
+{
+    AI_BIZ_HEAD_INFO_T head;
+    char *data = tuya_ai_biz_frame_alloc(len);
+
+    if (NULL == data) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(data, 0, len);
+    memcpy(data, &tag, sizeof(tag));
+    memset(&head, 0, sizeof(head));
+    head.stream_flag = AI_STREAM_ING;
+    head.len = len;
+    return tuya_ai_biz_frame_push(id, type, NULL, &head, data);
+}
+
+static OPERATE_RET __biz_ut_send(uint16_t id, AI_PACKET_PT type, uint32_t tag, uint32_t len)
+{
+    AI_BIZ_HEAD_INFO_T head;
+    std::vector<char> data(len);
+
+    memcpy(data.data(), &tag, sizeof(tag));
+    memset(&head, 0, sizeof(head));
+    head.stream_flag = AI_STREAM_ING;
+    head.len = len;
+    return tuya_ai_send_biz_pkt(id, NULL, type, &head, data.data());
+}
+
+class AiBizTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        s_pkts.clear();
+        s_wire_slow = false;
+        ASSERT_EQ(OPRT_OK, ut_ai_biz_open());
+        ut_ai_proto_set_write_cb(__biz_ut_capture);
+    }
+
+    void TearDown() override
+    {
+        ut_ai_biz_close();
+    }
+};
+
+TEST_F(AiBizTest, queue_order)
+{
+    AI_BIZ_SEND_STAT_T stat;
+
+    // queued while the client is not ready, audio goes first, each stream keeps its order
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_TEXT_ID, AI_PT_TEXT, 1, 32));
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_VIDEO_ID, AI_PT_VIDEO, 2, 1024));
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, 3, BIZ_UT_AUDIO_LEN));
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_TEXT_ID, AI_PT_TEXT, 4, 32));
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, 5, BIZ_UT_AUDIO_LEN));
+    ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_VIDEO_ID, AI_PT_VIDEO, 6, 1024));
+    EXPECT_EQ(OPRT_TIMEOUT, tuya_ai_biz_frame_wait(50));
+    EXPECT_TRUE(s_pkts.empty());
+
+    ut_ai_biz_set_ready(TRUE);
+    ASSERT_EQ(OPRT_OK, tuya_ai_biz_frame_wait(BIZ_UT_WAIT_MS));
+
+    std::vector<uint32_t> tags;
+    for (auto &pkt : s_pkts) {
+        tags.push_back(pkt.tag);
+    }
+    EXPECT_EQ(std::vector<uint32_t>({3, 5, 2, 6, 1, 4}), tags);
+    EXPECT_EQ(BIZ_UT_AUDIO_ID, s_pkts[0].id);
+    EXPECT_EQ(BIZ_UT_VIDEO_ID, s_pkts[2].id);
+    EXPECT_EQ(BIZ_UT_TEXT_ID, s_pkts[4].id);
+
+    tuya_ai_biz_get_send_stat(&stat);
+    EXPECT_EQ(6u, stat.frame_num);
+    EXPECT_EQ(0u, stat.drop_num);
+}
+
+TEST_F(AiBizTest, pool_exhausted)
+{
+    UT_AI_PROTO_STAT_T proto;
+    AI_BIZ_SEND_STAT_T stat;
+    std::vector<char *> frames;
+
+    // a full stream queue drops the frame pushed, the other streams still queue
+    for (uint32_t i = 0; i < UT_AI_BIZ_FRAME_QUEUE_NUM; i++) {
+        ASSERT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, i, BIZ_UT_AUDIO_LEN));
+    }
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, __biz_ut_push(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, 100, BIZ_UT_AUDIO_LEN));
+    tuya_ai_biz_get_send_stat(&stat);
+    EXPECT_EQ(1u, stat.drop_num);
+    // the dropped frame went back to the pool, the next frame small enough takes it
+    EXPECT_EQ(1u, ut_ai_biz_pool_num());
+    EXPECT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_TEXT_ID, AI_PT_TEXT, 200, 32));
+    EXPECT_EQ(0u, ut_ai_biz_pool_num());
+
+    ut_ai_biz_set_ready(TRUE);
+    ASSERT_EQ(OPRT_OK, tuya_ai_biz_frame_wait(BIZ_UT_WAIT_MS));
+    ASSERT_EQ((size_t)UT_AI_BIZ_FRAME_QUEUE_NUM + 1, s_pkts.size());
+    for (uint32_t i = 0; i < UT_AI_BIZ_FRAME_QUEUE_NUM; i++) {
+        EXPECT_EQ(i, s_pkts[i].tag);
+    }
+    tuya_ai_biz_get_send_stat(&stat);
+    EXPECT_EQ(UT_AI_BIZ_FRAME_QUEUE_NUM + 1u, stat.frame_num);
+
+    // the pool keeps as many frames as configured, they are taken again without allocation
+    EXPECT_EQ((uint32_t)UT_AI_BIZ_FRAME_POOL_NUM, ut_ai_biz_pool_num());
+    ut_ai_proto_stat_reset();
+    for (uint32_t i = 0; i < UT_AI_BIZ_FRAME_POOL_NUM; i++) {
+        frames.push_back(tuya_ai_biz_frame_alloc(BIZ_UT_AUDIO_LEN));
+        ASSERT_NE(nullptr, frames.back());
+    }
+    ut_ai_proto_stat_get(&proto);
+    EXPECT_EQ(0u, proto.alloc_num);
+    EXPECT_EQ(0u, ut_ai_biz_pool_num());
+
+    // the pool exhausted, or no frame large enough, allocates
+    frames.push_back(tuya_ai_biz_frame_alloc(BIZ_UT_AUDIO_LEN));
+    ASSERT_NE(nullptr, frames.back());
+    ut_ai_proto_stat_get(&proto);
+    EXPECT_EQ(1u, proto.alloc_num);
+
+    tuya_ai_biz_frame_free(frames[0]);
+    frames.push_back(tuya_ai_biz_frame_alloc(BIZ_UT_VIDEO_LEN));
+    ASSERT_NE(nullptr, frames.back());
+    ut_ai_proto_stat_get(&proto);
+    EXPECT_EQ(2u, proto.alloc_num);
+    EXPECT_EQ(1u, ut_ai_biz_pool_num());
+
+    // frees beyond the pool size release the frame
+    for (size_t i = 1; i < frames.size(); i++) {
+        tuya_ai_biz_frame_free(frames[i]);
+    }
+    EXPECT_EQ((uint32_t)UT_AI_BIZ_FRAME_POOL_NUM, ut_ai_biz_pool_num());
+}
+
+TEST_F(AiBizTest, capture_to_wire_latency)
+{
+    s_wire_slow = true;
+    ut_ai_biz_set_ready(TRUE);
+
+    // audio captured every 5 ms while 16 KB video frames go out every 40 ms on an 8 Mbit/s wire,
+    // sent from the capture threads as before, then pushed to the biz send thread
+    for (bool push : {false, true}) {
+        std::vector<UT_TIME_T> captured(BIZ_UT_AUDIO_NUM);
+        std::vector<double> call_us;
+        std::atomic<bool> done(false);
+        uint32_t video_tag = 0;
+
+        s_pkts.clear();
+        std::thread video([&] {
+            while (!done) {
+                uint32_t tag = 0x10000 + video_tag++;
+                if (push) {
+                    __biz_ut_push(BIZ_UT_VIDEO_ID, AI_PT_VIDEO, tag, BIZ_UT_VIDEO_LEN);
+                } else {
+                    __biz_ut_send(BIZ_UT_VIDEO_ID, AI_PT_VIDEO, tag, BIZ_UT_VIDEO_LEN);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(BIZ_UT_VIDEO_US));
+            }
+        });
+
+        auto next = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < BIZ_UT_AUDIO_NUM; i++) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::microseconds(BIZ_UT_AUDIO_US);
+            captured[i] = std::chrono::steady_clock::now();
+            if (push) {
+                EXPECT_EQ(OPRT_OK, __biz_ut_push(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, i, BIZ_UT_AUDIO_LEN));
+            } else {
+                EXPECT_EQ(OPRT_OK, __biz_ut_send(BIZ_UT_AUDIO_ID, AI_PT_AUDIO, i, BIZ_UT_AUDIO_LEN));
+            }
+            call_us.push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - captured[i]).count());
+        }
+        done = true;
+        video.join();
+        if (push) {
+            ASSERT_EQ(OPRT_OK, tuya_ai_biz_frame_wait(BIZ_UT_WAIT_MS));
+        }
+
+        std::vector<double> latency_us;
+        uint32_t expect = 0;
+        {
+            std::lock_guard<std::mutex> lock(s_pkt_mutex);
+            for (auto &pkt : s_pkts) {
+                if (BIZ_UT_AUDIO_ID != pkt.id) {
+                    continue;
+                }
+                // audio frames keep their order, none are lost
+                EXPECT_EQ(expect++, pkt.tag);
+                latency_us.push_back(
+                    std::chrono::duration<double, std::micro>(pkt.time - captured[pkt.tag]).count());
+            }
+        }
+        ASSERT_EQ((uint32_t)BIZ_UT_AUDIO_NUM, expect);
+
+        std::sort(latency_us.begin(), latency_us.end());
+        std::sort(call_us.begin(), call_us.end());
+        auto pct = [](const std::vector<double> &v, double p) { return v[(size_t)(p * (v.size() - 1))]; };
+        printf("[ BENCH    ] %s: capture to wire p50 %6.0f us p99 %6.0f us max %6.0f us, capture thread blocked "
+               "p50 %6.0f us p99 %6.0f us max %6.0f us\n",
+               push ? "pushed" : "direct", pct(latency_us, 0.5), pct(latency_us, 0.99), latency_us.back(),
+               pct(call_us, 0.5), pct(call_us, 0.99), call_us.back());
+    }
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ut_ai_biz_drv.c
+ * @brief builds tuya_ai_biz.c with the client readiness in the hands of the
+ * cases, the frames go through the protocol of ut_ai_protocol_drv.c, the
+ * object replaces the one of the library in the test binary.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tuya_ai_client.h"
+
+#include "ut_ai_protocol_drv.h"
+#include "ut_ai_biz_drv.h"
+
+static volatile BOOL_T sg_ready;
+
+static uint8_t __ut_ai_client_is_ready(void)
+{
+    return sg_ready;
+}
+
+static void __ut_ai_client_reg_cb(AI_BASIC_DATA_HANDLE cb)
+{
+}
+
+#define AI_BIZ_FRAME_QUEUE_NUM  UT_AI_BIZ_FRAME_QUEUE_NUM
+#define AI_BIZ_FRAME_POOL_NUM   UT_AI_BIZ_FRAME_POOL_NUM
+#define tuya_ai_client_is_ready __ut_ai_client_is_ready
+#define tuya_ai_client_reg_cb   __ut_ai_client_reg_cb
+
+#include "../src/tuya_ai_biz.c"
+
+OPERATE_RET ut_ai_biz_open(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    sg_ready = FALSE;
+    rt = ut_ai_proto_open(AI_PACKET_SL0);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    return __ai_clt_run_evt(NULL);
+}
+
+void ut_ai_biz_close(void)
+{
+    __ai_biz_deinit();
+    ut_ai_proto_close();
+    sg_ready = FALSE;
+}
+
+void ut_ai_biz_set_ready(BOOL_T ready)
+{
+    sg_ready = ready;
+    if (ready && ai_basic_biz && ai_basic_biz->send_sem) {
+        tal_semaphore_post(ai_basic_biz->send_sem);
+    }
+}
+
+uint32_t ut_ai_biz_pool_num(void)
+{
+    uint32_t num = 0;
+
+    tal_mutex_lock(ai_basic_biz->frame_mutex);
+    num = ai_basic_biz->pool_num;
+    tal_mutex_unlock(ai_basic_biz->frame_mutex);
+
+    return num;
+}
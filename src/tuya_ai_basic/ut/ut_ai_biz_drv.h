@@ -0,0 +1,45 @@
+/**
+ * @file ut_ai_biz_drv.h
+ * @brief tuya_ai_biz on the tuya_ai_protocol socket stand-in of
+ * ut_ai_protocol_drv.h, the cases decide when the client is ready and see
+ * the frame pool, see ut_ai_biz_drv.c
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_AI_BIZ_DRV_H__
+#define __UT_AI_BIZ_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_biz.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UT_AI_BIZ_FRAME_QUEUE_NUM 16
+#define UT_AI_BIZ_FRAME_POOL_NUM  4
+
+/**
+ * @brief open the protocol stand-in at sl0 and init biz as the client run
+ * event does, the client is not ready
+ */
+OPERATE_RET ut_ai_biz_open(void);
+
+void ut_ai_biz_close(void);
+
+/**
+ * @brief the biz send thread only sends while the client is ready
+ */
+void ut_ai_biz_set_ready(BOOL_T ready);
+
+/**
+ * @brief frames kept in the pool for reuse
+ */
+uint32_t ut_ai_biz_pool_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_AI_BIZ_DRV_H__ */
@@ -0,0 +1,174 @@
+/**
+ * @file ut_ai_protocol.cpp
+ * @brief tuya_ai_protocol send path test cases, the packets built in place
+ * are signed and decrypt to the data sent, whole or fragmented, without any
+ * allocation, and a frames/s benchmark with the bytes copied per frame.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_ai_protocol_drv.h"
+}
+
+#define PROTO_UT_FRAME_NUM 2000
+
+static std::vector<std::string> s_packets;
+
+static void __proto_ut_capture(const uint8_t *buf, uint32_t len)
+{
+    s_packets.emplace_back((const char *)buf, len);
+}
+
+static std::string __proto_ut_data(uint32_t len)
+{
+    std::string data(len, 0);
+
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = (char)(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+static OPERATE_RET __proto_ut_send(AI_PACKET_PT type, std::string &data)
+{
+    AI_SEND_PACKET_T pkt;
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.type = type;
+    pkt.data = (char *)data.data();
+    pkt.len = data.size();
+    pkt.total_len = data.size();
+    return tuya_ai_basic_pkt_send(&pkt);
+}
+
+class AiProtocolTest : public ::testing::TestWithParam<AI_PACKET_SL> {
+  protected:
+    void SetUp() override
+    {
+        s_packets.clear();
+        ASSERT_EQ(OPRT_OK, ut_ai_proto_open(GetParam()));
+        ut_ai_proto_set_write_cb(__proto_ut_capture);
+    }
+
+    void TearDown() override
+    {
+        ut_ai_proto_close();
+    }
+
+    // the data carried by the packets captured, checked packet by packet
+    std::string unpack_all(uint32_t origin_len)
+    {
+        std::string data;
+        std::vector<char> payload(AI_MAX_FRAGMENT_LENGTH);
+        uint16_t sequence = 0;
+
+        for (size_t i = 0; i < s_packets.size(); i++) {
+            AI_PACKET_HEAD_T head;
+            uint32_t payload_len = 0;
+            EXPECT_EQ(OPRT_OK, ut_ai_proto_unpack((const uint8_t *)s_packets[i].data(), s_packets[i].size(), &head,
+                                                  payload.data(), &payload_len));
+            EXPECT_LE(s_packets[i].size(), (size_t)AI_MAX_FRAGMENT_LENGTH);
+            EXPECT_EQ(GetParam(), head.security_level);
+            if (i) {
+                EXPECT_EQ(sequence + 1, UNI_NTOHS(head.sequence));
+            }
+            sequence = UNI_NTOHS(head.sequence);
+
+            AI_FRAG_FLAG frag = AI_PACKET_NO_FRAG;
+            if (s_packets.size() > 1) {
+                frag = (0 == i) ? AI_PACKET_FRAG_START
+                                : (s_packets.size() - 1 == i) ? AI_PACKET_FRAG_END : AI_PACKET_FRAG_ING;
+            }
+            EXPECT_EQ(frag, head.frag_flag);
+
+            uint32_t offset = 0;
+            if (AI_PACKET_NO_FRAG == frag || AI_PACKET_FRAG_START == frag) {
+                // payload head, no attributes, then the length of the whole data
+                uint32_t len = 0;
+                memcpy(&len, payload.data() + sizeof(AI_PAYLOAD_HEAD_T), sizeof(len));
+                EXPECT_EQ(origin_len, UNI_NTOHL(len));
+                offset = sizeof(AI_PAYLOAD_HEAD_T) + sizeof(len);
+            }
+            data.append(payload.data() + offset, payload_len - offset);
+        }
+        return data;
+    }
+};
+
+TEST_P(AiProtocolTest, round_trip)
+{
+    for (uint32_t len : {1, 640, 16 * 1024, 50 * 1024}) {
+        std::string data = __proto_ut_data(len);
+        s_packets.clear();
+        ASSERT_EQ(OPRT_OK, __proto_ut_send(AI_PT_AUDIO, data));
+        EXPECT_EQ(len > AI_MAX_FRAGMENT_LENGTH ? 3u : 1u, s_packets.size()) << len;
+        EXPECT_TRUE(data == unpack_all(len)) << len;
+    }
+}
+
+TEST_P(AiProtocolTest, no_alloc)
+{
+    UT_AI_PROTO_STAT_T stat;
+    std::string data = __proto_ut_data(640);
+
+    ut_ai_proto_set_write_cb(NULL);
+    ut_ai_proto_stat_reset();
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(OPRT_OK, __proto_ut_send(AI_PT_AUDIO, data));
+    }
+    ut_ai_proto_stat_get(&stat);
+    EXPECT_EQ(0u, stat.alloc_num);
+    EXPECT_EQ(100u, stat.write_num);
+}
+
+TEST_P(AiProtocolTest, benchmark)
+{
+    ut_ai_proto_set_write_cb(NULL);
+
+    for (uint32_t len : {320, 640, 4096, 16 * 1024, 64 * 1024}) {
+        std::string data = __proto_ut_data(len);
+        UT_AI_PROTO_STAT_T stat;
+
+        // best of three runs, ns per frame
+        auto bench = [](const std::function<void()> &fn) {
+            double best = 0;
+            for (int r = 0; r < 3; r++) {
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                best = (0 == r || ns < best) ? ns : best;
+            }
+            return best / PROTO_UT_FRAME_NUM;
+        };
+
+        ut_ai_proto_stat_reset();
+        double ns = bench([&data] {
+            for (int i = 0; i < PROTO_UT_FRAME_NUM; i++) {
+                __proto_ut_send(AI_PT_AUDIO, data);
+            }
+        });
+        ut_ai_proto_stat_get(&stat);
+        uint32_t frame_num = 3 * PROTO_UT_FRAME_NUM;
+        EXPECT_EQ(0u, stat.alloc_num);
+
+        printf("[ BENCH    ] sl%u %6u bytes: %8.0f frames/s %7.1f MB/s, per frame %.1f packets %.1f allocs, %.1f "
+               "copies %.0f bytes copied %.0f bytes written\n",
+               GetParam(), len, 1e9 / ns, len * 1e3 / ns, (double)stat.write_num / frame_num,
+               (double)stat.alloc_num / frame_num, (double)stat.copy_num / frame_num,
+               (double)stat.copy_bytes / frame_num, (double)stat.write_bytes / frame_num);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(SecurityLevel, AiProtocolTest,
+                         ::testing::Values((AI_PACKET_SL)AI_PACKET_SL0, (AI_PACKET_SL)AI_PACKET_SECURITY_LEVEL));
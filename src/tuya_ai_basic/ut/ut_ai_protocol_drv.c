@@ -0,0 +1,166 @@
+/**
+ * @file ut_ai_protocol_drv.c
+ * @brief builds tuya_ai_protocol.c on a socket stand-in instead of the TCP
+ * transporter, with its memcpy counted, the object replaces the one of the
+ * library in the test binary.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tuya_transporter.h"
+#include "tuya_iot.h"
+#include "mbedtls/hkdf.h"
+#include "mbedtls/chacha20.h"
+#include "mix_method.h"
+#include "cJSON.h"
+#include "uni_random.h"
+#include "tal_hash.h"
+#include "cipher_wrapper.h"
+#include "tal_security.h"
+
+#include "ut_ai_protocol_drv.h"
+
+static UT_AI_PROTO_STAT_T sg_stat;
+static UT_AI_PROTO_WRITE_CB sg_write_cb;
+static tuya_iot_client_t sg_client;
+static uint8_t sg_socket; // the stand-in transporter handle
+
+/* every tal_malloc and tal_calloc of the test binary, linked with --wrap */
+void *__real_tal_malloc(size_t size);
+void *__real_tal_calloc(size_t nitems, size_t size);
+
+void *__wrap_tal_malloc(size_t size)
+{
+    sg_stat.alloc_num++;
+    return __real_tal_malloc(size);
+}
+
+void *__wrap_tal_calloc(size_t nitems, size_t size)
+{
+    sg_stat.alloc_num++;
+    return __real_tal_calloc(nitems, size);
+}
+
+static void *__ut_ai_memcpy(void *dst, const void *src, size_t n)
+{
+    sg_stat.copy_num++;
+    sg_stat.copy_bytes += n;
+    return memcpy(dst, src, n);
+}
+
+static tuya_iot_client_t *__ut_ai_iot_client_get(void)
+{
+    return &sg_client;
+}
+
+static OPERATE_RET __ut_ai_transporter_write(tuya_transporter_t transporter, uint8_t *buf, int len, int timeout_ms)
+{
+    sg_stat.write_num++;
+    sg_stat.write_bytes += len;
+    if (sg_write_cb) {
+        sg_write_cb(buf, len);
+    }
+    return len;
+}
+
+static OPERATE_RET __ut_ai_transporter_close(tuya_transporter_t transporter)
+{
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ut_ai_transporter_destroy(tuya_transporter_t transporter)
+{
+    return OPRT_OK;
+}
+
+#define memcpy                   __ut_ai_memcpy
+#define tuya_iot_client_get      __ut_ai_iot_client_get
+#define tuya_transporter_write   __ut_ai_transporter_write
+#define tuya_transporter_close   __ut_ai_transporter_close
+#define tuya_transporter_destroy __ut_ai_transporter_destroy
+
+#include "../src/tuya_ai_protocol.c"
+
+#undef memcpy
+
+OPERATE_RET ut_ai_proto_open(AI_PACKET_SL sl)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    strcpy(sg_client.activate.localkey, "ut_local_key_0123");
+    rt = __ai_basic_proto_init();
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+    ai_basic_proto->sl = sl;
+    ai_basic_proto->transporter = (tuya_transporter_t)&sg_socket;
+    ai_basic_proto->connected = TRUE;
+
+    return OPRT_OK;
+}
+
+void ut_ai_proto_close(void)
+{
+    __ai_basic_proto_deinit();
+    sg_write_cb = NULL;
+}
+
+void ut_ai_proto_set_write_cb(UT_AI_PROTO_WRITE_CB cb)
+{
+    sg_write_cb = cb;
+}
+
+OPERATE_RET ut_ai_proto_unpack(const uint8_t *pkt, uint32_t len, AI_PACKET_HEAD_T *head, char *payload,
+                               uint32_t *payload_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t signature[AI_SIGN_LEN] = {0};
+    char *buf = NULL;
+    uint32_t head_len = 0, packet_len = 0;
+
+    if (len < sizeof(AI_PACKET_HEAD_T) + sizeof(uint32_t) + AI_SIGN_LEN) {
+        return OPRT_INVALID_PARM;
+    }
+    buf = tal_malloc(len);
+    if (NULL == buf) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memcpy(buf, pkt, len);
+    memcpy(head, buf, sizeof(AI_PACKET_HEAD_T));
+
+    head_len = __ai_get_head_len(buf);
+    packet_len = __ai_get_packet_len(buf);
+    if (head_len + packet_len != len) {
+        rt = OPRT_COM_ERROR;
+        goto __exit;
+    }
+
+    rt = __ai_packet_sign(buf, signature);
+    if (OPRT_OK != rt || memcmp(signature, buf + len - AI_SIGN_LEN, AI_SIGN_LEN)) {
+        rt = OPRT_COM_ERROR;
+        goto __exit;
+    }
+
+    // one iv per connection, the fragments without it use it as well
+    memcpy(ai_basic_proto->decrypt_iv, ai_basic_proto->encrypt_iv, AI_IV_LEN);
+    rt = __ai_decrypt_packet(buf + head_len, packet_len - AI_SIGN_LEN, payload, payload_len);
+
+__exit:
+    tal_free(buf);
+    return rt;
+}
+
+void ut_ai_proto_stat_get(UT_AI_PROTO_STAT_T *stat)
+{
+    *stat = sg_stat;
+}
+
+void ut_ai_proto_stat_reset(void)
+{
+    memset(&sg_stat, 0, sizeof(sg_stat));
+}
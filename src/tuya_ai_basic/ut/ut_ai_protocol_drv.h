@@ -0,0 +1,64 @@
+/**
+ * @file ut_ai_protocol_drv.h
+ * @brief tuya_ai_protocol connected to a local socket stand-in, the cases see
+ * every packet written and count the allocations and copies of the send path,
+ * see ut_ai_protocol_drv.c
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_AI_PROTOCOL_DRV_H__
+#define __UT_AI_PROTOCOL_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t alloc_num;   // tal_malloc and tal_calloc calls
+    uint32_t copy_num;    // memcpy calls of tuya_ai_protocol.c
+    uint64_t copy_bytes;  // bytes moved by them
+    uint32_t write_num;   // packets written to the socket
+    uint64_t write_bytes; // bytes written to the socket
+} UT_AI_PROTO_STAT_T;
+
+typedef void (*UT_AI_PROTO_WRITE_CB)(const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief init the protocol and mark it connected to the stand-in
+ *
+ * @param[in] sl security level of the packets, AI_PACKET_SL0 or the one built in
+ */
+OPERATE_RET ut_ai_proto_open(AI_PACKET_SL sl);
+
+void ut_ai_proto_close(void);
+
+/**
+ * @brief called with every packet written, NULL to drop them
+ */
+void ut_ai_proto_set_write_cb(UT_AI_PROTO_WRITE_CB cb);
+
+/**
+ * @brief check the signature of a packet written and decrypt its payload
+ *
+ * @param[in] pkt the packet as written
+ * @param[in] len its length
+ * @param[out] head the packet head
+ * @param[out] payload room for the payload, AI_MAX_FRAGMENT_LENGTH
+ * @param[out] payload_len the payload length, padding removed
+ */
+OPERATE_RET ut_ai_proto_unpack(const uint8_t *pkt, uint32_t len, AI_PACKET_HEAD_T *head, char *payload,
+                               uint32_t *payload_len);
+
+void ut_ai_proto_stat_get(UT_AI_PROTO_STAT_T *stat);
+
+void ut_ai_proto_stat_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_AI_PROTOCOL_DRV_H__ */
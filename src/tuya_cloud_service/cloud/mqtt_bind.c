@@ -189,7 +189,7 @@ void mqtt_bind_token_get_thread(void *args)
             rt = tuya_mqtt_start(&mqbind->mqctx);
             if (OPRT_OK != rt) {
                 PR_ERR("tuya mqtt connect fail:%d, retry..", rt);
-                tal_system_sleep(1000);
+                tal_system_sleep(1000 + mqbind->mqctx.retry_delay_ms);
                 break;
             }
             mqbind->state = STATE_MQTT_BIND_CONNECTED_WAIT;
@@ -211,6 +211,9 @@ void mqtt_bind_token_get_thread(void *args)
 
         case STATE_MQTT_BIND_TOKEN_WAIT:
             tuya_mqtt_loop(&mqbind->mqctx);
+            if (mqbind->mqctx.retry_delay_ms) {
+                tal_system_sleep(mqbind->mqctx.retry_delay_ms);
+            }
             break;
 
         case STATE_MQTT_BIND_COMPLETE:
@@ -92,11 +92,142 @@ static int tuya_mqtt_signature_tool(const tuya_meta_info_t *input, tuya_mqtt_acc
     return OPRT_OK;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                          Subscription topic trie                           */
+/* -------------------------------------------------------------------------- */
+static size_t mqtt_topic_level_length(const char *level, size_t length)
+{
+    const char *end = memchr(level, '/', length);
+    return end ? (size_t)(end - level) : length;
+}
+
+static bool mqtt_topic_node_is(const mqtt_topic_node_t *node, char wildcard)
+{
+    return node->level_length == 1 && node->level[0] == wildcard;
+}
+
+/* node of a topic filter, the missing levels are created when create is true */
+static mqtt_topic_node_t *mqtt_topic_node_find(mqtt_topic_node_t *node, const char *topic, bool create)
+{
+    size_t length = strlen(topic);
+    size_t level_length;
+    mqtt_topic_node_t *child;
+
+    for (;;) {
+        level_length = mqtt_topic_level_length(topic, length);
+        for (child = node->child; child; child = child->sibling) {
+            if (child->level_length == level_length && !memcmp(child->level, topic, level_length)) {
+                break;
+            }
+        }
+
+        if (NULL == child) {
+            if (!create) {
+                return NULL;
+            }
+            child = tal_calloc(1, sizeof(mqtt_topic_node_t) + level_length);
+            if (NULL == child) {
+                return NULL;
+            }
+            child->level_length = level_length;
+            memcpy(child->level, topic, level_length);
+            child->sibling = node->child;
+            node->child = child;
+        }
+
+        node = child;
+        if (level_length == length) {
+            return node;
+        }
+        topic += level_length + 1;
+        length -= level_length + 1;
+    }
+}
+
+/* free the empty levels below a node, all of them when force is true */
+static void mqtt_topic_node_prune(mqtt_topic_node_t *node, bool force)
+{
+    mqtt_topic_node_t **target = &node->child;
+    mqtt_subscribe_handle_t *handle;
+
+    while (*target) {
+        mqtt_topic_node_t *entry = *target;
+        mqtt_topic_node_prune(entry, force);
+        while (force && entry->handle_list) {
+            handle = entry->handle_list;
+            entry->handle_list = handle->next;
+            tal_free(handle);
+        }
+        if (entry->child == NULL && entry->handle_list == NULL) {
+            *target = entry->sibling;
+            tal_free(entry);
+        } else {
+            target = &entry->sibling;
+        }
+    }
+}
+
+/* call the handles of a node, only count them when count is not NULL */
+static void mqtt_topic_node_notify(const mqtt_topic_node_t *node, uint16_t msgid, const mqtt_client_message_t *msg,
+                                   uint32_t *count)
+{
+    const mqtt_subscribe_handle_t *handle = node->handle_list;
+    for (; handle; handle = handle->next) {
+        if (count) {
+            (*count)++;
+        } else {
+            handle->cb(msgid, msg, handle->userdata);
+        }
+    }
+}
+
+/* match the topic levels left against the children of a node */
+static void mqtt_topic_node_dispatch(const mqtt_topic_node_t *node, const char *level, size_t length, bool first,
+                                     uint16_t msgid, const mqtt_client_message_t *msg, uint32_t *count)
+{
+    size_t level_length = mqtt_topic_level_length(level, length);
+    bool system = first && level_length > 0 && level[0] == '$'; // wildcards do not match $ topics
+    const mqtt_topic_node_t *child = node->child;
+    const mqtt_topic_node_t *multi;
+
+    for (; child; child = child->sibling) {
+        if (mqtt_topic_node_is(child, '#')) {
+            if (!system) {
+                mqtt_topic_node_notify(child, msgid, msg, count);
+            }
+            continue;
+        }
+
+        if (mqtt_topic_node_is(child, '+') ? system
+                                           : (child->level_length != level_length ||
+                                              memcmp(child->level, level, level_length))) {
+            continue;
+        }
+
+        if (level_length < length) {
+            mqtt_topic_node_dispatch(child, level + level_length + 1, length - level_length - 1, false, msgid, msg,
+                                     count);
+            continue;
+        }
+
+        mqtt_topic_node_notify(child, msgid, msg, count);
+        /* "a/#" matches "a" as well */
+        for (multi = child->child; multi; multi = multi->sibling) {
+            if (mqtt_topic_node_is(multi, '#')) {
+                mqtt_topic_node_notify(multi, msgid, msg, count);
+            }
+        }
+    }
+}
+
 /**
  * @brief Registers a callback function for handling MQTT subscribe messages.
  *
  * This function allows you to register a callback function that will be called
- * when an MQTT subscribe message is received.
+ * when an MQTT subscribe message is received. The topic may be a filter with
+ * the '+' and '#' wildcards. The default callback, used when cb is NULL,
+ * decrypts the payload in the client receive buffer when it is the only
+ * handler of the message, and into a copy otherwise.
  *
  * @param context The MQTT context.
  * @param topic The topic to subscribe to.
@@ -119,36 +250,38 @@ int tuya_mqtt_subscribe_message_callback_register(tuya_mqtt_context_t *context,
         return OPRT_COM_ERROR;
     }
 
+    if (cb == NULL) {
+        cb = on_subscribe_message_default;
+    }
+
+    /* LOCK */
+    mqtt_topic_node_t *node = mqtt_topic_node_find(&context->subscribe_root, topic, true);
+    if (!node) {
+        PR_ERR("malloc error");
+        mqtt_topic_node_prune(&context->subscribe_root, false);
+        return OPRT_MALLOC_FAILED;
+    }
+
     /* Repetition filter */
-    mqtt_subscribe_handle_t *target = context->subscribe_list;
-    while (target) {
-        if (!memcmp(target->topic, topic, target->topic_length) && target->cb == cb) {
+    mqtt_subscribe_handle_t *target = node->handle_list;
+    for (; target; target = target->next) {
+        if (target->cb == cb) {
             PR_WARN("Repetition:%s", topic);
             return OPRT_OK;
         }
-        target = target->next;
     }
 
     /* Intser new handle */
     mqtt_subscribe_handle_t *newtarget = tal_calloc(1, sizeof(mqtt_subscribe_handle_t));
     if (!newtarget) {
         PR_ERR("malloc error");
+        mqtt_topic_node_prune(&context->subscribe_root, false);
         return OPRT_MALLOC_FAILED;
     }
-
-    newtarget->topic_length = strlen(topic);
-    newtarget->topic = tal_calloc(1, newtarget->topic_length + 1); // strdup
-    strcpy(newtarget->topic, topic);
-
-    if (cb) {
-        newtarget->cb = cb;
-    } else {
-        newtarget->cb = on_subscribe_message_default;
-    }
+    newtarget->cb = cb;
     newtarget->userdata = userdata;
-    /* LOCK */
-    newtarget->next = context->subscribe_list;
-    context->subscribe_list = newtarget;
+    newtarget->next = node->handle_list;
+    node->handle_list = newtarget;
     /* UNLOCK */
     return OPRT_OK;
 }
@@ -172,20 +305,16 @@ int tuya_mqtt_subscribe_message_callback_unregister(tuya_mqtt_context_t *context
         return OPRT_INVALID_PARM;
     }
 
-    size_t topic_length = strlen(topic);
-
     /* LOCK */
-    /* Remove object form list */
-    mqtt_subscribe_handle_t **target = &context->subscribe_list;
-    while (*target) {
-        mqtt_subscribe_handle_t *entry = *target;
-        if (entry->topic_length == topic_length && !memcmp(topic, entry->topic, topic_length)) {
-            *target = entry->next;
-            tal_free(entry->topic);
+    /* Remove handles of the topic filter */
+    mqtt_topic_node_t *node = mqtt_topic_node_find(&context->subscribe_root, topic, false);
+    if (node) {
+        while (node->handle_list) {
+            mqtt_subscribe_handle_t *entry = node->handle_list;
+            node->handle_list = entry->next;
             tal_free(entry);
-        } else {
-            target = &entry->next;
         }
+        mqtt_topic_node_prune(&context->subscribe_root, false);
     }
     /* UNLOCK */
 
@@ -200,29 +329,72 @@ int tuya_mqtt_subscribe_message_callback_unregister(tuya_mqtt_context_t *context
 static void mqtt_subscribe_message_distribute(tuya_mqtt_context_t *context, uint16_t msgid,
                                               const mqtt_client_message_t *msg)
 {
-    const char *topic = msg->topic;
-    size_t topic_length = strlen(msg->topic);
+    uint32_t consumer_num = 0;
 
     /* LOCK */
-    mqtt_subscribe_handle_t *target = context->subscribe_list;
-    for (; target; target = target->next) {
-        if (target->topic_length == topic_length && !memcmp(topic, target->topic, target->topic_length)) {
-            target->cb(msgid, msg, target->userdata);
-        }
-    }
+    mqtt_topic_node_dispatch(&context->subscribe_root, msg->topic, msg->topic_length, true, msgid, msg,
+                             &consumer_num);
+    context->subscribe_consumer_num = consumer_num;
+    mqtt_topic_node_dispatch(&context->subscribe_root, msg->topic, msg->topic_length, true, msgid, msg, NULL);
     /* UNLOCK */
 }
 
 /* -------------------------------------------------------------------------- */
 /*                       Tuya internal subscribe message                      */
 /* -------------------------------------------------------------------------- */
-static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, const uint8_t *payload, size_t payload_len)
+/* protocol id from the top level "protocol" key of a message, -1 if absent */
+static int tuya_protocol_id_scan(const char *json, size_t len)
+{
+    const char *end = json + len;
+    const char *key = NULL;
+    int depth = 0;
+    int id = 0;
+
+    for (; json < end; json++) {
+        if (*json == '{' || *json == '[') {
+            depth++;
+        } else if (*json == '}' || *json == ']') {
+            depth--;
+        } else if (*json == '"') {
+            key = ++json;
+            while (json < end && *json != '"') {
+                json += (*json == '\\') ? 2 : 1;
+            }
+            if (json >= end) {
+                return -1;
+            }
+            if (depth != 1 || json - key != 8 || memcmp(key, "protocol", 8)) {
+                continue;
+            }
+            for (json++; json < end && (*json == ' ' || *json == ':'); json++) {
+            }
+            if (json >= end || *json < '0' || *json > '9') {
+                continue;
+            }
+            for (; json < end && *json >= '0' && *json <= '9'; json++) {
+                id = id * 10 + (*json - '0');
+            }
+            return id;
+        }
+    }
+
+    return -1;
+}
+
+static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, const uint8_t *payload, size_t payload_len,
+                                               bool inplace)
 {
     int ret = OPRT_OK;
 
+    /* in the client receive buffer jsonstr lives until we return, a copy is freed */
     char *jsonstr = NULL;
-    ret = tuya_parse_protocol_data(DP_CMD_MQ, (uint8_t *)payload, payload_len, context->signature.cipherkey,
-                                   (char **)&jsonstr);
+    if (inplace) {
+        ret = tuya_parse_protocol_data_inplace(DP_CMD_MQ, (uint8_t *)payload, payload_len, context->cipher,
+                                               (char **)&jsonstr);
+    } else {
+        ret = tuya_parse_protocol_data_keyed(DP_CMD_MQ, (uint8_t *)payload, payload_len, context->cipher,
+                                             (char **)&jsonstr);
+    }
     if (OPRT_OK != ret) {
         PR_ERR("Cmd Parse Fail:%d", ret);
         return OPRT_COM_ERROR;
@@ -230,61 +402,312 @@ static int tuya_protocol_message_parse_process(tuya_mqtt_context_t *context, con
 
     PR_DEBUG("Data JSON:%s", jsonstr);
 
+    /* the cJSON tree is only built when a handler of the protocol wants it */
+    size_t jsonstr_len = strlen(jsonstr);
+    int protocol_id = tuya_protocol_id_scan(jsonstr, jsonstr_len);
+    tuya_protocol_handle_t *bucket = NULL;
+    tuya_protocol_handle_t *target = NULL;
+    bool need_json = (protocol_id < 0);
+
+    if (protocol_id >= 0) {
+        bucket = context->protocol_table[protocol_id & (TUYA_PROTOCOL_TABLE_SIZE - 1)];
+        for (target = bucket; target; target = target->next) {
+            if (target->id == protocol_id && !target->raw) {
+                need_json = true;
+            }
+        }
+    }
+
     /* json parse */
     cJSON *root = NULL;
     cJSON *json = NULL;
-    root = cJSON_Parse((const char *)jsonstr);
-    tal_free(jsonstr);
-    if (NULL == root) {
-        PR_ERR("JSON parse error");
-        return OPRT_CJSON_PARSE_ERR;
-    }
+    if (need_json) {
+        root = cJSON_Parse((const char *)jsonstr);
+        if (NULL == root) {
+            PR_ERR("JSON parse error");
+            if (!inplace) {
+                tal_free(jsonstr);
+            }
+            return OPRT_CJSON_PARSE_ERR;
+        }
 
-    /* JSON key verfiy */
-    if ((NULL == cJSON_GetObjectItem(root, "protocol")) || (NULL == cJSON_GetObjectItem(root, "t")) ||
-        (NULL == cJSON_GetObjectItem(root, "data"))) {
-        PR_ERR("param is no correct");
-        cJSON_Delete(root);
-        return OPRT_CJSON_GET_ERR;
-    }
+        /* JSON key verfiy */
+        if ((NULL == cJSON_GetObjectItem(root, "protocol")) || (NULL == cJSON_GetObjectItem(root, "t")) ||
+            (NULL == cJSON_GetObjectItem(root, "data"))) {
+            PR_ERR("param is no correct");
+            cJSON_Delete(root);
+            if (!inplace) {
+                tal_free(jsonstr);
+            }
+            return OPRT_CJSON_GET_ERR;
+        }
 
-    /* protocol ID */
-    int protocol_id = cJSON_GetObjectItem(root, "protocol")->valueint;
-    json = cJSON_GetObjectItem(root, "data");
-    if (NULL == json) {
-        PR_ERR("get json err");
-        cJSON_Delete(root);
-        return OPRT_CJSON_GET_ERR;
+        /* protocol ID */
+        protocol_id = cJSON_GetObjectItem(root, "protocol")->valueint;
+        json = cJSON_GetObjectItem(root, "data");
+        if (NULL == json) {
+            PR_ERR("get json err");
+            cJSON_Delete(root);
+            if (!inplace) {
+                tal_free(jsonstr);
+            }
+            return OPRT_CJSON_GET_ERR;
+        }
+        bucket = context->protocol_table[protocol_id & (TUYA_PROTOCOL_TABLE_SIZE - 1)];
     }
 
     /* dispatch */
     tuya_protocol_event_t event;
     event.event_id = protocol_id;
-    event.root_json = root;
-    event.data = cJSON_GetObjectItem(root, "data");
+    event.raw = jsonstr;
+    event.raw_len = jsonstr_len;
 
     /* LOCK */
-    tuya_protocol_handle_t *target = context->protocol_list;
-    for (; target; target = target->next) {
+    for (target = bucket; target; target = target->next) {
         if (target->id == protocol_id) {
+            event.root_json = target->raw ? NULL : root;
+            event.data = target->raw ? NULL : cJSON_GetObjectItem(root, "data");
             event.user_data = target->user_data, target->cb(&event);
         }
     }
     /* UNLOCK */
 
     cJSON_Delete(root);
+    if (!inplace) {
+        tal_free(jsonstr);
+    }
     return OPRT_OK;
 }
 
 static void on_subscribe_message_default(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
 {
     tuya_mqtt_context_t *context = (tuya_mqtt_context_t *)userdata;
-    int ret = tuya_protocol_message_parse_process(context, msg->payload, msg->length);
+    /* the other handlers of the message must see the ciphertext */
+    bool inplace = (1 == context->subscribe_consumer_num);
+    int ret = tuya_protocol_message_parse_process(context, msg->payload, msg->length, inplace);
     if (ret != OPRT_OK) {
         PR_ERR("protocol message parse error:%d", ret);
     }
 }
 
+/* -------------------------------------------------------------------------- */
+/*                         QoS1 publish inflight table                        */
+/* -------------------------------------------------------------------------- */
+/* deadline a is before b, wrap safe */
+#define PUBLISH_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+static uint32_t mqtt_publish_heap_key(tuya_mqtt_context_t *context, uint8_t pos)
+{
+    return context->publish_slot[context->publish_heap[pos]].timeout;
+}
+
+static void mqtt_publish_heap_set(tuya_mqtt_context_t *context, uint8_t pos, uint8_t slot)
+{
+    context->publish_heap[pos] = slot;
+    context->publish_slot[slot].heap_pos = pos;
+}
+
+static void mqtt_publish_heap_fix(tuya_mqtt_context_t *context, uint8_t pos)
+{
+    uint8_t slot = context->publish_heap[pos];
+    uint32_t key = context->publish_slot[slot].timeout;
+    uint8_t child;
+
+    /* sift up */
+    while (pos > 0 && PUBLISH_BEFORE(key, mqtt_publish_heap_key(context, (pos - 1) / 2))) {
+        mqtt_publish_heap_set(context, pos, context->publish_heap[(pos - 1) / 2]);
+        pos = (pos - 1) / 2;
+    }
+
+    /* sift down */
+    while ((child = pos * 2 + 1) < context->publish_num) {
+        if (child + 1 < context->publish_num &&
+            PUBLISH_BEFORE(mqtt_publish_heap_key(context, child + 1), mqtt_publish_heap_key(context, child))) {
+            child++;
+        }
+        if (!PUBLISH_BEFORE(mqtt_publish_heap_key(context, child), key)) {
+            break;
+        }
+        mqtt_publish_heap_set(context, pos, context->publish_heap[child]);
+        pos = child;
+    }
+
+    mqtt_publish_heap_set(context, pos, slot);
+}
+
+static int mqtt_publish_index_find(tuya_mqtt_context_t *context, uint16_t msgid)
+{
+    uint8_t pos = msgid % MQTT_PUBLISH_INDEX_SIZE;
+
+    while (context->publish_index[pos]) {
+        if (context->publish_slot[context->publish_index[pos] - 1].msgid == msgid) {
+            return pos;
+        }
+        pos = (pos + 1) % MQTT_PUBLISH_INDEX_SIZE;
+    }
+
+    return -1;
+}
+
+static void mqtt_publish_index_insert(tuya_mqtt_context_t *context, uint8_t slot)
+{
+    uint8_t pos = context->publish_slot[slot].msgid % MQTT_PUBLISH_INDEX_SIZE;
+
+    while (context->publish_index[pos]) {
+        pos = (pos + 1) % MQTT_PUBLISH_INDEX_SIZE;
+    }
+    context->publish_index[pos] = slot + 1;
+}
+
+/* linear probing removal, shift back the entries probed past the hole */
+static void mqtt_publish_index_remove(tuya_mqtt_context_t *context, uint8_t pos)
+{
+    uint8_t hole = pos, home;
+
+    context->publish_index[hole] = 0;
+    for (;;) {
+        pos = (pos + 1) % MQTT_PUBLISH_INDEX_SIZE;
+        if (0 == context->publish_index[pos]) {
+            break;
+        }
+        home = context->publish_slot[context->publish_index[pos] - 1].msgid % MQTT_PUBLISH_INDEX_SIZE;
+        if ((hole <= pos) ? (hole < home && home <= pos) : (hole < home || home <= pos)) {
+            continue;
+        }
+        context->publish_index[hole] = context->publish_index[pos];
+        context->publish_index[pos] = 0;
+        hole = pos;
+    }
+}
+
+static void mqtt_publish_send(tuya_mqtt_context_t *context, uint8_t slot)
+{
+    mqtt_publish_handle_t *handle = &context->publish_slot[slot];
+
+    handle->msgid = mqtt_client_publish(context->mqtt_client, handle->topic, handle->payload, handle->payload_length,
+                                        MQTT_QOS_1);
+    if (handle->msgid <= 0) {
+        return;
+    }
+
+    if (handle->send_cnt++) {
+        context->publish_stat.retransmit++;
+    }
+    handle->send_time = tal_system_get_millisecond();
+    context->publish_unsent--;
+    mqtt_publish_index_insert(context, slot);
+}
+
+/* take a handle out of the table, the caller notifies and frees the payload */
+static void mqtt_publish_remove(tuya_mqtt_context_t *context, uint8_t slot, mqtt_publish_handle_t *out)
+{
+    mqtt_publish_handle_t *handle = &context->publish_slot[slot];
+    uint8_t pos = handle->heap_pos;
+    int index;
+
+    if (handle->msgid > 0) {
+        index = mqtt_publish_index_find(context, handle->msgid);
+        if (index >= 0) {
+            mqtt_publish_index_remove(context, index);
+        }
+    } else {
+        context->publish_unsent--;
+    }
+
+    context->publish_num--;
+    if (pos < context->publish_num) {
+        mqtt_publish_heap_set(context, pos, context->publish_heap[context->publish_num]);
+        mqtt_publish_heap_fix(context, pos);
+    }
+
+    *out = *handle;
+    memset(handle, 0, sizeof(mqtt_publish_handle_t));
+}
+
+/* the payload is owned by the table from now on, freed on failure too */
+static int mqtt_publish_add(tuya_mqtt_context_t *context, const char *topic, uint8_t *payload, size_t payload_length,
+                            mqtt_publish_notify_cb_t cb, void *user_data, int timeout_ms, bool async)
+{
+    mqtt_publish_handle_t *handle = NULL;
+    uint8_t slot;
+
+    tal_mutex_lock(context->publish_mutex);
+    if (context->publish_num >= MQTT_PUBLISH_INFLIGHT_MAX) {
+        context->publish_stat.window_full++;
+        tal_mutex_unlock(context->publish_mutex);
+        tal_free(payload);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    for (slot = 0; context->publish_slot[slot].cb; slot++) {
+    }
+    handle = &context->publish_slot[slot];
+    handle->msgid = 0;
+    handle->send_cnt = 0;
+    handle->topic = (char *)topic;
+    handle->timeout = tal_system_get_millisecond() + timeout_ms;
+    handle->cb = cb;
+    handle->user_data = user_data;
+    handle->payload = payload;
+    handle->payload_length = payload_length;
+
+    context->publish_heap[context->publish_num] = slot;
+    handle->heap_pos = context->publish_num++;
+    mqtt_publish_heap_fix(context, handle->heap_pos);
+    context->publish_unsent++;
+
+    /* publish under the lock so the PUBACK can not come before the index */
+    if (async == false) {
+        mqtt_publish_send(context, slot);
+    }
+    tal_mutex_unlock(context->publish_mutex);
+
+    return OPRT_OK;
+}
+
+/* sent publishes are lost with the connection, send them again after reconnect */
+static void mqtt_publish_requeue(tuya_mqtt_context_t *context)
+{
+    uint8_t slot;
+
+    tal_mutex_lock(context->publish_mutex);
+    memset(context->publish_index, 0, sizeof(context->publish_index));
+    for (slot = 0; slot < MQTT_PUBLISH_INFLIGHT_MAX; slot++) {
+        if (context->publish_slot[slot].cb && context->publish_slot[slot].msgid > 0) {
+            context->publish_slot[slot].msgid = 0;
+            context->publish_unsent++;
+        }
+    }
+    tal_mutex_unlock(context->publish_mutex);
+}
+
+/* time out expired publishes and send the pending ones */
+static void mqtt_publish_process(tuya_mqtt_context_t *context)
+{
+    mqtt_publish_handle_t entry;
+    uint32_t now = tal_system_get_millisecond();
+    uint8_t slot;
+
+    tal_mutex_lock(context->publish_mutex);
+    while (context->publish_num > 0 && !PUBLISH_BEFORE(now, mqtt_publish_heap_key(context, 0))) {
+        mqtt_publish_remove(context, context->publish_heap[0], &entry);
+        context->publish_stat.timeout++;
+        tal_mutex_unlock(context->publish_mutex);
+
+        entry.cb(OPRT_TIMEOUT, entry.user_data);
+        tal_free(entry.payload);
+
+        tal_mutex_lock(context->publish_mutex);
+    }
+
+    for (slot = 0; slot < MQTT_PUBLISH_INFLIGHT_MAX && context->publish_unsent > 0; slot++) {
+        if (context->publish_slot[slot].cb && context->publish_slot[slot].msgid <= 0) {
+            mqtt_publish_send(context, slot);
+        }
+    }
+    tal_mutex_unlock(context->publish_mutex);
+}
+
 /* -------------------------------------------------------------------------- */
 /*                         MQTT Client event callback                         */
 /* -------------------------------------------------------------------------- */
@@ -309,6 +732,7 @@ static void mqtt_client_disconnected_cb(void *client, void *userdata)
     tuya_mqtt_context_t *context = (tuya_mqtt_context_t *)userdata;
     PR_INFO("mqtt client disconnected!");
     context->is_connected = false;
+    mqtt_publish_requeue(context);
     if (context->on_disconnect) {
         context->on_disconnect(context, context->user_data);
     }
@@ -320,7 +744,7 @@ static void mqtt_client_message_cb(void *client, uint16_t msgid, const mqtt_clie
     tuya_mqtt_context_t *context = (tuya_mqtt_context_t *)userdata;
 
     /* topic filter */
-    PR_DEBUG("recv message TopicName:%s, payload len:%d", msg->topic, msg->length);
+    PR_DEBUG("recv message TopicName:%.*s, payload len:%d", (int)msg->topic_length, msg->topic, msg->length);
     mqtt_subscribe_message_distribute(context, msgid, msg);
 }
 
@@ -335,22 +759,33 @@ static void mqtt_client_puback_cb(void *client, uint16_t msgid, void *userdata)
 {
     client = client;
     tuya_mqtt_context_t *context = (tuya_mqtt_context_t *)userdata;
+    mqtt_publish_handle_t entry;
+    uint32_t rtt;
+    int index;
+
     PR_DEBUG("PUBACK ID:%d", msgid);
 
-    /* LOCK */
-    /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
-        if (msgid == entry->msgid) {
-            entry->cb(OPRT_OK, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
-            break;
-        }
+    tal_mutex_lock(context->publish_mutex);
+    index = mqtt_publish_index_find(context, msgid);
+    if (index < 0) {
+        tal_mutex_unlock(context->publish_mutex);
+        return;
     }
-    /* UNLOCK */
+    mqtt_publish_remove(context, context->publish_index[index] - 1, &entry);
+
+    rtt = tal_system_get_millisecond() - entry.send_time;
+    if (rtt > context->publish_stat.ack_rtt_max) {
+        context->publish_stat.ack_rtt_max = rtt;
+    }
+    if (0 == context->publish_stat.acked++) {
+        context->publish_stat.ack_rtt_avg = rtt;
+    } else {
+        context->publish_stat.ack_rtt_avg = (context->publish_stat.ack_rtt_avg * 7 + rtt) / 8;
+    }
+    tal_mutex_unlock(context->publish_mutex);
+
+    entry.cb(OPRT_OK, entry.user_data);
+    tal_free(entry.payload);
 }
 
 /**
@@ -392,6 +827,19 @@ int tuya_mqtt_init(tuya_mqtt_context_t *context, const tuya_mqtt_config_t *confi
         return rt;
     }
 
+    /* key schedule of the payload cipher, reused by every publish and message */
+    rt = mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, (const unsigned char *)context->signature.cipherkey,
+                                     16, &context->cipher);
+    if (OPRT_OK != rt) {
+        PR_ERR("mqtt cipher create error:%d", rt);
+        return rt;
+    }
+
+    rt = tal_mutex_create_init(&context->publish_mutex);
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
     /* MQTT Client object new */
     context->mqtt_client = mqtt_client_new();
     if (context->mqtt_client == NULL) {
@@ -457,6 +905,7 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
     PR_INFO("topic_out:%s", context->signature.topic_out);
     PR_INFO("tuya_mqtt_start...");
     context->manual_disconnect = false;
+    context->retry_delay_ms = 0;
 
     mqtt_client_status_t mqtt_status;
 
@@ -479,7 +928,7 @@ int tuya_mqtt_start(tuya_mqtt_context_t *context)
             PR_WARN("Connection to the MQTT server failed. Retrying "
                     "connection after %hu ms backoff.",
                     (unsigned short)nextRetryBackOff);
-            tal_system_sleep(nextRetryBackOff + 10000);
+            context->retry_delay_ms = nextRetryBackOff + 10000;
         }
         return OPRT_COM_ERROR;
     }
@@ -511,31 +960,18 @@ int tuya_mqtt_stop(tuya_mqtt_context_t *context)
     return OPRT_OK;
 }
 
-/**
- * @brief Registers a MQTT protocol with the given context.
- *
- * This function registers a MQTT protocol with the specified context. The
- * protocol is identified by the protocol ID. When a message with the registered
- * protocol ID is received, the provided callback function will be called.
- *
- * @param[in] context The MQTT context to register the protocol with.
- * @param[in] protocol_id The ID of the protocol to register.
- * @param[in] cb The callback function to be called when a message with the
- * registered protocol ID is received.
- * @param[in] user_data User data to be passed to the callback function.
- *
- * @return 0 on success, negative error code on failure.
- */
-int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
-                                void *user_data)
+static int tuya_mqtt_protocol_handle_add(tuya_mqtt_context_t *context, uint16_t protocol_id,
+                                        tuya_protocol_callback_t cb, void *user_data, bool raw)
 {
     if (context == NULL || context->is_inited == false || cb == NULL) {
         return OPRT_INVALID_PARM;
     }
 
+    tuya_protocol_handle_t **bucket = &context->protocol_table[protocol_id & (TUYA_PROTOCOL_TABLE_SIZE - 1)];
+
     /* LOCK */
     /* Repetition filter */
-    tuya_protocol_handle_t *target = context->protocol_list;
+    tuya_protocol_handle_t *target = *bucket;
     while (target) {
         if (target->id == protocol_id && target->cb == cb) {
             return OPRT_COM_ERROR;
@@ -548,15 +984,57 @@ int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_
         return OPRT_MALLOC_FAILED;
     }
     new_handle->id = protocol_id;
+    new_handle->raw = raw;
     new_handle->cb = cb;
     new_handle->user_data = user_data;
-    new_handle->next = context->protocol_list;
-    context->protocol_list = new_handle;
+    new_handle->next = *bucket;
+    *bucket = new_handle;
     /* UNLOCK */
 
     return OPRT_OK;
 }
 
+/**
+ * @brief Registers a MQTT protocol with the given context.
+ *
+ * This function registers a MQTT protocol with the specified context. The
+ * protocol is identified by the protocol ID. When a message with the registered
+ * protocol ID is received, the provided callback function will be called.
+ *
+ * @param[in] context The MQTT context to register the protocol with.
+ * @param[in] protocol_id The ID of the protocol to register.
+ * @param[in] cb The callback function to be called when a message with the
+ * registered protocol ID is received.
+ * @param[in] user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, negative error code on failure.
+ */
+int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                void *user_data)
+{
+    return tuya_mqtt_protocol_handle_add(context, protocol_id, cb, user_data, false);
+}
+
+/**
+ * @brief Registers a MQTT protocol handler that takes the decrypted text.
+ *
+ * The handler gets the decrypted JSON in event->raw and event->raw_len, with
+ * root_json and data set to NULL. When every handler of a message is raw the
+ * message is not parsed into a cJSON tree.
+ *
+ * @param[in] context The MQTT context to register the protocol with.
+ * @param[in] protocol_id The ID of the protocol to register.
+ * @param[in] cb The callback function.
+ * @param[in] user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, negative error code on failure.
+ */
+int tuya_mqtt_protocol_register_raw(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                    void *user_data)
+{
+    return tuya_mqtt_protocol_handle_add(context, protocol_id, cb, user_data, true);
+}
+
 /**
  * Unregisters a protocol from the Tuya MQTT service.
  *
@@ -577,7 +1055,7 @@ int tuya_mqtt_protocol_unregister(tuya_mqtt_context_t *context, uint16_t protoco
 
     /* LOCK */
     /* Remove object form list */
-    tuya_protocol_handle_t **target = &context->protocol_list;
+    tuya_protocol_handle_t **target = &context->protocol_table[protocol_id & (TUYA_PROTOCOL_TABLE_SIZE - 1)];
     while (*target) {
         tuya_protocol_handle_t *entry = *target;
         if (entry->id == protocol_id && entry->cb == cb) {
@@ -610,16 +1088,18 @@ int tuya_mqtt_protocol_unregister_all(tuya_mqtt_context_t *context)
     /* LOCK */
     /* Remove object form list */
     tuya_protocol_handle_t *entry = NULL;
-    tuya_protocol_handle_t *target = context->protocol_list;
-    while (target) {
-        entry = target;
-        target = entry->next;
-        tal_free(entry);
+    tuya_protocol_handle_t *target = NULL;
+    for (int i = 0; i < TUYA_PROTOCOL_TABLE_SIZE; i++) {
+        target = context->protocol_table[i];
+        while (target) {
+            entry = target;
+            target = entry->next;
+            tal_free(entry);
+        }
+        context->protocol_table[i] = NULL;
     }
     /* UNLOCK */
 
-    context->protocol_list = NULL;
-
     return OPRT_OK;
 }
 
@@ -654,38 +1134,11 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
         return OPRT_OK;
     }
 
-    mqtt_publish_handle_t *handle = tal_malloc(sizeof(mqtt_publish_handle_t));
-    TUYA_CHECK_NULL_RETURN(handle, OPRT_MALLOC_FAILED);
-    handle->next = NULL;
-    handle->msgid = 0;
-    handle->topic = (char *)topic;
-    handle->timeout = tal_time_get_posix() + timeout_ms;
-    handle->cb = cb;
-    handle->user_data = user_data;
-    handle->payload_length = payload_length;
-    handle->payload = tal_malloc(payload_length);
-    if (handle->payload == NULL) {
-        return OPRT_MALLOC_FAILED;
-    }
-    memcpy(handle->payload, payload, payload_length);
-
-    if (async == false) {
-        handle->msgid = mqtt_client_publish(context->mqtt_client, handle->topic, handle->payload,
-                                            handle->payload_length, MQTT_QOS_1);
-    }
-
-    if (context->publish_list == NULL) {
-        context->publish_list = handle;
-        return OPRT_OK;
-    }
-
-    mqtt_publish_handle_t *last = context->publish_list;
-    while (last->next != NULL) {
-        last = last->next;
-    }
-    last->next = handle;
+    uint8_t *copy = tal_malloc(payload_length);
+    TUYA_CHECK_NULL_RETURN(copy, OPRT_MALLOC_FAILED);
+    memcpy(copy, payload, payload_length);
 
-    return OPRT_OK;
+    return mqtt_publish_add(context, topic, copy, payload_length, cb, user_data, timeout_ms, async);
 }
 
 /**
@@ -720,21 +1173,31 @@ int tuya_mqtt_protocol_data_publish_with_topic_common(tuya_mqtt_context_t *conte
 
     int ret = OPRT_OK;
 
-    char *buffer = NULL;
+    /* the frame is built and encrypted in this one buffer */
+    uint32_t buffer_size = tuya_pack_protocol_data_size(DP_CMD_MQ, (const char *)data);
     uint32_t buffer_len = 0;
+    uint8_t *buffer = tal_malloc(buffer_size);
+    if (buffer == NULL) {
+        return OPRT_MALLOC_FAILED;
+    }
 
-    ret = tuya_pack_protocol_data(DP_CMD_MQ, (const char *)data, protocol_id, (uint8_t *)context->signature.cipherkey,
-                                  &buffer, &buffer_len);
+    ret = tuya_pack_protocol_data_into(DP_CMD_MQ, (const char *)data, protocol_id, context->cipher, buffer,
+                                       buffer_size, &buffer_len);
     if (ret != OPRT_OK) {
         PR_ERR("tuya_pack_protocol_data error:%d", ret);
+        tal_free(buffer);
         return ret;
     }
 
-    /* mqtt client publish */
-    ret = tuya_mqtt_client_publish_common(context, (const char *)topic, (const uint8_t *)buffer, buffer_len, cb,
-                                          user_data, timeout_ms, async);
-    tal_free(buffer);
-    return ret;
+    /* mqtt client publish, QoS1 keeps the packed buffer instead of a copy */
+    if (cb == NULL) {
+        ret = tuya_mqtt_client_publish_common(context, (const char *)topic, (const uint8_t *)buffer, buffer_len, cb,
+                                              user_data, timeout_ms, async);
+        tal_free(buffer);
+        return ret;
+    }
+
+    return mqtt_publish_add(context, topic, buffer, buffer_len, cb, user_data, timeout_ms, async);
 }
 
 /**
@@ -810,7 +1273,9 @@ int tuya_mqtt_protocol_data_publish(tuya_mqtt_context_t *context, uint16_t proto
  *
  * This function is responsible for processing incoming MQTT messages and
  * handling MQTT events for the Tuya MQTT service. It should be called
- * periodically to ensure proper functioning of the MQTT service.
+ * periodically to ensure proper functioning of the MQTT service. It does not
+ * wait after a failed reconnect, the caller waits context->retry_delay_ms
+ * before calling it again.
  *
  * @param context Pointer to the Tuya MQTT context structure.
  * @return Returns 0 on success, or a negative error code on failure.
@@ -828,8 +1293,9 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
         return rt;
     }
 
-    /* reconnect */
+    /* reconnect, a failure leaves the back-off in retry_delay_ms */
     if (context->is_connected == false) {
+        context->retry_delay_ms = 0;
         mqtt_status = mqtt_client_connect(context->mqtt_client);
         if (mqtt_status == MQTT_STATUS_NOT_AUTHORIZED) {
             if (context->on_unbind) {
@@ -844,33 +1310,15 @@ int tuya_mqtt_loop(tuya_mqtt_context_t *context)
                 PR_WARN("Connection to the MQTT server failed. Retrying "
                         "connection after %hu ms backoff.",
                         (unsigned short)nextRetryBackOff);
-                tal_system_sleep(nextRetryBackOff);
+                context->retry_delay_ms = nextRetryBackOff;
                 return rt;
             }
         }
         return rt;
     }
 
-    /* LOCK */
     /* publish async process */
-    mqtt_publish_handle_t **next_handle = &context->publish_list;
-    for (; *next_handle; next_handle = &(*next_handle)->next) {
-        mqtt_publish_handle_t *entry = *next_handle;
-
-        if (entry->timeout <= tal_time_get_posix()) {
-            entry->cb(OPRT_TIMEOUT, entry->user_data);
-            *next_handle = entry->next;
-            tal_free(entry->payload);
-            tal_free(entry);
-            continue;
-        }
-
-        if (entry->msgid <= 0) {
-            entry->msgid =
-                mqtt_client_publish(context->mqtt_client, entry->topic, entry->payload, entry->payload_length, 1);
-        }
-    }
-    /* UNLOCK */
+    mqtt_publish_process(context);
 
     /* yield */
     mqtt_client_yield(context->mqtt_client);
@@ -894,6 +1342,7 @@ int tuya_mqtt_destory(tuya_mqtt_context_t *context)
     }
 
     tuya_mqtt_protocol_unregister_all(context);
+    mqtt_topic_node_prune(&context->subscribe_root, true);
     if (context->mqtt_client) {
         mqtt_client_status_t mqtt_status = mqtt_client_deinit(context->mqtt_client);
         mqtt_client_free(context->mqtt_client);
@@ -903,6 +1352,20 @@ int tuya_mqtt_destory(tuya_mqtt_context_t *context)
         }
     }
 
+    if (context->publish_mutex) {
+        for (uint8_t slot = 0; slot < MQTT_PUBLISH_INFLIGHT_MAX; slot++) {
+            tal_free(context->publish_slot[slot].payload);
+        }
+        memset(context->publish_slot, 0, sizeof(context->publish_slot));
+        context->publish_num = 0;
+        context->publish_unsent = 0;
+        tal_mutex_release(context->publish_mutex);
+        context->publish_mutex = NULL;
+    }
+
+    mbedtls_cipher_keyed_free(context->cipher);
+    context->cipher = NULL;
+
     return OPRT_OK;
 }
 
@@ -923,6 +1386,27 @@ bool tuya_mqtt_connected(tuya_mqtt_context_t *context)
     return context->is_connected;
 }
 
+/**
+ * @brief Gets the QoS1 publish statistics of the MQTT context.
+ *
+ * @param context The MQTT context.
+ * @param stat Output of the statistics.
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_publish_stat_get(tuya_mqtt_context_t *context, tuya_mqtt_publish_stat_t *stat)
+{
+    if (context == NULL || stat == NULL || context->publish_mutex == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(context->publish_mutex);
+    *stat = context->publish_stat;
+    stat->inflight = context->publish_num;
+    tal_mutex_unlock(context->publish_mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Reports the progress of an upgrade operation over MQTT.
  *
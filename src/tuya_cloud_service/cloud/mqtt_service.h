@@ -30,6 +30,9 @@ extern "C" {
 #include "cJSON.h"
 #include "mqtt_client_interface.h"
 #include "backoff_algorithm.h"
+#include "tuya_config_defaults.h"
+#include "tal_mutex.h"
+#include "cipher_wrapper.h"
 
 // data max len
 #define TUYA_MQTT_CLIENTID_MAXLEN   (32U)
@@ -125,9 +128,11 @@ typedef struct {
 
 typedef struct {
     uint16_t event_id;
-    cJSON *root_json;
-    cJSON *data;
+    cJSON *root_json; // NULL for raw handlers
+    cJSON *data;      // NULL for raw handlers
     void *user_data;
+    const char *raw;  // decrypted JSON text, valid during the callback
+    size_t raw_len;
 } tuya_protocol_event_t;
 
 typedef tuya_protocol_event_t tuya_mqtt_event_t; // compat TODO:remove
@@ -137,40 +142,77 @@ typedef void (*tuya_protocol_callback_t)(tuya_protocol_event_t *event);
 typedef struct tuya_protocol_handle {
     struct tuya_protocol_handle *next;
     uint16_t id;
+    bool raw; // called with the decrypted text, no cJSON tree
     tuya_protocol_callback_t cb;
     void *user_data;
 } tuya_protocol_handle_t;
 
+/* protocol handlers are hashed by id, must be a power of 2 */
+#ifndef TUYA_PROTOCOL_TABLE_SIZE
+#define TUYA_PROTOCOL_TABLE_SIZE (16)
+#endif
+
 typedef void (*mqtt_subscribe_message_cb_t)(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata);
 
 typedef struct mqtt_subscribe_handle {
     struct mqtt_subscribe_handle *next;
-    char *topic;
-    size_t topic_length;
     mqtt_subscribe_message_cb_t cb;
     void *userdata;
 } mqtt_subscribe_handle_t;
 
+/* one topic level of the subscription trie, '+' and '#' are levels too */
+typedef struct mqtt_topic_node {
+    struct mqtt_topic_node *child;
+    struct mqtt_topic_node *sibling;
+    mqtt_subscribe_handle_t *handle_list; // subscriptions ending at this level
+    uint16_t level_length;
+    char level[0];
+} mqtt_topic_node_t;
+
 typedef void (*mqtt_publish_notify_cb_t)(int result, void *user_data);
 
 typedef struct mqtt_publish_handle {
-    struct mqtt_publish_handle *next;
-    uint16_t msgid;
-    int timeout;
+    uint16_t msgid;     // 0 until sent
+    uint8_t heap_pos;   // position in the timeout heap
+    uint8_t send_cnt;
+    uint32_t timeout;   // deadline, tal_system_get_millisecond
+    uint32_t send_time; // last send, tal_system_get_millisecond
     char *topic;
-    uint8_t *payload;
+    uint8_t *payload; // owned by the handle
     size_t payload_length;
-    mqtt_publish_notify_cb_t cb;
+    mqtt_publish_notify_cb_t cb; // NULL when the slot is free
     void *user_data;
 } mqtt_publish_handle_t;
 
+/* msgid hash of the inflight table, twice the window to keep probes short */
+#define MQTT_PUBLISH_INDEX_SIZE (MQTT_PUBLISH_INFLIGHT_MAX * 2)
+
+typedef struct {
+    uint32_t inflight;    // publishes waiting to be sent or acked
+    uint32_t window_full; // publishes refused because the window was full
+    uint32_t retransmit;  // publishes sent again after a reconnect
+    uint32_t acked;
+    uint32_t timeout;
+    uint32_t ack_rtt_max; // ms
+    uint32_t ack_rtt_avg; // ms, smoothed
+} tuya_mqtt_publish_stat_t;
+
 typedef struct {
     void *mqtt_client;
     tuya_mqtt_access_t signature;
-    tuya_protocol_handle_t *protocol_list;
-    mqtt_subscribe_handle_t *subscribe_list;
-    mqtt_publish_handle_t *publish_list;
+    cipher_keyed_t *cipher; // bound to signature.cipherkey for the context lifetime
+    tuya_protocol_handle_t *protocol_table[TUYA_PROTOCOL_TABLE_SIZE];
+    mqtt_topic_node_t subscribe_root;
+    uint32_t subscribe_consumer_num; // handlers of the message being dispatched
+    MUTEX_HANDLE publish_mutex;
+    mqtt_publish_handle_t publish_slot[MQTT_PUBLISH_INFLIGHT_MAX];
+    uint8_t publish_index[MQTT_PUBLISH_INDEX_SIZE]; // by msgid, slot + 1, 0 is empty
+    uint8_t publish_heap[MQTT_PUBLISH_INFLIGHT_MAX]; // slots, earliest deadline first
+    uint8_t publish_num;
+    uint8_t publish_unsent;
+    tuya_mqtt_publish_stat_t publish_stat;
     BackoffAlgorithmContext_t backoff_algorithm;
+    uint32_t retry_delay_ms; // wait before the next tuya_mqtt_start or tuya_mqtt_loop after a failed connect
     uint32_t sequence_in;
     uint32_t sequence_out;
     bool manual_disconnect;
@@ -198,6 +240,8 @@ int tuya_mqtt_init(tuya_mqtt_context_t *context, const tuya_mqtt_config_t *confi
  * @brief Starts the MQTT service.
  *
  * This function starts the MQTT service using the provided MQTT context.
+ * It does not wait after a failed connect, the caller waits
+ * context->retry_delay_ms before trying again.
  *
  * @param context The MQTT context to be used for starting the service.
  * @return Returns 0 on success, or a negative error code on failure.
@@ -265,6 +309,23 @@ bool tuya_mqtt_connected(tuya_mqtt_context_t *context);
 int tuya_mqtt_protocol_register(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
                                 void *user_data);
 
+/**
+ * @brief Registers a MQTT protocol handler that takes the decrypted text.
+ *
+ * The handler gets the decrypted JSON in event->raw and event->raw_len, with
+ * root_json and data set to NULL. When every handler of a message is raw the
+ * message is not parsed into a cJSON tree.
+ *
+ * @param context The MQTT context to register the protocol with.
+ * @param protocol_id The ID of the protocol to register.
+ * @param cb The callback function.
+ * @param user_data User data to be passed to the callback function.
+ *
+ * @return 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_protocol_register_raw(tuya_mqtt_context_t *context, uint16_t protocol_id, tuya_protocol_callback_t cb,
+                                    void *user_data);
+
 /**
  * @brief Unregisters a MQTT protocol with the specified protocol ID and
  * callback function.
@@ -372,7 +433,9 @@ int tuya_mqtt_protocol_data_publish_with_topic_common(tuya_mqtt_context_t *conte
  * @param user_data User data to be passed to the callback function.
  * @param timeout_ms The timeout for the publish operation in milliseconds.
  * @param async Whether to perform the publish operation asynchronously or not.
- * @return 0 on success, or a negative error code on failure.
+ * @return 0 on success, OPRT_EXCEED_UPPER_LIMIT if MQTT_PUBLISH_INFLIGHT_MAX
+ * publishes with a callback are still waiting for PUBACK, or another negative
+ * error code on failure.
  */
 int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *topic, const uint8_t *payload,
                                     size_t payload_length, mqtt_publish_notify_cb_t cb, void *user_data, int timeout_ms,
@@ -382,7 +445,8 @@ int tuya_mqtt_client_publish_common(tuya_mqtt_context_t *context, const char *to
  * @brief Registers a callback function for handling MQTT subscribe messages.
  *
  * This function allows you to register a callback function that will be called
- * when an MQTT subscribe message is received.
+ * when an MQTT subscribe message is received. The topic may be a filter with
+ * the '+' and '#' wildcards.
  *
  * @param context The MQTT context.
  * @param topic The topic to subscribe to.
@@ -427,6 +491,16 @@ int tuya_mqtt_subscribe_message_callback_unregister(tuya_mqtt_context_t *context
  */
 int tuya_mqtt_upgrade_progress_report(tuya_mqtt_context_t *context, int channel, int percent);
 
+/**
+ * @brief Gets the statistics of QoS1 publishes.
+ *
+ * @param context Pointer to the MQTT context.
+ * @param stat Pointer to the statistics to fill.
+ *
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_mqtt_publish_stat_get(tuya_mqtt_context_t *context, tuya_mqtt_publish_stat_t *stat);
+
 #ifdef __cplusplus
 }
 #endif
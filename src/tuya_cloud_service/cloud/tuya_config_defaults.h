@@ -45,6 +45,31 @@
 #define MQTT_KEEPALIVE_INTERVALIN (120)
 #endif
 
+/**
+ * @brief MQTT QoS1 publishes waiting for PUBACK at the same time.
+ *
+ */
+#ifndef MQTT_PUBLISH_INFLIGHT_MAX
+#define MQTT_PUBLISH_INFLIGHT_MAX (8)
+#endif
+
+/**
+ * @brief Window to merge DP reports of a device into one MQTT message, 0
+ * publishes every report at once.
+ *
+ */
+#ifndef DP_REPORT_COALESCE_MS
+#define DP_REPORT_COALESCE_MS (0)
+#endif
+
+/**
+ * @brief Merged DP reports are published early when they reach this size.
+ *
+ */
+#ifndef DP_REPORT_COALESCE_BYTES
+#define DP_REPORT_COALESCE_BYTES (1024)
+#endif
+
 /**
  * @brief Defaults auto check upgrade interval.
  *
@@ -76,6 +101,22 @@
 #define MQTT_CONNECT_RETRY_MIN_DELAY_MS (1000U)
 #endif
 
+/**
+ * @brief Longest wait of an idle client loop, tuya_iot_start() and the other
+ * state changes wake it at once.
+ */
+#ifndef TUYA_IOT_IDLE_WAIT_MS
+#define TUYA_IOT_IDLE_WAIT_MS (5000U)
+#endif
+
+/**
+ * @brief Retry interval of the client loop while the network is down or the
+ * cloud is unreachable, a link status change ends the wait early.
+ */
+#ifndef TUYA_IOT_RETRY_WAIT_MS
+#define TUYA_IOT_RETRY_WAIT_MS (1000U)
+#endif
+
 /**
  * @brief MQTT BIND TLS timeout config.
  */
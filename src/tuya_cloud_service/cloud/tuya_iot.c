@@ -27,6 +27,7 @@
 #include "tuya_iot_dp.h"
 #include "tuya_register_center.h"
 #include "tuya_tls.h"
+#include "http_client_interface.h"
 #include "netmgr.h"
 #include "tuya_health.h"
 typedef enum {
@@ -64,6 +65,50 @@ static int iot_dispatch_event(tuya_iot_client_t *client)
     return OPRT_OK;
 }
 
+/* end an idle or retry wait of the client loop, posts coalesce */
+static void iot_wakeup(tuya_iot_client_t *client)
+{
+    if (client->wakeup) {
+        tal_semaphore_post(client->wakeup);
+    }
+}
+
+static void iot_wait(tuya_iot_client_t *client, uint32_t timeout_ms)
+{
+    if (client->wakeup) {
+        tal_semaphore_wait(client->wakeup, timeout_ms);
+    } else {
+        tal_system_sleep(timeout_ms);
+    }
+}
+
+static int iot_link_status_on(void *data)
+{
+    tuya_iot_client_t *client = s_iot_client_solo;
+    if (NULL == client) {
+        return OPRT_OK;
+    }
+
+    /* a link down has nothing to retry, the waits end on their own */
+    if ((netmgr_status_e)(intptr_t)data != NETMGR_LINK_UP) {
+        return OPRT_OK;
+    }
+
+    client->online.link_up = tal_system_get_millisecond();
+    client->online.mqtt_online = 0;
+    client->online.first_dp = 0;
+    iot_wakeup(client);
+    return OPRT_OK;
+}
+
+static void iot_link_up_mark(tuya_iot_client_t *client)
+{
+    /* the link came up before the client subscribed to its changes */
+    if (0 == client->online.link_up) {
+        client->online.link_up = tal_system_get_millisecond();
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /*                            Activate data process                           */
 /* -------------------------------------------------------------------------- */
@@ -378,6 +423,12 @@ static void mqtt_client_connected_on(void *context, void *user_data)
 {
     tuya_iot_client_t *client = (tuya_iot_client_t *)user_data;
 
+    /* the first connect after the link came up, reconnects in STATE_MQTT_YIELD too */
+    if (0 == client->online.mqtt_online) {
+        client->online.mqtt_online = tal_system_get_millisecond();
+        PR_INFO("link up to mqtt online: %u ms", (uint32_t)(client->online.mqtt_online - client->online.link_up));
+    }
+
     /* MATOP Init */
     matop_serice_init(&client->matop,
                       &(const matop_config_t){.mqctx = &client->mqctx, .devid = client->activate.devid});
@@ -558,6 +609,7 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     PR_DEBUG("authkey:%s", client->config.authkey);
 
     tal_semaphore_create_init(&client->token_get.sem, 0, 1);
+    tal_semaphore_create_init(&client->wakeup, 0, 1);
 
     /* Default storage namespace */
     if (client->config.storage_namespace == NULL) {
@@ -565,6 +617,7 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     }
     /* Software timer Init */
     tuya_tls_init();
+    http_client_init();
     tuya_register_center_init();
     /* Load Tuya cloud endpoint config */
     tuya_endpoint_init();
@@ -584,6 +637,8 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
 
     tuya_ota_init(&ota_config);
 
+    tuya_iot_dp_report_init();
+
     tuya_health_monitor_init();
 
     /* Auto check upgrade timer init */
@@ -593,6 +648,9 @@ int tuya_iot_init(tuya_iot_client_t *client, const tuya_iot_config_t *config)
     }
     s_iot_client_solo = client;
 
+    /* link changes end the network waits of the client loop */
+    tal_event_subscribe(EVENT_LINK_STATUS_CHG, "iot", iot_link_status_on, SUBSCRIBE_TYPE_NORMAL);
+
     client->state = STATE_IDLE;
     client->nextstate = STATE_IDLE;
     return ret;
@@ -615,6 +673,7 @@ int tuya_iot_start(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_START;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -629,6 +688,7 @@ int tuya_iot_start(tuya_iot_client_t *client)
 int tuya_iot_stop(tuya_iot_client_t *client)
 {
     client->nextstate = STATE_STOP;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -649,6 +709,7 @@ int tuya_iot_reconnect(tuya_iot_client_t *client)
         return OPRT_COM_ERROR;
     }
     client->nextstate = STATE_MQTT_RECONNECT;
+    iot_wakeup(client);
     return OPRT_OK;
 }
 
@@ -683,6 +744,7 @@ int tuya_iot_reset(tuya_iot_client_t *client)
     client->event.value.asInteger = TUYA_RESET_TYPE_FACTORY;
     iot_dispatch_event(client);
     client->nextstate = STATE_RESET;
+    iot_wakeup(client);
 
     if (client->state == STATE_TOKEN_PENDING) {
         client->token_get.result = OPRT_COM_ERROR;
@@ -764,10 +826,14 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_MQTT_YIELD:
         tuya_mqtt_loop(&client->mqctx);
         matop_serice_yield(&client->matop);
+        if (client->mqctx.retry_delay_ms) {
+            /* reconnect back-off, a link up retries at once */
+            iot_wait(client, client->mqctx.retry_delay_ms);
+        }
         break;
 
     case STATE_IDLE:
-        tal_system_sleep(500);
+        iot_wait(client, TUYA_IOT_IDLE_WAIT_MS);
         break;
 
     case STATE_START:
@@ -831,10 +897,11 @@ int tuya_iot_yield(tuya_iot_client_t *client)
 
     case STATE_NETWORK_CHECK:
         if (client->config.network_check && client->config.network_check()) {
+            iot_link_up_mark(client);
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = client->is_activated ? STATE_ENDPOINT_GET : STATE_ENDPOINT_UPDATE;
         } else {
-            tal_system_sleep(1000);
+            iot_wait(client, TUYA_IOT_RETRY_WAIT_MS);
         }
         break;
 
@@ -852,7 +919,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ENDPOINT_UPDATE:
         ret = tuya_endpoint_update();
         if (ret != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_wait(client, TUYA_IOT_RETRY_WAIT_MS);
             break;
         }
         if (client->is_activated) {
@@ -870,7 +937,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_ACTIVATING:
         ret = client_activate_process(client, client->binding->token);
         if (ret != OPRT_OK) {
-            tal_system_sleep(1000);
+            iot_wait(client, TUYA_IOT_RETRY_WAIT_MS);
             break;
         }
 
@@ -915,6 +982,9 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_MQTT_CONNECT_START:
         if (run_state_mqtt_connect_start(client) == OPRT_OK) {
             client->nextstate = STATE_MQTT_CONNECTING;
+        } else {
+            /* back-off of the MQTT service, a link change retries at once */
+            iot_wait(client, client->mqctx.retry_delay_ms ? client->mqctx.retry_delay_ms : TUYA_IOT_RETRY_WAIT_MS);
         }
         break;
 
@@ -932,6 +1002,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = STATE_MQTT_CONNECT_START;
         } else {
+            http_client_pool_flush();
             client->status = TUYA_STATUS_UNCONNECT_ROUTER;
             client->nextstate = STATE_NETWORK_RECONNECT;
         }
@@ -939,10 +1010,11 @@ int tuya_iot_yield(tuya_iot_client_t *client)
 
     case STATE_NETWORK_RECONNECT:
         if (client->config.network_check && client->config.network_check()) {
+            iot_link_up_mark(client);
             client->status = TUYA_STATUS_WIFI_CONNECTED;
             client->nextstate = STATE_MQTT_CONNECT_START;
         } else {
-            tal_system_sleep(1000);
+            iot_wait(client, TUYA_IOT_RETRY_WAIT_MS);
         }
         break;
 
@@ -959,6 +1031,7 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     case STATE_STOP:
         tuya_mqtt_stop(&client->mqctx);
         tuya_mqtt_destory(&client->mqctx);
+        http_client_pool_flush();
         client->nextstate = STATE_IDLE;
         break;
 
@@ -969,6 +1042,51 @@ int tuya_iot_yield(tuya_iot_client_t *client)
     return ret;
 }
 
+/**
+ * @brief Runs the Tuya IoT client loop until it reaches a status.
+ *
+ * The waits of the loop end on link changes and state requests, so the status
+ * is reached as soon as the network and the cloud allow it.
+ *
+ * @param client Pointer to the Tuya IoT client structure.
+ * @param status The status to wait for.
+ * @param timeout_ms Longest time to run, SEM_WAIT_FOREVER for no limit.
+ * @return OPRT_OK when the status is reached, OPRT_TIMEOUT otherwise.
+ */
+int tuya_iot_run_until(tuya_iot_client_t *client, tuya_client_status_t status, uint32_t timeout_ms)
+{
+    if (client == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    SYS_TIME_T start = tal_system_get_millisecond();
+    while (client->status != status) {
+        if (timeout_ms != SEM_WAIT_FOREVER && (tal_system_get_millisecond() - start) >= timeout_ms) {
+            return OPRT_TIMEOUT;
+        }
+        tuya_iot_yield(client);
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the time points of the last link up to online sequence.
+ *
+ * @param client Pointer to the Tuya IoT client structure.
+ * @param stat Receives the link up, MQTT online and first DP time points.
+ * @return OPRT_OK on success, otherwise an error code.
+ */
+int tuya_iot_online_stat_get(tuya_iot_client_t *client, tuya_iot_online_stat_t *stat)
+{
+    if (client == NULL || stat == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+
+    *stat = client->online;
+    return OPRT_OK;
+}
+
 /**
  * @brief Checks if the Tuya IoT client is activated.
  *
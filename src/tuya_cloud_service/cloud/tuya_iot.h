@@ -216,6 +216,13 @@ typedef struct {
     tuya_token_get_cb_t cb[MAX_TOKEN_GET_NUM];
 } tuya_token_get_t;
 
+/* milliseconds from tal_system_get_millisecond(), 0 until reached */
+typedef struct {
+    SYS_TIME_T link_up;     // last network link up seen by the client
+    SYS_TIME_T mqtt_online; // first MQTT connect after link_up
+    SYS_TIME_T first_dp;    // first DP command accepted after link_up
+} tuya_iot_online_stat_t;
+
 struct tuya_iot_client_handle {
     tuya_iot_config_t config;
     tuya_activated_data_t activate;
@@ -225,6 +232,8 @@ struct tuya_iot_client_handle {
     tuya_token_get_t token_get;
     tuya_binding_info_t *binding;
     TIMER_ID check_upgrade_timer;
+    SEM_HANDLE wakeup; // posted on link changes and state requests
+    tuya_iot_online_stat_t online;
     uint8_t status;
     uint8_t state;
     uint8_t nextstate;
@@ -298,6 +307,28 @@ int tuya_iot_destroy(tuya_iot_client_t *client);
  */
 int tuya_iot_yield(tuya_iot_client_t *client);
 
+/**
+ * @brief Run the client loop until it reaches a status or the timeout expires.
+ *
+ * The loop blocks on the network, link events and its retry timers instead of
+ * sleeping, a single pass may overrun the timeout by its own blocking time.
+ *
+ * @param client - The Tuya client context.
+ * @param status - The tuya_client_status_t to wait for.
+ * @param timeout_ms - Longest time to run, SEM_WAIT_FOREVER for no limit.
+ * @return int - OPRT_OK when the status is reached, OPRT_TIMEOUT otherwise.
+ */
+int tuya_iot_run_until(tuya_iot_client_t *client, tuya_client_status_t status, uint32_t timeout_ms);
+
+/**
+ * @brief Get the time points of the last link up to online sequence.
+ *
+ * @param client - The Tuya client context.
+ * @param stat - Receives the time points.
+ * @return int - OPRT_OK successful or error code.
+ */
+int tuya_iot_online_stat_get(tuya_iot_client_t *client, tuya_iot_online_stat_t *stat);
+
 /**
  * @brief Report Tuya data point(DP) services to the cloud.
  *
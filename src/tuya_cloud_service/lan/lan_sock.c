@@ -7,7 +7,8 @@
  * events efficiently, and provide a clean shutdown process.
  *
  * The implementation utilizes a select-based approach to monitor and react to
- * socket events across multiple sockets. It supports operations such as adding
+ * socket events across multiple sockets, or epoll with an eventfd wakeup on
+ * Linux so only ready sockets are visited and registrations apply at once. It supports operations such as adding
  * a new socket reader, updating existing readers, and removing readers. Error
  * handling and socket event detection are integral parts of the loop to ensure
  * robust operation.
@@ -25,11 +26,32 @@
  *
  */
 
+#include "tuya_iot_config.h"
 #include "lan_sock.h"
 #include "tal_api.h"
 #include "tal_network.h"
 #include "tuya_lan.h"
 
+// epoll on linux, tal_net_select elsewhere
+#ifndef LAN_SLOOP_USING_EPOLL
+#if defined(OPERATING_SYSTEM) && (OPERATING_SYSTEM == SYSTEM_LINUX)
+#define LAN_SLOOP_USING_EPOLL 1
+#else
+#define LAN_SLOOP_USING_EPOLL 0
+#endif
+#endif
+
+#if LAN_SLOOP_USING_EPOLL
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#define LAN_SLOOP_OP_ADD   0
+#define LAN_SLOOP_OP_DEL   1
+#define LAN_SLOOP_OP_WRITE 2
+
 #pragma pack(1)
 
 #define LAN_UDP_READER_CNT 5
@@ -40,7 +62,20 @@ typedef struct LAN_SLOOP_S {
     sloop_sock_t *readers;
     BOOL_T terminate;
     QUEUE_HANDLE queue;
+#if LAN_SLOOP_USING_EPOLL
+    int epoll_fd;
+    int wakeup_fd;
+#else
+    int write_cnt;            // readers waiting for write readiness
+    TUYA_FD_SET_T fds[3];     // registered read/write/err fds
+    TUYA_FD_SET_T act_fds[3]; // fds returned by select
+#endif
 } LAN_SLOOP_S, *P_LAN_SLOOP_S;
+
+typedef struct {
+    uint8_t op;
+    sloop_sock_t info;
+} LAN_SLOOP_MSG_T;
 #pragma pack()
 
 static P_LAN_SLOOP_S g_sloop = NULL;
@@ -50,22 +85,233 @@ static P_LAN_SLOOP_S g_sloop = NULL;
 #define STACK_SIZE_LAN (4 * 1024)
 #endif
 
+#define LAN_SLOOP_TIMEOUT_MS 1000
+#define LAN_SLOOP_EVENT_NUM  16
+
 static uint32_t __ty_sock_get_reader_num(void)
 {
     return (LAN_UDP_READER_CNT + tuya_lan_get_client_num());
 }
 
-static void __sock_table_set_fds(TUYA_FD_SET_T *rfds, TUYA_FD_SET_T *efds)
+#if LAN_SLOOP_USING_EPOLL
+#define LAN_SLOOP_WAKEUP_IDX 0xFFFFFFFF
+
+static OPERATE_RET __sloop_backend_init(void)
 {
-    int idx;
-    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-        if (g_sloop->readers[idx].sock >= 0) {
-            tal_net_fd_set(g_sloop->readers[idx].sock, rfds);
-            tal_net_fd_set(g_sloop->readers[idx].sock, efds);
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = LAN_SLOOP_WAKEUP_IDX};
+
+    g_sloop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    g_sloop->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_sloop->epoll_fd < 0 || g_sloop->wakeup_fd < 0 ||
+        epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_ADD, g_sloop->wakeup_fd, &ev) < 0) {
+        PR_ERR("epoll init err:%d", errno);
+        return OPRT_COM_ERROR;
+    }
+
+    return OPRT_OK;
+}
+
+static void __sloop_backend_deinit(void)
+{
+    if (g_sloop->wakeup_fd >= 0) {
+        close(g_sloop->wakeup_fd);
+        g_sloop->wakeup_fd = -1;
+    }
+    if (g_sloop->epoll_fd >= 0) {
+        close(g_sloop->epoll_fd);
+        g_sloop->epoll_fd = -1;
+    }
+}
+
+static void __sloop_backend_ctl(int op, uint32_t idx)
+{
+    sloop_sock_t *reader = &g_sloop->readers[idx];
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = idx};
+
+    if (reader->write) {
+        ev.events |= EPOLLOUT;
+    }
+    if (epoll_ctl(g_sloop->epoll_fd, op, reader->sock, &ev) < 0) {
+        PR_ERR("epoll ctl %d sock %d err:%d", op, reader->sock, errno);
+    }
+}
+
+static void __sloop_backend_add(uint32_t idx)
+{
+    __sloop_backend_ctl(EPOLL_CTL_ADD, idx);
+}
+
+static void __sloop_backend_mod(uint32_t idx)
+{
+    __sloop_backend_ctl(EPOLL_CTL_MOD, idx);
+}
+
+static void __sloop_backend_del(uint32_t idx)
+{
+    epoll_ctl(g_sloop->epoll_fd, EPOLL_CTL_DEL, g_sloop->readers[idx].sock, NULL);
+}
+
+static void __sloop_backend_wakeup(void)
+{
+    uint64_t val = 1;
+
+    if (write(g_sloop->wakeup_fd, &val, sizeof(val)) < 0) {
+        PR_ERR("wakeup err:%d", errno);
+    }
+}
+
+/* only the ready sockets are visited */
+static int __sloop_backend_dispatch(uint32_t timeout_ms)
+{
+    struct epoll_event events[LAN_SLOOP_EVENT_NUM];
+    sloop_sock_t *reader = NULL;
+    sloop_sock_write write_cb = NULL;
+    uint64_t val = 0;
+    int actv_cnt = 0, i = 0;
+
+    actv_cnt = epoll_wait(g_sloop->epoll_fd, events, LAN_SLOOP_EVENT_NUM, timeout_ms);
+    if (actv_cnt < 0) {
+        return (EINTR == errno) ? 0 : actv_cnt;
+    }
+
+    for (i = 0; i < actv_cnt; i++) {
+        if (LAN_SLOOP_WAKEUP_IDX == events[i].data.u32) {
+            if (read(g_sloop->wakeup_fd, &val, sizeof(val)) < 0) {
+                PR_ERR("wakeup read err:%d", errno);
+            }
+            continue;
+        }
+
+        reader = &g_sloop->readers[events[i].data.u32];
+        if (reader->sock < 0) {
+            continue;
+        }
+        if ((events[i].events & EPOLLERR) && reader->err) {
+            PR_ERR("socket err, sock:%d, idx:%d", reader->sock, events[i].data.u32);
+            reader->err(reader->sock);
+        }
+        if ((events[i].events & (EPOLLIN | EPOLLHUP)) && reader->read) {
+            reader->read(reader->sock);
+        }
+        if ((events[i].events & EPOLLOUT) && reader->write) {
+            write_cb = reader->write;
+            reader->write = NULL;
+            __sloop_backend_mod(events[i].data.u32);
+            write_cb(reader->sock);
+        }
+    }
+
+    return actv_cnt;
+}
+#else
+#define LAN_SLOOP_RFDS 0
+#define LAN_SLOOP_WFDS 1
+#define LAN_SLOOP_EFDS 2
+
+static OPERATE_RET __sloop_backend_init(void)
+{
+    int i = 0;
+
+    for (i = 0; i < 3; i++) {
+        tal_net_fd_zero(&g_sloop->fds[i]);
+    }
+
+    return OPRT_OK;
+}
+
+static void __sloop_backend_deinit(void)
+{
+    return;
+}
+
+static void __sloop_backend_mod(uint32_t idx)
+{
+    sloop_sock_t *reader = &g_sloop->readers[idx];
+
+    if (reader->write) {
+        if (!tal_net_fd_isset(reader->sock, &g_sloop->fds[LAN_SLOOP_WFDS])) {
+            tal_net_fd_set(reader->sock, &g_sloop->fds[LAN_SLOOP_WFDS]);
+            g_sloop->write_cnt++;
         }
+    } else if (tal_net_fd_isset(reader->sock, &g_sloop->fds[LAN_SLOOP_WFDS])) {
+        tal_net_fd_clear(reader->sock, &g_sloop->fds[LAN_SLOOP_WFDS]);
+        g_sloop->write_cnt--;
     }
 }
 
+static void __sloop_backend_add(uint32_t idx)
+{
+    int sock = g_sloop->readers[idx].sock;
+
+    tal_net_fd_set(sock, &g_sloop->fds[LAN_SLOOP_RFDS]);
+    tal_net_fd_set(sock, &g_sloop->fds[LAN_SLOOP_EFDS]);
+    __sloop_backend_mod(idx);
+}
+
+static void __sloop_backend_del(uint32_t idx)
+{
+    sloop_sock_t *reader = &g_sloop->readers[idx];
+
+    reader->write = NULL;
+    __sloop_backend_mod(idx);
+    tal_net_fd_clear(reader->sock, &g_sloop->fds[LAN_SLOOP_RFDS]);
+    tal_net_fd_clear(reader->sock, &g_sloop->fds[LAN_SLOOP_EFDS]);
+}
+
+static void __sloop_backend_wakeup(void)
+{
+    // no portable wakeup fd for select, an idle loop waits on the queue instead
+    return;
+}
+
+static int __sloop_backend_dispatch(uint32_t timeout_ms)
+{
+    TUYA_FD_SET_T *act_fds = g_sloop->act_fds;
+    sloop_sock_t *reader = NULL;
+    sloop_sock_write write_cb = NULL;
+    int actv_cnt = 0, left = 0, idx = 0;
+
+    memcpy(act_fds, g_sloop->fds, sizeof(g_sloop->act_fds));
+    actv_cnt = tal_net_select(g_sloop->max_sock + 1, &act_fds[LAN_SLOOP_RFDS],
+                              g_sloop->write_cnt ? &act_fds[LAN_SLOOP_WFDS] : NULL, &act_fds[LAN_SLOOP_EFDS],
+                              timeout_ms);
+    if (actv_cnt <= 0) {
+        return actv_cnt;
+    }
+
+    for (idx = 0, left = actv_cnt; idx < __ty_sock_get_reader_num() && left > 0; idx++) {
+        reader = &g_sloop->readers[idx];
+        if (reader->sock < 0) {
+            continue;
+        }
+        if (tal_net_fd_isset(reader->sock, &act_fds[LAN_SLOOP_EFDS])) {
+            left--;
+            if (reader->err) {
+                PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), reader->sock, idx);
+                reader->err(reader->sock);
+            }
+        }
+        if (tal_net_fd_isset(reader->sock, &act_fds[LAN_SLOOP_RFDS])) {
+            left--;
+            if (reader->read) {
+                reader->read(reader->sock);
+            }
+        }
+        if (g_sloop->write_cnt && tal_net_fd_isset(reader->sock, &act_fds[LAN_SLOOP_WFDS])) {
+            left--;
+            if (reader->write) {
+                write_cb = reader->write;
+                reader->write = NULL;
+                __sloop_backend_mod(idx);
+                write_cb(reader->sock);
+            }
+        }
+    }
+
+    return actv_cnt;
+}
+#endif
+
 static void __sock_select_err_handle()
 {
     int idx;
@@ -90,6 +336,7 @@ void __ty_sock_loop_deinit(void)
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (g_sloop->readers[idx].sock != -1) {
                 PR_DEBUG("deinit lan sock %d and close it", g_sloop->readers[idx].sock);
+                __sloop_backend_del(idx);
                 tal_net_close(g_sloop->readers[idx].sock);
                 g_sloop->readers[idx].sock = -1;
                 g_sloop->readers[idx].pre_select = NULL;
@@ -102,6 +349,7 @@ void __ty_sock_loop_deinit(void)
         tal_free(g_sloop->readers);
         g_sloop->readers = NULL;
     }
+    __sloop_backend_deinit();
     if (g_sloop->queue) {
         tal_queue_free(g_sloop->queue);
     }
@@ -126,6 +374,7 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
             PR_DEBUG("update lan sock %d,read:%p", sock_info.sock, sock_info.read);
             memset(&g_sloop->readers[idx], 0, sizeof(sloop_sock_t));
             memcpy(&g_sloop->readers[idx], &sock_info, sizeof(sloop_sock_t));
+            __sloop_backend_mod(idx);
             break;
         }
     }
@@ -136,6 +385,7 @@ void __ty_add_sock_reader(sloop_sock_t sock_info)
                 PR_DEBUG("reg lan sock %d,read:%p", sock_info.sock, sock_info.read);
                 memset(&g_sloop->readers[idx], 0, sizeof(sloop_sock_t));
                 memcpy(&g_sloop->readers[idx], &sock_info, sizeof(sloop_sock_t));
+                __sloop_backend_add(idx);
                 g_sloop->cnt++;
                 break;
             }
@@ -156,12 +406,14 @@ void __ty_del_sock_reader(int sock)
     for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
         if (g_sloop->readers[idx].sock == sock) {
             PR_DEBUG("unreg lan sock %d and close it", sock);
+            __sloop_backend_del(idx);
             tal_net_close(g_sloop->readers[idx].sock);
             g_sloop->readers[idx].sock = -1;
             // g_sloop->readers[idx].pre_select = NULL;
             g_sloop->readers[idx].read = NULL;
             g_sloop->readers[idx].err = NULL;
             g_sloop->readers[idx].quit = NULL;
+            g_sloop->readers[idx].write = NULL;
             g_sloop->cnt--;
             break;
         }
@@ -172,91 +424,100 @@ void __ty_del_sock_reader(int sock)
         return;
     }
 
+#if !LAN_SLOOP_USING_EPOLL
+    if (sock == g_sloop->max_sock) {
+        g_sloop->max_sock = 0;
+        for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+            if (g_sloop->readers[idx].sock > g_sloop->max_sock) {
+                g_sloop->max_sock = g_sloop->readers[idx].sock;
+            }
+        }
+    }
+#endif
+
     return;
 }
 
+void __ty_wait_sock_write(int sock, sloop_sock_write write)
+{
+    uint8_t idx = 0;
+    for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
+        if (g_sloop->readers[idx].sock == sock) {
+            g_sloop->readers[idx].write = write;
+            __sloop_backend_mod(idx);
+            return;
+        }
+    }
+
+    PR_ERR("wait write not found");
+}
+
+/* apply all queued registration changes, the first fetch may block */
+static void __ty_sock_apply_queue(uint32_t timeout_ms)
+{
+    LAN_SLOOP_MSG_T msg;
+
+    while (OPRT_OK == tal_queue_fetch(g_sloop->queue, &msg, timeout_ms)) {
+        timeout_ms = 0;
+        if (LAN_SLOOP_OP_ADD == msg.op) {
+            __ty_add_sock_reader(msg.info);
+        } else if (LAN_SLOOP_OP_DEL == msg.op) {
+            __ty_del_sock_reader(msg.info.sock);
+        } else {
+            __ty_wait_sock_write(msg.info.sock, msg.info.write);
+        }
+    }
+}
+
+static OPERATE_RET __ty_sock_post(uint8_t op, sloop_sock_t *sock_info)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    LAN_SLOOP_MSG_T msg = {.op = op};
+
+    if (NULL == g_sloop) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+
+    memcpy(&msg.info, sock_info, sizeof(sloop_sock_t));
+    op_ret = tal_queue_post(g_sloop->queue, &msg, 0);
+    if (OPRT_OK != op_ret) {
+        PR_ERR("queue post err");
+        return op_ret;
+    }
+    __sloop_backend_wakeup();
+
+    return OPRT_OK;
+}
+
 void tuya_sock_loop_run(void *data)
 {
     int actv_cnt = 0;
     int idx = 0;
-    TUYA_FD_SET_T *rfds, *efds;
-    sloop_sock_t queue_data = {0};
-
-    rfds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    efds = tal_malloc(sizeof(TUYA_FD_SET_T));
-    if (rfds == NULL || efds == NULL) {
-        PR_ERR("malloc err");
-        goto Err;
-    }
-    memset(rfds, 0, sizeof(TUYA_FD_SET_T));
-    memset(efds, 0, sizeof(TUYA_FD_SET_T));
 
     // while (tuya_get_sock_loop_terminate() &&
     // tal_thread_get_state(g_sloop->thread) == THREAD_STATE_RUNNING) {
     while (tuya_get_sock_loop_terminate()) {
-        memset(&queue_data, 0, sizeof(sloop_sock_t));
-        if (tal_queue_fetch(g_sloop->queue, &queue_data, 0) == 0) {
-            if (queue_data.read) {
-                __ty_add_sock_reader(queue_data);
-            } else {
-                __ty_del_sock_reader(queue_data.sock);
-            }
-        }
+#if LAN_SLOOP_USING_EPOLL
+        __ty_sock_apply_queue(0);
+#else
+        __ty_sock_apply_queue((0 == g_sloop->cnt) ? 2000 : 0);
+#endif
         for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
             if (g_sloop->readers[idx].pre_select) {
                 g_sloop->readers[idx].pre_select();
             }
         }
+#if !LAN_SLOOP_USING_EPOLL
         if (g_sloop->cnt == 0) {
-            tal_system_sleep(2000);
             continue;
         }
+#endif
 
-        tal_net_fd_zero(rfds);
-        tal_net_fd_zero(efds);
-        __sock_table_set_fds(rfds, efds);
-        actv_cnt = tal_net_select(g_sloop->max_sock + 1, rfds, NULL, efds, 1 * 1000);
+        actv_cnt = __sloop_backend_dispatch(LAN_SLOOP_TIMEOUT_MS);
         if (actv_cnt < 0) {
             PR_ERR("errno:%d", tal_net_get_errno());
             __sock_select_err_handle();
             tal_system_sleep(1000);
-            continue;
-        } else if (actv_cnt == 0) {
-            continue;
-        } else {
-            for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-                if (g_sloop->readers[idx].sock >= 0) {
-                    if (0 == tal_net_fd_isset(g_sloop->readers[idx].sock, efds)) {
-                        continue;
-                    }
-                    if (g_sloop->readers[idx].err) {
-                        PR_ERR("socket err:%d, sock:%d, idx:%d", tal_net_get_errno(), g_sloop->readers[idx].sock, idx);
-                        g_sloop->readers[idx].err(g_sloop->readers[idx].sock);
-                    }
-                    actv_cnt--;
-                    if (0 == actv_cnt) {
-                        break;
-                    }
-                }
-            }
-        }
-
-        if (0 == actv_cnt) {
-            continue;
-        }
-
-        for (idx = 0; idx < __ty_sock_get_reader_num(); idx++) {
-            if (g_sloop->readers[idx].sock >= 0) {
-                if (tal_net_fd_isset(g_sloop->readers[idx].sock, rfds)) {
-                    if (g_sloop->readers[idx].read) {
-                        g_sloop->readers[idx].read(g_sloop->readers[idx].sock);
-                        actv_cnt--;
-                        if (0 == actv_cnt) {
-                            break;
-                        }
-                    }
-                }
-            }
         }
     }
 
@@ -266,14 +527,6 @@ void tuya_sock_loop_run(void *data)
         }
     }
 
-Err:
-    if (rfds) {
-        tal_free(rfds);
-    }
-    if (efds) {
-        tal_free(efds);
-    }
-
     tuya_lan_exit();
     __ty_sock_loop_deinit();
 
@@ -307,7 +560,13 @@ OPERATE_RET tuya_sock_loop_init(void)
     memset(g_sloop, 0, sizeof(LAN_SLOOP_S));
     g_sloop->terminate = TRUE;
 
-    op_ret = tal_queue_create_init(&g_sloop->queue, sizeof(sloop_sock_t), LAN_QUEUE_NUM);
+    op_ret = __sloop_backend_init();
+    if (OPRT_OK != op_ret) {
+        goto Err;
+    }
+
+    // room for closing every reader at once
+    op_ret = tal_queue_create_init(&g_sloop->queue, sizeof(LAN_SLOOP_MSG_T), LAN_QUEUE_NUM + __ty_sock_get_reader_num());
     if (OPRT_OK != op_ret) {
         PR_ERR("init queue err");
         goto Err;
@@ -355,9 +614,8 @@ Err:
 OPERATE_RET tuya_reg_lan_sock(sloop_sock_t sock_info)
 {
     OPERATE_RET op_ret = OPRT_OK;
-    op_ret = tal_queue_post(g_sloop->queue, &sock_info, 0);
+    op_ret = __ty_sock_post(LAN_SLOOP_OP_ADD, &sock_info);
     if (OPRT_OK != op_ret) {
-        PR_ERR("queue post err");
         return op_ret;
     }
     PR_DEBUG("reg post queue %d", sock_info.sock);
@@ -380,15 +638,34 @@ OPERATE_RET tuya_unreg_lan_sock(int sock)
     OPERATE_RET op_ret = OPRT_OK;
     sloop_sock_t sock_info = {0};
     sock_info.sock = sock;
-    op_ret = tal_queue_post(g_sloop->queue, &sock_info, 0);
+    op_ret = __ty_sock_post(LAN_SLOOP_OP_DEL, &sock_info);
     if (OPRT_OK != op_ret) {
-        PR_ERR("queue post err");
         return op_ret;
     }
     PR_DEBUG("unreg post queue %d", sock);
     return OPRT_OK;
 }
 
+/**
+ * @brief Waits once for a registered LAN socket to become writable.
+ *
+ * The callback is called from the socket loop thread the first time the
+ * socket can be written, then cleared. Call again to wait for the next time.
+ *
+ * @param sock The socket descriptor of a registered LAN socket.
+ * @param write The write readiness callback, NULL cancels a pending wait.
+ * @return The result of the operation.
+ *         - OPRT_OK: The wait was successfully posted.
+ *         - Other error codes indicating the failure reason.
+ */
+OPERATE_RET tuya_wait_lan_sock_write(int sock, sloop_sock_write write)
+{
+    sloop_sock_t sock_info = {0};
+    sock_info.sock = sock;
+    sock_info.write = write;
+    return __ty_sock_post(LAN_SLOOP_OP_WRITE, &sock_info);
+}
+
 /**
  * @brief Disables the socket loop for Tuya Cloud service.
  *
@@ -452,6 +729,9 @@ void tuya_dump_lan_sock_reader(void)
             if (g_sloop->readers[idx].quit) {
                 PR_DEBUG("quit:%p", g_sloop->readers[idx].quit);
             }
+            if (g_sloop->readers[idx].write) {
+                PR_DEBUG("write:%p", g_sloop->readers[idx].write);
+            }
         }
     }
     PR_DEBUG("**************lan sock reader info dump end**************");
@@ -57,6 +57,14 @@ typedef void (*sloop_sock_err)(int sock);
  */
 typedef void (*sloop_sock_quit)();
 
+/**
+ * @brief sock write ready handler, called once per wait
+ *
+ * @param[in] sock fd
+ *
+ */
+typedef void (*sloop_sock_write)(int sock);
+
 /**
  * @brief reg sock info
  *
@@ -67,6 +75,7 @@ typedef struct sloop_sock_t {
     sloop_sock_read read;
     sloop_sock_err err;
     sloop_sock_quit quit;
+    sloop_sock_write write; // optional, wait for write readiness once after register
 } sloop_sock_t;
 
 /**
@@ -91,6 +100,17 @@ OPERATE_RET tuya_reg_lan_sock(sloop_sock_t sock_info);
  */
 OPERATE_RET tuya_unreg_lan_sock(int sock);
 
+/**
+ * @brief wait once for a registered sock to become writable
+ *
+ * @param[in] sock fd
+ * @param[in] write write ready handler, NULL to cancel
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_wait_lan_sock_write(int sock, sloop_sock_write write);
+
 /**
  * @brief set sock loop disable
  *
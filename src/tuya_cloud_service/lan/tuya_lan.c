@@ -57,6 +57,7 @@ typedef struct {
     uint8_t randB[RAND_LEN];
     uint8_t hmac[HMAC_LEN];
     uint8_t secret_key[SESSIONKEY_LEN];
+    cipher_keyed_t *cipher; // bound to secret_key once the handshake is done
 } lan_session_t;
 
 typedef struct {
@@ -113,6 +114,7 @@ static lan_mgr_t *lan_mgr_get(void)
 
 static void lan_session_free(lan_session_t *session)
 {
+    mbedtls_cipher_keyed_free(session->cipher);
     memset(session, 0, sizeof(lan_session_t));
     session->fd = -1;
 }
@@ -464,29 +466,27 @@ static int lan_send(lan_session_t *session, uint32_t fr_num, uint32_t fr_type, u
         //! TODO:
         return OPRT_COM_ERROR;
     }
-    int plaintext_len = sizeof(lpv35_plaintext_data_t) + len;
-    lpv35_plaintext_data_t *plaintext_data = tal_malloc(plaintext_len);
-    if (plaintext_data == NULL) {
-        PR_ERR("plaintext_data fail");
-        return OPRT_MALLOC_FAILED;
-    }
-    memset(plaintext_data, 0, plaintext_len);
-    plaintext_data->ret_code = ret_code;
-    memcpy(plaintext_data->data, data, len);
     // lpv3.5 test arch
     lpv35_frame_object_t frame = {.sequence = session->sequence_out++,
                                   .type = fr_type,
-                                  .data = (void *)plaintext_data,
-                                  .data_len = plaintext_len};
+                                  .data_len = sizeof(lpv35_plaintext_data_t) + len};
     send_buf = tal_malloc(lpv35_frame_buffer_size_get(&frame));
     if (send_buf == NULL) {
         PR_ERR("send_buf malloc fail");
-        tal_free(plaintext_data);
         return OPRT_MALLOC_FAILED;
     }
-    memset(send_buf, 0, lpv35_frame_buffer_size_get(&frame));
-    op_ret = lpv35_frame_serialize(key, 16, &frame, send_buf, (int *)&send_len);
-    tal_free(plaintext_data);
+    // the plaintext is built in the frame and encrypted in place
+    lpv35_plaintext_data_t *plaintext_data = (lpv35_plaintext_data_t *)(send_buf + LPV35_FRAME_DATA_OFFSET);
+    plaintext_data->ret_code = ret_code;
+    if (len) {
+        memcpy(plaintext_data->data, data, len);
+    }
+    frame.data = (uint8_t *)plaintext_data;
+    if (key == session->secret_key && session->cipher) {
+        op_ret = lpv35_frame_serialize_keyed(session->cipher, &frame, send_buf, (int *)&send_len);
+    } else {
+        op_ret = lpv35_frame_serialize(key, 16, &frame, send_buf, (int *)&send_len);
+    }
     if (op_ret != OPRT_OK) {
         PR_ERR("lpv35_frame_serialize fail:%d", op_ret);
         tal_free(send_buf);
@@ -692,8 +692,7 @@ static void lan_protocol_process(lan_mgr_t *lan, lan_session_t *session, lpv35_f
         char *describe = NULL;
 
         char *jsonstr = NULL;
-        op_ret =
-            tuya_parse_protocol_data(DP_CMD_LAN, out, out_len, lan->iot_client->activate.localkey, (char **)&jsonstr);
+        op_ret = tuya_parse_protocol_data_inplace(DP_CMD_LAN, out, out_len, NULL, (char **)&jsonstr);
         if (OPRT_OK != op_ret) {
             PR_ERR("Cmd Parse Fail:%d", op_ret);
             describe = "parse data error";
@@ -723,9 +722,6 @@ static void lan_protocol_process(lan_mgr_t *lan, lan_session_t *session, lpv35_f
 
     FRM_TP_CMD_ERR:
         lan_send(session, frame->sequence, frame->type, 1, (uint8_t *)describe, describe ? strlen(describe) : 0, true);
-        if (jsonstr) {
-            tal_free(jsonstr);
-        }
         if (root) {
             cJSON_Delete(root);
         }
@@ -795,6 +791,12 @@ static void lan_protocol_process(lan_mgr_t *lan, lan_session_t *session, lpv35_f
             lan_session_fault_set(session);
             break;
         }
+        // expand the session key once, every following frame reuses it
+        op_ret = mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, session->secret_key, SESSIONKEY_LEN,
+                                             &session->cipher);
+        if (op_ret != OPRT_OK) {
+            PR_WARN("session cipher create error:%d", op_ret);
+        }
         break;
 
     case FRM_QUERY_STAT:
@@ -973,8 +975,10 @@ recv_again:
             continue;
         }
         //! TODO:
+        // decrypted inside the receive buffer, frame_out.data is not freed
         lpv35_frame_object_t frame_out = {0};
-        ret = lpv35_frame_parse(key, SESSIONKEY_LEN, frame_buffer, frame_len, &frame_out);
+        cipher_keyed_t *cipher = (key == session->secret_key) ? session->cipher : NULL;
+        ret = lpv35_frame_parse_inplace(key, SESSIONKEY_LEN, cipher, frame_buffer, frame_len, &frame_out);
         if (ret != OPRT_OK) {
             PR_ERR("lpv35_frame_parse fail:%d", ret);
             break;
@@ -983,9 +987,6 @@ recv_again:
         // update time
         lan_session_time_update(session, tal_time_get_posix());
         lan_protocol_process(lan, session, &frame_out);
-        if (frame_out.data) {
-            tal_free(frame_out.data);
-        }
     }
 
     if (tmp_recv_buf) {
@@ -51,6 +51,9 @@
 #define PV23_AD_DATA_LEN     (12)
 #define PV23_EXCEPT_DATA_LEN (PV23_AD_DATA_LEN + PV23_NONCE_LEN + PV23_TAG_LEN)
 
+// {"protocol":%u,"t":%u,"data":} around the source json
+#define PACK_JSON_WRAP_LEN (60)
+
 /**
  * @brief Generates a serial number for the Tuya protocol packet.
  *
@@ -71,10 +74,34 @@ uint32_t tuya_pack_protocol_serial_no(void)
     return serial_no;
 }
 
-static OPERATE_RET __parse_data_with_pv23(const DP_CMD_TYPE_E cmd, const uint8_t *data, const uint32_t len,
-                                          const uint8_t *key, char **out_data)
+/* a keyed cipher reuses its expanded key, otherwise the key is set up per call */
+static int __protocol_auth_encrypt(cipher_keyed_t *cipher, const cipher_params_t *input, uint8_t *output,
+                                   size_t *olen, uint8_t *tag, size_t tag_len)
+{
+    if (cipher) {
+        return mbedtls_cipher_keyed_auth_encrypt(cipher, input, output, olen, tag, tag_len);
+    }
+    return mbedtls_cipher_auth_encrypt_wrapper(input, output, olen, tag, tag_len);
+}
+
+static int __protocol_auth_decrypt(cipher_keyed_t *cipher, const cipher_params_t *input, uint8_t *output,
+                                   size_t *olen, uint8_t *tag, size_t tag_len)
+{
+    if (cipher) {
+        return mbedtls_cipher_keyed_auth_decrypt(cipher, input, output, olen, tag, tag_len);
+    }
+    return mbedtls_cipher_auth_decrypt_wrapper(input, output, olen, tag, tag_len);
+}
+
+static OPERATE_RET __parse_data_with_pv23(const DP_CMD_TYPE_E cmd, uint8_t *data, const uint32_t len,
+                                          const uint8_t *key, cipher_keyed_t *cipher, bool inplace, char **out_data)
 {
     OPERATE_RET op_ret = OPRT_OK;
+    if (len < PV23_EXCEPT_DATA_LEN) {
+        PR_ERR("pv2.3 data len invalid %d", len);
+        return OPRT_INVALID_PARM;
+    }
+
     if (memcmp(data, TUYA_PV23, PV23_VERSION_LEN) != 0) {
         PR_ERR("verison error, must pv2.3");
         return OPRT_VERSION_FMT_ERR;
@@ -98,11 +125,18 @@ static OPERATE_RET __parse_data_with_pv23(const DP_CMD_TYPE_E cmd, const uint8_t
     uint8_t *ad_data = (uint8_t *)(data + 0);
     uint32_t data_len = len - PV23_EXCEPT_DATA_LEN;
     size_t ec_len = 0;
-    uint8_t *ec_data = tal_malloc(data_len + 1);
-    TUYA_CHECK_NULL_RETURN(ec_data, OPRT_MALLOC_FAILED);
+    uint8_t *ec_data = NULL;
+    if (inplace) {
+        // plaintext overwrites the ciphertext, its terminator the verified tag
+        ec_data = data + PV23_DATA_OFFSET;
+    } else {
+        ec_data = tal_malloc(data_len + 1);
+        TUYA_CHECK_NULL_RETURN(ec_data, OPRT_MALLOC_FAILED);
+    }
 
     // decrypt data
-    op_ret = mbedtls_cipher_auth_decrypt_wrapper(
+    op_ret = __protocol_auth_decrypt(
+        cipher,
         &(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
                                  .key = (unsigned char *)key,
                                  .key_len = 16,
@@ -116,7 +150,9 @@ static OPERATE_RET __parse_data_with_pv23(const DP_CMD_TYPE_E cmd, const uint8_t
     if (op_ret != OPRT_OK) {
         PR_ERR("mbedtls_cipher_auth_decrypt_wrapper:0x%x", -op_ret);
         *out_data = NULL;
-        tal_free(ec_data);
+        if (!inplace) {
+            tal_free(ec_data);
+        }
         return op_ret;
     }
 
@@ -127,8 +163,8 @@ static OPERATE_RET __parse_data_with_pv23(const DP_CMD_TYPE_E cmd, const uint8_t
     return OPRT_OK;
 }
 
-static OPERATE_RET __parse_data_with_lpv35(const DP_CMD_TYPE_E cmd, const uint8_t *data, const uint32_t len,
-                                           const uint8_t *key, char **out_data)
+static OPERATE_RET __parse_data_with_lpv35(const DP_CMD_TYPE_E cmd, uint8_t *data, const uint32_t len,
+                                           const uint8_t *key, bool inplace, char **out_data)
 {
     char pv_buf[4];
     memset(pv_buf, 0, sizeof(pv_buf));
@@ -145,9 +181,13 @@ static OPERATE_RET __parse_data_with_lpv35(const DP_CMD_TYPE_E cmd, const uint8_
     uint8_t *ec_data = NULL;
     uint32_t ec_len = len - DATA_OFFSET_22_32;
 
-    ec_data = tal_malloc(ec_len + 1);
-    TUYA_CHECK_NULL_RETURN(ec_data, OPRT_MALLOC_FAILED);
-    memcpy(ec_data, data + DATA_OFFSET_22_32, ec_len);
+    if (inplace) {
+        ec_data = data + DATA_OFFSET_22_32;
+    } else {
+        ec_data = tal_malloc(ec_len + 1);
+        TUYA_CHECK_NULL_RETURN(ec_data, OPRT_MALLOC_FAILED);
+        memcpy(ec_data, data + DATA_OFFSET_22_32, ec_len);
+    }
 
     ec_data[ec_len] = 0;
 
@@ -156,27 +196,8 @@ static OPERATE_RET __parse_data_with_lpv35(const DP_CMD_TYPE_E cmd, const uint8_
     return OPRT_OK;
 }
 
-/**
- * @brief Parses the protocol data for a given command.
- *
- * This function takes in the command type, data, length, key, and a pointer to
- * store the output data. It parses the protocol data based on the provided
- * command and returns the result in the `out_data` parameter.
- *
- * @param cmd The command type to parse.
- * @param data The input data to be parsed.
- * @param len The length of the input data.
- * @param key The key used for parsing the data.
- * @param out_data A pointer to store the parsed output data.
- *
- * @return The operation result status. Possible values are:
- *         - OPRT_OK: Operation successful.
- *         - OPRT_INVALID_PARM: Invalid parameter provided.
- *         - OPRT_MALLOC_FAILED: Memory allocation failed.
- *         - OPRT_PARSE_FAILED: Parsing of the protocol data failed.
- */
-OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len, const char *key,
-                                     char **out_data)
+static OPERATE_RET __parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len, const char *key,
+                                         cipher_keyed_t *cipher, bool inplace, char **out_data)
 {
     if ((NULL == data) || (len < DATA_OFFSET_22_32)) {
         PR_ERR("data is NULL OR Len Invalid %d", len);
@@ -196,7 +217,7 @@ OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, con
     if (DP_CMD_LAN == cmd) {
         if (0 == strcmp(pv, "3.5")) {
             PR_TRACE("Data From LAN AND V=3.5");
-            op_ret = __parse_data_with_lpv35(cmd, data, len, (uint8_t *)key, out_data);
+            op_ret = __parse_data_with_lpv35(cmd, data, len, (uint8_t *)key, inplace, out_data);
         } else {
             PR_ERR("Data From LAN But No Match Parse %s", pv);
             return OPRT_COM_ERROR;
@@ -204,7 +225,7 @@ OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, con
     } else if (DP_CMD_MQ == cmd) {
         if (0 == strcmp(pv, "2.3")) {
             PR_TRACE("Data From MQTT AND V=2.3");
-            op_ret = __parse_data_with_pv23(cmd, data, len, (uint8_t *)key, out_data);
+            op_ret = __parse_data_with_pv23(cmd, data, len, (uint8_t *)key, cipher, inplace, out_data);
         } else {
             PR_ERR("Data From MQTT But No Match Parse %s", pv);
             return OPRT_COM_ERROR;
@@ -217,40 +238,113 @@ OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, con
     return op_ret;
 }
 
-static OPERATE_RET __pack_data_with_cmd_pv23(const DP_CMD_TYPE_E cmd, const char *pv, const char *src,
-                                             const uint32_t pro, const uint32_t num, const uint8_t *key,
-                                             uint8_t **pack_out, uint32_t *out_len)
+/**
+ * @brief Parses the protocol data for a given command.
+ *
+ * This function takes in the command type, data, length, key, and a pointer to
+ * store the output data. It parses the protocol data based on the provided
+ * command and returns the result in the `out_data` parameter.
+ *
+ * @param cmd The command type to parse.
+ * @param data The input data to be parsed.
+ * @param len The length of the input data.
+ * @param key The key used for parsing the data.
+ * @param out_data A pointer to store the parsed output data.
+ *
+ * @return The operation result status. Possible values are:
+ *         - OPRT_OK: Operation successful.
+ *         - OPRT_INVALID_PARM: Invalid parameter provided.
+ *         - OPRT_MALLOC_FAILED: Memory allocation failed.
+ *         - OPRT_PARSE_FAILED: Parsing of the protocol data failed.
+ */
+OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len, const char *key,
+                                     char **out_data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-    char *out = NULL;
-    int offset = 0;
+    return __parse_protocol_data(cmd, data, len, key, NULL, false, out_data);
+}
 
-    PR_TRACE("To:%d src:%s pro:%d num:%d", cmd, src, pro, num);
-    // make json data
-    int len = strlen(src) + 60;
-    out = tal_malloc(len);
-    if (NULL == out) {
-        PR_ERR("tal_malloc Fails %d", len);
-        return OPRT_MALLOC_FAILED;
+/**
+ * @brief Parses the protocol data with a cipher bound to the session key.
+ *
+ * Same as tuya_parse_protocol_data, the key schedule held by \p cipher is
+ * reused instead of being expanded again for every message.
+ *
+ * @param cmd The command type to parse.
+ * @param data The input data to be parsed.
+ * @param len The length of the input data.
+ * @param cipher AES-128-GCM handle created with the session key.
+ * @param out_data A pointer to store the parsed output data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_parse_protocol_data_keyed(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len,
+                                           cipher_keyed_t *cipher, char **out_data)
+{
+    if (NULL == cipher) {
+        return OPRT_INVALID_PARM;
     }
+    return __parse_protocol_data(cmd, data, len, NULL, cipher, false, out_data);
+}
 
-    // offset += sprintf(out + offset, "{\"protocol\":%d,\"t\":%d,\"data\":%s", pro, (uint32_t)tal_time_get_posix(),
-    // src);
-    offset += sprintf(out + offset, "{\"protocol\":%" PRIu32 ",\"t\":%" PRIu32 ",\"data\":%s", pro,
-                      (uint32_t)tal_time_get_posix(), src);
+/**
+ * @brief Parses the protocol data inside the receive buffer.
+ *
+ * Same as tuya_parse_protocol_data_keyed, but nothing is allocated: the
+ * plaintext is written over the ciphertext and \p out_data points into
+ * \p data, so it must not be freed and is only valid as long as the buffer.
+ * The terminator takes the first byte after the payload, the verified tag
+ * for DP_CMD_MQ and data[len] for DP_CMD_LAN, which must be writable.
+ *
+ * @param cmd The command type to parse.
+ * @param data The input data, modified in place.
+ * @param len The length of the input data.
+ * @param cipher AES-128-GCM handle created with the session key, unused by
+ * DP_CMD_LAN whose payload is already decrypted by the lpv3.5 frame.
+ * @param out_data Set to the json string inside \p data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_parse_protocol_data_inplace(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len,
+                                             cipher_keyed_t *cipher, char **out_data)
+{
+    if (DP_CMD_MQ == cmd && NULL == cipher) {
+        return OPRT_INVALID_PARM;
+    }
+    return __parse_protocol_data(cmd, data, len, NULL, cipher, true, out_data);
+}
 
-    out[offset++] = '}';
-    out[offset] = 0;
+static int __pack_json_wrap(char *out, uint32_t size, const char *src, const uint32_t pro)
+{
+    int offset = snprintf(out, size, "{\"protocol\":%" PRIu32 ",\"t\":%" PRIu32 ",\"data\":%s}", pro,
+                          (uint32_t)tal_time_get_posix(), src);
+    if (offset < 0 || (uint32_t)offset >= size) {
+        return -1;
+    }
 
     PR_TRACE("After Pack:%s offset:%d", out, offset);
+    return offset;
+}
 
-    // make pack data
-    uint8_t *buf = tal_malloc(offset + PV23_EXCEPT_DATA_LEN);
-    if (buf == NULL) {
-        tal_free(out);
-        return OPRT_MALLOC_FAILED;
+static OPERATE_RET __pack_data_with_cmd_pv23(const DP_CMD_TYPE_E cmd, const char *pv, const char *src,
+                                             const uint32_t pro, const uint32_t num, const uint8_t *key,
+                                             cipher_keyed_t *cipher, uint8_t *buf, uint32_t buf_size,
+                                             uint32_t *out_len)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+
+    PR_TRACE("To:%d src:%s pro:%d num:%d", cmd, src, pro, num);
+    if (buf_size < PV23_EXCEPT_DATA_LEN + 1) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    // make json data in place of the ciphertext, the tag follows it
+    int offset = __pack_json_wrap((char *)(buf + PV23_DATA_OFFSET), buf_size - PV23_EXCEPT_DATA_LEN, src, pro);
+    if (offset < 0) {
+        PR_ERR("pack buffer too small %d", buf_size);
+        return OPRT_BUFFER_NOT_ENOUGH;
     }
-    memset(buf, 0, offset + PV23_EXCEPT_DATA_LEN);
 
     // make head data
     // version
@@ -272,25 +366,23 @@ static OPERATE_RET __pack_data_with_cmd_pv23(const DP_CMD_TYPE_E cmd, const char
 
     // AES GCM encrypt
     size_t encrypt_olen = 0;
-    op_ret = mbedtls_cipher_auth_encrypt_wrapper(&(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
-                                                                          .key = (unsigned char *)key,
-                                                                          .key_len = 16,
-                                                                          .nonce = buf + PV23_NONCE_OFFSET,
-                                                                          .nonce_len = PV23_NONCE_LEN,
-                                                                          .ad = buf,
-                                                                          .ad_len = PV23_AD_DATA_LEN,
-                                                                          .data = (unsigned char *)out,
-                                                                          .data_len = strlen(out)},
-                                                 buf + PV23_DATA_OFFSET, &encrypt_olen, buf + PV23_DATA_OFFSET + offset,
-                                                 PV23_TAG_LEN);
-    tal_free(out);
+    op_ret = __protocol_auth_encrypt(cipher,
+                                     &(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
+                                                              .key = (unsigned char *)key,
+                                                              .key_len = 16,
+                                                              .nonce = buf + PV23_NONCE_OFFSET,
+                                                              .nonce_len = PV23_NONCE_LEN,
+                                                              .ad = buf,
+                                                              .ad_len = PV23_AD_DATA_LEN,
+                                                              .data = buf + PV23_DATA_OFFSET,
+                                                              .data_len = offset},
+                                     buf + PV23_DATA_OFFSET, &encrypt_olen, buf + PV23_DATA_OFFSET + offset,
+                                     PV23_TAG_LEN);
     if (op_ret != OPRT_OK) {
         PR_ERR("mbedtls_cipher_auth_encrypt_wrapper:0x%x", -op_ret);
-        tal_free(buf);
         return op_ret;
     }
 
-    *pack_out = buf;
     *out_len = PV23_EXCEPT_DATA_LEN + encrypt_olen;
 
     return OPRT_OK;
@@ -298,44 +390,20 @@ static OPERATE_RET __pack_data_with_cmd_pv23(const DP_CMD_TYPE_E cmd, const char
 
 static OPERATE_RET __pack_data_with_cmd_lpv35(const DP_CMD_TYPE_E cmd, const char *pv, const char *src,
                                               const uint32_t pro, const uint32_t num, const uint8_t *key,
-                                              uint8_t **pack_out, uint32_t *out_len)
+                                              uint8_t *buf, uint32_t buf_size, uint32_t *out_len)
 {
-    char *out = NULL;
-    int offset = 0;
-
     PR_TRACE("To:%d src:%s pro:%d num:%d", cmd, src, pro, num);
-
-    // make json data
-    int len = strlen(src) + 60;
-    out = tal_malloc(len);
-    if (NULL == out) {
-        PR_ERR("tal_malloc Fails %d", len);
-        return OPRT_MALLOC_FAILED;
+    if (buf_size < DATA_OFFSET_22_32 + 1) {
+        return OPRT_BUFFER_NOT_ENOUGH;
     }
 
-    // offset += sprintf(out + offset, "{\"protocol\":%d,\"t\":%d,\"data\":%s", pro, (uint32_t)tal_time_get_posix(),
-    // src);
-    offset += sprintf(out + offset, "{\"protocol\":%" PRIu32 ",\"t\":%" PRIu32 ",\"data\":%s", pro,
-                      (uint32_t)tal_time_get_posix(), src);
-
-    out[offset++] = '}';
-    out[offset] = 0;
-
-    PR_TRACE("After Pack:%s offset:%d", out, offset);
-
-    // make pack data
-    uint8_t *buf = tal_malloc(DATA_OFFSET_22_32 + offset + 16);
-    if (buf == NULL) {
-        tal_free(out);
-        return OPRT_MALLOC_FAILED;
+    // not aes data, the json keeps its terminator
+    int offset = __pack_json_wrap((char *)(buf + DATA_OFFSET_22_32), buf_size - DATA_OFFSET_22_32, src, pro);
+    if (offset < 0) {
+        PR_ERR("pack buffer too small %d", buf_size);
+        return OPRT_BUFFER_NOT_ENOUGH;
     }
-    memset(buf, 0, DATA_OFFSET_22_32 + offset + 16);
 
-    // not aes data
-    memcpy(buf + DATA_OFFSET_22_32, out, offset);
-    tal_free(out);
-
-    *pack_out = buf;
     *out_len = (DATA_OFFSET_22_32 + offset);
 
     // make head data
@@ -353,27 +421,11 @@ static OPERATE_RET __pack_data_with_cmd_lpv35(const DP_CMD_TYPE_E cmd, const cha
     return OPRT_OK;
 }
 
-/**
- * @brief Packs the protocol data for Tuya Cloud service.
- *
- * This function takes the command type, source data, protocol version,
- * encryption key, and outputs the packed protocol data.
- *
- * @param cmd The command type.
- * @param src The source data to be packed.
- * @param pro The protocol version.
- * @param key The encryption key.
- * @param out Pointer to the output packed data.
- * @param out_len Pointer to the length of the output packed data.
- *
- * @return The operation result status.
- *     - OPRT_OK: Operation successful.
- *     - Other error codes: Operation failed.
- */
-OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro, uint8_t *key,
-                                    char **out, uint32_t *out_len)
+static OPERATE_RET __pack_protocol_data_into(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro,
+                                             uint8_t *key, cipher_keyed_t *cipher, uint8_t *buf, uint32_t buf_size,
+                                             uint32_t *out_len)
 {
-    if ((NULL == src) || NULL == out) {
+    if ((NULL == src) || NULL == buf || NULL == out_len) {
         PR_ERR("Invalid Param");
         return OPRT_INVALID_PARM;
     }
@@ -392,7 +444,7 @@ OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, co
     if (DP_CMD_LAN == cmd) {
         if (0 == strcmp(pv, "3.5")) {
             PR_TRACE("Data To LAN AND V=3.5");
-            op_ret = __pack_data_with_cmd_lpv35(cmd, pv, src, pro, num, (uint8_t *)key, (uint8_t **)out, out_len);
+            op_ret = __pack_data_with_cmd_lpv35(cmd, pv, src, pro, num, (uint8_t *)key, buf, buf_size, out_len);
         } else {
             PR_ERR("Data To LAN But No Match Parse %s", pv);
             return OPRT_COM_ERROR;
@@ -400,7 +452,7 @@ OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, co
     } else if (DP_CMD_MQ == cmd) {
         if (0 == strcmp(pv, "2.3")) {
             PR_TRACE("Data To MQTT AND V=2.3");
-            op_ret = __pack_data_with_cmd_pv23(cmd, pv, src, pro, num, key, (uint8_t **)out, out_len);
+            op_ret = __pack_data_with_cmd_pv23(cmd, pv, src, pro, num, key, cipher, buf, buf_size, out_len);
         } else {
             PR_ERR("Data To MQTT But No Match Parse %s", pv);
             return OPRT_COM_ERROR;
@@ -413,6 +465,135 @@ OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, co
     return op_ret;
 }
 
+/**
+ * @brief Gets the buffer size needed to pack the protocol data.
+ *
+ * @param cmd The command type.
+ * @param src The source data to be packed.
+ *
+ * @return The buffer size for tuya_pack_protocol_data_into, 0 if \p cmd is
+ * not supported.
+ */
+uint32_t tuya_pack_protocol_data_size(const DP_CMD_TYPE_E cmd, const char *src)
+{
+    uint32_t src_len = (NULL == src) ? 0 : strlen(src);
+
+    if (DP_CMD_LAN == cmd) {
+        return DATA_OFFSET_22_32 + src_len + PACK_JSON_WRAP_LEN;
+    } else if (DP_CMD_MQ == cmd) {
+        return PV23_EXCEPT_DATA_LEN + src_len + PACK_JSON_WRAP_LEN;
+    }
+
+    return 0;
+}
+
+static OPERATE_RET __pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro, uint8_t *key,
+                                        cipher_keyed_t *cipher, char **out, uint32_t *out_len)
+{
+    if ((NULL == src) || NULL == out) {
+        PR_ERR("Invalid Param");
+        return OPRT_INVALID_PARM;
+    }
+
+    uint32_t buf_size = tuya_pack_protocol_data_size(cmd, src);
+    if (0 == buf_size) {
+        PR_ERR("Invlaid Cmd:%d", cmd);
+        return OPRT_COM_ERROR;
+    }
+
+    uint8_t *buf = tal_malloc(buf_size);
+    if (NULL == buf) {
+        PR_ERR("tal_malloc Fails %d", buf_size);
+        return OPRT_MALLOC_FAILED;
+    }
+
+    OPERATE_RET op_ret = __pack_protocol_data_into(cmd, src, pro, key, cipher, buf, buf_size, out_len);
+    if (OPRT_OK != op_ret) {
+        tal_free(buf);
+        return op_ret;
+    }
+
+    *out = (char *)buf;
+    return OPRT_OK;
+}
+
+/**
+ * @brief Packs the protocol data for Tuya Cloud service.
+ *
+ * This function takes the command type, source data, protocol version,
+ * encryption key, and outputs the packed protocol data.
+ *
+ * @param cmd The command type.
+ * @param src The source data to be packed.
+ * @param pro The protocol version.
+ * @param key The encryption key.
+ * @param out Pointer to the output packed data.
+ * @param out_len Pointer to the length of the output packed data.
+ *
+ * @return The operation result status.
+ *     - OPRT_OK: Operation successful.
+ *     - Other error codes: Operation failed.
+ */
+OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro, uint8_t *key,
+                                    char **out, uint32_t *out_len)
+{
+    return __pack_protocol_data(cmd, src, pro, key, NULL, out, out_len);
+}
+
+/**
+ * @brief Packs the protocol data with a cipher bound to the session key.
+ *
+ * Same as tuya_pack_protocol_data, the key schedule held by \p cipher is
+ * reused instead of being expanded again for every message.
+ *
+ * @param cmd The command type.
+ * @param src The source data to be packed.
+ * @param pro The protocol version.
+ * @param cipher AES-128-GCM handle created with the session key.
+ * @param out Pointer to the output packed data.
+ * @param out_len Pointer to the length of the output packed data.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_pack_protocol_data_keyed(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro,
+                                          cipher_keyed_t *cipher, char **out, uint32_t *out_len)
+{
+    if (NULL == cipher) {
+        return OPRT_INVALID_PARM;
+    }
+    return __pack_protocol_data(cmd, src, pro, NULL, cipher, out, out_len);
+}
+
+/**
+ * @brief Packs the protocol data into a caller-provided buffer.
+ *
+ * Same as tuya_pack_protocol_data_keyed, but the json is built where the
+ * ciphertext goes and encrypted in place, so nothing is allocated. The buffer
+ * holds the header room before the payload and the tag after it, its size
+ * comes from tuya_pack_protocol_data_size.
+ *
+ * @param cmd The command type.
+ * @param src The source data to be packed.
+ * @param pro The protocol version.
+ * @param cipher AES-128-GCM handle created with the session key, unused by
+ * DP_CMD_LAN which is encrypted by the lpv3.5 frame.
+ * @param buf The output buffer.
+ * @param buf_size The size of \p buf.
+ * @param out_len Pointer to the length of the output packed data.
+ *
+ * @return OPRT_OK on success, OPRT_BUFFER_NOT_ENOUGH if \p buf is too small.
+ * Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_pack_protocol_data_into(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro,
+                                         cipher_keyed_t *cipher, uint8_t *buf, uint32_t buf_size, uint32_t *out_len)
+{
+    if (DP_CMD_MQ == cmd && NULL == cipher) {
+        return OPRT_INVALID_PARM;
+    }
+    return __pack_protocol_data_into(cmd, src, pro, NULL, cipher, buf, buf_size, out_len);
+}
+
 /**
  * @brief Retrieves the size of the frame buffer for LPV35 frame objects.
  *
@@ -428,26 +609,10 @@ int lpv35_frame_buffer_size_get(lpv35_frame_object_t *frame_obj)
             LPV35_FRAME_TAG_SIZE + LPV35_FRAME_TAIL_SIZE);
 }
 
-/**
- * @brief Serializes an LPV35 frame object into a byte array.
- *
- * This function takes a key, key length, input LPV35 frame object, and output
- * byte array as parameters. It serializes the input frame object into the byte
- * array and updates the length of the output array.
- *
- * @param key The key used for serialization.
- * @param key_len The length of the key.
- * @param input The LPV35 frame object to be serialized.
- * @param output The byte array to store the serialized data.
- * @param olen A pointer to the length of the output byte array. This value will
- * be updated with the actual length of the serialized data.
- * @return OPERATE_RET Returns an OPERATE_RET value indicating the success or
- * failure of the serialization process.
- */
-OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_frame_object_t *input, uint8_t *output,
-                                  int *olen)
+static OPERATE_RET __lpv35_frame_serialize(const uint8_t *key, int key_len, cipher_keyed_t *cipher,
+                                           const lpv35_frame_object_t *input, uint8_t *output, int *olen)
 {
-    if (key == NULL || key_len == 0 || input == NULL || output == NULL || olen == NULL) {
+    if ((cipher == NULL && (key == NULL || key_len == 0)) || input == NULL || output == NULL || olen == NULL) {
         PR_ERR("PARAM ERROR");
         return OPRT_INVALID_PARM;
     }
@@ -481,16 +646,17 @@ OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_f
 
     // AES GCM encrypt
     size_t encrypt_olen = 0;
-    op_ret = mbedtls_cipher_auth_encrypt_wrapper(&(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
-                                                                          .key = (unsigned char *)key,
-                                                                          .key_len = key_len,
-                                                                          .nonce = nonce,
-                                                                          .nonce_len = LPV35_FRAME_NONCE_SIZE,
-                                                                          .ad = (uint8_t *)(&ad),
-                                                                          .ad_len = sizeof(lpv35_additional_data_t),
-                                                                          .data = input->data,
-                                                                          .data_len = input->data_len},
-                                                 output + offset, &encrypt_olen, tag, LPV35_FRAME_TAG_SIZE);
+    op_ret = __protocol_auth_encrypt(cipher,
+                                     &(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
+                                                              .key = (unsigned char *)key,
+                                                              .key_len = key_len,
+                                                              .nonce = nonce,
+                                                              .nonce_len = LPV35_FRAME_NONCE_SIZE,
+                                                              .ad = (uint8_t *)(&ad),
+                                                              .ad_len = sizeof(lpv35_additional_data_t),
+                                                              .data = input->data,
+                                                              .data_len = input->data_len},
+                                     output + offset, &encrypt_olen, tag, LPV35_FRAME_TAG_SIZE);
     if (op_ret != OPRT_OK) {
         PR_ERR("mbedtls_cipher_auth_encrypt_wrapper:0x%x", -op_ret);
         return op_ret;
@@ -513,30 +679,53 @@ OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_f
 }
 
 /**
- * @brief Parses an LPV35 frame.
+ * @brief Serializes an LPV35 frame object into a byte array.
  *
- * This function takes the LPV35 frame key, input data, and output object as
- * parameters and parses the LPV35 frame to populate the output object with the
- * parsed data.
+ * This function takes a key, key length, input LPV35 frame object, and output
+ * byte array as parameters. It serializes the input frame object into the byte
+ * array and updates the length of the output array.
  *
- * @param key The LPV35 frame key.
- * @param key_len The length of the LPV35 frame key.
- * @param input The input data containing the LPV35 frame.
- * @param ilen The length of the input data.
- * @param output The output object to store the parsed data.
+ * @param key The key used for serialization.
+ * @param key_len The length of the key.
+ * @param input The LPV35 frame object to be serialized.
+ * @param output The byte array to store the serialized data.
+ * @param olen A pointer to the length of the output byte array. This value will
+ * be updated with the actual length of the serialized data.
+ * @return OPERATE_RET Returns an OPERATE_RET value indicating the success or
+ * failure of the serialization process.
+ */
+OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_frame_object_t *input, uint8_t *output,
+                                  int *olen)
+{
+    return __lpv35_frame_serialize(key, key_len, NULL, input, output, olen);
+}
+
+/**
+ * @brief Serializes an LPV35 frame with a cipher bound to the session key.
  *
- * @return The result of the operation. Possible return values are:
- *         - OPRT_OK: The LPV35 frame was successfully parsed.
- *         - OPRT_INVALID_PARM: Invalid parameters were provided.
- *         - OPRT_PARSE_FRAME_ERR: Error occurred while parsing the LPV35 frame.
+ * @param cipher AES-128-GCM handle created with the session key.
+ * @param input The LPV35 frame object to be serialized.
+ * @param output The byte array to store the serialized data.
+ * @param olen Updated with the length of the serialized data.
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
  */
-OPERATE_RET lpv35_frame_parse(const uint8_t *key, int key_len, const uint8_t *input, int ilen,
-                              lpv35_frame_object_t *output)
+OPERATE_RET lpv35_frame_serialize_keyed(cipher_keyed_t *cipher, const lpv35_frame_object_t *input, uint8_t *output,
+                                        int *olen)
+{
+    if (cipher == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+    return __lpv35_frame_serialize(NULL, 0, cipher, input, output, olen);
+}
+
+static OPERATE_RET __lpv35_frame_parse(const uint8_t *key, int key_len, cipher_keyed_t *cipher, const uint8_t *input,
+                                       int ilen, bool inplace, lpv35_frame_object_t *output)
 {
     OPERATE_RET op_ret = OPRT_OK;
     int offset = 0;
 
-    if (key == NULL || key_len == 0 || input == NULL || ilen == 0 || output == NULL) {
+    if ((cipher == NULL && (key == NULL || key_len == 0)) || input == NULL || ilen == 0 || output == NULL) {
         PR_ERR("PARAM ERROR");
         return OPRT_INVALID_PARM;
     }
@@ -603,28 +792,102 @@ OPERATE_RET lpv35_frame_parse(const uint8_t *key, int key_len, const uint8_t *in
     memcpy(&ad, input + LPV35_FRAME_HEAD_SIZE, sizeof(lpv35_additional_data_t));
 
     // decrypt data
-    output->data = tal_malloc(output->data_len + 1);
-    TUYA_CHECK_NULL_RETURN(output->data, OPRT_MALLOC_FAILED);
-    memset(output->data, 0, output->data_len + 1);
+    if (inplace) {
+        output->data = data;
+    } else {
+        output->data = tal_malloc(output->data_len + 1);
+        TUYA_CHECK_NULL_RETURN(output->data, OPRT_MALLOC_FAILED);
+        memset(output->data, 0, output->data_len + 1);
+    }
     size_t decrypt_olen = 0;
-    op_ret = mbedtls_cipher_auth_decrypt_wrapper(&(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
-                                                                          .key = (unsigned char *)key,
-                                                                          .key_len = key_len,
-                                                                          .nonce = nonce,
-                                                                          .nonce_len = LPV35_FRAME_NONCE_SIZE,
-                                                                          .ad = (uint8_t *)(&ad),
-                                                                          .ad_len = sizeof(lpv35_additional_data_t),
-                                                                          .data = data,
-                                                                          .data_len = output->data_len},
-                                                 output->data, &decrypt_olen, tag, LPV35_FRAME_TAG_SIZE);
+    op_ret = __protocol_auth_decrypt(cipher,
+                                     &(const cipher_params_t){.cipher_type = MBEDTLS_CIPHER_AES_128_GCM,
+                                                              .key = (unsigned char *)key,
+                                                              .key_len = key_len,
+                                                              .nonce = nonce,
+                                                              .nonce_len = LPV35_FRAME_NONCE_SIZE,
+                                                              .ad = (uint8_t *)(&ad),
+                                                              .ad_len = sizeof(lpv35_additional_data_t),
+                                                              .data = data,
+                                                              .data_len = output->data_len},
+                                     output->data, &decrypt_olen, tag, LPV35_FRAME_TAG_SIZE);
     if (op_ret != OPRT_OK) {
         PR_ERR("mbedtls_cipher_auth_decrypt_wrapper:0x%x", -op_ret);
-        tal_free(output->data);
+        if (!inplace) {
+            tal_free(output->data);
+        }
         output->data = NULL;
         return op_ret;
     }
     output->data_len = (uint32_t)decrypt_olen;
+    // the tag is verified, its first byte terminates the plaintext
+    output->data[output->data_len] = 0;
     offset += output->data_len;
 
     return op_ret;
 }
+
+/**
+ * @brief Parses an LPV35 frame.
+ *
+ * This function takes the LPV35 frame key, input data, and output object as
+ * parameters and parses the LPV35 frame to populate the output object with the
+ * parsed data.
+ *
+ * @param key The LPV35 frame key.
+ * @param key_len The length of the LPV35 frame key.
+ * @param input The input data containing the LPV35 frame.
+ * @param ilen The length of the input data.
+ * @param output The output object to store the parsed data.
+ *
+ * @return The result of the operation. Possible return values are:
+ *         - OPRT_OK: The LPV35 frame was successfully parsed.
+ *         - OPRT_INVALID_PARM: Invalid parameters were provided.
+ *         - OPRT_PARSE_FRAME_ERR: Error occurred while parsing the LPV35 frame.
+ */
+OPERATE_RET lpv35_frame_parse(const uint8_t *key, int key_len, const uint8_t *input, int ilen,
+                              lpv35_frame_object_t *output)
+{
+    return __lpv35_frame_parse(key, key_len, NULL, input, ilen, false, output);
+}
+
+/**
+ * @brief Parses an LPV35 frame with a cipher bound to the session key.
+ *
+ * @param cipher AES-128-GCM handle created with the session key.
+ * @param input The input data containing the LPV35 frame.
+ * @param ilen The length of the input data.
+ * @param output The output object to store the parsed data.
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET lpv35_frame_parse_keyed(cipher_keyed_t *cipher, const uint8_t *input, int ilen,
+                                    lpv35_frame_object_t *output)
+{
+    if (cipher == NULL) {
+        return OPRT_INVALID_PARM;
+    }
+    return __lpv35_frame_parse(NULL, 0, cipher, input, ilen, false, output);
+}
+
+/**
+ * @brief Parses an LPV35 frame inside the receive buffer.
+ *
+ * The plaintext is decrypted over the ciphertext and output->data points
+ * into \p input, it must not be freed. The byte following the plaintext is
+ * set to 0, so output->data can be used as a string.
+ *
+ * @param key The LPV35 frame key, used when \p cipher is NULL.
+ * @param key_len The length of the LPV35 frame key.
+ * @param cipher AES-128-GCM handle created with the session key, or NULL.
+ * @param input The input data containing the LPV35 frame, modified in place.
+ * @param ilen The length of the input data.
+ * @param output The output object to store the parsed data.
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET lpv35_frame_parse_inplace(const uint8_t *key, int key_len, cipher_keyed_t *cipher, uint8_t *input,
+                                      int ilen, lpv35_frame_object_t *output)
+{
+    return __lpv35_frame_parse(key, key_len, cipher, input, ilen, true, output);
+}
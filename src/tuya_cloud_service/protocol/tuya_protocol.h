@@ -63,6 +63,11 @@ extern "C" {
      LPV35_FRAME_TYPE_SIZE + LPV35_FRAME_DATALEN_SIZE + LPV35_FRAME_NONCE_SIZE + LPV35_FRAME_TAG_SIZE +                \
      LPV35_FRAME_TAIL_SIZE)
 
+// plaintext placed here is encrypted in place by lpv35_frame_serialize
+#define LPV35_FRAME_DATA_OFFSET                                                                                        \
+    (LPV35_FRAME_HEAD_SIZE + LPV35_FRAME_VERSION_SIZE + LPV35_FRAME_RESERVE_SIZE + LPV35_FRAME_SEQUENCE_SIZE +         \
+     LPV35_FRAME_TYPE_SIZE + LPV35_FRAME_DATALEN_SIZE + LPV35_FRAME_NONCE_SIZE)
+
 #pragma pack(1)
 typedef struct {
     uint8_t version : 4;
@@ -112,6 +117,36 @@ typedef dp_cmd_type_t DP_CMD_TYPE_E;
 OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len, const char *key,
                                      char **out_data);
 
+/**
+ * @brief parse protocol data with a cipher bound to the key
+ *
+ * @param[in] cmd refer to DP_CMD_TYPE_E
+ * @param[in] data origin data
+ * @param[in] len data length
+ * @param[in] cipher AES-128-GCM keyed handle
+ * @param[out] out_data parse out
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_parse_protocol_data_keyed(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len,
+                                           cipher_keyed_t *cipher, char **out_data);
+
+/**
+ * @brief parse protocol data in place, nothing is allocated
+ *
+ * @param[in] cmd refer to DP_CMD_TYPE_E
+ * @param[in,out] data origin data, decrypted in place
+ * @param[in] len data length, data[len] must be writable for DP_CMD_LAN
+ * @param[in] cipher AES-128-GCM keyed handle, required by DP_CMD_MQ
+ * @param[out] out_data parse out, points into data and must not be freed
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_parse_protocol_data_inplace(const DP_CMD_TYPE_E cmd, uint8_t *data, const int len,
+                                             cipher_keyed_t *cipher, char **out_data);
+
 /**
  * @brief pack protocol data
  *
@@ -129,9 +164,55 @@ OPERATE_RET tuya_parse_protocol_data(const DP_CMD_TYPE_E cmd, uint8_t *data, con
  */
 OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro, uint8_t *key,
                                     char **out, uint32_t *out_len);
+
+/**
+ * @brief pack protocol data with a cipher bound to the key
+ *
+ * @param[in] cmd refer to DP_CMD_TYPE_E
+ * @param[in] src origin data
+ * @param[in] pro pro
+ * @param[in] cipher AES-128-GCM keyed handle
+ * @param[out] out pack out
+ * @param[out] out_len pack out length
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_pack_protocol_data_keyed(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro,
+                                          cipher_keyed_t *cipher, char **out, uint32_t *out_len);
+
+/**
+ * @brief get the buffer size needed by tuya_pack_protocol_data_into
+ *
+ * @param[in] cmd refer to DP_CMD_TYPE_E
+ * @param[in] src data to be packed
+ *
+ * @return buffer size, 0 if cmd is not supported
+ */
+uint32_t tuya_pack_protocol_data_size(const DP_CMD_TYPE_E cmd, const char *src);
+
+/**
+ * @brief pack protocol data into a caller buffer, nothing is allocated
+ *
+ * @param[in] cmd refer to DP_CMD_TYPE_E
+ * @param[in] src data to be packed
+ * @param[in] pro protocol id
+ * @param[in] cipher AES-128-GCM keyed handle, required by DP_CMD_MQ
+ * @param[out] buf output buffer, see tuya_pack_protocol_data_size
+ * @param[in] buf_size size of buf
+ * @param[out] out_len packed data length
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_pack_protocol_data_into(const DP_CMD_TYPE_E cmd, const char *src, const uint32_t pro,
+                                         cipher_keyed_t *cipher, uint8_t *buf, uint32_t buf_size, uint32_t *out_len);
 /**
  * @brief add head and tail in lpv35 frame
  *
+ * input->data may point at output + LPV35_FRAME_DATA_OFFSET, it is then
+ * encrypted in place and no plaintext copy is needed.
+ *
  * @param[in] key encrypt key
  * @param[in] key_len encrypt key len
  * @param[in] input raw data of lpv35 frame
@@ -144,6 +225,20 @@ OPERATE_RET tuya_pack_protocol_data(const DP_CMD_TYPE_E cmd, const char *src, co
 OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_frame_object_t *input, uint8_t *output,
                                   int *olen);
 
+/**
+ * @brief add head and tail in lpv35 frame with a cipher bound to the key
+ *
+ * @param[in] cipher AES-128-GCM keyed handle
+ * @param[in] input raw data of lpv35 frame
+ * @param[out] output out frame data
+ * @param[out] olen out frame data len
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET lpv35_frame_serialize_keyed(cipher_keyed_t *cipher, const lpv35_frame_object_t *input, uint8_t *output,
+                                        int *olen);
+
 /**
  * @brief lpv35 frame parse
  *
@@ -159,6 +254,36 @@ OPERATE_RET lpv35_frame_serialize(const uint8_t *key, int key_len, const lpv35_f
 OPERATE_RET lpv35_frame_parse(const uint8_t *key, int key_len, const uint8_t *input, int ilen,
                               lpv35_frame_object_t *output);
 
+/**
+ * @brief lpv35 frame parse with a cipher bound to the key
+ *
+ * @param[in] cipher AES-128-GCM keyed handle
+ * @param[in] input lpv35 frame
+ * @param[in] ilen lpv35 frame len
+ * @param[out] output decrypt raw lpv35 data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET lpv35_frame_parse_keyed(cipher_keyed_t *cipher, const uint8_t *input, int ilen,
+                                    lpv35_frame_object_t *output);
+
+/**
+ * @brief lpv35 frame parse in place, nothing is allocated
+ *
+ * @param[in] key the key, used when cipher is NULL
+ * @param[in] key_len the key len
+ * @param[in] cipher AES-128-GCM keyed handle or NULL
+ * @param[in,out] input lpv35 frame, decrypted in place
+ * @param[in] ilen lpv35 frame len
+ * @param[out] output raw lpv35 data, output->data points into input
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET lpv35_frame_parse_inplace(const uint8_t *key, int key_len, cipher_keyed_t *cipher, uint8_t *input,
+                                      int ilen, lpv35_frame_object_t *output);
+
 /**
  * @brief get lpv35 frame buffer size
  *
@@ -23,7 +23,14 @@
 
 #define MAX_TRANS_TYPE_NUM (DTT_SCT_SCENE + 1)
 
+#ifndef DP_SCHEMA_NUM_MAX
 #define DP_SCHEMA_NUM_MAX 1
+#endif
+
+// devid hash buckets, must be a power of 2
+#ifndef DP_SCHEMA_BUCKET_NUM
+#define DP_SCHEMA_BUCKET_NUM 8
+#endif
 
 typedef struct {
     // DELAYED_WORK_HANDLE tmm_dp_sync;
@@ -31,10 +38,50 @@ typedef struct {
     MUTEX_HANDLE mutex;
     uint8_t schema_num;
     dp_schema_t *schema_list[DP_SCHEMA_NUM_MAX];
+    uint32_t devid_hash[DP_SCHEMA_NUM_MAX]; // hash of schema_list[i]->devid, compared before strcmp
+    uint16_t bucket[DP_SCHEMA_BUCKET_NUM];  // first slot + 1 of each hash chain, 0 is empty
+    uint16_t next[DP_SCHEMA_NUM_MAX];       // next slot + 1 in the same chain, 0 is the end
 } dp_schema_mgr_t;
 
 static dp_schema_mgr_t s_dsmgr = {0};
 
+static uint32_t dp_devid_hash(const char *devid)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*devid) {
+        hash ^= (uint8_t)*devid++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* length of a string once escaped as a json string, quotes excluded */
+static uint32_t dp_json_str_len(const char *str)
+{
+    uint32_t len = 0;
+
+    for (; *str; str++) {
+        switch (*str) {
+        case '"':
+        case '\\':
+        case '\b':
+        case '\f':
+        case '\n':
+        case '\r':
+        case '\t':
+            len += 2;
+            break;
+        default:
+            len += ((uint8_t)*str < 0x20) ? 6 : 1;
+            break;
+        }
+    }
+
+    return len;
+}
+
 /**
  * @brief Appends a JSON string to the given data with the specified time, type,
  * and repetition sequence.
@@ -118,16 +165,27 @@ __err_exit:
  */
 dp_node_t *dp_node_find(dp_schema_t *schema, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
+    if (id < 0 || id >= (int)CNTSOF(schema->index) || 0 == schema->index[id]) {
+        return NULL;
+    }
 
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
+    return &schema->node[schema->index[id] - 1];
+}
+
+static uint16_t *dp_schema_link(dp_schema_mgr_t *dsmgr, const char *devid, uint32_t hash)
+{
+    // walk only the chain of this hash bucket
+    uint16_t *link = &dsmgr->bucket[hash & (DP_SCHEMA_BUCKET_NUM - 1)];
+
+    while (*link) {
+        uint16_t i = *link - 1;
+        if (hash == dsmgr->devid_hash[i] && 0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
             break;
         }
+        link = &dsmgr->next[i];
     }
-    return dpnode;
+
+    return link;
 }
 
 /**
@@ -138,22 +196,13 @@ dp_node_t *dp_node_find(dp_schema_t *schema, int id)
  */
 dp_schema_t *dp_schema_find(const char *devid)
 {
-    int i = 0;
-
-    PR_TRACE("try to find schema devid %s", devid);
     dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            return dsmgr->schema_list[i];
-        }
+    uint16_t *link = NULL;
 
-        PR_TRACE("find schema devid %s, not match!", dsmgr->schema_list[i]->devid);
-    }
+    PR_TRACE("try to find schema devid %s", devid);
+    link = dp_schema_link(dsmgr, devid, dp_devid_hash(devid));
 
-    return NULL;
+    return *link ? dsmgr->schema_list[*link - 1] : NULL;
 }
 
 /**
@@ -168,20 +217,12 @@ dp_schema_t *dp_schema_find(const char *devid)
  */
 dp_node_t *dp_node_find_by_devid(char *devid, int id)
 {
-    int i;
-    dp_node_t *dpnode = NULL;
-
     dp_schema_t *schema = dp_schema_find(devid);
     if (NULL == schema) {
         return NULL;
     }
-    for (i = 0; i < schema->num; i++) {
-        if (schema->node[i].desc.id == id) {
-            dpnode = &schema->node[i];
-            break;
-        }
-    }
-    return dpnode;
+
+    return dp_node_find(schema, id);
 }
 
 static __attribute__((unused)) OPERATE_RET dp_obj_equal_resp(dp_schema_t *schema, uint8_t *dpid, uint8_t num,
@@ -785,7 +826,7 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
         }
 
         case PROP_STR: {
-            dpvalid->len += 2 * strlen(dp->value.dp_str) + 15;
+            dpvalid->len += dp_json_str_len(dp->value.dp_str) + 15;
         } break;
 
         case PROP_ENUM: {
@@ -794,7 +835,7 @@ int dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
                 tal_mutex_unlock(schema->mutex);
                 return OPRT_SVC_DP_TYPE_PROP_ILLEGAL;
             }
-            dpvalid->len += strlen(dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]) + 15;
+            dpvalid->len += dp_json_str_len(dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]) + 15;
         } break;
 
         default: {
@@ -957,6 +998,253 @@ __err_exit:
     return op_ret;
 }
 
+/* bounded json writer, keeps counting past the end so the caller learns the
+ * needed size */
+typedef struct {
+    char *buf;
+    uint32_t size;
+    uint32_t len;
+} dp_json_writer_t;
+
+static void dp_json_put_char(dp_json_writer_t *w, char c)
+{
+    if (w->len < w->size) {
+        w->buf[w->len] = c;
+    }
+    w->len++;
+}
+
+static void dp_json_put_raw(dp_json_writer_t *w, const char *str, uint32_t len)
+{
+    if (w->len + len <= w->size) {
+        memcpy(w->buf + w->len, str, len);
+    }
+    w->len += len;
+}
+
+static void dp_json_put_uint(dp_json_writer_t *w, uint32_t value)
+{
+    char tmp[10];
+    uint8_t n = 0;
+
+    do {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (n) {
+        dp_json_put_char(w, tmp[--n]);
+    }
+}
+
+static void dp_json_put_int(dp_json_writer_t *w, int value)
+{
+    if (value < 0) {
+        dp_json_put_char(w, '-');
+        dp_json_put_uint(w, 0u - (uint32_t)value);
+    } else {
+        dp_json_put_uint(w, (uint32_t)value);
+    }
+}
+
+/* same escaping as cJSON_PrintUnformatted */
+static void dp_json_put_str(dp_json_writer_t *w, const char *str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    dp_json_put_char(w, '"');
+    for (; *str; str++) {
+        uint8_t c = (uint8_t)*str;
+        switch (c) {
+        case '"':
+        case '\\':
+            dp_json_put_char(w, '\\');
+            dp_json_put_char(w, c);
+            break;
+        case '\b':
+            dp_json_put_raw(w, "\\b", 2);
+            break;
+        case '\f':
+            dp_json_put_raw(w, "\\f", 2);
+            break;
+        case '\n':
+            dp_json_put_raw(w, "\\n", 2);
+            break;
+        case '\r':
+            dp_json_put_raw(w, "\\r", 2);
+            break;
+        case '\t':
+            dp_json_put_raw(w, "\\t", 2);
+            break;
+        default:
+            if (c < 0x20) {
+                dp_json_put_raw(w, "\\u00", 4);
+                dp_json_put_char(w, hex[c >> 4]);
+                dp_json_put_char(w, hex[c & 0x0f]);
+            } else {
+                dp_json_put_char(w, c);
+            }
+            break;
+        }
+    }
+    dp_json_put_char(w, '"');
+}
+
+static void dp_json_put_key(dp_json_writer_t *w, uint8_t id)
+{
+    dp_json_put_char(w, '"');
+    dp_json_put_uint(w, id);
+    dp_json_put_raw(w, "\":", 2);
+}
+
+static dp_obj_t *dp_rept_obj_find(dp_rept_in_t *dpin, uint8_t id)
+{
+    uint16_t i;
+
+    for (i = 0; i < dpin->dpscnt; i++) {
+        if (id == dpin->dps[i].id) {
+            return &dpin->dps[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get the buffer size needed by dp_rept_json_stream.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpvalid Validation result from dp_rept_valid_check.
+ * @return Upper bound of the report length, terminating '\0' included.
+ */
+uint32_t dp_rept_json_stream_size(dp_schema_t *schema, dp_rept_valid_t *dpvalid)
+{
+    // {"devId":"","dps":{},"t":{}} and '\0'
+    return dpvalid->len + dpvalid->timelen + dp_json_str_len(schema->devid) + 32;
+}
+
+/**
+ * @brief Writes the whole report json of the valid DPs into a buffer in one
+ * pass.
+ *
+ * The output is {"devId":"..","dps":{..}}, with "t":{..} added for STAT
+ * reports carrying time stamps. Unlike dp_rept_json_output() and
+ * dp_rept_json_append() no intermediate string or cJSON object is allocated.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpin Pointer to the input data structure.
+ * @param dpvalid Validation result from dp_rept_valid_check.
+ * @param buf Output buffer, see dp_rept_json_stream_size().
+ * @param size Size of the output buffer.
+ * @param len Length of the report without '\0', also set when the buffer is
+ * too small.
+ * @return OPRT_OK on success, OPRT_BUFFER_NOT_ENOUGH if the buffer is too
+ * small. Others on error, please refer to tuya_error_code.h
+ */
+int dp_rept_json_stream(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, char *buf, uint32_t size,
+                        uint32_t *len)
+{
+    uint16_t i;
+    OPERATE_RET op_ret = OPRT_OK;
+    bool has_time = false;
+    dp_json_writer_t w = {.buf = buf, .size = size, .len = 0};
+
+    if (NULL == schema || NULL == dpin || NULL == dpvalid || NULL == len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    dp_json_put_raw(&w, "{\"devId\":", 9);
+    dp_json_put_str(&w, schema->devid);
+    dp_json_put_raw(&w, ",\"dps\":{", 8);
+
+    tal_mutex_lock(schema->mutex);
+    for (i = 0; i < dpvalid->num; i++) {
+        dp_obj_t *dp = dp_rept_obj_find(dpin, dpvalid->dpid[i]);
+        dp_node_t *dpnode = dp ? dp_node_find(schema, dp->id) : NULL;
+        if (NULL == dpnode) {
+            PR_DEBUG("dp %d not found", dpvalid->dpid[i]);
+            op_ret = OPRT_SVC_DP_ID_NOT_FOUND;
+            break;
+        }
+        if (dp->type != dpnode->desc.prop_tp) {
+            op_ret = OPRT_SVC_DP_TP_NOT_MATCH;
+            break;
+        }
+
+        if (i) {
+            dp_json_put_char(&w, ',');
+        }
+        dp_json_put_key(&w, dp->id);
+        switch (dp->type) {
+        case PROP_BOOL:
+            if (TRUE == dp->value.dp_bool) {
+                dp_json_put_raw(&w, "true", 4);
+            } else {
+                dp_json_put_raw(&w, "false", 5);
+            }
+            break;
+        case PROP_VALUE:
+            dp_json_put_int(&w, dp->value.dp_value);
+            break;
+        case PROP_BITMAP:
+            dp_json_put_uint(&w, dp->value.dp_bitmap);
+            break;
+        case PROP_STR:
+            dp_json_put_str(&w, dp->value.dp_str);
+            break;
+        case PROP_ENUM:
+            dp_json_put_str(&w, dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]);
+            break;
+        default:
+            op_ret = OPRT_COM_ERROR;
+            break;
+        }
+        if (OPRT_OK != op_ret) {
+            break;
+        }
+        if (dp->time_stamp) {
+            has_time = true;
+        }
+    }
+    tal_mutex_unlock(schema->mutex);
+
+    if (OPRT_OK != op_ret) {
+        return op_ret;
+    }
+    dp_json_put_char(&w, '}');
+
+    // STAT type DP needs to assemble a timestamp
+    if ((T_STAT_REPT == dpin->rept_type) && has_time) {
+        bool first = true;
+        dp_json_put_raw(&w, ",\"t\":{", 6);
+        for (i = 0; i < dpvalid->num; i++) {
+            dp_obj_t *dp = dp_rept_obj_find(dpin, dpvalid->dpid[i]);
+            if (0 == dp->time_stamp) {
+                continue;
+            }
+            if (!first) {
+                dp_json_put_char(&w, ',');
+            }
+            first = false;
+            dp_json_put_key(&w, dp->id);
+            dp_json_put_uint(&w, (uint32_t)dp->time_stamp);
+        }
+        dp_json_put_char(&w, '}');
+    }
+    dp_json_put_char(&w, '}');
+
+    *len = w.len;
+    if (w.len >= size) {
+        PR_ERR("dp rept buffer not enough %d %d", w.len, size);
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+    buf[w.len] = 0;
+
+    PR_DEBUG("dp rept out: %s", buf);
+
+    return OPRT_OK;
+}
+
 // int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin,
 // dp_rept_out_t *dpout)
 // {
@@ -1525,6 +1813,7 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
     OPERATE_RET op_ret = OPRT_OK;
     dp_node_pos_t *nodepos = NULL;
     int nodenum;
+    int i;
 
     nodepos = tal_malloc(sizeof(dp_node_pos_t) * 255);
     if (NULL == nodepos) {
@@ -1562,15 +1851,30 @@ int dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out
         PR_ERR("dp_node_parse fail:%d", op_ret);
         goto __exit;
     }
+    // id to node table, the first node wins if an id is duplicated
+    for (i = 0; i < nodenum; i++) {
+        uint8_t id = dp_schema->node[i].desc.id;
+        if (0 == dp_schema->index[id]) {
+            dp_schema->index[id] = i + 1;
+        }
+    }
     dp_schema->actv.preprocess = other_attr.preprocess;
     dp_schema->actv.attach_dp_if = TRUE;
     strncpy(dp_schema->devid, devid, DEV_ID_LEN);
     if (dp_schema_out) {
         *dp_schema_out = dp_schema;
     }
-    if (s_dsmgr.schema_num < DP_SCHEMA_NUM_MAX) {
-        s_dsmgr.schema_list[s_dsmgr.schema_num] = dp_schema;
-        s_dsmgr.schema_num++;
+    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
+        if (NULL == s_dsmgr.schema_list[i]) {
+            uint32_t hash = dp_devid_hash(dp_schema->devid);
+            uint16_t *head = &s_dsmgr.bucket[hash & (DP_SCHEMA_BUCKET_NUM - 1)];
+            s_dsmgr.schema_list[i] = dp_schema;
+            s_dsmgr.devid_hash[i] = hash;
+            s_dsmgr.next[i] = *head;
+            *head = i + 1;
+            s_dsmgr.schema_num++;
+            break;
+        }
     }
     PR_DEBUG("create dp_schema Success ");
     tal_free(nodepos);
@@ -1596,23 +1900,23 @@ __exit:
  */
 int dp_schema_delete(char *devid)
 {
-    int i = 0;
+    uint16_t i = 0;
+    uint16_t *link = NULL;
 
     PR_TRACE("try to delete schema devid %s", devid);
     dp_schema_mgr_t *dsmgr = &s_dsmgr;
-    for (i = 0; i < DP_SCHEMA_NUM_MAX; i++) {
-        if (NULL == dsmgr->schema_list[i]) {
-            continue;
-        }
-
-        if (0 == strcmp(devid, dsmgr->schema_list[i]->devid)) {
-            tal_mutex_release(dsmgr->schema_list[i]->mutex);
-            tal_free(dsmgr->schema_list[i]);
-            dsmgr->schema_list[i] = NULL;
-            dsmgr->schema_num--;
-            return OPRT_OK;
-        }
+    link = dp_schema_link(dsmgr, devid, dp_devid_hash(devid));
+    if (0 == *link) {
+        return OPRT_OK;
     }
 
+    i = *link - 1;
+    *link = dsmgr->next[i];
+    dsmgr->next[i] = 0;
+    tal_mutex_release(dsmgr->schema_list[i]->mutex);
+    tal_free(dsmgr->schema_list[i]);
+    dsmgr->schema_list[i] = NULL;
+    dsmgr->schema_num--;
+
     return OPRT_OK;
 }
\ No newline at end of file
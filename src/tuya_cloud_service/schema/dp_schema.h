@@ -331,6 +331,8 @@ typedef struct {
     MUTEX_HANDLE mutex;
     /** count of dp */
     uint8_t num;
+    /** dp id to node position + 1, 0 means not exist */
+    uint8_t index[256];
     /** dp info */
     dp_node_t node[0];
 } dp_schema_t;
@@ -498,6 +500,32 @@ int dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t
  */
 int dp_rept_json_append(dp_schema_t *schema, char *data, char *time, char *type, uint8_t rept_seq, char **pp_out);
 
+/**
+ * @brief Get the buffer size needed by dp_rept_json_stream.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpvalid Validation result from dp_rept_valid_check.
+ * @return Upper bound of the report length, terminating '\0' included.
+ */
+uint32_t dp_rept_json_stream_size(dp_schema_t *schema, dp_rept_valid_t *dpvalid);
+
+/**
+ * @brief Writes the whole report json of the valid DPs into a buffer in one
+ * pass, without intermediate strings or cJSON objects.
+ *
+ * @param schema Pointer to the DP schema structure.
+ * @param dpin Pointer to the input data structure.
+ * @param dpvalid Validation result from dp_rept_valid_check.
+ * @param buf Output buffer, see dp_rept_json_stream_size().
+ * @param size Size of the output buffer.
+ * @param len Length of the report without '\0', also set when the buffer is
+ * too small.
+ * @return OPRT_OK on success, OPRT_BUFFER_NOT_ENOUGH if the buffer is too
+ * small. Others on error, please refer to tuya_error_code.h
+ */
+int dp_rept_json_stream(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, char *buf, uint32_t size,
+                        uint32_t *len);
+
 /**
  * @brief Creates a new data point schema for a device.
  *
@@ -24,6 +24,7 @@
 #include "tuya_lan.h"
 #include "tal_api.h"
 #include "mix_method.h"
+#include "tuya_config_defaults.h"
 
 #ifdef ENABLE_BLUETOOTH
 #include "ble_mgr.h"
@@ -195,9 +196,385 @@ int tuya_iot_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, cJSON *cm
     msg->data_js = cmd_js;
     msg->user_data = client;
 
+    if (0 == client->online.first_dp) {
+        client->online.first_dp = tal_system_get_millisecond();
+        PR_INFO("link up to first dp: %u ms", (uint32_t)(client->online.first_dp - client->online.link_up));
+    }
+
     return tal_workq_schedule(WORKQ_HIGHTPRI, tuya_iot_dp_parse_on_worq, msg);
 }
 
+/* -------------------------------------------------------------------------- */
+/*                             DP report coalescer                            */
+/* -------------------------------------------------------------------------- */
+typedef struct dp_rept_batch {
+    struct dp_rept_batch *next;
+    char devid[DEV_ID_LEN + 1];
+    uint32_t queue_ms; // when the oldest pending DP was queued
+    uint32_t len;      // report json size estimate
+    uint8_t num;
+    uint8_t cap;
+    dp_obj_t *dps; // one per changed DP id, strings are owned
+} dp_rept_batch_t;
+
+static MUTEX_HANDLE s_dp_rept_mutex = NULL;
+static DELAYED_WORK_HANDLE s_dp_rept_flush = NULL;
+static dp_rept_batch_t *s_dp_rept_list = NULL;
+static tuya_iot_dp_report_stat_t s_dp_rept_stat;
+
+static dp_obj_t *dp_obj_find(dp_obj_t *dps, uint16_t dpscnt, uint8_t id)
+{
+    for (uint16_t i = 0; i < dpscnt; i++) {
+        if (id == dps[i].id) {
+            return &dps[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t dp_rept_obj_len(dp_obj_t *dp, dp_node_t *dpnode)
+{
+    if (PROP_STR == dp->type) {
+        return strlen(dp->value.dp_str) + 15;
+    } else if (PROP_ENUM == dp->type && dpnode && dp->value.dp_enum < dpnode->prop.prop_enum.cnt) {
+        return strlen(dpnode->prop.prop_enum.pp_enum[dp->value.dp_enum]) + 15;
+    }
+
+    return 20;
+}
+
+static void dp_rept_batch_free(dp_rept_batch_t *batch)
+{
+    for (uint8_t i = 0; i < batch->num; i++) {
+        if (PROP_STR == batch->dps[i].type) {
+            tal_free(batch->dps[i].value.dp_str);
+        }
+    }
+    tal_free(batch->dps);
+    tal_free(batch);
+}
+
+static void dp_rept_batch_send(tuya_iot_client_t *client, dp_rept_batch_t *batch)
+{
+    int ret = OPRT_COM_ERROR;
+    uint32_t delay = tal_system_get_millisecond() - batch->queue_ms;
+    dp_schema_t *schema = dp_schema_find(batch->devid);
+    dp_rept_valid_t *dpvalid = NULL;
+    char *out = NULL;
+    uint32_t size = 0;
+    uint32_t len = 0;
+    dp_rept_in_t dpin;
+
+    //! values were checked and cached when queued, only build the report
+    dpin.dps = batch->dps;
+    dpin.dpscnt = batch->num;
+    dpin.flags = 0;
+    dpin.rept_type = T_RE_TRANS_REPT;
+
+    if (NULL == schema || !tuya_iot_is_connected()) {
+        goto __exit;
+    }
+
+    dpvalid = tal_malloc(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * batch->num);
+    if (NULL == dpvalid) {
+        ret = OPRT_MALLOC_FAILED;
+        goto __exit;
+    }
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * batch->num);
+
+    ret = dp_rept_valid_check(schema, &dpin, dpvalid);
+    if (OPRT_OK != ret) {
+        goto __exit;
+    }
+
+    size = dp_rept_json_stream_size(schema, dpvalid);
+    out = tal_malloc(size);
+    if (NULL == out) {
+        ret = OPRT_MALLOC_FAILED;
+        goto __exit;
+    }
+
+    ret = dp_rept_json_stream(schema, &dpin, dpvalid, out, size, &len);
+    if (OPRT_OK != ret) {
+        goto __exit;
+    }
+
+    PR_DEBUG("mqtt channel report %d dps, delay %d ms", batch->num, delay);
+    ret = tuya_mqtt_protocol_data_publish_common(&client->mqctx, PRO_DATA_PUSH, (const uint8_t *)out, (uint16_t)len,
+                                                 (mqtt_publish_notify_cb_t)dp_sync_cb, dpvalid, 5000, false);
+    if (OPRT_OK == ret) {
+        dpvalid = NULL; // freed by dp_sync_cb
+    }
+
+__exit:
+    tal_mutex_lock(s_dp_rept_mutex);
+    if (OPRT_OK == ret) {
+        s_dp_rept_stat.message_num++;
+        if (delay > s_dp_rept_stat.delay_max) {
+            s_dp_rept_stat.delay_max = delay;
+        }
+        if (1 == s_dp_rept_stat.message_num) {
+            s_dp_rept_stat.delay_avg = delay;
+        } else {
+            s_dp_rept_stat.delay_avg = (s_dp_rept_stat.delay_avg * 7 + delay) / 8;
+        }
+    }
+    tal_mutex_unlock(s_dp_rept_mutex);
+
+    if (OPRT_OK != ret) {
+        PR_ERR("dp merged report failed %d", ret);
+        //! start mqtt cloud sync
+        tuya_iot_dp_sync_start(client, 5);
+    }
+
+    tal_free(out);
+    tal_free(dpvalid);
+    dp_rept_batch_free(batch);
+}
+
+/* send the batches of a device, or all of them, expired_only keeps the ones
+ * still inside the window and rearms the timer for them */
+static void dp_rept_flush(tuya_iot_client_t *client, const char *devid, bool expired_only)
+{
+    dp_rept_batch_t *ready = NULL;
+    dp_rept_batch_t *batch = NULL;
+    dp_rept_batch_t **pos = NULL;
+#if DP_REPORT_COALESCE_MS
+    uint32_t now = tal_system_get_millisecond();
+#endif
+    uint32_t next = DP_REPORT_COALESCE_MS;
+    bool rearm = false;
+
+    if (NULL == s_dp_rept_mutex) {
+        return;
+    }
+
+    tal_mutex_lock(s_dp_rept_mutex);
+    pos = &s_dp_rept_list;
+    while ((batch = *pos)) {
+        if (devid && strcmp(devid, batch->devid)) {
+            pos = &batch->next;
+            continue;
+        }
+#if DP_REPORT_COALESCE_MS
+        uint32_t age = now - batch->queue_ms;
+        if (expired_only && age < DP_REPORT_COALESCE_MS) {
+            if (DP_REPORT_COALESCE_MS - age < next) {
+                next = DP_REPORT_COALESCE_MS - age;
+            }
+            rearm = true;
+            pos = &batch->next;
+            continue;
+        }
+#endif
+        *pos = batch->next;
+        batch->next = ready;
+        ready = batch;
+    }
+    if (rearm) {
+        tal_workq_start_delayed(s_dp_rept_flush, next, LOOP_ONCE);
+    }
+    tal_mutex_unlock(s_dp_rept_mutex);
+
+    while (ready) {
+        batch = ready;
+        ready = batch->next;
+        dp_rept_batch_send(client, batch);
+    }
+}
+
+static void dp_rept_flush_on_worq(void *data)
+{
+    dp_rept_flush((tuya_iot_client_t *)data, NULL, true);
+}
+
+/* room for one more DP in a batch, grown by the DPs left in the report */
+static int dp_rept_batch_reserve(dp_rept_batch_t *batch, uint8_t more)
+{
+    dp_obj_t *dps = NULL;
+    uint32_t cap = 0;
+
+    if (batch->num < batch->cap) {
+        return OPRT_OK;
+    }
+
+    cap = batch->cap * 2;
+    if (cap < (uint32_t)batch->num + more) {
+        cap = batch->num + more;
+    }
+    if (cap > MAX_DP_NUM) {
+        cap = MAX_DP_NUM;
+    }
+
+    dps = tal_realloc(batch->dps, sizeof(dp_obj_t) * cap);
+    if (NULL == dps) {
+        return OPRT_MALLOC_FAILED;
+    }
+    batch->dps = dps;
+    batch->cap = cap;
+
+    return OPRT_OK;
+}
+
+/* take a batch off the pending list, the caller sends it */
+static void dp_rept_batch_detach(dp_rept_batch_t *batch, dp_rept_batch_t **ready)
+{
+    dp_rept_batch_t **pos = &s_dp_rept_list;
+
+    while (*pos != batch) {
+        pos = &(*pos)->next;
+    }
+    *pos = batch->next;
+    batch->next = *ready;
+    *ready = batch;
+}
+
+/* merge validated DPs into the pending batch of their device, state DPs keep
+ * the last value, an event DP already pending sends the batch first */
+static int dp_rept_queue(tuya_iot_client_t *client, dp_schema_t *schema, dp_rept_in_t *dpin,
+                         dp_rept_valid_t *dpvalid)
+{
+    int ret = OPRT_OK;
+    dp_rept_batch_t *ready = NULL;
+    dp_rept_batch_t *batch = NULL;
+
+    tal_mutex_lock(s_dp_rept_mutex);
+    if (NULL == s_dp_rept_flush) {
+        ret = tal_workq_init_delayed(WORKQ_HIGHTPRI, dp_rept_flush_on_worq, client, &s_dp_rept_flush);
+        if (OPRT_OK != ret) {
+            tal_mutex_unlock(s_dp_rept_mutex);
+            return ret;
+        }
+    }
+
+    for (batch = s_dp_rept_list; batch && strcmp(batch->devid, schema->devid); batch = batch->next) {
+    }
+
+    for (uint8_t i = 0; i < dpvalid->num; i++) {
+        dp_obj_t *dp = dp_obj_find(dpin->dps, dpin->dpscnt, dpvalid->dpid[i]);
+        dp_node_t *dpnode = dp_node_find(schema, dp->id);
+        dp_obj_t *slot = batch ? dp_obj_find(batch->dps, batch->num, dp->id) : NULL;
+        char *str = NULL;
+
+        if (batch && ((slot && dpnode && TRIG_DIRECT == dpnode->desc.trig) || (!slot && batch->num >= MAX_DP_NUM))) {
+            dp_rept_batch_detach(batch, &ready);
+            batch = NULL;
+            slot = NULL;
+        }
+
+        if (PROP_STR == dp->type) {
+            str = tal_malloc(strlen(dp->value.dp_str) + 1);
+            if (NULL == str) {
+                ret = OPRT_MALLOC_FAILED;
+                break;
+            }
+            strcpy(str, dp->value.dp_str);
+        }
+
+        if (NULL == batch) {
+            batch = tal_calloc(1, sizeof(dp_rept_batch_t));
+            if (NULL == batch || OPRT_OK != dp_rept_batch_reserve(batch, dpvalid->num - i)) {
+                tal_free(batch);
+                tal_free(str);
+                ret = OPRT_MALLOC_FAILED;
+                break;
+            }
+            strncpy(batch->devid, schema->devid, DEV_ID_LEN);
+            batch->queue_ms = tal_system_get_millisecond();
+            if (NULL == s_dp_rept_list) {
+                tal_workq_start_delayed(s_dp_rept_flush, DP_REPORT_COALESCE_MS, LOOP_ONCE);
+            }
+            batch->next = s_dp_rept_list;
+            s_dp_rept_list = batch;
+        }
+
+        if (slot) {
+            if (PROP_STR == slot->type) {
+                tal_free(slot->value.dp_str);
+            }
+            s_dp_rept_stat.merge_num++;
+        } else if (OPRT_OK == (ret = dp_rept_batch_reserve(batch, dpvalid->num - i))) {
+            slot = &batch->dps[batch->num++];
+        } else {
+            tal_free(str);
+            break;
+        }
+        *slot = *dp;
+        if (str) {
+            slot->value.dp_str = str;
+        }
+        batch->len += dp_rept_obj_len(dp, dpnode);
+    }
+
+    if (batch && batch->len >= DP_REPORT_COALESCE_BYTES) {
+        dp_rept_batch_detach(batch, &ready);
+    }
+    s_dp_rept_stat.report_num++;
+    tal_mutex_unlock(s_dp_rept_mutex);
+
+    while (ready) {
+        batch = ready;
+        ready = batch->next;
+        dp_rept_batch_send(client, batch);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Initializes the DP report coalescer.
+ *
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_report_init(void)
+{
+    if (s_dp_rept_mutex) {
+        return OPRT_OK;
+    }
+
+    return tal_mutex_create_init(&s_dp_rept_mutex);
+}
+
+/**
+ * @brief Publishes the DP reports waiting in the coalesce window at once.
+ *
+ * @param client The Tuya IoT client instance.
+ * @param devid The device ID, NULL for all devices.
+ *
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_report_flush(tuya_iot_client_t *client, const char *devid)
+{
+    if (NULL == client || NULL == s_dp_rept_mutex) {
+        return OPRT_INVALID_PARM;
+    }
+
+    dp_rept_flush(client, devid, false);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the DP report coalescer statistics.
+ *
+ * @param stat Output of the statistics.
+ *
+ * @return Returns 0 on success, or a negative error code on failure.
+ */
+int tuya_iot_dp_report_stat_get(tuya_iot_dp_report_stat_t *stat)
+{
+    if (NULL == stat || NULL == s_dp_rept_mutex) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(s_dp_rept_mutex);
+    *stat = s_dp_rept_stat;
+    tal_mutex_unlock(s_dp_rept_mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Reports device object data to the Tuya IoT cloud service.
  *
@@ -234,7 +611,7 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     if (NULL == dpvalid) {
         return OPRT_MALLOC_FAILED;
     }
-    memset(dpvalid, 0, sizeof(sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt));
+    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpscnt);
 
     PR_DEBUG("dp report: devid %s, dps 0x%08x, dpscnt %d, flags %d", devid ? devid : "null", dps, dpscnt, flags);
 
@@ -256,6 +633,8 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     if (tuya_ble_is_connected()) {
         dp_rept_in_t *ble_dpin = NULL;
 
+        dp_rept_flush(client, schema->devid, false);
+
         ble_dpin = tal_malloc(sizeof(dp_rept_in_t) + sizeof(dp_obj_t) * dpvalid->num);
         if (NULL == ble_dpin) {
             tal_free(dpvalid);
@@ -285,37 +664,48 @@ int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_
     }
 #endif
 
-    dp_rept_out_t dpout;
+    //! mqtt reports of a device are merged inside the coalesce window
+    if (DP_REPORT_COALESCE_MS > 0 && s_dp_rept_mutex && !tuya_lan_is_connected() && tuya_iot_is_connected()) {
+        ret = dp_rept_queue(client, schema, &dpin, dpvalid);
+        tal_free(dpvalid);
+        return ret;
+    }
 
-    memset(&dpout, 0, sizeof(dpout));
+    //! sent at once, the DPs of the device still in the window go first
+    dp_rept_flush(client, schema->devid, false);
+
+    //! the final report json is written in one pass, lan and mqtt share it
+    uint32_t size = dp_rept_json_stream_size(schema, dpvalid);
+    uint32_t len = 0;
+    char *out = tal_malloc(size);
+    if (NULL == out) {
+        tal_free(dpvalid);
+        return OPRT_MALLOC_FAILED;
+    }
 
-    ret = dp_rept_json_output(schema, &dpin, dpvalid, &dpout);
+    ret = dp_rept_json_stream(schema, &dpin, dpvalid, out, size, &len);
     if (OPRT_OK != ret) {
-        PR_DEBUG("dp rept json output error %d", ret);
+        PR_DEBUG("dp rept json stream error %d", ret);
+        tal_free(out);
+        tal_free(dpvalid);
         return ret;
     }
 
     if (tuya_lan_is_connected()) {
-        char *out = NULL;
         PR_DEBUG("lan channel report");
-        dp_rept_json_append(schema, dpout.dpsjson, NULL, NULL, 0, &out);
         ret = tuya_lan_dp_report(out);
-        tal_free(out);
         tal_free(dpvalid);
         tuya_iot_dp_sync_start(client, 5);
     } else if (tuya_iot_is_connected()) {
         PR_DEBUG("mqtt channel report");
-        ret = tuya_iot_dp_report_json_with_notify(client, dpout.dpsjson, NULL, dp_sync_cb, dpvalid, 5000);
+        ret = tuya_mqtt_protocol_data_publish_common(&client->mqctx, PRO_DATA_PUSH, (const uint8_t *)out, (uint16_t)len,
+                                                     (mqtt_publish_notify_cb_t)dp_sync_cb, dpvalid, 5000, false);
     } else {
         PR_ERR("no channel for connect");
+        tal_free(dpvalid);
     }
 
-    if (dpout.dpsjson) {
-        tal_free(dpout.dpsjson);
-    }
-    if (dpout.timejson) {
-        tal_free(dpout.timejson);
-    }
+    tal_free(out);
 
     return ret;
 }
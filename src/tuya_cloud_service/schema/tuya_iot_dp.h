@@ -23,6 +23,19 @@ extern "C" {
 
 #include "tuya_iot.h"
 
+/**
+ * @brief DP report coalescer statistics, report_num - message_num is the
+ * number of MQTT messages saved
+ *
+ */
+typedef struct {
+    uint32_t report_num;  // reports queued in the coalesce window
+    uint32_t message_num; // messages published for them
+    uint32_t merge_num;   // DP values replaced by a newer one before publish
+    uint32_t delay_max;   // ms from the first queued DP to publish
+    uint32_t delay_avg;   // ms, smoothed
+} tuya_iot_dp_report_stat_t;
+
 /**
  * @brief
  *
@@ -55,6 +68,30 @@ int tuya_iot_dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_s
  */
 int tuya_iot_dp_obj_report(tuya_iot_client_t *client, const char *devid, dp_obj_t *dps, uint16_t dpscnt, int flags);
 
+/**
+ * @brief Initializes the DP report coalescer, see DP_REPORT_COALESCE_MS.
+ *
+ * @return int
+ */
+int tuya_iot_dp_report_init(void);
+
+/**
+ * @brief Publishes the DP reports waiting in the coalesce window at once.
+ *
+ * @param client
+ * @param devid device ID, NULL for all devices
+ * @return int
+ */
+int tuya_iot_dp_report_flush(tuya_iot_client_t *client, const char *devid);
+
+/**
+ * @brief Gets the DP report coalescer statistics.
+ *
+ * @param stat
+ * @return int
+ */
+int tuya_iot_dp_report_stat_get(tuya_iot_dp_report_stat_t *stat);
+
 /**
  * @brief
  *
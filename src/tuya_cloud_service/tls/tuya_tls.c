@@ -11,6 +11,7 @@
  *
  */
 
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS // session master secret, tells a resumed handshake
 #include "tuya_tls.h"
 
 #if !defined(MBEDTLS_CONFIG_FILE)
@@ -38,14 +39,28 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/platform_util.h"
+#include "crc32i.h"
 
 #define TLS_URL_LEN (128 + 16)
 
+/* sessions kept for resumption, 0 disables the cache */
+#ifndef TUYA_TLS_SESSION_CACHE_NUM
+#define TUYA_TLS_SESSION_CACHE_NUM 4
+#endif
+
+/* save sessions to kv so they survive a reboot */
+#ifndef TUYA_TLS_SESSION_PERSIST
+#define TUYA_TLS_SESSION_PERSIST 0
+#endif
+
+typedef struct tuya_tls_ca_chain tuya_tls_ca_chain_t;
+
 typedef struct {
     tuya_tls_config_t config;
     mbedtls_ssl_context ssl_ctx;
     mbedtls_ssl_config conf_ctx;
-    mbedtls_x509_crt cacert;
+    tuya_tls_ca_chain_t *ca_chain;
     mbedtls_x509_crt client_cert;
     mbedtls_pk_context client_pkey;
     int socket_fd;
@@ -309,6 +324,305 @@ static int __tuya_tls_socket_recv_cb(void *ctx, unsigned char *buf, size_t len)
     return rv;
 }
 
+/* -------------------------------------------------------------------------- */
+/*                      TLS session cache and shared CA                       */
+/* -------------------------------------------------------------------------- */
+typedef struct {
+    bool valid;
+    bool verify; // set up with a verified server certificate
+    tuya_tls_mode_t mode;
+    uint16_t port;
+    uint32_t used; // lru stamp
+    char host[TLS_URL_LEN];
+    mbedtls_ssl_session session;
+} tuya_tls_session_entry_t;
+
+struct tuya_tls_ca_chain {
+    const char *ca_cert; // the PEM/DER buffer the chain was parsed from
+    int size;
+    uint16_t ref;
+    mbedtls_x509_crt crt;
+    char data[]; // copy of the buffer, new content at the same place is parsed again
+};
+
+static MUTEX_HANDLE s_tls_cache_mutex = NULL;
+#if TUYA_TLS_SESSION_CACHE_NUM > 0
+static tuya_tls_session_entry_t s_tls_session[TUYA_TLS_SESSION_CACHE_NUM];
+static uint32_t s_tls_session_used = 0;
+#endif
+static tuya_tls_ca_chain_t *s_tls_ca_chain = NULL;
+static tuya_tls_stat_t s_tls_stat;
+
+#if TUYA_TLS_SESSION_CACHE_NUM > 0
+static void __tuya_tls_session_key(const char *host, uint16_t port, char *key, size_t size)
+{
+    unsigned int hash = hash_crc32i_init();
+
+    hash = hash_crc32i_update(hash, host, strlen(host));
+    hash = hash_crc32i_update(hash, &port, sizeof(port));
+    snprintf(key, size, "tls_ss_%08x", hash_crc32i_finish(hash));
+}
+
+/* entry of a host, a session set up without verify is never used by a
+ * connection that verifies the server */
+static tuya_tls_session_entry_t *__tuya_tls_session_find(tuya_tls_config_t *config)
+{
+    for (int i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+        tuya_tls_session_entry_t *entry = &s_tls_session[i];
+        if (entry->valid && entry->port == config->port && entry->mode == config->mode &&
+            (entry->verify || !config->verify) && !strcmp(entry->host, config->hostname)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static tuya_tls_session_entry_t *__tuya_tls_session_slot(tuya_tls_config_t *config)
+{
+    tuya_tls_session_entry_t *slot = &s_tls_session[0];
+
+    for (int i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+        tuya_tls_session_entry_t *entry = &s_tls_session[i];
+        if (entry->valid && entry->port == config->port && !strcmp(entry->host, config->hostname)) {
+            slot = entry;
+            break;
+        }
+        if (!entry->valid || (slot->valid && entry->used < slot->used)) {
+            slot = entry;
+        }
+    }
+
+    mbedtls_ssl_session_free(&slot->session);
+    memset(slot, 0, sizeof(tuya_tls_session_entry_t));
+    strcpy(slot->host, config->hostname);
+    slot->port = config->port;
+    slot->mode = config->mode;
+    slot->verify = config->verify;
+
+    return slot;
+}
+
+#if TUYA_TLS_SESSION_PERSIST
+static tuya_tls_session_entry_t *__tuya_tls_session_restore(tuya_tls_config_t *config)
+{
+    char key[16];
+    const uint8_t *value = NULL;
+    size_t length = 0;
+    tuya_tls_session_entry_t *entry = NULL;
+
+    __tuya_tls_session_key(config->hostname, config->port, key, sizeof(key));
+    if (OPRT_OK != tal_kv_get_ref(key, &value, &length)) {
+        return NULL;
+    }
+
+    // [mode][verify][mbedtls_ssl_session_save]
+    if (length > 2 && value[0] == config->mode && (value[1] || !config->verify)) {
+        entry = __tuya_tls_session_slot(config);
+        entry->verify = value[1];
+        if (0 == mbedtls_ssl_session_load(&entry->session, value + 2, length - 2)) {
+            entry->valid = true;
+        } else {
+            mbedtls_ssl_session_free(&entry->session);
+            entry = NULL;
+        }
+    }
+    tal_kv_release(value);
+
+    return entry;
+}
+
+static void __tuya_tls_session_persist(tuya_tls_session_entry_t *entry)
+{
+    char key[16];
+    size_t length = 0;
+    uint8_t *value = NULL;
+
+    mbedtls_ssl_session_save(&entry->session, NULL, 0, &length);
+    value = tal_malloc(length + 2);
+    if (NULL == value) {
+        return;
+    }
+    value[0] = entry->mode;
+    value[1] = entry->verify;
+    if (0 == mbedtls_ssl_session_save(&entry->session, value + 2, length, &length)) {
+        __tuya_tls_session_key(entry->host, entry->port, key, sizeof(key));
+        tal_kv_set(key, value, length + 2);
+    }
+    tal_free(value);
+}
+#endif
+#endif
+
+/* offer the cached session of the host, master keeps its secret to tell a
+ * resumed handshake from a full one */
+static bool __tuya_tls_session_offer(mbedtls_ssl_context *ssl, tuya_tls_config_t *config, unsigned char *master)
+{
+    bool offered = false;
+
+#if TUYA_TLS_SESSION_CACHE_NUM > 0
+    tuya_tls_session_entry_t *entry = NULL;
+
+    if (NULL == config->hostname || strlen(config->hostname) >= TLS_URL_LEN) {
+        return false;
+    }
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    entry = __tuya_tls_session_find(config);
+#if TUYA_TLS_SESSION_PERSIST
+    if (NULL == entry) {
+        entry = __tuya_tls_session_restore(config);
+    }
+#endif
+    if (entry && 0 == mbedtls_ssl_set_session(ssl, &entry->session)) {
+        entry->used = ++s_tls_session_used;
+        memcpy(master, entry->session.master, sizeof(entry->session.master));
+        offered = true;
+    }
+    tal_mutex_unlock(s_tls_cache_mutex);
+#endif
+
+    return offered;
+}
+
+/* count the finished handshake and keep its session for the next connect */
+static void __tuya_tls_session_update(mbedtls_ssl_context *ssl, tuya_tls_config_t *config, bool offered,
+                                      const unsigned char *master, uint32_t cost_ms)
+{
+    bool resumed = false;
+
+#if TUYA_TLS_SESSION_CACHE_NUM > 0
+    tuya_tls_session_entry_t *entry = NULL;
+    mbedtls_ssl_session session;
+
+    mbedtls_ssl_session_init(&session);
+    if (config->hostname && strlen(config->hostname) < TLS_URL_LEN && 0 == mbedtls_ssl_get_session(ssl, &session)) {
+        resumed = offered && !memcmp(master, session.master, sizeof(session.master));
+
+        tal_mutex_lock(s_tls_cache_mutex);
+        entry = __tuya_tls_session_slot(config);
+        entry->session = session; // the entry owns the ticket and peer cert now
+        entry->used = ++s_tls_session_used;
+        entry->valid = true;
+#if TUYA_TLS_SESSION_PERSIST
+        if (!resumed) {
+            __tuya_tls_session_persist(entry);
+        }
+#endif
+        tal_mutex_unlock(s_tls_cache_mutex);
+    } else {
+        mbedtls_ssl_session_free(&session);
+    }
+#endif
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    if (resumed) {
+        s_tls_stat.resumed_ms = s_tls_stat.resumed_num++ ? (s_tls_stat.resumed_ms * 7 + cost_ms) / 8 : cost_ms;
+    } else {
+        s_tls_stat.full_ms = s_tls_stat.full_num++ ? (s_tls_stat.full_ms * 7 + cost_ms) / 8 : cost_ms;
+    }
+    tal_mutex_unlock(s_tls_cache_mutex);
+}
+
+/* a failed handshake drops the session it offered */
+static void __tuya_tls_session_drop(tuya_tls_config_t *config, bool offered)
+{
+    tal_mutex_lock(s_tls_cache_mutex);
+#if TUYA_TLS_SESSION_CACHE_NUM > 0
+    tuya_tls_session_entry_t *entry = offered ? __tuya_tls_session_find(config) : NULL;
+    if (entry) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->valid = false;
+    }
+#endif
+    s_tls_stat.fail_num++;
+    tal_mutex_unlock(s_tls_cache_mutex);
+}
+
+static void __tuya_tls_ca_chain_put(tuya_tls_ca_chain_t *chain)
+{
+    bool last = false;
+
+    if (NULL == chain) {
+        return;
+    }
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    last = (0 == --chain->ref);
+    tal_mutex_unlock(s_tls_cache_mutex);
+
+    if (last) {
+        mbedtls_x509_crt_free(&chain->crt);
+        tal_free(chain);
+    }
+}
+
+/* the parsed CA chain is shared by every connection using the same CA buffer */
+static tuya_tls_ca_chain_t *__tuya_tls_ca_chain_get(const char *ca_cert, int size, int *err)
+{
+    tuya_tls_ca_chain_t *chain = NULL;
+    tuya_tls_ca_chain_t *old = NULL;
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    if (s_tls_ca_chain && s_tls_ca_chain->ca_cert == ca_cert && s_tls_ca_chain->size == size &&
+        0 == memcmp(s_tls_ca_chain->data, ca_cert, size)) {
+        chain = s_tls_ca_chain;
+        chain->ref++;
+    }
+    tal_mutex_unlock(s_tls_cache_mutex);
+    if (chain) {
+        return chain;
+    }
+
+    chain = tal_calloc(1, sizeof(tuya_tls_ca_chain_t) + size);
+    if (NULL == chain) {
+        *err = OPRT_MALLOC_FAILED;
+        return NULL;
+    }
+    mbedtls_x509_crt_init(&chain->crt);
+    *err = mbedtls_x509_crt_parse(&chain->crt, (const unsigned char *)ca_cert, size);
+    if (*err != OPRT_OK) {
+        mbedtls_x509_crt_free(&chain->crt);
+        tal_free(chain);
+        return NULL;
+    }
+    chain->ca_cert = ca_cert;
+    chain->size = size;
+    memcpy(chain->data, ca_cert, size);
+    chain->ref = 2; // the cache and the caller
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    old = s_tls_ca_chain;
+    s_tls_ca_chain = chain;
+    s_tls_stat.ca_parse_num++;
+    tal_mutex_unlock(s_tls_cache_mutex);
+
+    __tuya_tls_ca_chain_put(old);
+
+    return chain;
+}
+
+/**
+ * @brief Gets the TLS handshake statistics.
+ *
+ * @param[out] stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_tls_stat_get(tuya_tls_stat_t *stat)
+{
+    if (NULL == stat || NULL == s_tls_cache_mutex) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(s_tls_cache_mutex);
+    *stat = s_tls_stat;
+    tal_mutex_unlock(s_tls_cache_mutex);
+
+    return OPRT_OK;
+}
+
 static int tuya_tls_ciphersuite_list_PSK[] = {MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256, 0};
 
 static void mbedtls_cert_pkey_free(tuya_tls_hander p_tls_handler)
@@ -318,10 +632,9 @@ static void mbedtls_cert_pkey_free(tuya_tls_hander p_tls_handler)
 
     PR_DEBUG("mbedtls_cert_pkey_free.");
 
-    if (config->ca_cert) {
-        mbedtls_x509_crt_free(&tls_context->cacert);
-    } else if (config->client_cert && config->client_pkey) {
-        mbedtls_x509_crt_free(&tls_context->cacert);
+    __tuya_tls_ca_chain_put(tls_context->ca_chain);
+    tls_context->ca_chain = NULL;
+    if (config->client_cert && config->client_pkey) {
         mbedtls_x509_crt_free(&tls_context->client_cert);
         mbedtls_pk_free(&tls_context->client_pkey);
     }
@@ -342,18 +655,15 @@ static OPERATE_RET mbedtls_cert_pkey_parse(tuya_tls_hander p_tls_handler)
         mbedtls_ssl_conf_authmode(&(tls_context->conf_ctx), MBEDTLS_SSL_VERIFY_NONE);
     }
 
-    mbedtls_x509_crt *p_cert_ctx = &(tls_context->cacert);
-    mbedtls_x509_crt_init(p_cert_ctx);
-
-    // parse ca cert
+    // parse ca cert, or share the chain parsed by an earlier connection
     if (config->ca_cert) {
         PR_DEBUG("load root ca cert.");
-        op_ret = mbedtls_x509_crt_parse(p_cert_ctx, (const unsigned char *)config->ca_cert, config->ca_cert_size);
-        if (op_ret != OPRT_OK) {
+        tls_context->ca_chain = __tuya_tls_ca_chain_get(config->ca_cert, config->ca_cert_size, &op_ret);
+        if (NULL == tls_context->ca_chain) {
             PR_ERR("mbedtls_x509_crt_parse Fail. 0x%x %d", -op_ret, op_ret);
             return op_ret;
         }
-        mbedtls_ssl_conf_ca_chain(&(tls_context->conf_ctx), p_cert_ctx, NULL);
+        mbedtls_ssl_conf_ca_chain(&(tls_context->conf_ctx), &tls_context->ca_chain->crt, NULL);
     }
 
     /* parse client own cert */
@@ -425,6 +735,14 @@ OPERATE_RET tuya_tls_init(void)
     }
     mbedtls_ctr_drbg_set_prediction_resistance(&ty_ctr_drbg, MBEDTLS_CTR_DRBG_PR_OFF);
 
+    if (NULL == s_tls_cache_mutex) {
+        op_ret = tal_mutex_create_init(&s_tls_cache_mutex);
+        if (op_ret) {
+            PR_ERR("cache mutex create fail. %d", op_ret);
+            goto exit;
+        }
+    }
+
     PR_NOTICE("tuya_tls_init ok!");
 
     return OPRT_OK;
@@ -550,6 +868,8 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
 {
     OPERATE_RET op_ret;
     tuya_mbedtls_context_t *tls_context = (tuya_mbedtls_context_t *)p_tls_handler;
+    unsigned char master[48];
+    bool offered = false;
 
     if (NULL == p_tls_handler || socket_fd < 0) {
         PR_ERR("INPUT INVALID PARM");
@@ -639,7 +959,10 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
     mbedtls_ssl_set_bio(p_ssl_ctx, tls_context, __tuya_tls_socket_send_cb, __tuya_tls_socket_recv_cb, NULL);
     PR_DEBUG("socket fd is set. set to inner send/recv to handshake");
 
+    offered = __tuya_tls_session_offer(p_ssl_ctx, &tls_context->config, master);
+
     TIME_T cur_time = tal_time_get_posix();
+    SYS_TIME_T start_ms = tal_system_get_millisecond();
 
     while ((op_ret = mbedtls_ssl_handshake(p_ssl_ctx)) != 0) {
         if (op_ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
@@ -678,6 +1001,11 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
         goto tuya_tls_connect_EXIT;
     }
 
+    /* only a verified peer gets its session cached */
+    __tuya_tls_session_update(p_ssl_ctx, &tls_context->config, offered, master,
+                              tal_system_get_millisecond() - start_ms);
+    mbedtls_platform_zeroize(master, sizeof(master));
+
     PR_DEBUG("handshake finish for %s. set send/recv to user set", (hostname ? hostname : ""));
     if (tls_context->config.f_send && tls_context->config.f_recv) {
         mbedtls_ssl_set_bio(p_ssl_ctx, tls_context->config.user_data, tls_context->config.f_send,
@@ -690,6 +1018,9 @@ OPERATE_RET tuya_tls_connect(tuya_tls_hander p_tls_handler, char *hostname, int
     return OPRT_OK;
 
 tuya_tls_connect_EXIT:
+    /* a failed handshake or verify */
+    __tuya_tls_session_drop(&tls_context->config, offered);
+    mbedtls_platform_zeroize(master, sizeof(master));
 
     PR_ERR("TUYA_TLS faild Connect %s:%d", (hostname ? hostname : ""), port_num);
 
@@ -91,6 +91,19 @@ typedef struct {
     void *user_data;
 } tuya_tls_config_t;
 
+/**
+ * @brief tls handshake statistics
+ *
+ */
+typedef struct {
+    uint32_t full_num;     // full handshakes
+    uint32_t resumed_num;  // handshakes resuming a cached session
+    uint32_t fail_num;     // failed handshakes
+    uint32_t full_ms;      // smoothed cost of a full handshake
+    uint32_t resumed_ms;   // smoothed cost of a resumed handshake
+    uint32_t ca_parse_num; // CA chains parsed, a shared chain is parsed once
+} tuya_tls_stat_t;
+
 /**
  * @brief Get mbedtls random data in the specified length
  *
@@ -198,6 +211,16 @@ int tuya_tls_write(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
  */
 int tuya_tls_read(tuya_tls_hander tls_handler, uint8_t *buf, uint32_t len);
 
+/**
+ * @brief tls handshake statistics
+ *
+ * @param[out] stat statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tuya_tls_stat_get(tuya_tls_stat_t *stat);
+
 /**
  * @brief generated random
  *
@@ -0,0 +1,294 @@
+/**
+ * @file ut_dp_rept_stream.cpp
+ * @brief DP report json test cases, the one pass writer against the report
+ * built by dp_rept_json_output and wrapped again as tuya_iot_dp_obj_report did
+ * before, byte for byte for MQTT and by content for LAN, and the allocations,
+ * heap high-water and latency per report of both paths.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "cJSON.h"
+#include "ut_dp_schema_drv.h"
+#include "ut_mqtt_service_drv.h"
+}
+
+#define REPT_UT_DEVID      "ut_rept_devid_0123"
+#define REPT_UT_REPORT_NUM 20000
+
+static const char *s_rept_ut_schema = "["
+                                      "{\"id\":1,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"bool\"}},"
+                                      "{\"id\":2,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"value\","
+                                      "\"max\":100000,\"min\":-100000,\"scale\":0}},"
+                                      "{\"id\":3,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"enum\","
+                                      "\"range\":[\"white\",\"colour\",\"scene\"]}},"
+                                      "{\"id\":20,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"string\","
+                                      "\"maxlen\":255}},"
+                                      "{\"id\":21,\"mode\":\"ro\",\"type\":\"obj\",\"property\":{\"type\":\"string\","
+                                      "\"maxlen\":255}},"
+                                      "{\"id\":101,\"mode\":\"rw\",\"type\":\"obj\",\"property\":{\"type\":\"value\","
+                                      "\"max\":100000,\"min\":-100000,\"scale\":1}}"
+                                      "]";
+
+// the report of tuya_iot_dp_obj_report before the one pass writer: the dps
+// object from dp_rept_json_output, wrapped by tuya_iot_dp_report_json_common
+// for MQTT or by dp_rept_json_append for LAN
+static int __rept_ut_old(dp_schema_t *schema, dp_rept_in_t *dpin, bool lan, std::string &out)
+{
+    int ret = OPRT_OK;
+    dp_rept_out_t dpout;
+    char *buffer = NULL;
+    size_t size = sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpin->dpscnt;
+    dp_rept_valid_t *dpvalid = (dp_rept_valid_t *)tal_malloc(size);
+
+    memset(dpvalid, 0, size);
+    ret = ut_dp_rept_valid_check(schema, dpin, dpvalid);
+    if (OPRT_OK != ret) {
+        tal_free(dpvalid);
+        return ret;
+    }
+
+    // a time json is only asked for when timejson is set
+    memset(&dpout, 0, sizeof(dpout));
+    dpout.timejson = (T_STAT_REPT == dpin->rept_type) ? (char *)"" : NULL;
+    ret = ut_dp_rept_json_output(schema, dpin, dpvalid, &dpout);
+    if (OPRT_OK != ret) {
+        tal_free(dpvalid);
+        return ret;
+    }
+    if (dpout.timejson && 0 == dpout.timejson[0]) {
+        dpout.timejson = NULL;
+    }
+
+    if (lan) {
+        ut_dp_rept_json_append(schema, dpout.dpsjson, NULL, NULL, 0, &buffer);
+    } else if (dpout.timejson) {
+        buffer = (char *)tal_malloc(strlen(dpout.dpsjson) + strlen(dpout.timejson) + 64);
+        sprintf(buffer, "{\"devId\":\"%s\",\"dps\":%s,\"t\":%s}", schema->devid, dpout.dpsjson, dpout.timejson);
+    } else {
+        buffer = (char *)tal_malloc(strlen(dpout.dpsjson) + 64);
+        sprintf(buffer, "{\"devId\":\"%s\",\"dps\":%s}", schema->devid, dpout.dpsjson);
+    }
+    out = buffer;
+
+    tal_free(buffer);
+    tal_free(dpout.dpsjson);
+    tal_free(dpout.timejson);
+    tal_free(dpvalid);
+
+    return OPRT_OK;
+}
+
+// the report of tuya_iot_dp_obj_report now, LAN and MQTT share it
+static int __rept_ut_stream(dp_schema_t *schema, dp_rept_in_t *dpin, std::string &out)
+{
+    int ret = OPRT_OK;
+    uint32_t len = 0;
+    size_t size = sizeof(dp_rept_valid_t) + sizeof(uint8_t) * dpin->dpscnt;
+    dp_rept_valid_t *dpvalid = (dp_rept_valid_t *)tal_malloc(size);
+
+    memset(dpvalid, 0, size);
+    ret = ut_dp_rept_valid_check(schema, dpin, dpvalid);
+    if (OPRT_OK != ret) {
+        tal_free(dpvalid);
+        return ret;
+    }
+
+    uint32_t buf_size = ut_dp_rept_json_stream_size(schema, dpvalid);
+    char *buf = (char *)tal_malloc(buf_size);
+    ret = ut_dp_rept_json_stream(schema, dpin, dpvalid, buf, buf_size, &len);
+    if (OPRT_OK == ret) {
+        EXPECT_EQ(strlen(buf), len);
+        out.assign(buf, len);
+    }
+
+    tal_free(buf);
+    tal_free(dpvalid);
+
+    return ret;
+}
+
+static std::string __rept_ut_item(const char *json, const char *name)
+{
+    std::string out;
+    cJSON *root = cJSON_Parse(json);
+    cJSON *item = cJSON_GetObjectItem(root, name);
+
+    if (item) {
+        char *str = cJSON_PrintUnformatted(item);
+        out = str;
+        cJSON_free(str);
+    }
+    cJSON_Delete(root);
+
+    return out;
+}
+
+class DpReptStreamTest : public ::testing::Test {
+  protected:
+    dp_schema_t *schema = nullptr;
+    std::vector<dp_obj_t> dps;
+
+    void SetUp() override
+    {
+        // as the apps do, so the cJSON allocations of the old path are counted
+        cJSON_Hooks hooks = {tal_malloc, tal_free};
+        cJSON_InitHooks(&hooks);
+        ASSERT_EQ(OPRT_OK, ut_dp_schema_create((char *)REPT_UT_DEVID, (char *)s_rept_ut_schema, &schema));
+    }
+
+    void TearDown() override
+    {
+        ut_dp_schema_delete((char *)REPT_UT_DEVID);
+        cJSON_InitHooks(NULL);
+    }
+
+    void add(uint8_t id, dp_prop_tp_t type, dp_value_t value, TIME_T time_stamp = 0)
+    {
+        dp_obj_t dp;
+        memset(&dp, 0, sizeof(dp));
+        dp.id = id;
+        dp.type = type;
+        dp.value = value;
+        dp.time_stamp = time_stamp;
+        dps.push_back(dp);
+    }
+
+    // the same DPs reported by both paths, the schema cache must not filter them
+    void expect_same(dp_rept_type_t rept_type)
+    {
+        dp_rept_in_t dpin = {rept_type, DP_REPT_NO_FILTER_FLAG, NULL, (uint8_t)dps.size(), dps.data()};
+        std::string old_mqtt, old_lan, stream;
+
+        ASSERT_EQ(OPRT_OK, __rept_ut_old(schema, &dpin, false, old_mqtt));
+        ASSERT_EQ(OPRT_OK, __rept_ut_old(schema, &dpin, true, old_lan));
+        ASSERT_EQ(OPRT_OK, __rept_ut_stream(schema, &dpin, stream));
+        EXPECT_EQ(old_mqtt, stream);
+        // LAN used {"dps":..,"devId":..}, the keys are in another order now
+        EXPECT_EQ(__rept_ut_item(old_lan.c_str(), "dps"), __rept_ut_item(stream.c_str(), "dps"));
+        EXPECT_EQ(__rept_ut_item(old_lan.c_str(), "devId"), __rept_ut_item(stream.c_str(), "devId"));
+    }
+};
+
+TEST_F(DpReptStreamTest, old_format)
+{
+    dp_value_t v;
+
+    v.dp_bool = true;
+    add(1, PROP_BOOL, v);
+    v.dp_value = -4321;
+    add(2, PROP_VALUE, v);
+    v.dp_enum = 2;
+    add(3, PROP_ENUM, v);
+    v.dp_str = (char *)"plain";
+    add(20, PROP_STR, v);
+    v.dp_value = 100000;
+    add(101, PROP_VALUE, v);
+    expect_same(T_OBJ_REPT);
+
+    // the escapes of cJSON_PrintUnformatted
+    dps.clear();
+    v.dp_str = (char *)"q\"b\\s/\b\f\n\r\t\x01\x1f end";
+    add(20, PROP_STR, v);
+    v.dp_str = (char *)"\xe4\xbd\xa0\xe5\xa5\xbd";
+    add(21, PROP_STR, v);
+    v.dp_bool = false;
+    add(1, PROP_BOOL, v);
+    expect_same(T_OBJ_REPT);
+
+    dps.clear();
+    v.dp_str = (char *)"";
+    add(20, PROP_STR, v);
+    expect_same(T_OBJ_REPT);
+
+    // statistics carry their time stamps
+    dps.clear();
+    v.dp_value = 7;
+    add(2, PROP_VALUE, v, 1700000000);
+    v.dp_bool = true;
+    add(1, PROP_BOOL, v);
+    v.dp_value = -1;
+    add(101, PROP_VALUE, v, 1700000001);
+    expect_same(T_STAT_REPT);
+}
+
+TEST_F(DpReptStreamTest, benchmark)
+{
+    dp_value_t v;
+    std::string out;
+
+    for (uint32_t num : {1, 3, 6}) {
+        dps.clear();
+        // bool, value, enum, string, string, value
+        for (uint32_t i = 0; i < num; i++) {
+            static const uint8_t ids[] = {1, 2, 3, 20, 21, 101};
+            static const dp_prop_tp_t types[] = {PROP_BOOL, PROP_VALUE, PROP_ENUM, PROP_STR, PROP_STR, PROP_VALUE};
+            memset(&v, 0, sizeof(v));
+            if (PROP_STR == types[i]) {
+                v.dp_str = (char *)"{\"scene\":\"reading\",\"bright\":800}";
+            } else {
+                v.dp_value = i + 1;
+            }
+            add(ids[i], types[i], v);
+        }
+        dp_rept_in_t dpin = {T_OBJ_REPT, DP_REPT_NO_FILTER_FLAG, NULL, (uint8_t)dps.size(), dps.data()};
+
+        // allocations and heap high-water of one report
+        auto heap = [&](const std::function<void()> &fn, uint32_t &alloc_num, size_t &peak) {
+            uint32_t start = ut_alloc_num();
+            ut_heap_track(true);
+            fn();
+            EXPECT_EQ(0u, ut_heap_used());
+            alloc_num = ut_alloc_num() - start;
+            peak = ut_heap_peak();
+            ut_heap_track(false);
+        };
+        // best of three runs, ns per report
+        auto bench = [](const std::function<void()> &fn) {
+            double best = 0;
+            for (int r = 0; r < 3; r++) {
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                best = (0 == r || ns < best) ? ns : best;
+            }
+            return best / REPT_UT_REPORT_NUM;
+        };
+
+        uint32_t old_alloc = 0, stream_alloc = 0;
+        size_t old_peak = 0, stream_peak = 0;
+        // the schema keeps a copy of the string values, made by the first report
+        __rept_ut_stream(schema, &dpin, out);
+        heap([&] { __rept_ut_old(schema, &dpin, false, out); }, old_alloc, old_peak);
+        heap([&] { __rept_ut_stream(schema, &dpin, out); }, stream_alloc, stream_peak);
+        // the valid list and the report buffer
+        EXPECT_EQ(2u, stream_alloc);
+        EXPECT_LT(stream_peak, old_peak);
+
+        double old_ns = bench([&] {
+            for (int i = 0; i < REPT_UT_REPORT_NUM; i++) {
+                __rept_ut_old(schema, &dpin, false, out);
+            }
+        });
+        double stream_ns = bench([&] {
+            for (int i = 0; i < REPT_UT_REPORT_NUM; i++) {
+                __rept_ut_stream(schema, &dpin, out);
+            }
+        });
+
+        printf("[ BENCH    ] %u dps, %3zu bytes: old %u allocs %4zu bytes peak %5.0f ns, stream %u allocs %4zu bytes "
+               "peak %5.0f ns per report\n",
+               num, out.size(), old_alloc, old_peak, old_ns, stream_alloc, stream_peak, stream_ns);
+    }
+}
@@ -0,0 +1,221 @@
+/**
+ * @file ut_dp_schema.cpp
+ * @brief dp_schema test cases, the devid hash chains of the schema manager
+ * when several schemas share a bucket, and a report validation throughput
+ * benchmark by schema size and batch size.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_dp_schema_drv.h"
+}
+
+#define SCHEMA_UT_DEV_NUM    12
+#define SCHEMA_UT_REPORT_NUM 20000
+
+// num DPs from id 1, bool, value, enum and string in turn, bitmap DPs are left
+// out as dp_type_check compares their type with cJSON_Number and drops them
+static std::string __schema_ut_json(uint32_t num)
+{
+    static const char *props[] = {
+        "{\"type\":\"bool\"}",
+        "{\"type\":\"value\",\"max\":1000,\"min\":0,\"scale\":0}",
+        "{\"type\":\"enum\",\"range\":[\"low\",\"mid\",\"high\"]}",
+        "{\"type\":\"string\",\"maxlen\":64}",
+    };
+    std::string json = "[";
+
+    for (uint32_t i = 0; i < num; i++) {
+        char node[160];
+        snprintf(node, sizeof(node), "%s{\"id\":%u,\"mode\":\"rw\",\"type\":\"obj\",\"property\":%s}", i ? "," : "",
+                 i + 1, props[i % 4]);
+        json += node;
+    }
+
+    return json + "]";
+}
+
+// a changed value for each DP of the batch, seq picks the value
+static void __schema_ut_dps(std::vector<dp_obj_t> &dps, uint32_t num, uint32_t seq)
+{
+    static const dp_prop_tp_t types[] = {PROP_BOOL, PROP_VALUE, PROP_ENUM, PROP_STR};
+    static char *strs[] = {(char *)"on", (char *)"off"};
+
+    dps.resize(num);
+    for (uint32_t i = 0; i < num; i++) {
+        dp_obj_t *dp = &dps[i];
+        memset(dp, 0, sizeof(*dp));
+        dp->id = i + 1;
+        dp->type = types[i % 4];
+        switch (dp->type) {
+        case PROP_BOOL:
+            dp->value.dp_bool = seq & 1;
+            break;
+        case PROP_VALUE:
+            dp->value.dp_value = seq % 1000;
+            break;
+        case PROP_ENUM:
+            dp->value.dp_enum = seq % 3;
+            break;
+        case PROP_STR:
+            dp->value.dp_str = strs[seq & 1];
+            break;
+        }
+    }
+}
+
+class DpSchemaTest : public ::testing::Test {
+  protected:
+    std::vector<std::string> devids;
+
+    dp_schema_t *create(const std::string &devid, uint32_t dp_num)
+    {
+        dp_schema_t *schema = nullptr;
+        std::string json = __schema_ut_json(dp_num);
+
+        EXPECT_EQ(OPRT_OK, ut_dp_schema_create((char *)devid.c_str(), (char *)json.c_str(), &schema));
+        devids.push_back(devid);
+        return schema;
+    }
+
+    void TearDown() override
+    {
+        for (auto &devid : devids) {
+            ut_dp_schema_delete((char *)devid.c_str());
+        }
+        EXPECT_EQ(0u, ut_dp_schema_num());
+    }
+};
+
+TEST_F(DpSchemaTest, hash_chain)
+{
+    std::vector<dp_schema_t *> schemas;
+    std::vector<std::string> chain; // devids of the longest bucket, oldest first
+    uint32_t bucket = 0;
+    char devid[DEV_ID_LEN + 1];
+
+    for (uint32_t i = 0; i < SCHEMA_UT_DEV_NUM; i++) {
+        snprintf(devid, sizeof(devid), "ut_dev_%02u", i);
+        schemas.push_back(create(devid, 4));
+    }
+    ASSERT_EQ((uint32_t)SCHEMA_UT_DEV_NUM, ut_dp_schema_num());
+    ASSERT_EQ((uint32_t)SCHEMA_UT_DEV_NUM, ut_dp_schema_chain_len(0) + ut_dp_schema_chain_len(1));
+
+    // more schemas than buckets, some of them share a chain
+    bucket = ut_dp_schema_chain_len(0) >= ut_dp_schema_chain_len(1) ? 0 : 1;
+    for (auto &id : devids) {
+        if (bucket == ut_dp_schema_bucket(id.c_str())) {
+            chain.push_back(id);
+        }
+    }
+    ASSERT_GE(chain.size(), 3u);
+
+    for (uint32_t i = 0; i < SCHEMA_UT_DEV_NUM; i++) {
+        EXPECT_EQ(schemas[i], ut_dp_schema_find(devids[i].c_str()));
+    }
+    // walks the whole chain and stops at its end
+    EXPECT_EQ(nullptr, ut_dp_schema_find("ut_dev_none"));
+    EXPECT_EQ(nullptr, ut_dp_schema_find(""));
+
+    // unlink the tail, a middle node and the head, new schemas go on the head
+    std::vector<std::string> gone = {chain.front(), chain[chain.size() / 2], chain.back()};
+    for (auto &id : gone) {
+        EXPECT_EQ(OPRT_OK, ut_dp_schema_delete((char *)id.c_str()));
+        EXPECT_EQ(nullptr, ut_dp_schema_find(id.c_str()));
+        // deleting a devid not registered does nothing
+        EXPECT_EQ(OPRT_OK, ut_dp_schema_delete((char *)id.c_str()));
+    }
+    EXPECT_EQ(chain.size() - gone.size(), ut_dp_schema_chain_len(bucket));
+    EXPECT_EQ(SCHEMA_UT_DEV_NUM - gone.size(), ut_dp_schema_num());
+    for (uint32_t i = 0; i < SCHEMA_UT_DEV_NUM; i++) {
+        bool deleted = std::find(gone.begin(), gone.end(), devids[i]) != gone.end();
+        EXPECT_EQ(deleted ? nullptr : schemas[i], ut_dp_schema_find(devids[i].c_str())) << devids[i];
+    }
+
+    // the freed slots are taken again and linked into the same chain
+    for (auto &id : gone) {
+        dp_schema_t *schema = create(id, 4);
+        EXPECT_EQ(schema, ut_dp_schema_find(id.c_str()));
+    }
+    EXPECT_EQ(chain.size(), ut_dp_schema_chain_len(bucket));
+    EXPECT_EQ((uint32_t)SCHEMA_UT_DEV_NUM, ut_dp_schema_num());
+    for (auto &id : chain) {
+        dp_schema_t *schema = ut_dp_schema_find(id.c_str());
+        ASSERT_NE(nullptr, schema);
+        EXPECT_STREQ(id.c_str(), schema->devid);
+    }
+}
+
+TEST_F(DpSchemaTest, benchmark)
+{
+    std::vector<dp_obj_t> dps;
+    char devid[DEV_ID_LEN + 1];
+
+    // the other devices share the buckets, as on a gateway, the three measured schemas fill it up
+    for (uint32_t i = 3; i < UT_DP_SCHEMA_NUM_MAX; i++) {
+        snprintf(devid, sizeof(devid), "ut_sub_%02u", i);
+        create(devid, 4);
+    }
+
+    for (uint32_t schema_num : {8, 32, 128}) {
+        snprintf(devid, sizeof(devid), "ut_bench_%u", schema_num);
+        ASSERT_NE(nullptr, create(devid, schema_num));
+
+        for (uint32_t batch : {1, 4, 16, 128}) {
+            if (batch > schema_num) {
+                continue;
+            }
+            dp_rept_valid_t *dpvalid = (dp_rept_valid_t *)malloc(sizeof(dp_rept_valid_t) + batch);
+            uint32_t seq = 0;
+            uint32_t valid_num = 0;
+
+            // best of three runs, ns per report
+            auto bench = [](const std::function<void()> &fn) {
+                double best = 0;
+                for (int r = 0; r < 3; r++) {
+                    auto start = std::chrono::steady_clock::now();
+                    fn();
+                    double ns =
+                        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                    best = (0 == r || ns < best) ? ns : best;
+                }
+                return best / SCHEMA_UT_REPORT_NUM;
+            };
+
+            // every report changes all the DPs of the batch, as tuya_iot_dp_obj_report looks them up
+            double ns = bench([&] {
+                for (int i = 0; i < SCHEMA_UT_REPORT_NUM; i++) {
+                    dp_rept_in_t dpin;
+                    __schema_ut_dps(dps, batch, ++seq);
+                    dpin.rept_type = T_OBJ_REPT;
+                    dpin.flags = 0;
+                    dpin.dps = dps.data();
+                    dpin.dpscnt = batch;
+                    memset(dpvalid, 0, sizeof(dp_rept_valid_t) + batch);
+                    dp_schema_t *schema = ut_dp_schema_find(devid);
+                    if (schema && OPRT_OK == ut_dp_rept_valid_check(schema, &dpin, dpvalid)) {
+                        valid_num += dpvalid->num;
+                    }
+                }
+            });
+            EXPECT_EQ(3u * SCHEMA_UT_REPORT_NUM * batch, valid_num);
+
+            printf("[ BENCH    ] %3u dps schema, %3u dps per report: %7.0f ns per report, %5.1f ns per dp, %.2f M "
+                   "dps/s\n",
+                   schema_num, batch, ns, ns / batch, batch * 1e3 / ns);
+            free(dpvalid);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file ut_dp_schema_drv.c
+ * @brief dp_schema with the public functions renamed, so the copy in
+ * tuya_cloud_service stays untouched, and more schemas than hash buckets
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "ut_dp_schema_drv.h"
+
+#define DP_SCHEMA_NUM_MAX           UT_DP_SCHEMA_NUM_MAX
+#define DP_SCHEMA_BUCKET_NUM        UT_DP_SCHEMA_BUCKET_NUM
+#define dp_rept_json_append         ut_dp_rept_json_append
+#define dp_node_find                ut_dp_node_find
+#define dp_schema_find              ut_dp_schema_find
+#define dp_node_find_by_devid       ut_dp_node_find_by_devid
+#define dp_data_recv_parse          ut_dp_data_recv_parse
+#define dp_pv_stat_get              ut_dp_pv_stat_get
+#define dp_pv_stat_set              ut_dp_pv_stat_set
+#define dp_rept_valid_check         ut_dp_rept_valid_check
+#define dp_rept_json_output         ut_dp_rept_json_output
+#define dp_rept_json_stream_size    ut_dp_rept_json_stream_size
+#define dp_rept_json_stream         ut_dp_rept_json_stream
+#define dp_obj_dump_stat_local_json ut_dp_obj_dump_stat_local_json
+#define dp_obj_dump_all_json        ut_dp_obj_dump_all_json
+#define dp_schema_create            ut_dp_schema_create
+#define dp_schema_delete            ut_dp_schema_delete
+
+#include "../schema/dp_schema.c"
+
+uint32_t ut_dp_schema_bucket(const char *devid)
+{
+    return dp_devid_hash(devid) & (DP_SCHEMA_BUCKET_NUM - 1);
+}
+
+uint32_t ut_dp_schema_chain_len(uint32_t bucket)
+{
+    uint32_t len = 0;
+    uint16_t slot = s_dsmgr.bucket[bucket];
+
+    while (slot) {
+        len++;
+        slot = s_dsmgr.next[slot - 1];
+    }
+
+    return len;
+}
+
+uint32_t ut_dp_schema_num(void)
+{
+    return s_dsmgr.schema_num;
+}
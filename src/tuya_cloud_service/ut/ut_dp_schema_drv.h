@@ -0,0 +1,59 @@
+/**
+ * @file ut_dp_schema_drv.h
+ * @brief dp_schema built again for the test cases, with room for several
+ * schemas in a few devid hash buckets so that the chains get long, see
+ * ut_dp_schema_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_DP_SCHEMA_DRV_H__
+#define __UT_DP_SCHEMA_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "dp_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UT_DP_SCHEMA_NUM_MAX    16
+#define UT_DP_SCHEMA_BUCKET_NUM 2
+
+int ut_dp_schema_create(char *devid, char *schema_json, dp_schema_t **dp_schema_out);
+
+int ut_dp_schema_delete(char *devid);
+
+dp_schema_t *ut_dp_schema_find(const char *devid);
+
+int ut_dp_rept_valid_check(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid);
+
+int ut_dp_rept_json_append(dp_schema_t *schema, char *data, char *time, char *type, uint8_t rept_seq, char **pp_out);
+
+int ut_dp_rept_json_output(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, dp_rept_out_t *dpout);
+
+uint32_t ut_dp_rept_json_stream_size(dp_schema_t *schema, dp_rept_valid_t *dpvalid);
+
+int ut_dp_rept_json_stream(dp_schema_t *schema, dp_rept_in_t *dpin, dp_rept_valid_t *dpvalid, char *buf,
+                           uint32_t size, uint32_t *len);
+
+/**
+ * @brief the hash bucket a devid falls in
+ */
+uint32_t ut_dp_schema_bucket(const char *devid);
+
+/**
+ * @brief the number of schemas chained in a hash bucket
+ */
+uint32_t ut_dp_schema_chain_len(uint32_t bucket);
+
+/**
+ * @brief the number of schemas registered
+ */
+uint32_t ut_dp_schema_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_DP_SCHEMA_DRV_H__ */
@@ -0,0 +1,165 @@
+/**
+ * @file ut_lan_sock.cpp
+ * @brief lan socket loop test cases on the epoll and the select backend, 1 to
+ * 64 socketpair clients are echoed from the loop thread, with how long a
+ * registration takes to apply and the round trip of all clients.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_lan_sock_drv.h"
+}
+
+#define LAN_SOCK_UT_ROUNDS  200
+#define LAN_SOCK_UT_TIMEOUT 3000
+
+static std::atomic<uint32_t> s_read_num;
+
+// the device side of a client, send back what it got
+static void __lan_sock_ut_echo(int32_t sock)
+{
+    char buf[64];
+    int len = read(sock, buf, sizeof(buf));
+
+    s_read_num++;
+    if (len > 0) {
+        EXPECT_EQ(len, write(sock, buf, len));
+    }
+}
+
+class LanSockTest : public ::testing::TestWithParam<const UT_LAN_SOCK_BACKEND_T *> {
+  protected:
+    const UT_LAN_SOCK_BACKEND_T *backend = nullptr;
+    std::vector<int> devices; // registered to the loop, closed by it
+    std::vector<int> clients;
+
+    void SetUp() override
+    {
+        backend = GetParam();
+        s_read_num = 0;
+        ASSERT_EQ(OPRT_OK, backend->init());
+    }
+
+    void TearDown() override
+    {
+        EXPECT_EQ(OPRT_OK, backend->stop());
+        for (int fd : clients) {
+            close(fd);
+        }
+    }
+
+    // the reply of one client, -1 when it does not come in time
+    int recv_reply(int fd, char *buf, int len)
+    {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+
+        if (poll(&pfd, 1, LAN_SOCK_UT_TIMEOUT) <= 0) {
+            return -1;
+        }
+        return read(fd, buf, len);
+    }
+
+    bool echo(int fd, uint32_t seq)
+    {
+        char reply[sizeof(seq)];
+
+        if ((ssize_t)sizeof(seq) != write(fd, &seq, sizeof(seq))) {
+            return false;
+        }
+        return (int)sizeof(reply) == recv_reply(fd, reply, sizeof(reply)) && 0 == memcmp(reply, &seq, sizeof(seq));
+    }
+
+    // register clients up to num, ms until the loop echoes every new one
+    double add_clients(uint32_t num)
+    {
+        size_t first = clients.size();
+        auto start = std::chrono::steady_clock::now();
+
+        while (clients.size() < num) {
+            int sv[2];
+            EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+            sloop_sock_t info;
+            memset(&info, 0, sizeof(info));
+            info.sock = sv[0];
+            info.read = __lan_sock_ut_echo;
+            EXPECT_EQ(OPRT_OK, backend->reg(info));
+            devices.push_back(sv[0]);
+            clients.push_back(sv[1]);
+        }
+        for (size_t i = first; i < clients.size(); i++) {
+            EXPECT_TRUE(echo(clients[i], i)) << backend->name << " client " << i;
+        }
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+TEST_P(LanSockTest, unreg_closes_sock)
+{
+    char buf[8];
+
+    add_clients(4);
+    ASSERT_EQ(OPRT_OK, backend->unreg(devices[0]));
+    ASSERT_EQ(OPRT_OK, backend->unreg(devices[2]));
+
+    // the loop closes the device side, the client reads the end of the stream
+    EXPECT_EQ(0, recv_reply(clients[0], buf, sizeof(buf)));
+    EXPECT_EQ(0, recv_reply(clients[2], buf, sizeof(buf)));
+    for (int i = 0; i < 100 && 2 != backend->cnt(); i++) {
+        tal_system_sleep(10);
+    }
+    EXPECT_EQ(2, backend->cnt());
+
+    EXPECT_TRUE(echo(clients[1], 1));
+    EXPECT_TRUE(echo(clients[3], 3));
+}
+
+TEST_P(LanSockTest, benchmark)
+{
+    for (uint32_t num = 1; num <= UT_LAN_SOCK_CLIENT_MAX; num *= 2) {
+        double reg_ms = add_clients(num);
+        ASSERT_EQ((int)num, backend->cnt());
+
+        // every client sends, then all replies are read
+        uint32_t read_num = s_read_num;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < LAN_SOCK_UT_ROUNDS; round++) {
+            for (uint32_t i = 0; i < num; i++) {
+                uint32_t seq = round * num + i;
+                ASSERT_EQ((ssize_t)sizeof(seq), write(clients[i], &seq, sizeof(seq)));
+            }
+            for (uint32_t i = 0; i < num; i++) {
+                uint32_t seq = 0;
+                ASSERT_EQ((int)sizeof(seq), recv_reply(clients[i], (char *)&seq, sizeof(seq)));
+                ASSERT_EQ(round * num + i, seq) << backend->name << " client " << i;
+            }
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        us /= LAN_SOCK_UT_ROUNDS;
+
+        printf("[ BENCH    ] %-6s %2u clients: registration applied in %7.1f ms, round %8.1f us, %5.1f us per "
+               "client, %.2f reads per message\n",
+               backend->name, num, reg_ms, us, us / num,
+               (double)(s_read_num - read_num) / (LAN_SOCK_UT_ROUNDS * num));
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Backend, LanSockTest, ::testing::Values(&ut_lan_sock_epoll, &ut_lan_sock_select),
+                         [](const ::testing::TestParamInfo<const UT_LAN_SOCK_BACKEND_T *> &info) {
+                             return std::string(info.param->name);
+                         });
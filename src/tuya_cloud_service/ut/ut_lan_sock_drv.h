@@ -0,0 +1,40 @@
+/**
+ * @file ut_lan_sock_drv.h
+ * @brief the lan socket loop built once per backend, epoll and select, with
+ * room for UT_LAN_SOCK_CLIENT_MAX clients, see ut_lan_sock_epoll_drv.c and
+ * ut_lan_sock_select_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_LAN_SOCK_DRV_H__
+#define __UT_LAN_SOCK_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "lan_sock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UT_LAN_SOCK_CLIENT_MAX 64
+
+typedef struct {
+    const char *name;
+    OPERATE_RET (*init)(void);
+    OPERATE_RET (*reg)(sloop_sock_t sock_info);
+    OPERATE_RET (*unreg)(int sock);
+    /* disable the loop and wait for its thread to free it */
+    OPERATE_RET (*stop)(void);
+    /* sockets registered, as applied by the loop */
+    int (*cnt)(void);
+} UT_LAN_SOCK_BACKEND_T;
+
+extern const UT_LAN_SOCK_BACKEND_T ut_lan_sock_epoll;
+extern const UT_LAN_SOCK_BACKEND_T ut_lan_sock_select;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_LAN_SOCK_DRV_H__ */
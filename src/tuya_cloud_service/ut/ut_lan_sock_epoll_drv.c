@@ -0,0 +1,59 @@
+/**
+ * @file ut_lan_sock_epoll_drv.c
+ * @brief builds lan_sock.c with its epoll backend and the lan clients of
+ * tuya_lan.c replaced, the object replaces the one of the library in the
+ * test binary.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+
+#include "ut_lan_sock_drv.h"
+
+static uint32_t __ut_lan_get_client_num(void)
+{
+    return UT_LAN_SOCK_CLIENT_MAX;
+}
+
+static int __ut_lan_exit(void)
+{
+    return 0;
+}
+
+#define LAN_SLOOP_USING_EPOLL   1
+#define tuya_lan_get_client_num __ut_lan_get_client_num
+#define tuya_lan_exit           __ut_lan_exit
+
+#include "../lan/lan_sock.c"
+
+static OPERATE_RET __ut_lan_sock_stop(void)
+{
+    uint32_t wait_ms = 0;
+
+    tuya_sock_loop_disable();
+    if (g_sloop) {
+        __sloop_backend_wakeup();
+    }
+    while (g_sloop && wait_ms < 3 * LAN_SLOOP_TIMEOUT_MS) {
+        tal_system_sleep(10);
+        wait_ms += 10;
+    }
+
+    return g_sloop ? OPRT_TIMEOUT : OPRT_OK;
+}
+
+static int __ut_lan_sock_cnt(void)
+{
+    return g_sloop ? g_sloop->cnt : -1;
+}
+
+const UT_LAN_SOCK_BACKEND_T ut_lan_sock_epoll = {
+    .name = "epoll",
+    .init = tuya_sock_loop_init,
+    .reg = tuya_reg_lan_sock,
+    .unreg = tuya_unreg_lan_sock,
+    .stop = __ut_lan_sock_stop,
+    .cnt = __ut_lan_sock_cnt,
+};
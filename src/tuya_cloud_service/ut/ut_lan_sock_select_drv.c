@@ -0,0 +1,70 @@
+/**
+ * @file ut_lan_sock_select_drv.c
+ * @brief builds lan_sock.c a second time with its select backend, the one of
+ * the systems without epoll, under names of its own so both backends run in
+ * the same test binary.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+
+#define __ty_sock_loop_deinit        __ut_sel_sock_loop_deinit
+#define __ty_add_sock_reader         __ut_sel_add_sock_reader
+#define __ty_del_sock_reader         __ut_sel_del_sock_reader
+#define __ty_wait_sock_write         __ut_sel_wait_sock_write
+#define tuya_sock_loop_run           __ut_sel_sock_loop_run
+#define tuya_sock_loop_init          __ut_sel_sock_loop_init
+#define tuya_reg_lan_sock            __ut_sel_reg_lan_sock
+#define tuya_unreg_lan_sock          __ut_sel_unreg_lan_sock
+#define tuya_wait_lan_sock_write     __ut_sel_wait_lan_sock_write
+#define tuya_sock_loop_disable       __ut_sel_sock_loop_disable
+#define tuya_get_sock_loop_terminate __ut_sel_get_sock_loop_terminate
+#define tuya_dump_lan_sock_reader    __ut_sel_dump_lan_sock_reader
+
+#include "ut_lan_sock_drv.h"
+
+static uint32_t __ut_lan_get_client_num(void)
+{
+    return UT_LAN_SOCK_CLIENT_MAX;
+}
+
+static int __ut_lan_exit(void)
+{
+    return 0;
+}
+
+#define LAN_SLOOP_USING_EPOLL   0
+#define tuya_lan_get_client_num __ut_lan_get_client_num
+#define tuya_lan_exit           __ut_lan_exit
+
+#include "../lan/lan_sock.c"
+
+static OPERATE_RET __ut_lan_sock_stop(void)
+{
+    uint32_t wait_ms = 0;
+
+    // no wakeup fd, the loop sees it after its select timeout
+    tuya_sock_loop_disable();
+    while (g_sloop && wait_ms < 3 * LAN_SLOOP_TIMEOUT_MS) {
+        tal_system_sleep(10);
+        wait_ms += 10;
+    }
+
+    return g_sloop ? OPRT_TIMEOUT : OPRT_OK;
+}
+
+static int __ut_lan_sock_cnt(void)
+{
+    return g_sloop ? g_sloop->cnt : -1;
+}
+
+const UT_LAN_SOCK_BACKEND_T ut_lan_sock_select = {
+    .name = "select",
+    .init = tuya_sock_loop_init,
+    .reg = tuya_reg_lan_sock,
+    .unreg = tuya_unreg_lan_sock,
+    .stop = __ut_lan_sock_stop,
+    .cnt = __ut_lan_sock_cnt,
+};
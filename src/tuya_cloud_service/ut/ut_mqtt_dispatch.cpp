@@ -0,0 +1,255 @@
+/**
+ * @file ut_mqtt_dispatch.cpp
+ * @brief message dispatch test cases of mqtt_service, topic filter matching in
+ * the subscription trie, the protocol id scanner and the protocol table, the
+ * allocations per received frame, and a messages/s benchmark through both
+ * dispatch paths.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_mqtt_service_drv.h"
+}
+
+#define DISPATCH_UT_TOPIC_IN "smart/device/in/ut_devid_0123456789"
+
+static const char *s_filters[] = {
+    "a/b", "a/+", "a/#", "#", "+/b", "+/+/c", "a/b/#", "$SYS/#", "$SYS/+",
+};
+#define DISPATCH_UT_FILTER_NUM (sizeof(s_filters) / sizeof(s_filters[0]))
+
+static std::vector<std::string> s_hits;
+static std::string s_raw;
+static uint32_t s_protocol_num = 0;
+static std::string s_frame;
+static uint32_t s_frame_changed = 0;
+
+static void __dispatch_ut_topic_cb(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    s_hits.push_back((const char *)userdata);
+}
+
+static void __dispatch_ut_count_cb(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    s_protocol_num++;
+}
+
+// another handler of topic_in, the frame must reach it as the broker sent it
+static void __dispatch_ut_frame_cb(uint16_t msgid, const mqtt_client_message_t *msg, void *userdata)
+{
+    if (s_frame != std::string((const char *)msg->payload, msg->length)) {
+        s_frame_changed++;
+    }
+}
+
+static void __dispatch_ut_protocol_cb(tuya_protocol_event_t *event)
+{
+    s_protocol_num++;
+    s_raw.assign(event->raw, event->raw_len);
+    EXPECT_EQ(nullptr, event->root_json);
+}
+
+class MqttDispatchTest : public ::testing::Test {
+  protected:
+    tuya_mqtt_context_t *mqtt = nullptr;
+
+    void SetUp() override
+    {
+        s_hits.clear();
+        s_raw.clear();
+        s_protocol_num = 0;
+        s_frame_changed = 0;
+        mqtt = ut_mqtt_open();
+        ASSERT_NE(nullptr, mqtt);
+    }
+
+    void TearDown() override
+    {
+        ut_mqtt_close();
+    }
+
+    std::string hits(const char *topic)
+    {
+        std::string out;
+
+        s_hits.clear();
+        EXPECT_EQ(OPRT_OK, ut_broker_message(topic, (const uint8_t *)"x", 1));
+        std::sort(s_hits.begin(), s_hits.end());
+        for (auto &h : s_hits) {
+            out += (out.empty() ? "" : " ") + h;
+        }
+        return out;
+    }
+};
+
+TEST_F(MqttDispatchTest, topic_filter_match)
+{
+    for (size_t i = 0; i < DISPATCH_UT_FILTER_NUM; i++) {
+        ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, s_filters[i], __dispatch_ut_topic_cb,
+                                                                          (void *)s_filters[i]));
+    }
+
+    EXPECT_EQ("# +/b a/# a/+ a/b a/b/#", hits("a/b"));
+    EXPECT_EQ("# a/# a/+", hits("a/c"));
+    // "a/#" and "a/b/#" match their parent level too
+    EXPECT_EQ("# a/#", hits("a"));
+    EXPECT_EQ("# +/+/c a/# a/b/#", hits("a/b/c"));
+    EXPECT_EQ("# +/b", hits("x/b"));
+    EXPECT_EQ("# a/#", hits("a//b"));
+    EXPECT_EQ("# a/# a/+", hits("a/"));
+    // wildcards at the first level do not match $ topics
+    EXPECT_EQ("$SYS/# $SYS/+", hits("$SYS/b"));
+    EXPECT_EQ("$SYS/#", hits("$SYS/x/c"));
+}
+
+TEST_F(MqttDispatchTest, unregister_prunes_levels)
+{
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, "a/b/c", __dispatch_ut_topic_cb,
+                                                                      (void *)"a/b/c"));
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, "a/+", __dispatch_ut_topic_cb,
+                                                                      (void *)"a/+"));
+    // the same callback twice is one subscription
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, "a/+", __dispatch_ut_topic_cb,
+                                                                      (void *)"a/+"));
+    EXPECT_EQ("a/+", hits("a/b"));
+    EXPECT_EQ("a/b/c", hits("a/b/c"));
+
+    EXPECT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_unregister(mqtt, "a/b/c"));
+    EXPECT_EQ("", hits("a/b/c"));
+    EXPECT_EQ("a/+", hits("a/b"));
+
+    EXPECT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_unregister(mqtt, "a/+"));
+    EXPECT_EQ("", hits("a/b"));
+
+    // only the levels of topic_in are left
+    int levels = 0;
+    for (const mqtt_topic_node_t *node = mqtt->subscribe_root.child; node; node = node->child) {
+        EXPECT_EQ(nullptr, node->sibling);
+        levels++;
+    }
+    EXPECT_EQ(4, levels);
+}
+
+TEST_F(MqttDispatchTest, protocol_id_scan)
+{
+    EXPECT_EQ(5, ut_mqtt_protocol_id_scan("{\"protocol\":5,\"t\":1,\"data\":{}}"));
+    EXPECT_EQ(64, ut_mqtt_protocol_id_scan("{\"t\":1, \"protocol\" : 64}"));
+    EXPECT_EQ(302, ut_mqtt_protocol_id_scan("{\"data\":{\"protocol\":9},\"protocol\":302}"));
+    EXPECT_EQ(7, ut_mqtt_protocol_id_scan("{\"s\":\"x\\\"protocol\\\":8\",\"protocol\":7}"));
+    EXPECT_EQ(-1, ut_mqtt_protocol_id_scan("{\"data\":{\"protocol\":9}}"));
+    EXPECT_EQ(-1, ut_mqtt_protocol_id_scan("{\"protocol\":\"5\"}"));
+    EXPECT_EQ(-1, ut_mqtt_protocol_id_scan("{\"protocol"));
+}
+
+TEST_F(MqttDispatchTest, protocol_raw_handler)
+{
+    uint8_t buf[512];
+    uint32_t len = 0;
+
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_protocol_register_raw(mqtt, 5, __dispatch_ut_protocol_cb, NULL));
+
+    ASSERT_EQ(OPRT_OK, ut_mqtt_message_pack(5, "{\"dps\":{\"1\":true}}", buf, sizeof(buf), &len));
+    ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    EXPECT_EQ(1u, s_protocol_num);
+    EXPECT_NE(std::string::npos, s_raw.find("\"protocol\":5"));
+    EXPECT_NE(std::string::npos, s_raw.find("\"data\":{\"dps\":{\"1\":true}}"));
+
+    // same bucket, other id, no handler and no cJSON tree
+    ASSERT_EQ(OPRT_OK, ut_mqtt_message_pack(5 + TUYA_PROTOCOL_TABLE_SIZE, "{}", buf, sizeof(buf), &len));
+    ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    EXPECT_EQ(1u, s_protocol_num);
+
+    EXPECT_EQ(OPRT_OK, tuya_mqtt_protocol_unregister(mqtt, 5, __dispatch_ut_protocol_cb));
+    ASSERT_EQ(OPRT_OK, ut_mqtt_message_pack(5, "{}", buf, sizeof(buf), &len));
+    ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    EXPECT_EQ(1u, s_protocol_num);
+}
+
+TEST_F(MqttDispatchTest, protocol_alloc_per_frame)
+{
+    const uint32_t frame_num = 100;
+    uint8_t buf[512];
+    uint32_t len = 0;
+    uint32_t alloc_num = 0;
+
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_protocol_register_raw(mqtt, 5, __dispatch_ut_protocol_cb, NULL));
+    ASSERT_EQ(OPRT_OK, ut_mqtt_message_pack(5, "{\"dps\":{\"1\":true,\"2\":30}}", buf, sizeof(buf), &len));
+    s_frame.assign((const char *)buf, len);
+
+    // the default handler is the only one, the frame is decrypted where it was received
+    alloc_num = ut_alloc_num();
+    for (uint32_t i = 0; i < frame_num; i++) {
+        ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    }
+    EXPECT_EQ(0u, ut_alloc_num() - alloc_num);
+    EXPECT_EQ(frame_num, s_protocol_num);
+
+    // shared with another handler called after it, the default handler decrypts a copy
+    EXPECT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_unregister(mqtt, DISPATCH_UT_TOPIC_IN));
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, DISPATCH_UT_TOPIC_IN,
+                                                                      __dispatch_ut_frame_cb, NULL));
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, DISPATCH_UT_TOPIC_IN, NULL, mqtt));
+    alloc_num = ut_alloc_num();
+    for (uint32_t i = 0; i < frame_num; i++) {
+        ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    }
+    EXPECT_EQ(frame_num, ut_alloc_num() - alloc_num);
+    EXPECT_EQ(2 * frame_num, s_protocol_num);
+    EXPECT_EQ(0u, s_frame_changed);
+    EXPECT_NE(std::string::npos, s_raw.find("\"data\":{\"dps\":{\"1\":true,\"2\":30}}"));
+
+    // alone again
+    EXPECT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_unregister(mqtt, DISPATCH_UT_TOPIC_IN));
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, DISPATCH_UT_TOPIC_IN, NULL, mqtt));
+    alloc_num = ut_alloc_num();
+    ASSERT_EQ(OPRT_OK, ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len));
+    EXPECT_EQ(0u, ut_alloc_num() - alloc_num);
+    EXPECT_EQ(2 * frame_num + 1, s_protocol_num);
+}
+
+TEST_F(MqttDispatchTest, benchmark_dispatch)
+{
+    const uint32_t msg_num = 200000;
+    const char *topics[] = {"smart/device/out/a", "smart/device/in/b", "smart/ota/c", "d/ai/x"};
+    uint8_t msg[64] = {0};
+    uint8_t buf[512];
+    uint32_t len = 0;
+
+    // a few filters besides topic_in, as a device has
+    for (auto topic : topics) {
+        ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, topic, __dispatch_ut_count_cb, NULL));
+    }
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_subscribe_message_callback_register(mqtt, "smart/+/+/e", __dispatch_ut_count_cb,
+                                                                      NULL));
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < msg_num; i++) {
+        ut_broker_message(topics[i % 4], msg, sizeof(msg));
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(msg_num, s_protocol_num);
+    printf("[ BENCH    ] topic dispatch: %.0f msg/s\n", msg_num / sec);
+
+    // decrypt, id scan and a raw handler, the payload is copied in as the client receives it
+    s_protocol_num = 0;
+    ASSERT_EQ(OPRT_OK, tuya_mqtt_protocol_register_raw(mqtt, 5, __dispatch_ut_protocol_cb, NULL));
+    ASSERT_EQ(OPRT_OK, ut_mqtt_message_pack(5, "{\"dps\":{\"1\":true,\"2\":30}}", buf, sizeof(buf), &len));
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < msg_num / 4; i++) {
+        ut_broker_message(DISPATCH_UT_TOPIC_IN, buf, len);
+    }
+    sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(msg_num / 4, s_protocol_num);
+    printf("[ BENCH    ] protocol dispatch: %.0f msg/s, %u bytes\n", msg_num / 4 / sec, len);
+}
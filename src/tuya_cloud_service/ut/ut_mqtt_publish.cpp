@@ -0,0 +1,218 @@
+/**
+ * @file ut_mqtt_publish.cpp
+ * @brief QoS1 publish test cases of mqtt_service against the local broker
+ * stand-in, the inflight window, PUBACK matching, timeouts and resends, the
+ * reconnect back-off, and a publish throughput benchmark.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+extern "C" {
+#include "tal_api.h"
+#include "ut_mqtt_service_drv.h"
+}
+
+#define PUBLISH_UT_TOPIC   "smart/device/out/ut_devid_0123456789"
+#define PUBLISH_UT_TIMEOUT (3000)
+
+static std::map<intptr_t, int> s_result; // user_data -> result, once per publish
+static uint32_t s_notify_num = 0;
+
+static void __publish_ut_notify(int result, void *user_data)
+{
+    s_notify_num++;
+    EXPECT_EQ(0u, s_result.count((intptr_t)user_data)) << "notified twice " << (intptr_t)user_data;
+    s_result[(intptr_t)user_data] = result;
+}
+
+class MqttPublishTest : public ::testing::Test {
+  protected:
+    tuya_mqtt_context_t *mqtt = nullptr;
+    uint8_t payload[64] = {0};
+
+    void SetUp() override
+    {
+        s_result.clear();
+        s_notify_num = 0;
+        mqtt = ut_mqtt_open();
+        ASSERT_NE(nullptr, mqtt);
+        ASSERT_TRUE(tuya_mqtt_connected(mqtt));
+    }
+
+    void TearDown() override
+    {
+        ut_mqtt_close();
+    }
+
+    int publish(intptr_t tag, int timeout_ms = PUBLISH_UT_TIMEOUT, bool async = false)
+    {
+        return tuya_mqtt_client_publish_common(mqtt, PUBLISH_UT_TOPIC, payload, sizeof(payload), __publish_ut_notify,
+                                               (void *)tag, timeout_ms, async);
+    }
+
+    tuya_mqtt_publish_stat_t stat()
+    {
+        tuya_mqtt_publish_stat_t st;
+        EXPECT_EQ(OPRT_OK, tuya_mqtt_publish_stat_get(mqtt, &st));
+        return st;
+    }
+};
+
+TEST_F(MqttPublishTest, ack_on_yield)
+{
+    for (intptr_t i = 0; i < MQTT_PUBLISH_INFLIGHT_MAX; i++) {
+        ASSERT_EQ(OPRT_OK, publish(i));
+    }
+    EXPECT_EQ((uint32_t)MQTT_PUBLISH_INFLIGHT_MAX, stat().inflight);
+
+    tuya_mqtt_loop(mqtt);
+
+    EXPECT_EQ((uint32_t)MQTT_PUBLISH_INFLIGHT_MAX, s_notify_num);
+    for (auto &r : s_result) {
+        EXPECT_EQ(OPRT_OK, r.second);
+    }
+    tuya_mqtt_publish_stat_t st = stat();
+    EXPECT_EQ(0u, st.inflight);
+    EXPECT_EQ((uint32_t)MQTT_PUBLISH_INFLIGHT_MAX, st.acked);
+    EXPECT_EQ(0u, st.retransmit);
+}
+
+TEST_F(MqttPublishTest, window_full_backpressure)
+{
+    ut_broker_hold_ack(true);
+    for (intptr_t i = 0; i < MQTT_PUBLISH_INFLIGHT_MAX; i++) {
+        ASSERT_EQ(OPRT_OK, publish(i));
+    }
+
+    // refused without a notify, the caller keeps the payload
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, publish(MQTT_PUBLISH_INFLIGHT_MAX));
+    EXPECT_EQ(1u, stat().window_full);
+    EXPECT_EQ(0u, s_notify_num);
+
+    // one PUBACK opens one slot
+    EXPECT_EQ(1u, ut_broker_ack(1, false));
+    EXPECT_EQ(OPRT_OK, publish(MQTT_PUBLISH_INFLIGHT_MAX));
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, publish(MQTT_PUBLISH_INFLIGHT_MAX + 1));
+    EXPECT_EQ((uint32_t)MQTT_PUBLISH_INFLIGHT_MAX, stat().inflight);
+}
+
+TEST_F(MqttPublishTest, random_acks_across_msgid_wrap)
+{
+    const intptr_t publish_num = 5000;
+    intptr_t tag = 0;
+
+    // msgids wrap past 65535 and skip 0 while publishes are inflight
+    srand(1);
+    ut_broker_set_msgid(65535 - 2000);
+    ut_broker_hold_ack(true);
+
+    while (tag < publish_num) {
+        while (tag < publish_num && OPRT_OK == publish(tag)) {
+            tag++;
+        }
+        ut_broker_ack(1 + rand() % MQTT_PUBLISH_INFLIGHT_MAX, true);
+    }
+    ut_broker_ack(ut_broker_pending_num(), true);
+
+    EXPECT_EQ((uint32_t)publish_num, s_notify_num);
+    for (auto &r : s_result) {
+        EXPECT_EQ(OPRT_OK, r.second);
+    }
+    EXPECT_EQ(0u, stat().inflight);
+    EXPECT_EQ((uint32_t)publish_num, stat().acked);
+}
+
+TEST_F(MqttPublishTest, timeout_without_ack)
+{
+    ut_broker_hold_ack(true);
+    ASSERT_EQ(OPRT_OK, publish(0, 20));
+    ASSERT_EQ(OPRT_OK, publish(1, PUBLISH_UT_TIMEOUT));
+
+    tal_system_sleep(40);
+    tuya_mqtt_loop(mqtt);
+
+    // only the expired one, its late PUBACK is ignored
+    EXPECT_EQ(1u, s_notify_num);
+    EXPECT_EQ(OPRT_TIMEOUT, s_result[0]);
+    EXPECT_EQ(2u, ut_broker_ack(2, false));
+    EXPECT_EQ(2u, s_notify_num);
+    EXPECT_EQ(OPRT_OK, s_result[1]);
+
+    tuya_mqtt_publish_stat_t st = stat();
+    EXPECT_EQ(1u, st.timeout);
+    EXPECT_EQ(1u, st.acked);
+    EXPECT_EQ(0u, st.inflight);
+}
+
+TEST_F(MqttPublishTest, resend_after_reconnect)
+{
+    const intptr_t publish_num = 4;
+
+    ut_broker_hold_ack(true);
+    for (intptr_t i = 0; i < publish_num; i++) {
+        ASSERT_EQ(OPRT_OK, publish(i));
+    }
+    // queued while disconnected, sent with the others after the reconnect
+    ut_broker_drop();
+    ASSERT_EQ(OPRT_OK, publish(publish_num, PUBLISH_UT_TIMEOUT, true));
+    EXPECT_EQ(0u, s_notify_num);
+    EXPECT_EQ((uint32_t)publish_num, ut_broker_publish_num());
+
+    ut_broker_hold_ack(false);
+    tuya_mqtt_loop(mqtt); // reconnect
+    ASSERT_TRUE(tuya_mqtt_connected(mqtt));
+    tuya_mqtt_loop(mqtt); // resend and ack
+
+    EXPECT_EQ((uint32_t)publish_num + 1, s_notify_num);
+    EXPECT_EQ((uint32_t)publish_num * 2 + 1, ut_broker_publish_num());
+    tuya_mqtt_publish_stat_t st = stat();
+    EXPECT_EQ((uint32_t)publish_num, st.retransmit);
+    EXPECT_EQ((uint32_t)publish_num + 1, st.acked);
+    EXPECT_EQ(0u, st.inflight);
+}
+
+TEST_F(MqttPublishTest, reconnect_backoff_left_to_caller)
+{
+    ut_broker_drop();
+    ut_broker_refuse(true);
+
+    // the loop returns at once, the caller waits the back-off
+    tuya_mqtt_loop(mqtt);
+    EXPECT_FALSE(tuya_mqtt_connected(mqtt));
+    EXPECT_GT(mqtt->retry_delay_ms, 0u);
+
+    ut_broker_refuse(false);
+    tuya_mqtt_loop(mqtt);
+    EXPECT_TRUE(tuya_mqtt_connected(mqtt));
+    EXPECT_EQ(0u, mqtt->retry_delay_ms);
+}
+
+TEST_F(MqttPublishTest, benchmark_publish_ack)
+{
+    const intptr_t publish_num = 200000;
+    intptr_t tag = 0;
+
+    ut_broker_hold_ack(true);
+    auto start = std::chrono::steady_clock::now();
+    while (tag < publish_num) {
+        while (tag < publish_num && OPRT_OK == publish(tag)) {
+            tag++;
+        }
+        // acks come back in batches, not always in order
+        ut_broker_ack(MQTT_PUBLISH_INFLIGHT_MAX / 2, 0 == (tag & 1));
+    }
+    ut_broker_ack(ut_broker_pending_num(), false);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    tuya_mqtt_publish_stat_t st = stat();
+    EXPECT_EQ((uint32_t)publish_num, st.acked);
+    printf("[ BENCH    ] window %d: %.0f publish+ack/s, window full %u, ack rtt avg %u ms max %u ms\n",
+           MQTT_PUBLISH_INFLIGHT_MAX, publish_num / sec, st.window_full, st.ack_rtt_avg, st.ack_rtt_max);
+}
@@ -0,0 +1,334 @@
+/**
+ * @file ut_mqtt_service_drv.c
+ * @brief builds mqtt_service.c on a local broker stand-in instead of the MQTT
+ * client, the cases decide when the broker connects, acks and drops.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tuya_cloud_types.h"
+
+#define mqtt_client_new         __ut_broker_new
+#define mqtt_client_free        __ut_broker_free
+#define mqtt_client_init        __ut_broker_init
+#define mqtt_client_deinit      __ut_broker_deinit
+#define mqtt_client_connect     __ut_broker_connect
+#define mqtt_client_disconnect  __ut_broker_disconnect
+#define mqtt_client_yield       __ut_broker_yield
+#define mqtt_client_subscribe   __ut_broker_subscribe
+#define mqtt_client_unsubscribe __ut_broker_unsubscribe
+#define mqtt_client_publish     __ut_broker_publish
+
+#include "../cloud/mqtt_service.c"
+
+#include "ut_mqtt_service_drv.h"
+
+#define UT_BROKER_PENDING_MAX (256)
+#define UT_BROKER_RECV_MAX    (4096)
+#define UT_HEAP_BLOCK_MAX     (256)
+
+typedef struct {
+    mqtt_client_config_t config;
+    bool connected;
+    bool refuse;   // connects fail
+    bool hold_ack; // PUBACKs wait for ut_broker_ack
+    uint16_t msgid;
+    uint32_t publish_num;
+    uint16_t pending[UT_BROKER_PENDING_MAX]; // QoS1 publishes not acked yet
+    uint32_t pending_num;
+    uint8_t recv_buf[UT_BROKER_RECV_MAX]; // the client receive buffer, topic then payload
+} UT_BROKER_T;
+
+typedef struct {
+    void *ptr;
+    size_t size;
+} UT_HEAP_BLOCK_T;
+
+static UT_BROKER_T sg_broker;
+static tuya_mqtt_context_t sg_mqtt;
+static uint32_t sg_alloc_num;
+
+/* blocks allocated while the heap is tracked, with the bytes live and the peak */
+static bool sg_heap_track;
+static UT_HEAP_BLOCK_T sg_heap_block[UT_HEAP_BLOCK_MAX];
+static size_t sg_heap_used;
+static size_t sg_heap_peak;
+
+static void __ut_heap_add(void *ptr, size_t size)
+{
+    uint32_t i;
+
+    if (!sg_heap_track || NULL == ptr) {
+        return;
+    }
+    for (i = 0; i < UT_HEAP_BLOCK_MAX; i++) {
+        if (NULL == sg_heap_block[i].ptr) {
+            sg_heap_block[i].ptr = ptr;
+            sg_heap_block[i].size = size;
+            sg_heap_used += size;
+            if (sg_heap_used > sg_heap_peak) {
+                sg_heap_peak = sg_heap_used;
+            }
+            return;
+        }
+    }
+}
+
+/* every tal_malloc, tal_calloc and tal_free of the test binary, linked with --wrap */
+void *__real_tal_malloc(size_t size);
+void *__real_tal_calloc(size_t nitems, size_t size);
+void __real_tal_free(void *ptr);
+
+void *__wrap_tal_malloc(size_t size)
+{
+    void *ptr = __real_tal_malloc(size);
+
+    sg_alloc_num++;
+    __ut_heap_add(ptr, size);
+    return ptr;
+}
+
+void *__wrap_tal_calloc(size_t nitems, size_t size)
+{
+    void *ptr = __real_tal_calloc(nitems, size);
+
+    sg_alloc_num++;
+    __ut_heap_add(ptr, nitems * size);
+    return ptr;
+}
+
+void __wrap_tal_free(void *ptr)
+{
+    uint32_t i;
+
+    for (i = 0; sg_heap_track && ptr && i < UT_HEAP_BLOCK_MAX; i++) {
+        if (ptr == sg_heap_block[i].ptr) {
+            sg_heap_used -= sg_heap_block[i].size;
+            sg_heap_block[i].ptr = NULL;
+            break;
+        }
+    }
+    __real_tal_free(ptr);
+}
+
+static uint16_t __ut_broker_next_msgid(void)
+{
+    if (0 == ++sg_broker.msgid) {
+        sg_broker.msgid = 1;
+    }
+    return sg_broker.msgid;
+}
+
+void *mqtt_client_new(void)
+{
+    return &sg_broker;
+}
+
+void mqtt_client_free(void *client)
+{
+}
+
+mqtt_client_status_t mqtt_client_init(void *client, const mqtt_client_config_t *config)
+{
+    sg_broker.config = *config;
+    return MQTT_STATUS_SUCCESS;
+}
+
+mqtt_client_status_t mqtt_client_deinit(void *client)
+{
+    return MQTT_STATUS_SUCCESS;
+}
+
+mqtt_client_status_t mqtt_client_connect(void *client)
+{
+    if (sg_broker.refuse) {
+        return MQTT_STATUS_NETWORK_CONNECT_FAILED;
+    }
+
+    sg_broker.connected = true;
+    sg_broker.config.on_connected(client, sg_broker.config.userdata);
+
+    return MQTT_STATUS_SUCCESS;
+}
+
+mqtt_client_status_t mqtt_client_disconnect(void *client)
+{
+    sg_broker.connected = false;
+    sg_broker.pending_num = 0;
+    sg_broker.config.on_disconnected(client, sg_broker.config.userdata);
+
+    return MQTT_STATUS_SUCCESS;
+}
+
+mqtt_client_status_t mqtt_client_yield(void *client)
+{
+    if (!sg_broker.hold_ack) {
+        ut_broker_ack(sg_broker.pending_num, false);
+    }
+
+    return MQTT_STATUS_SUCCESS;
+}
+
+uint16_t mqtt_client_subscribe(void *client, const char *topic, uint8_t qos)
+{
+    return sg_broker.connected ? __ut_broker_next_msgid() : 0;
+}
+
+uint16_t mqtt_client_unsubscribe(void *client, const char *topic, uint8_t qos)
+{
+    return sg_broker.connected ? __ut_broker_next_msgid() : 0;
+}
+
+uint16_t mqtt_client_publish(void *client, const char *topic, const uint8_t *payload, size_t length, uint8_t qos)
+{
+    uint16_t msgid = 0;
+
+    if (!sg_broker.connected || (MQTT_QOS_1 == qos && sg_broker.pending_num >= UT_BROKER_PENDING_MAX)) {
+        return 0;
+    }
+
+    msgid = __ut_broker_next_msgid();
+    sg_broker.publish_num++;
+    if (MQTT_QOS_1 == qos) {
+        sg_broker.pending[sg_broker.pending_num++] = msgid;
+    }
+
+    return msgid;
+}
+
+tuya_mqtt_context_t *ut_mqtt_open(void)
+{
+    const tuya_mqtt_config_t config = {
+        .host = "127.0.0.1",
+        .port = 1883,
+        .timeout = 3000,
+        .devid = "ut_devid_0123456789",
+        .seckey = "ut_seckey_012345",
+        .localkey = "ut_localkey_0123",
+    };
+
+    memset(&sg_broker, 0, sizeof(sg_broker));
+
+    if (OPRT_OK != tuya_mqtt_init(&sg_mqtt, &config) || OPRT_OK != tuya_mqtt_start(&sg_mqtt)) {
+        return NULL;
+    }
+
+    return &sg_mqtt;
+}
+
+void ut_mqtt_close(void)
+{
+    tuya_mqtt_destory(&sg_mqtt);
+}
+
+void ut_broker_set_msgid(uint16_t msgid)
+{
+    sg_broker.msgid = msgid;
+}
+
+void ut_broker_hold_ack(bool hold)
+{
+    sg_broker.hold_ack = hold;
+}
+
+void ut_broker_refuse(bool refuse)
+{
+    sg_broker.refuse = refuse;
+}
+
+uint32_t ut_broker_ack(uint32_t num, bool shuffle)
+{
+    uint32_t acked = 0, pos = 0;
+    uint16_t msgid = 0;
+
+    while (acked < num && sg_broker.pending_num > 0) {
+        pos = shuffle ? (uint32_t)rand() % sg_broker.pending_num : 0;
+        msgid = sg_broker.pending[pos];
+        memmove(&sg_broker.pending[pos], &sg_broker.pending[pos + 1],
+                (sg_broker.pending_num - pos - 1) * sizeof(sg_broker.pending[0]));
+        sg_broker.pending_num--;
+
+        sg_broker.config.on_published(&sg_broker, msgid, sg_broker.config.userdata);
+        acked++;
+    }
+
+    return acked;
+}
+
+void ut_broker_drop(void)
+{
+    sg_broker.connected = false;
+    sg_broker.pending_num = 0;
+    sg_broker.config.on_disconnected(&sg_broker, sg_broker.config.userdata);
+}
+
+OPERATE_RET ut_broker_message(const char *topic, const uint8_t *payload, size_t length)
+{
+    size_t topic_length = strlen(topic);
+    mqtt_client_message_t msg;
+
+    if (topic_length + 1 + length > UT_BROKER_RECV_MAX) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    // like the packet, the topic is not NUL terminated
+    memcpy(sg_broker.recv_buf, topic, topic_length);
+    sg_broker.recv_buf[topic_length] = '#';
+    memcpy(sg_broker.recv_buf + topic_length + 1, payload, length);
+
+    msg.topic = (const char *)sg_broker.recv_buf;
+    msg.topic_length = topic_length;
+    msg.payload = sg_broker.recv_buf + topic_length + 1;
+    msg.length = length;
+    msg.qos = MQTT_QOS_1;
+    sg_broker.config.on_message(&sg_broker, __ut_broker_next_msgid(), &msg, sg_broker.config.userdata);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET ut_mqtt_message_pack(uint16_t protocol_id, const char *data, uint8_t *buf, uint32_t size, uint32_t *len)
+{
+    if (tuya_pack_protocol_data_size(DP_CMD_MQ, data) > size) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    return tuya_pack_protocol_data_into(DP_CMD_MQ, data, protocol_id, sg_mqtt.cipher, buf, size, len);
+}
+
+int ut_mqtt_protocol_id_scan(const char *json)
+{
+    return tuya_protocol_id_scan(json, strlen(json));
+}
+
+uint32_t ut_broker_publish_num(void)
+{
+    return sg_broker.publish_num;
+}
+
+uint32_t ut_broker_pending_num(void)
+{
+    return sg_broker.pending_num;
+}
+
+uint32_t ut_alloc_num(void)
+{
+    return sg_alloc_num;
+}
+
+void ut_heap_track(bool track)
+{
+    memset(sg_heap_block, 0, sizeof(sg_heap_block));
+    sg_heap_used = 0;
+    sg_heap_peak = 0;
+    sg_heap_track = track;
+}
+
+size_t ut_heap_used(void)
+{
+    return sg_heap_used;
+}
+
+size_t ut_heap_peak(void)
+{
+    return sg_heap_peak;
+}
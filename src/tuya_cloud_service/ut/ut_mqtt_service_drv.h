@@ -0,0 +1,94 @@
+/**
+ * @file ut_mqtt_service_drv.h
+ * @brief the local broker stand-in of the mqtt_service cases, see ut_mqtt_service_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_MQTT_SERVICE_DRV_H__
+#define __UT_MQTT_SERVICE_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "mqtt_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief init and start a mqtt context connected to the stand-in
+ */
+tuya_mqtt_context_t *ut_mqtt_open(void);
+
+void ut_mqtt_close(void);
+
+/**
+ * @brief set the last msgid handed out, the next one follows it
+ */
+void ut_broker_set_msgid(uint16_t msgid);
+
+/**
+ * @brief hold PUBACKs until ut_broker_ack, otherwise every yield acks all
+ */
+void ut_broker_hold_ack(bool hold);
+
+/**
+ * @brief make the next connects fail
+ */
+void ut_broker_refuse(bool refuse);
+
+/**
+ * @brief send num PUBACKs, oldest first or in random order, returns the PUBACKs sent
+ */
+uint32_t ut_broker_ack(uint32_t num, bool shuffle);
+
+/**
+ * @brief drop the connection, the PUBACKs not sent yet are lost
+ */
+void ut_broker_drop(void);
+
+/**
+ * @brief deliver a message from the broker, its topic is not NUL terminated
+ */
+OPERATE_RET ut_broker_message(const char *topic, const uint8_t *payload, size_t length);
+
+/**
+ * @brief encrypt a protocol message for the topic_in of the context, as the cloud does
+ */
+OPERATE_RET ut_mqtt_message_pack(uint16_t protocol_id, const char *data, uint8_t *buf, uint32_t size, uint32_t *len);
+
+/**
+ * @brief the protocol id scanner of mqtt_service, -1 if absent
+ */
+int ut_mqtt_protocol_id_scan(const char *json);
+
+uint32_t ut_broker_publish_num(void);
+
+uint32_t ut_broker_pending_num(void);
+
+/**
+ * @brief tal_malloc and tal_calloc calls so far, the frees are not counted
+ */
+uint32_t ut_alloc_num(void);
+
+/**
+ * @brief start or stop counting the bytes of the blocks allocated from now on,
+ * on one thread, the counters restart from 0
+ */
+void ut_heap_track(bool track);
+
+/**
+ * @brief bytes allocated since ut_heap_track and not freed yet
+ */
+size_t ut_heap_used(void);
+
+/**
+ * @brief the most bytes in use at once since ut_heap_track
+ */
+size_t ut_heap_peak(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_MQTT_SERVICE_DRV_H__ */
@@ -0,0 +1,167 @@
+/**
+ * @file ut_tuya_lan.cpp
+ * @brief lan tcp command test cases, the allocations a dp command frame and
+ * its reply cost from the receive buffer through lpv35_frame_parse_inplace to
+ * lan_send, one frame alone and several in one read.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "tal_api.h"
+#include "tuya_protocol.h"
+#include "tuya_lan.h"
+#include "ut_mqtt_service_drv.h"
+#include "ut_tuya_lan_drv.h"
+}
+
+#define LAN_UT_CMD_HEAD_LEN 15 // "3.5", crc, sequence and source ahead of the json
+#define LAN_UT_BATCH        4  // command frames in one read, within the 512 bytes receive buffer
+#define LAN_UT_TIMEOUT      3000
+
+static const uint8_t s_session_key[16] = {0x6c, 0x61, 0x6e, 0x5f, 0x75, 0x74, 0x5f, 0x73,
+                                          0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x4b, 0x59};
+
+class TuyaLanTest : public ::testing::Test {
+  protected:
+    int app = -1;
+    uint32_t sequence = 0;
+
+    void SetUp() override
+    {
+        ASSERT_EQ(OPRT_OK, ut_lan_open());
+        app = ut_lan_connect();
+        ASSERT_GE(app, 0);
+        ASSERT_EQ(OPRT_OK, ut_lan_session_key_set(s_session_key));
+    }
+
+    void TearDown() override
+    {
+        ut_lan_close();
+        if (app >= 0) {
+            close(app);
+        }
+    }
+
+    // a dp command as the app encrypts it with the session key
+    std::vector<uint8_t> command(const std::string &dps)
+    {
+        std::string data = std::string("3.5") + std::string(LAN_UT_CMD_HEAD_LEN - 3, '\0') +
+                           "{\"protocol\":5,\"t\":1,\"data\":{\"dps\":" + dps + "}}";
+        lpv35_frame_object_t frame = {
+            .sequence = ++sequence, .type = FRM_TP_CMD, .data = (uint8_t *)&data[0], .data_len = (uint32_t)data.size()};
+        std::vector<uint8_t> buf(lpv35_frame_buffer_size_get(&frame));
+        int len = 0;
+
+        EXPECT_EQ(OPRT_OK, lpv35_frame_serialize(s_session_key, sizeof(s_session_key), &frame, buf.data(), &len));
+        buf.resize(len);
+        return buf;
+    }
+
+    bool recv_all(uint8_t *buf, size_t len)
+    {
+        struct pollfd pfd = {.fd = app, .events = POLLIN, .revents = 0};
+
+        while (len) {
+            if (poll(&pfd, 1, LAN_UT_TIMEOUT) <= 0) {
+                return false;
+            }
+            ssize_t n = read(app, buf, len);
+            if (n <= 0) {
+                return false;
+            }
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // the next frame the device sent, decrypted, out->data is freed by the caller
+    bool reply(lpv35_frame_object_t *out)
+    {
+        std::vector<uint8_t> frame(LPV35_FRAME_HEAD_SIZE + sizeof(lpv35_fixed_head_t));
+
+        if (!recv_all(frame.data(), frame.size())) {
+            return false;
+        }
+        lpv35_fixed_head_t *fixed = (lpv35_fixed_head_t *)(frame.data() + LPV35_FRAME_HEAD_SIZE);
+        size_t head_len = frame.size();
+        frame.resize(head_len + UNI_NTOHL(fixed->length) + LPV35_FRAME_TAIL_SIZE);
+        if (!recv_all(frame.data() + head_len, frame.size() - head_len)) {
+            return false;
+        }
+        return OPRT_OK == lpv35_frame_parse(s_session_key, sizeof(s_session_key), frame.data(), frame.size(), out);
+    }
+
+    // a command reply carries a describe only when the command was refused
+    void expect_ack(const lpv35_frame_object_t &out)
+    {
+        EXPECT_EQ((uint32_t)FRM_TP_CMD, out.type);
+        EXPECT_EQ(sizeof(lpv35_plaintext_data_t), out.data_len);
+    }
+};
+
+// cJSON stays on the C heap here, the count covers the frame codec and the reply
+TEST_F(TuyaLanTest, command_allocations)
+{
+    std::vector<uint8_t> frame = command("{\"1\":true}");
+    lpv35_frame_object_t ack = {.sequence = 0, .type = 0, .data = NULL, .data_len = sizeof(lpv35_plaintext_data_t)};
+    lpv35_frame_object_t out = {0};
+
+    ASSERT_EQ((ssize_t)frame.size(), write(app, frame.data(), frame.size()));
+
+    // decrypted inside the receive buffer, the reply frame is the one block
+    uint32_t alloc_num = ut_alloc_num();
+    ut_heap_track(true);
+    ut_lan_client_read();
+    EXPECT_EQ(1u, ut_alloc_num() - alloc_num);
+    EXPECT_EQ((size_t)lpv35_frame_buffer_size_get(&ack), ut_heap_peak());
+    EXPECT_EQ(0u, ut_heap_used());
+    ut_heap_track(false);
+    EXPECT_EQ(1u, ut_lan_dp_num());
+
+    ASSERT_TRUE(reply(&out));
+    expect_ack(out);
+    tal_free(out.data);
+}
+
+TEST_F(TuyaLanTest, command_batch_allocations)
+{
+    std::vector<uint8_t> frames;
+    lpv35_frame_object_t out = {0};
+    uint32_t first = 0;
+
+    for (int i = 0; i < LAN_UT_BATCH; i++) {
+        std::vector<uint8_t> frame = command("{\"" + std::to_string(i + 1) + "\":true}");
+        frames.insert(frames.end(), frame.begin(), frame.end());
+    }
+    ASSERT_EQ((ssize_t)frames.size(), write(app, frames.data(), frames.size()));
+
+    // one read takes every frame, each costs its reply and nothing more
+    uint32_t alloc_num = ut_alloc_num();
+    ut_heap_track(true);
+    ut_lan_client_read();
+    EXPECT_EQ((uint32_t)LAN_UT_BATCH, ut_alloc_num() - alloc_num);
+    EXPECT_EQ(0u, ut_heap_used());
+    ut_heap_track(false);
+    EXPECT_EQ((uint32_t)LAN_UT_BATCH, ut_lan_dp_num());
+
+    for (int i = 0; i < LAN_UT_BATCH; i++) {
+        ASSERT_TRUE(reply(&out)) << i;
+        expect_ack(out);
+        if (0 == i) {
+            first = out.sequence;
+        }
+        EXPECT_EQ(first + i, out.sequence);
+        tal_free(out.data);
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * @file ut_tuya_lan_drv.c
+ * @brief builds tuya_lan.c with the socket loop, the fixed server ports and
+ * the dp dispatch replaced, the cases run the read handlers the loop would
+ * run, the object replaces the one of the library in the test binary.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tal_network.h"
+#include "lan_sock.h"
+#include "tuya_iot.h"
+#include "tuya_iot_dp.h"
+#include "cJSON.h"
+
+#include "ut_tuya_lan_drv.h"
+
+#define UT_LAN_SOCK_MAX 8
+
+static sloop_sock_t sg_sock[UT_LAN_SOCK_MAX];
+static tuya_iot_client_t sg_client;
+static uint32_t sg_dp_num;
+
+static OPERATE_RET __ut_lan_loop_init(void)
+{
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ut_lan_reg_sock(sloop_sock_t sock_info)
+{
+    int i;
+
+    for (i = 0; i < UT_LAN_SOCK_MAX; i++) {
+        if (NULL == sg_sock[i].read) {
+            sg_sock[i] = sock_info;
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+/* the loop closes a socket once it is unregistered */
+static OPERATE_RET __ut_lan_unreg_sock(int sock)
+{
+    int i;
+
+    for (i = 0; i < UT_LAN_SOCK_MAX; i++) {
+        if (sg_sock[i].read && sock == sg_sock[i].sock) {
+            memset(&sg_sock[i], 0, sizeof(sloop_sock_t));
+            tal_net_close(sock);
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_NOT_FOUND;
+}
+
+/* the servers take any free port, the cases connect to what they got */
+static TUYA_ERRNO __ut_lan_net_bind(const int fd, const TUYA_IP_ADDR_T addr, const uint16_t port)
+{
+    return tal_net_bind(fd, addr, 0);
+}
+
+static int __ut_lan_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, cJSON *cmd_js)
+{
+    sg_dp_num++;
+    cJSON_Delete(cmd_js);
+
+    return OPRT_OK;
+}
+
+#define tuya_sock_loop_init __ut_lan_loop_init
+#define tuya_reg_lan_sock   __ut_lan_reg_sock
+#define tuya_unreg_lan_sock __ut_lan_unreg_sock
+#define tal_net_bind        __ut_lan_net_bind
+#define tuya_iot_dp_parse   __ut_lan_dp_parse
+
+#include "../lan/tuya_lan.c"
+
+/* the socket of the last connected app */
+static sloop_sock_t *__ut_lan_client_get(void)
+{
+    int i;
+
+    for (i = UT_LAN_SOCK_MAX - 1; i >= 0; i--) {
+        if (lan_tcp_client_sock_read == sg_sock[i].read) {
+            return &sg_sock[i];
+        }
+    }
+
+    return NULL;
+}
+
+OPERATE_RET ut_lan_open(void)
+{
+    memset(sg_sock, 0, sizeof(sg_sock));
+    memset(&sg_client, 0, sizeof(sg_client));
+    sg_dp_num = 0;
+
+    sg_client.is_activated = true;
+    strcpy(sg_client.activate.localkey, UT_LAN_LOCALKEY);
+
+    return tuya_lan_init(&sg_client);
+}
+
+void ut_lan_close(void)
+{
+    tuya_lan_exit();
+}
+
+int ut_lan_connect(void)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = -1;
+
+    if (NULL == s_lan_mgr || 0 != getsockname(s_lan_mgr->tcp_serv_fd, (struct sockaddr *)&addr, &len)) {
+        return -1;
+    }
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (0 != connect(fd, (struct sockaddr *)&addr, len)) {
+        close(fd);
+        return -1;
+    }
+
+    // what the loop runs when the server socket turns readable
+    lan_tcp_serv_sock_read(s_lan_mgr->tcp_serv_fd);
+    if (NULL == __ut_lan_client_get()) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+OPERATE_RET ut_lan_session_key_set(const uint8_t *key)
+{
+    sloop_sock_t *sock = __ut_lan_client_get();
+    lan_session_t *session = sock ? lan_session_get_by_fd(sock->sock) : NULL;
+
+    if (NULL == session) {
+        return OPRT_NOT_FOUND;
+    }
+
+    memcpy(session->secret_key, key, SESSIONKEY_LEN);
+    return mbedtls_cipher_keyed_create(MBEDTLS_CIPHER_AES_128_GCM, session->secret_key, SESSIONKEY_LEN,
+                                       &session->cipher);
+}
+
+void ut_lan_client_read(void)
+{
+    sloop_sock_t *sock = __ut_lan_client_get();
+
+    if (sock) {
+        sock->read(sock->sock);
+    }
+}
+
+uint32_t ut_lan_dp_num(void)
+{
+    return sg_dp_num;
+}
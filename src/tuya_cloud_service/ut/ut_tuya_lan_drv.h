@@ -0,0 +1,53 @@
+/**
+ * @file ut_tuya_lan_drv.h
+ * @brief the lan service of an activated device on loopback sockets, with the
+ * socket loop left to the cases, see ut_tuya_lan_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_TUYA_LAN_DRV_H__
+#define __UT_TUYA_LAN_DRV_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UT_LAN_LOCALKEY "ut_localkey_0123"
+
+/**
+ * @brief init the lan service, its servers listen on ephemeral ports
+ */
+OPERATE_RET ut_lan_open(void);
+
+void ut_lan_close(void);
+
+/**
+ * @brief connect an app to the tcp server and accept it, returns the app side
+ * or -1
+ */
+int ut_lan_connect(void);
+
+/**
+ * @brief give the session of the last connected app the key the handshake
+ * agrees on, as FRM_SECURITY_TYPE5 does
+ */
+OPERATE_RET ut_lan_session_key_set(const uint8_t *key);
+
+/**
+ * @brief run the read handler the loop would run for the last connected app
+ */
+void ut_lan_client_read(void);
+
+/**
+ * @brief the dp commands handed to tuya_iot_dp_parse
+ */
+uint32_t ut_lan_dp_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_TUYA_LAN_DRV_H__ */
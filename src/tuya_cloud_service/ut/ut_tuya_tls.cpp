@@ -0,0 +1,117 @@
+/**
+ * @file ut_tuya_tls.cpp
+ * @brief TLS session cache test cases through tuya_tls_connect, the least
+ * recently used session is evicted, a session set up without verify is never
+ * offered to a connection that verifies, and a failed verify drops the session.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+extern "C" {
+#include "tal_api.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509.h"
+#include "ut_tuya_tls_drv.h"
+}
+
+#define TLS_UT_PORT 8883
+
+class TuyaTlsTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(OPRT_OK, ut_tls_open());
+    }
+
+    void TearDown() override
+    {
+        ut_tls_close();
+    }
+
+    // connects, true if the host had a session offered
+    bool offered(const std::string &host, bool verify = true, OPERATE_RET rt = OPRT_OK)
+    {
+        bool offered = false;
+        EXPECT_EQ(rt, ut_tls_connect(host.c_str(), TLS_UT_PORT, verify, &offered)) << host;
+        return offered;
+    }
+
+    tuya_tls_stat_t stat()
+    {
+        tuya_tls_stat_t stat;
+        EXPECT_EQ(OPRT_OK, tuya_tls_stat_get(&stat));
+        return stat;
+    }
+};
+
+TEST_F(TuyaTlsTest, lru_eviction)
+{
+    // fill the cache, then use h0 again so h1 is the least recently used
+    for (int i = 0; i < UT_TLS_SESSION_CACHE_NUM; i++) {
+        EXPECT_FALSE(offered("h" + std::to_string(i)));
+    }
+    EXPECT_TRUE(offered("h0"));
+    EXPECT_FALSE(offered("h" + std::to_string(UT_TLS_SESSION_CACHE_NUM)));
+
+    for (int i = 0; i <= UT_TLS_SESSION_CACHE_NUM; i++) {
+        if (1 != i) {
+            EXPECT_TRUE(offered("h" + std::to_string(i))) << i;
+        }
+    }
+    EXPECT_FALSE(offered("h1"));
+
+    tuya_tls_stat_t st = stat();
+    EXPECT_EQ(UT_TLS_SESSION_CACHE_NUM + 2u, st.full_num);
+    EXPECT_EQ(UT_TLS_SESSION_CACHE_NUM + 1u, st.resumed_num);
+    EXPECT_EQ(0u, st.fail_num);
+}
+
+TEST_F(TuyaTlsTest, unverified_session_not_offered_to_verify)
+{
+    EXPECT_FALSE(offered("host", false));
+    EXPECT_TRUE(offered("host", false));
+
+    // the unverified session is replaced by a verified one, which serves both
+    EXPECT_FALSE(offered("host", true));
+    EXPECT_TRUE(offered("host", true));
+    EXPECT_TRUE(offered("host", false));
+}
+
+TEST_F(TuyaTlsTest, dropped_after_failed_verify)
+{
+    // what mbedtls returns for an expired server certificate with verify required
+    UT_TLS_SERVER_T server = {.handshake_ret = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED,
+                              .verify_flags = MBEDTLS_X509_BADCERT_EXPIRED,
+                              .resume = true};
+
+    EXPECT_FALSE(offered("host"));
+
+    ut_tls_server_set(&server);
+    EXPECT_TRUE(offered("host", true, MBEDTLS_ERR_X509_CERT_VERIFY_FAILED));
+
+    server.handshake_ret = 0;
+    server.verify_flags = 0;
+    ut_tls_server_set(&server);
+    EXPECT_FALSE(offered("host"));
+
+    tuya_tls_stat_t st = stat();
+    EXPECT_EQ(2u, st.full_num);
+    EXPECT_EQ(0u, st.resumed_num);
+    EXPECT_EQ(1u, st.fail_num);
+}
+
+TEST_F(TuyaTlsTest, dropped_after_failed_handshake)
+{
+    UT_TLS_SERVER_T server = {.handshake_ret = MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE, .verify_flags = 0, .resume = true};
+
+    EXPECT_FALSE(offered("host"));
+
+    ut_tls_server_set(&server);
+    EXPECT_TRUE(offered("host", true, MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE));
+    EXPECT_FALSE(offered("host", true, MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE));
+}
@@ -0,0 +1,127 @@
+/**
+ * @file ut_tuya_tls_drv.c
+ * @brief builds tuya_tls.c with the handshake, the verify result and the
+ * session transfer of mbedtls replaced by a server stand-in, so the session
+ * cache is driven through tuya_tls_connect, the object replaces the one of
+ * the library in the test binary.
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS // session master secret
+#include "tuya_cloud_types.h"
+#include "tal_api.h"
+#include "tal_network.h"
+#include "tuya_tls.h"
+#include "mbedtls/ssl.h"
+
+#include "ut_tuya_tls_drv.h"
+
+static UT_TLS_SERVER_T sg_server;
+static bool sg_offered;
+static unsigned char sg_offered_master[48];
+static unsigned char sg_master[48];
+static unsigned char sg_master_seq;
+
+static OPERATE_RET __ut_net_set_timeout(const int fd, const int ms_timeout, const TUYA_TRANS_TYPE_E type)
+{
+    return OPRT_OK;
+}
+
+static int __ut_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session)
+{
+    sg_offered = true;
+    memcpy(sg_offered_master, session->master, sizeof(sg_offered_master));
+    return 0;
+}
+
+// the server resumes the session offered or sets up a new one
+static int __ut_ssl_handshake(mbedtls_ssl_context *ssl)
+{
+    if (sg_offered && sg_server.resume) {
+        memcpy(sg_master, sg_offered_master, sizeof(sg_master));
+    } else {
+        memset(sg_master, ++sg_master_seq, sizeof(sg_master));
+    }
+    return sg_server.handshake_ret;
+}
+
+static uint32_t __ut_ssl_get_verify_result(const mbedtls_ssl_context *ssl)
+{
+    return sg_server.verify_flags;
+}
+
+static int __ut_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *dst)
+{
+    memcpy(dst->master, sg_master, sizeof(sg_master));
+    return 0;
+}
+
+#define TUYA_TLS_SESSION_CACHE_NUM    UT_TLS_SESSION_CACHE_NUM
+#define TUYA_TLS_SESSION_PERSIST      0
+#define tal_net_set_timeout           __ut_net_set_timeout
+#define mbedtls_ssl_set_session       __ut_ssl_set_session
+#define mbedtls_ssl_handshake         __ut_ssl_handshake
+#define mbedtls_ssl_get_verify_result __ut_ssl_get_verify_result
+#define mbedtls_ssl_get_session       __ut_ssl_get_session
+
+#include "../tls/tuya_tls.c"
+
+static void __ut_tls_cache_clear(void)
+{
+    for (int i = 0; i < TUYA_TLS_SESSION_CACHE_NUM; i++) {
+        mbedtls_ssl_session_free(&s_tls_session[i].session);
+    }
+    memset(s_tls_session, 0, sizeof(s_tls_session));
+    s_tls_session_used = 0;
+    memset(&s_tls_stat, 0, sizeof(s_tls_stat));
+}
+
+OPERATE_RET ut_tls_open(void)
+{
+    UT_TLS_SERVER_T server = {.handshake_ret = 0, .verify_flags = 0, .resume = true};
+    OPERATE_RET rt = tuya_tls_init();
+
+    if (OPRT_OK == rt) {
+        __ut_tls_cache_clear();
+        ut_tls_server_set(&server);
+    }
+
+    return rt;
+}
+
+void ut_tls_close(void)
+{
+    __ut_tls_cache_clear();
+    mbedtls_ctr_drbg_free(&ty_ctr_drbg);
+    mbedtls_entropy_free(&ty_entropy);
+}
+
+void ut_tls_server_set(const UT_TLS_SERVER_T *server)
+{
+    sg_server = *server;
+}
+
+OPERATE_RET ut_tls_connect(const char *host, uint16_t port, bool verify, bool *offered)
+{
+    OPERATE_RET rt = OPRT_OK;
+    tuya_tls_config_t config;
+    tuya_tls_hander *handler = tuya_tls_connect_create();
+
+    if (NULL == handler) {
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(&config, 0, sizeof(config));
+    config.mode = TUYA_TLS_SERVER_CERT_MODE;
+    config.verify = verify;
+    tuya_tls_config_set(handler, &config);
+
+    sg_offered = false;
+    rt = tuya_tls_connect(handler, (char *)host, port, 0, 5);
+    *offered = sg_offered;
+
+    tuya_tls_disconnect(handler);
+    tuya_tls_connect_destroy(handler);
+
+    return rt;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file ut_tuya_tls_drv.h
+ * @brief tuya_tls connects to a server stand-in that decides the handshake,
+ * the verify result and whether the offered session is resumed, see
+ * ut_tuya_tls_drv.c
+ *
+ * @copyright Copyright (c) 2021-2024 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_TUYA_TLS_DRV_H__
+#define __UT_TUYA_TLS_DRV_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UT_TLS_SESSION_CACHE_NUM 4
+
+typedef struct {
+    int handshake_ret;     // mbedtls_ssl_handshake
+    uint32_t verify_flags; // mbedtls_ssl_get_verify_result
+    bool resume;           // an offered session is resumed
+} UT_TLS_SERVER_T;
+
+/**
+ * @brief init tuya_tls with an empty session cache and statistics, the
+ * server accepts every handshake and resumes the sessions offered
+ */
+OPERATE_RET ut_tls_open(void);
+
+void ut_tls_close(void);
+
+void ut_tls_server_set(const UT_TLS_SERVER_T *server);
+
+/**
+ * @brief one server cert connect and disconnect, offered tells if a cached
+ * session was offered
+ */
+OPERATE_RET ut_tls_connect(const char *host, uint16_t port, bool verify, bool *offered);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_TUYA_TLS_DRV_H__ */
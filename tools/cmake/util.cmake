@@ -56,6 +56,22 @@ function(list_uts RETURN DIR)
 endfunction()
 
 
+# ut directories of the app components, apps/<app>/<components>/<comp>/ut
+function(list_app_uts RETURN DIR)
+    execute_process(COMMAND "find" ${DIR} "-maxdepth" "5" "-wholename" "*ut/CMakeLists.txt"
+        OUTPUT_VARIABLE find_dir)
+    if("${find_dir}" STREQUAL "")
+        return()
+    endif()
+    string(REPLACE "\n" ";" sub_split ${find_dir})
+    foreach(s ${sub_split})
+        get_filename_component(ut_dir ${s} DIRECTORY)
+        list(APPEND ans ${ut_dir})
+    endforeach(s)
+    set(${RETURN} "${ans}" PARENT_SCOPE)
+endfunction()
+
+
 function(git_clone REPO DIR)
     if(EXISTS ${DIR})
         message(STATUS "[UTIL] Repo already exists [${DIR}]")